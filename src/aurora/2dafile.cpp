@@ -49,63 +49,190 @@ static const uint32 kVersion2b = MKTAG('V', '2', '.', 'b');
 
 namespace Aurora {
 
-TwoDARow::TwoDARow(TwoDAFile &parent) : _parent(&parent) {
+/** A fast tokenizer for the ASCII 2DA format.
+ *
+ *  This works exactly like a Common::StreamTokenizer with the rule
+ *  kRuleIgnoreAll, spaces and tabs as separators, " as the quote,
+ *  \n as the chunk end and \r as an ignored character. However, it
+ *  works directly on the raw data of the whole 2DA, instead of going
+ *  through the (virtual) stream interface character by character.
+ */
+class TwoDAFile::Tokenizer : boost::noncopyable {
+public:
+	Tokenizer(const byte *data, size_t size) : _data(data), _size(size), _pos(0) {
+	}
+
+	/** Did we reach the end of the data? */
+	bool eos() const {
+		return _pos >= _size;
+	}
+
+	/** Parse the current line into tokens. See StreamTokenizer::getTokens(). */
+	size_t getTokens(std::vector<Common::UString> &list, size_t min = 0, size_t max = SIZE_MAX,
+	                 const Common::UString &def = "") {
+
+		assert(max >= min);
+
+		list.clear();
+		list.reserve(min);
+
+		size_t realTokenCount = 0;
+		while (!isChunkEnd() && (realTokenCount < max)) {
+			if (!readToken())
+				continue;
+
+			list.push_back(Common::UString(_token));
+			realTokenCount++;
+		}
+
+		while (list.size() < min)
+			list.push_back(def);
+
+		return realTokenCount;
+	}
+
+	/** Skip past leading separators and ignored characters. */
+	void findFirstToken() {
+		while (!eos() && (isSeparator(_data[_pos]) || (_data[_pos] == '\r')))
+			_pos++;
+	}
+
+	/** Skip the next token. */
+	void skipToken() {
+		readToken();
+	}
+
+	/** Move to the start of the next line. */
+	void nextChunk() {
+		while (!eos() && (_data[_pos] != '\n'))
+			_pos++;
+
+		if (!eos())
+			_pos++;
+	}
+
+private:
+	const byte *_data;
+	size_t _size;
+	size_t _pos;
+
+	/** The raw (UTF-8) data of the last token read. */
+	std::string _token;
+
+	static bool isSeparator(byte c) {
+		return (c == ' ') || (c == '\t');
+	}
+
+	bool isChunkEnd() const {
+		return eos() || (_data[_pos] == '\n');
+	}
+
+	/** Read the next token into _token. Returns false if the token is empty. */
+	bool readToken() {
+		_token.clear();
+
+		bool inQuote   = false;
+		bool hasNull   = false;
+		bool separator = false;
+
+		while (!eos()) {
+			const byte c = _data[_pos];
+
+			if (c == '\r') {
+				_pos++;
+				continue;
+			}
+
+			if (c == '\"') {
+				inQuote = !inQuote;
+				_pos++;
+				continue;
+			}
+
+			if (!inQuote) {
+				// Stop right before the chunk end
+				if (c == '\n')
+					break;
+
+				if (isSeparator(c)) {
+					separator = true;
+					_pos++;
+					break;
+				}
+			}
+
+			_pos++;
+
+			// Cut off the token at a \0
+			hasNull = hasNull || (c == '\0');
+			if (hasNull)
+				continue;
+
+			/* The characters are taken as Latin-1, like the StreamTokenizer does.
+			 * Encode the upper half into UTF-8. */
+			if (c < 0x80) {
+				_token += (char) c;
+			} else {
+				_token += (char) (0xC0 | (c >> 6));
+				_token += (char) (0x80 | (c & 0x3F));
+			}
+		}
+
+		// Skip consecutive separators
+		if (separator)
+			while (!eos() && isSeparator(_data[_pos]))
+				_pos++;
+
+		return !_token.empty();
+	}
+};
+
+
+TwoDARow::TwoDARow(const TwoDAFile &parent, size_t index) : _parent(&parent), _index(index) {
 }
 
 TwoDARow::~TwoDARow() {
 }
 
 const Common::UString &TwoDARow::getString(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	const TwoDAFile::Column *cells = _parent->getColumn(_index, column);
+	if (!cells || cells->empty[_index])
 		return _parent->_defaultString;
 
-	return cell;
+	return cells->cells[_index];
 }
 
 const Common::UString &TwoDARow::getString(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultString;
-
-	return cell;
+	return getString(_parent->headerToColumn(column));
 }
 
 int32 TwoDARow::getInt(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	const TwoDAFile::Column *cells = _parent->getParsedColumn(_index, column);
+	if (!cells || cells->empty[_index])
 		return _parent->_defaultInt;
 
-	return _parent->parseInt(cell);
+	return cells->ints[_index];
 }
 
 int32 TwoDARow::getInt(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultInt;
-
-	return _parent->parseInt(cell);
+	return getInt(_parent->headerToColumn(column));
 }
 
 float TwoDARow::getFloat(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	const TwoDAFile::Column *cells = _parent->getParsedColumn(_index, column);
+	if (!cells || cells->empty[_index])
 		return _parent->_defaultFloat;
 
-	return _parent->parseFloat(cell);
+	return cells->floats[_index];
 }
 
 float TwoDARow::getFloat(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultFloat;
-
-	return _parent->parseFloat(cell);
+	return getFloat(_parent->headerToColumn(column));
 }
 
 bool TwoDARow::empty(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	const TwoDAFile::Column *cells = _parent->getColumn(_index, column);
+	if (!cells || cells->empty[_index])
 		return true;
 
 	return false;
@@ -115,23 +242,19 @@ bool TwoDARow::empty(const Common::UString &column) const {
 	return empty(_parent->headerToColumn(column));
 }
 
-static const Common::UString kEmpty;
-const Common::UString &TwoDARow::getCell(size_t n) const {
-	if (n >= _data.size())
-		return kEmpty;
 
-	return _data[n];
+TwoDAFile::Column::Column(size_t rowCount) : cells(rowCount), parsed(false) {
 }
 
 
 TwoDAFile::TwoDAFile(Common::SeekableReadStream &twoda) :
-	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this) {
+	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this, SIZE_MAX) {
 
 	load(twoda);
 }
 
 TwoDAFile::TwoDAFile(const GDAFile &gda) :
-	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this) {
+	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this, SIZE_MAX) {
 
 	load(gda);
 }
@@ -149,6 +272,10 @@ void TwoDAFile::clear() {
 		delete *row;
 	_rows.clear();
 
+	for (std::vector<Column *>::iterator column = _columns.begin(); column != _columns.end(); ++column)
+		delete *column;
+	_columns.clear();
+
 	_headerMap.clear();
 
 	_defaultString.clear();
@@ -188,39 +315,41 @@ void TwoDAFile::load(Common::SeekableReadStream &twoda) {
 }
 
 void TwoDAFile::read2a(Common::SeekableReadStream &twoda) {
-	Common::StreamTokenizer tokenize(Common::StreamTokenizer::kRuleIgnoreAll);
+	/* Read the whole rest of the 2DA in one go, and tokenize it in memory.
+	 *
+	 * Spaces and tabs act to separate cells, and we can quote spaces and
+	 * tabs with ". \n ends a whole row, and we're ignoring \r. */
 
-	// Spaces and tabs act to separate cells
-	tokenize.addSeparator(' ');
-	tokenize.addSeparator('\t');
-	// We can quote spaces and tabs with "
-	tokenize.addQuote('\"');
-	// \n ends a whole row
-	tokenize.addChunkEnd('\n');
-	// We're ignoring \r
-	tokenize.addIgnore('\r');
+	const size_t size = twoda.size() - twoda.pos();
 
-	readDefault2a(twoda, tokenize);
-	readHeaders2a(twoda, tokenize);
-	readRows2a(twoda, tokenize);
+	std::vector<byte> data(size);
+	if (size > 0)
+		if (twoda.read(&data[0], size) != size)
+			throw Common::Exception(Common::kReadError);
+
+	Tokenizer tokenize(data.empty() ? 0 : &data[0], data.size());
+
+	readDefault2a(tokenize);
+	readHeaders2a(tokenize);
+	readRows2a(tokenize);
 }
 
 void TwoDAFile::read2b(Common::SeekableReadStream &twoda) {
 	readHeaders2b(twoda);
-	skipRowNames2b(twoda);
-	readRows2b(twoda);
-}
 
-void TwoDAFile::readDefault2a(Common::SeekableReadStream &twoda,
-                              Common::StreamTokenizer &tokenize) {
+	const size_t rowCount = skipRowNames2b(twoda);
+
+	readRows2b(twoda, rowCount);
+}
 
+void TwoDAFile::readDefault2a(Tokenizer &tokenize) {
 	/* ASCII 2DA files can have default values that are returned for cells
 	 * that don't exist. They are specified in the second line, optionally
 	 * preceded by "Default:".
 	 */
 
 	std::vector<Common::UString> defaultRow;
-	tokenize.getTokens(twoda, defaultRow, 2);
+	tokenize.getTokens(defaultRow, 2);
 
 	if (defaultRow[0].equalsIgnoreCase("Default:"))
 		_defaultString = defaultRow[1];
@@ -228,51 +357,55 @@ void TwoDAFile::readDefault2a(Common::SeekableReadStream &twoda,
 	_defaultInt   = parseInt(_defaultString);
 	_defaultFloat = parseFloat(_defaultString);
 
-	tokenize.nextChunk(twoda);
+	tokenize.nextChunk();
 }
 
-void TwoDAFile::readHeaders2a(Common::SeekableReadStream &twoda,
-                              Common::StreamTokenizer &tokenize) {
-
+void TwoDAFile::readHeaders2a(Tokenizer &tokenize) {
 	/* Read the column headers of an ASCII 2DA file. */
 
-	while (!twoda.eos() && (tokenize.getTokens(twoda, _headers) == 0))
-		tokenize.nextChunk(twoda);
+	while (!tokenize.eos() && (tokenize.getTokens(_headers) == 0))
+		tokenize.nextChunk();
 
-	tokenize.nextChunk(twoda);
+	tokenize.nextChunk();
 }
 
-void TwoDAFile::readRows2a(Common::SeekableReadStream &twoda,
-                           Common::StreamTokenizer &tokenize) {
-
+void TwoDAFile::readRows2a(Tokenizer &tokenize) {
 	/* And now read the individual cells in the rows. */
 
-	size_t columnCount = _headers.size();
+	const size_t columnCount = _headers.size();
+
+	createColumns(0);
 
-	while (!twoda.eos()) {
-		TwoDARow *row = new TwoDARow(*this);
+	size_t rowCount = 0;
 
+	std::vector<Common::UString> cells;
+	while (!tokenize.eos()) {
 		/* Skip the first token, which is the row index, possibly indented.
 		 * The row index is implicit in the data and its use in the 2DA
 		 * file is only meant as a guideline for people editing the file by
 		 * hand. It might even be completely incorrect. */
-		tokenize.findFirstToken(twoda);
-		tokenize.skipToken(twoda);
+		tokenize.findFirstToken();
+		tokenize.skipToken();
 
 		// Read all the cells in the row
-		size_t count = tokenize.getTokens(twoda, row->_data, columnCount, columnCount, "****");
+		size_t count = tokenize.getTokens(cells, columnCount, columnCount, "****");
 
 		// And move to the next line
-		tokenize.nextChunk(twoda);
+		tokenize.nextChunk();
 
-		if (count == 0) {
-			// Ignore empty lines
-			delete row;
+		// Ignore empty lines
+		if (count == 0)
 			continue;
+
+		for (size_t i = 0; i < columnCount; i++) {
+			_columns[i]->cells.push_back(Common::UString());
+			_columns[i]->cells.back().swap(cells[i]);
 		}
 
-		_rows.push_back(row);
+		rowCount++;
 	}
+
+	createRows(rowCount);
 }
 
 void TwoDAFile::readHeaders2b(Common::SeekableReadStream &twoda) {
@@ -292,7 +425,7 @@ void TwoDAFile::readHeaders2b(Common::SeekableReadStream &twoda) {
 	}
 }
 
-void TwoDAFile::skipRowNames2b(Common::SeekableReadStream &twoda) {
+size_t TwoDAFile::skipRowNames2b(Common::SeekableReadStream &twoda) {
 	/* Next up are the row names / indices. Like for the ASCII 2DA files,
 	 * the actual row indices are implicit in the data, so we're just
 	 * ignoring them. The only information we care about is how many rows
@@ -300,7 +433,6 @@ void TwoDAFile::skipRowNames2b(Common::SeekableReadStream &twoda) {
 	 */
 
 	const uint32 rowCount = twoda.readUint32LE();
-	_rows.resize(rowCount, 0);
 
 	Common::StreamTokenizer tokenize(Common::StreamTokenizer::kRuleHeed);
 
@@ -309,9 +441,11 @@ void TwoDAFile::skipRowNames2b(Common::SeekableReadStream &twoda) {
 	tokenize.addSeparator('\0');
 
 	tokenize.skipToken(twoda, rowCount);
+
+	return rowCount;
 }
 
-void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
+void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda, size_t rowCount) {
 	/* And now read the cells. In binary 2DA files, each cell only
 	 * stores a single 16-bit number, the offset into the data segment
 	 * where the data for this cell can be found. Moreover, a single
@@ -320,7 +454,6 @@ void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
 	 */
 
 	size_t columnCount = _headers.size();
-	size_t rowCount    = _rows.size();
 	size_t cellCount   = columnCount * rowCount;
 
 	uint32 *offsets = new uint32[cellCount];
@@ -336,11 +469,9 @@ void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
 
 	size_t dataOffset = twoda.pos();
 
-	for (size_t i = 0; i < rowCount; i++) {
-		_rows[i] = new TwoDARow(*this);
-
-		_rows[i]->_data.resize(columnCount);
+	createColumns(rowCount);
 
+	for (size_t i = 0; i < rowCount; i++) {
 		for (size_t j = 0; j < columnCount; j++) {
 			size_t offset = dataOffset + offsets[i * columnCount + j];
 
@@ -351,16 +482,44 @@ void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
 				throw;
 			}
 
-			_rows[i]->_data[j] = tokenize.getToken(twoda);
-			if (_rows[i]->_data[j].empty())
-				_rows[i]->_data[j] = "****";
+			Common::UString &cell = _columns[j]->cells[i];
+
+			cell = tokenize.getToken(twoda);
+			if (cell.empty())
+				cell = "****";
 		}
 	}
 
 	delete[] offsets;
+
+	createRows(rowCount);
+}
+
+void TwoDAFile::createColumns(size_t rowCount) {
+	_columns.resize(_headers.size(), 0);
+
+	for (size_t i = 0; i < _columns.size(); i++)
+		_columns[i] = new Column(rowCount);
+}
+
+void TwoDAFile::createRows(size_t rowCount) {
+	// Mark the empty cells
+	for (std::vector<Column *>::iterator c = _columns.begin(); c != _columns.end(); ++c) {
+		assert((*c)->cells.size() == rowCount);
+
+		(*c)->empty.resize(rowCount);
+		for (size_t i = 0; i < rowCount; i++)
+			(*c)->empty[i] = (*c)->cells[i].empty() || ((*c)->cells[i] == "****");
+	}
+
+	_rows.resize(rowCount, 0);
+	for (size_t i = 0; i < rowCount; i++)
+		_rows[i] = new TwoDARow(*this, i);
 }
 
 void TwoDAFile::createHeaderMap() {
+	_headerMap.rehash(_headers.size());
+
 	for (size_t i = 0; i < _headers.size(); i++)
 		_headerMap.insert(std::make_pair(_headers[i], i));
 }
@@ -378,31 +537,31 @@ void TwoDAFile::load(const GDAFile &gda) {
 			_headers[i] = headerString ? headerString : Common::UString::format("[%u]", headers[i].hash);
 		}
 
-		_rows.resize(gda.getRowCount(), 0);
+		createColumns(gda.getRowCount());
+
 		for (size_t i = 0; i < gda.getRowCount(); i++) {
 			const GFF4Struct *row = gda.getRow(i);
 
-			_rows[i] = new TwoDARow(*this);
-			_rows[i]->_data.resize(gda.getColumnCount());
-
 			for (size_t j = 0; j < gda.getColumnCount(); j++) {
+				Common::UString &cell = _columns[j]->cells[i];
+
 				if (row) {
 					switch (headers[j].type) {
 						case GDAFile::kTypeString:
 						case GDAFile::kTypeResource:
-							_rows[i]->_data[j] = row->getString(headers[j].field);
+							cell = row->getString(headers[j].field);
 							break;
 
 						case GDAFile::kTypeInt:
-							_rows[i]->_data[j] = Common::UString::format("%d", (int) row->getSint(headers[j].field));
+							cell = Common::UString::format("%d", (int) row->getSint(headers[j].field));
 							break;
 
 						case GDAFile::kTypeFloat:
-							_rows[i]->_data[j] = Common::UString::format("%f", row->getDouble(headers[j].field));
+							cell = Common::UString::format("%f", row->getDouble(headers[j].field));
 							break;
 
 						case GDAFile::kTypeBool:
-							_rows[i]->_data[j] = Common::UString::format("%u", (uint) row->getUint(headers[j].field));
+							cell = Common::UString::format("%u", (uint) row->getUint(headers[j].field));
 							break;
 
 						default:
@@ -410,12 +569,14 @@ void TwoDAFile::load(const GDAFile &gda) {
 					}
 				}
 
-				if (_rows[i]->_data[j].empty())
-					_rows[i]->_data[j] = "****";
+				if (cell.empty())
+					cell = "****";
 
 			}
 		}
 
+		createRows(gda.getRowCount());
+
 	} catch (Common::Exception &e) {
 		clear();
 
@@ -460,15 +621,59 @@ const TwoDARow &TwoDAFile::getRow(const Common::UString &header, const Common::U
 	if (columnIndex == kFieldIDInvalid)
 		return _emptyRow;
 
-	for (std::vector<TwoDARow *>::const_iterator row = _rows.begin(); row != _rows.end(); ++row) {
-		if ((*row)->getString(columnIndex).equalsIgnoreCase(value))
-			return **row;
+	const Column &column = *_columns[columnIndex];
+	for (size_t i = 0; i < _rows.size(); i++) {
+		const Common::UString &cell = column.empty[i] ? _defaultString : column.cells[i];
+
+		if (cell.equalsIgnoreCase(value))
+			return *_rows[i];
 	}
 
 	// No such row
 	return _emptyRow;
 }
 
+const TwoDAFile::Column *TwoDAFile::getColumn(size_t row, size_t column) const {
+	if ((row >= _rows.size()) || (column >= _columns.size()))
+		return 0;
+
+	return _columns[column];
+}
+
+const TwoDAFile::Column *TwoDAFile::getParsedColumn(size_t row, size_t column) const {
+	if ((row >= _rows.size()) || (column >= _columns.size()))
+		return 0;
+
+	// Parse the column's numerical values the first time they're needed
+	Column *cells = _columns[column];
+	if (!cells->parsed.load(boost::memory_order_acquire))
+		parseColumn(*cells);
+
+	return cells;
+}
+
+void TwoDAFile::parseColumn(Column &column) const {
+	Common::StackLock lock(_parseMutex);
+
+	if (column.parsed.load(boost::memory_order_relaxed))
+		return;
+
+	const size_t rowCount = column.cells.size();
+
+	column.ints.resize(rowCount, 0);
+	column.floats.resize(rowCount, 0.0f);
+
+	for (size_t i = 0; i < rowCount; i++) {
+		if (column.empty[i])
+			continue;
+
+		column.ints  [i] = parseInt  (column.cells[i]);
+		column.floats[i] = parseFloat(column.cells[i]);
+	}
+
+	column.parsed.store(true, boost::memory_order_release);
+}
+
 void TwoDAFile::writeASCII(Common::WriteStream &out) const {
 	// Write header
 
@@ -489,9 +694,11 @@ void TwoDAFile::writeASCII(Common::WriteStream &out) const {
 		colLength[i + 1] = _headers[i].size();
 
 	for (size_t i = 0; i < _rows.size(); i++) {
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool   needQuote = _rows[i]->_data[j].contains(' ');
-			const size_t length    = needQuote ? _rows[i]->_data[j].size() + 2 : _rows[i]->_data[j].size();
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = _columns[j]->cells[i];
+
+			const bool   needQuote = cell.contains(' ');
+			const size_t length    = needQuote ? cell.size() + 2 : cell.size();
 
 			colLength[j + 1] = MAX<size_t>(colLength[j + 1], length);
 		}
@@ -511,14 +718,16 @@ void TwoDAFile::writeASCII(Common::WriteStream &out) const {
 	for (size_t i = 0; i < _rows.size(); i++) {
 		out.writeString(Common::UString::format("%*u", (int)colLength[0], (uint)i));
 
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool needQuote = _rows[i]->_data[j].contains(' ');
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = _columns[j]->cells[i];
+
+			const bool needQuote = cell.contains(' ');
 
 			Common::UString cellString;
 			if (needQuote)
-				cellString = Common::UString::format("\"%s\"", _rows[i]->_data[j].c_str());
+				cellString = Common::UString::format("\"%s\"", cell.c_str());
 			else
-				cellString = _rows[i]->_data[j];
+				cellString = cell;
 
 			out.writeString(Common::UString::format(" %-*s", (int)colLength[j + 1], cellString.c_str()));
 
@@ -670,19 +879,21 @@ void TwoDAFile::writeCSV(Common::WriteStream &out) const {
 	// Write array
 
 	for (size_t i = 0; i < _rows.size(); i++) {
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool needQuote = _rows[i]->_data[j].contains(',');
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = _columns[j]->cells[i];
+
+			const bool needQuote = cell.contains(',');
 
 			if (needQuote)
 				out.writeByte('"');
 
-			if (_rows[i]->_data[j] != "****")
-				out.writeString(_rows[i]->_data[j]);
+			if (cell != "****")
+				out.writeString(cell);
 
 			if (needQuote)
 				out.writeByte('"');
 
-			if (j < (_rows[i]->_data.size() - 1))
+			if (j < (_columns.size() - 1))
 				out.writeByte(',');
 		}
 
@@ -25,20 +25,22 @@
 #ifndef AURORA_2DAFILE_H
 #define AURORA_2DAFILE_H
 
+#include "src/common/atomic.h"
+
 #include <vector>
-#include <map>
 
 #include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/aurorafile.h"
 
 namespace Common {
 	class SeekableReadStream;
 	class WriteStream;
-	class StreamTokenizer;
 }
 
 namespace Aurora {
@@ -55,6 +57,9 @@ class GDAFile;
  *  For convenience's sake, there are also methods to directly parse
  *  the cell strings into integer or floating point values.
  *
+ *  A row itself holds no data, it only references its cells within
+ *  the columns of its parent TwoDAFile.
+ *
  *  See also class TwoDAFile.
  */
 class TwoDARow : boost::noncopyable {
@@ -80,15 +85,13 @@ public:
 	bool empty(const Common::UString &column) const;
 
 private:
-	TwoDAFile *_parent; ///< The parent 2DA.
+	const TwoDAFile *_parent; ///< The parent 2DA.
 
-	std::vector<Common::UString> _data;
+	size_t _index; ///< The index of this row within the parent 2DA.
 
-	TwoDARow(TwoDAFile &parent);
+	TwoDARow(const TwoDAFile &parent, size_t index);
 	~TwoDARow();
 
-	const Common::UString &getCell(size_t n) const;
-
 	friend class TwoDAFile;
 };
 
@@ -115,6 +118,17 @@ private:
  *  be read and modified with a simple text editor. The binary
  *  version cannot.
  *
+ *  Internally, the cells are stored column by column. Together with
+ *  the raw cell strings, each column knows which of its cells are
+ *  empty. The integer and floating point values of a column's cells
+ *  are parsed once, the first time a number is requested out of that
+ *  column, and are then kept around. Repeatedly reading numbers out
+ *  of a 2DA is therefore cheap.
+ *
+ *  Looking up a column by its header is a hash lookup. Code that reads
+ *  the same column out of many rows can instead look up the column
+ *  index once with headerToColumn() and then use that index directly.
+ *
  *  See also classes TwoDARow and TwoDARegistry.
  */
 class TwoDAFile : boost::noncopyable, public AuroraFile {
@@ -132,7 +146,11 @@ public:
 	/** Return the columns' headers. */
 	const std::vector<Common::UString> &getHeaders() const;
 
-	/** Translate a column header to a column index. */
+	/** Translate a column header to a column index.
+	 *
+	 *  The index can be used to read cells of that column out of any row
+	 *  of this 2DA, without looking up the header again.
+	 */
 	size_t headerToColumn(const Common::UString &header) const;
 
 	/** Get a row. */
@@ -159,7 +177,25 @@ public:
 	// '---
 
 private:
-	typedef std::map<Common::UString, size_t, Common::UString::iless> HeaderMap;
+	/** A column of cells. */
+	struct Column : boost::noncopyable {
+		std::vector<Common::UString> cells; ///< The raw contents of all cells.
+		std::vector<bool> empty;            ///< Is this cell empty?
+
+		/** Were the cells already parsed into ints and floats? */
+		boost::atomic<bool> parsed;
+
+		std::vector<int32> ints;   ///< The contents of all cells as ints.
+		std::vector<float> floats; ///< The contents of all cells as floats.
+
+		Column(size_t rowCount);
+	};
+
+	/** Fast tokenizer for the ASCII 2DA format. */
+	class Tokenizer;
+
+	typedef boost::unordered_map<Common::UString, size_t,
+	                             Common::hashUStringCaseInsensitive, Common::UString::iequal> HeaderMap;
 
 	Common::UString _defaultString; ///< The default string to return should a cell not exist.
 	int32           _defaultInt;    ///< The default int to return should a cell not exist.
@@ -171,6 +207,11 @@ private:
 	TwoDARow _emptyRow;
 	std::vector<TwoDARow *> _rows;
 
+	std::vector<Column *> _columns;
+
+	/** Protects the parsing of the columns' numerical values. */
+	mutable Common::Mutex _parseMutex;
+
 	// Loading helpers
 	void load(Common::SeekableReadStream &twoda);
 	void read2a(Common::SeekableReadStream &twoda);
@@ -178,20 +219,27 @@ private:
 	void clear();
 
 	// ASCII loading helpers
-	void readDefault2a(Common::SeekableReadStream &twoda, Common::StreamTokenizer &tokenize);
-	void readHeaders2a(Common::SeekableReadStream &twoda, Common::StreamTokenizer &tokenize);
-	void readRows2a   (Common::SeekableReadStream &twoda, Common::StreamTokenizer &tokenize);
+	void readDefault2a(Tokenizer &tokenize);
+	void readHeaders2a(Tokenizer &tokenize);
+	void readRows2a   (Tokenizer &tokenize);
 
 	// Binary loading helpers
-	void readHeaders2b (Common::SeekableReadStream &twoda);
-	void skipRowNames2b(Common::SeekableReadStream &twoda);
-	void readRows2b    (Common::SeekableReadStream &twoda);
+	void   readHeaders2b (Common::SeekableReadStream &twoda);
+	size_t skipRowNames2b(Common::SeekableReadStream &twoda);
+	void   readRows2b    (Common::SeekableReadStream &twoda, size_t rowCount);
 
 	// GDA loading/conversion helpers
 	void load(const GDAFile &gda);
 
+	void createColumns(size_t rowCount);
+	void createRows(size_t rowCount);
 	void createHeaderMap();
 
+	// Cell access helpers
+	const Column *getColumn(size_t row, size_t column) const;
+	const Column *getParsedColumn(size_t row, size_t column) const;
+	void parseColumn(Column &column) const;
+
 	static int32 parseInt(const Common::UString &str);
 	static float parseFloat(const Common::UString &str);
 
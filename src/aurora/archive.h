@@ -73,6 +73,9 @@ public:
 	 */
 	virtual Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const = 0;
 
+	/** Is this resource stored compressed or encrypted, needing to be decoded when read? */
+	virtual bool isResourceEncoded(uint32 index) const;
+
 	/** Return with which algorithm the name is hashed. */
 	virtual Common::HashAlgo getNameHashAlgo() const;
 
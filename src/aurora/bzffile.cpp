@@ -151,9 +151,7 @@ uint32 BZFFile::getResourceSize(uint32 index) const {
 Common::SeekableReadStream *BZFFile::getResource(uint32 index, bool UNUSED(tryNoCopy)) const {
 	const IResource &res = getIResource(index);
 
-	_bzf->seek(res.offset);
-
-	Common::MemoryReadStream   *packedStream = _bzf->readStream(res.packedSize);
+	Common::MemoryReadStream   *packedStream = _bzf->readStreamAt(res.offset, res.packedSize);
 	Common::SeekableReadStream *resStream    = 0;
 
 	try {
@@ -167,6 +165,11 @@ Common::SeekableReadStream *BZFFile::getResource(uint32 index, bool UNUSED(tryNo
 	return resStream;
 }
 
+bool BZFFile::isResourceEncoded(uint32 UNUSED(index)) const {
+	// All resources in a BZF are LZMA-compressed
+	return true;
+}
+
 Common::SeekableReadStream *BZFFile::decompress(Common::MemoryReadStream &packedStream,
                                                 uint32 unpackedSize) const {
 	lzma_filter filters[2];
@@ -66,6 +66,9 @@ public:
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
+	/** Is this resource stored compressed or encrypted? */
+	bool isResourceEncoded(uint32 index) const;
+
 	/** Merge information from the KEY into the BZF. */
 	void mergeKEY(const KEYFile &key, uint32 bifIndex);
 
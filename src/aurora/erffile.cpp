@@ -691,10 +691,8 @@ Common::SeekableReadStream *ERFFile::getResource(uint32 index, bool tryNoCopy) c
 	if (tryNoCopy && (_header.encryption == kEncryptionNone) && (_header.compression == kCompressionNone))
 		return new Common::SeekableSubReadStream(_erf, res.offset, res.offset + res.packedSize);
 
-	_erf->seek(res.offset);
-
 	// Read
-	Common::MemoryReadStream *stream = _erf->readStream(res.packedSize);
+	Common::MemoryReadStream *stream = _erf->readStreamAt(res.offset, res.packedSize);
 
 	// Decrypt
 	if (_header.encryption != kEncryptionNone)
@@ -704,6 +702,10 @@ Common::SeekableReadStream *ERFFile::getResource(uint32 index, bool tryNoCopy) c
 	return decompress(stream, res.unpackedSize);
 }
 
+bool ERFFile::isResourceEncoded(uint32 UNUSED(index)) const {
+	return (_header.encryption != kEncryptionNone) || (_header.compression != kCompressionNone);
+}
+
 Common::MemoryReadStream *ERFFile::decrypt(Common::SeekableReadStream &cryptStream,
                                            Encryption encryption, const std::vector<byte> &password) {
 	switch (encryption) {
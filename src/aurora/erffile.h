@@ -123,6 +123,9 @@ public:
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
+	/** Is this resource stored compressed or encrypted? */
+	bool isResourceEncoded(uint32 index) const;
+
 	/** Return the year the ERF was built. */
 	uint32 getBuildYear() const;
 	/** Return the day of year the ERF was built. */
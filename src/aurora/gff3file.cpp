@@ -28,7 +28,11 @@
 
 #include <cassert>
 
+#include <algorithm>
+
+#include "src/common/util.h"
 #include "src/common/error.h"
+#include "src/common/endianness.h"
 #include "src/common/memreadstream.h"
 #include "src/common/encoding.h"
 #include "src/common/ustring.h"
@@ -64,13 +68,13 @@ void GFF3File::Header::read(Common::SeekableReadStream &gff3) {
 
 
 GFF3File::GFF3File(Common::SeekableReadStream *gff3, uint32 id, bool repairNWNPremium) :
-	_stream(gff3), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
+	_stream(gff3), _data(0), _dataSize(0), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
 
 	load(id);
 }
 
 GFF3File::GFF3File(const Common::UString &gff3, FileType type, uint32 id, bool repairNWNPremium) :
-	_stream(0), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
+	_stream(0), _data(0), _dataSize(0), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
 
 	_stream = ResMan.getResource(gff3, type);
 	if (!_stream)
@@ -87,10 +91,18 @@ void GFF3File::clear() {
 	delete _stream;
 	_stream = 0;
 
+	delete[] _data;
+	_data     = 0;
+	_dataSize = 0;
+
 	for (StructArray::iterator strct = _structs.begin(); strct != _structs.end(); ++strct)
 		delete *strct;
 
 	_structs.clear();
+	_fields.clear();
+
+	_labels.clear();
+	_labelIDs.clear();
 }
 
 uint32 GFF3File::getType() const {
@@ -107,6 +119,7 @@ void GFF3File::load(uint32 id) {
 	try {
 
 		loadHeader(id);
+		loadData();
 		loadStructs();
 		loadLists();
 
@@ -116,6 +129,10 @@ void GFF3File::load(uint32 id) {
 		e.add("Failed reading GFF3 file");
 		throw;
 	}
+
+	// Everything else is read directly out of our data buffer
+	delete _stream;
+	_stream = 0;
 }
 
 void GFF3File::loadHeader(uint32 id) {
@@ -191,12 +208,114 @@ void GFF3File::loadHeader(uint32 id) {
 		throw Common::Exception("GFF3 header broken: section offset points outside stream");
 }
 
+void GFF3File::loadData() {
+	_dataSize = _stream->size();
+	_data     = new byte[_dataSize];
+
+	_stream->seek(0);
+	if (_stream->read(_data, _dataSize) != _dataSize)
+		throw Common::Exception(Common::kReadError);
+}
+
 void GFF3File::loadStructs() {
 	static const uint32 kStructSize = 12;
 
+	if ((_header.structOffset + (uint64) _header.structCount * kStructSize) > _dataSize)
+		throw Common::Exception("GFF3: Structs out of range");
+
 	_structs.reserve(_header.structCount);
-	for (uint32 i = 0; i < _header.structCount; i++)
-		_structs.push_back(new GFF3Struct(*this, _header.structOffset + i * kStructSize));
+	_fields.reserve(_header.fieldCount);
+
+	// IDs of the labels we've already read, indexed by their position in the label array
+	std::vector<uint32> labelIDs;
+
+	for (uint32 i = 0; i < _header.structCount; i++) {
+		const byte *strct = _data + _header.structOffset + i * kStructSize;
+
+		const uint32 id         = READ_LE_UINT32(strct);
+		const uint32 fieldIndex = READ_LE_UINT32(strct + 4);
+		const uint32 fieldCount = READ_LE_UINT32(strct + 8);
+
+		const size_t start = _fields.size();
+
+		// Read the field(s)
+		if      (fieldCount == 1)
+			readField (fieldIndex, labelIDs);
+		else if (fieldCount > 1)
+			readFields(fieldIndex, fieldCount, labelIDs);
+
+		/* Sort the struct's fields by their label, so we can find them quickly.
+		 * Of several fields with the same label, only the last one counts. */
+
+		std::stable_sort(_fields.begin() + start, _fields.end());
+
+		FieldArray::iterator last = _fields.begin() + start;
+		for (FieldArray::iterator f = last; f != _fields.end(); ++f)
+			if (((f + 1) == _fields.end()) || ((f + 1)->label != f->label))
+				*last++ = *f;
+
+		_fields.erase(last, _fields.end());
+
+		_structs.push_back(new GFF3Struct(*this, id, start, _fields.size() - start));
+	}
+}
+
+void GFF3File::readField(uint32 index, std::vector<uint32> &labelIDs) {
+	static const uint32 kFieldSize = 12;
+
+	// Sanity check
+	if (index > _header.fieldCount)
+		throw Common::Exception("GFF3: Field index out of range (%d/%d)", index, _header.fieldCount);
+
+	if ((_header.fieldOffset + (uint64) (index + 1) * kFieldSize) > _dataSize)
+		throw Common::Exception(Common::kReadError);
+
+	const byte *field = _data + _header.fieldOffset + index * kFieldSize;
+
+	const uint32 fieldType  = READ_LE_UINT32(field);
+	const uint32 fieldLabel = READ_LE_UINT32(field + 4);
+	const uint32 fieldData  = READ_LE_UINT32(field + 8);
+
+	_fields.push_back(GFF3Struct::Field((GFF3Struct::FieldType) fieldType, fieldData,
+	                                    readLabel(fieldLabel, labelIDs)));
+}
+
+void GFF3File::readFields(uint32 index, uint32 count, std::vector<uint32> &labelIDs) {
+	// Sanity check
+	if (index > _header.fieldIndicesCount)
+		throw Common::Exception("GFF3: Field indices index out of range (%d/%d)",
+		                        index , _header.fieldIndicesCount);
+
+	if ((_header.fieldIndicesOffset + (uint64) index + (uint64) count * 4) > _dataSize)
+		throw Common::Exception(Common::kReadError);
+
+	const byte *indices = _data + _header.fieldIndicesOffset + index;
+	for (uint32 i = 0; i < count; i++)
+		readField(READ_LE_UINT32(indices + i * 4), labelIDs);
+}
+
+uint32 GFF3File::readLabel(uint32 index, std::vector<uint32> &labelIDs) {
+	static const uint32 kLabelSize = 16;
+
+	if ((index < labelIDs.size()) && (labelIDs[index] != 0xFFFFFFFF))
+		return labelIDs[index];
+
+	const uint64 offset = _header.labelOffset + (uint64) index * kLabelSize;
+	if (offset > _dataSize)
+		throw Common::Exception(Common::kReadError);
+
+	const Common::UString label = Common::readString(_data + offset,
+	    MIN<size_t>(kLabelSize, _dataSize - offset), Common::kEncodingASCII);
+
+	// Give each distinct label an ID, so that we only need to compare those
+	std::pair<LabelMap::iterator, bool> result = _labelIDs.insert(std::make_pair(label, (uint32) _labels.size()));
+	if (result.second)
+		_labels.push_back(label);
+
+	if (index >= labelIDs.size())
+		labelIDs.resize(index + 1, 0xFFFFFFFF);
+
+	return labelIDs[index] = result.first->second;
 }
 
 void GFF3File::loadLists() {
@@ -283,21 +402,19 @@ const GFF3List &GFF3File::getList(uint32 i) const {
 	return _lists[listIndex];
 }
 
-Common::SeekableReadStream &GFF3File::getStream(uint32 offset) const {
-	_stream->seek(offset);
+uint32 GFF3File::getLabelID(const Common::UString &label) const {
+	LabelMap::const_iterator id = _labelIDs.find(label);
+	if (id == _labelIDs.end())
+		return 0xFFFFFFFF;
 
-	return *_stream;
-}
-
-Common::SeekableReadStream &GFF3File::getFieldData() const {
-	return getStream(_header.fieldDataOffset);
+	return id->second;
 }
 
 
-GFF3Struct::Field::Field() : type(kFieldTypeNone), data(0), extended(false) {
+GFF3Struct::Field::Field() : type(kFieldTypeNone), data(0), label(0xFFFFFFFF), extended(false) {
 }
 
-GFF3Struct::Field::Field(FieldType t, uint32 d) : type(t), data(d) {
+GFF3Struct::Field::Field(FieldType t, uint32 d, uint32 l) : type(t), data(d), label(l) {
 	// These field types need extended field data
 	extended = (type == kFieldTypeUint64     ) ||
 	           (type == kFieldTypeSint64     ) ||
@@ -312,108 +429,59 @@ GFF3Struct::Field::Field(FieldType t, uint32 d) : type(t), data(d) {
 }
 
 
-GFF3Struct::GFF3Struct(const GFF3File &parent, uint32 offset) : _parent(&parent) {
-	load(offset);
+bool GFF3Struct::Field::operator<(const Field &right) const {
+	return label < right.label;
 }
 
-GFF3Struct::~GFF3Struct() {
-}
 
-uint32 GFF3Struct::getID() const {
-	return _id;
-}
-
-// --- Loader ---
-
-void GFF3Struct::load(uint32 offset) {
-	Common::SeekableReadStream &data = _parent->getStream(offset);
+GFF3Struct::GFF3Struct(const GFF3File &parent, uint32 id, uint32 fieldIndex, uint32 fieldCount) :
+	_parent(&parent), _id(id), _fieldIndex(fieldIndex), _fieldCount(fieldCount) {
 
-	_id         = data.readUint32LE();
-	_fieldIndex = data.readUint32LE();
-	_fieldCount = data.readUint32LE();
-
-	// Read the field(s)
-	if      (_fieldCount == 1)
-		readField (data, _fieldIndex);
-	else if (_fieldCount > 1)
-		readFields(data, _fieldIndex, _fieldCount);
 }
 
-void GFF3Struct::readField(Common::SeekableReadStream &data, uint32 index) {
-	// Sanity check
-	if (index > _parent->_header.fieldCount)
-		throw Common::Exception("GFF3: Field index out of range (%d/%d)",
-				index, _parent->_header.fieldCount);
-
-	// Seek
-	data.seek(_parent->_header.fieldOffset + index * 12);
-
-	// Read the field data
-	const uint32 fieldType  = data.readUint32LE();
-	const uint32 fieldLabel = data.readUint32LE();
-	const uint32 fieldData  = data.readUint32LE();
-
-	// Read the name
-	Common::UString fieldName = readLabel(data, fieldLabel);
-
-	// And add the field to the map and name list
-	_fields[fieldName] = Field((FieldType) fieldType, fieldData);
-
-	_fieldNames.push_back(fieldName);
+GFF3Struct::~GFF3Struct() {
 }
 
-void GFF3Struct::readFields(Common::SeekableReadStream &data, uint32 index, uint32 count) {
-	// Sanity check
-	if (index > _parent->_header.fieldIndicesCount)
-		throw Common::Exception("GFF3: Field indices index out of range (%d/%d)",
-		                        index , _parent->_header.fieldIndicesCount);
-
-	// Seek
-	data.seek(_parent->_header.fieldIndicesOffset + index);
-
-	// Read the field indices
-	std::vector<uint32> indices;
-	readIndices(data, indices, count);
-
-	// Read the fields
-	for (std::vector<uint32>::const_iterator i = indices.begin(); i != indices.end(); ++i)
-		readField(data, *i);
+uint32 GFF3Struct::getID() const {
+	return _id;
 }
 
-void GFF3Struct::readIndices(Common::SeekableReadStream &data,
-                             std::vector<uint32> &indices, uint32 count) const {
-	indices.reserve(count);
-	while (count-- > 0)
-		indices.push_back(data.readUint32LE());
-}
+const byte *GFF3Struct::getData(const Field &field) const {
+	assert(field.extended);
 
-Common::UString GFF3Struct::readLabel(Common::SeekableReadStream &data, uint32 index) const {
-	data.seek(_parent->_header.labelOffset + index * 16);
+	const uint64 offset = _parent->_header.fieldDataOffset + (uint64) field.data;
 
-	return Common::readStringFixed(data, Common::kEncodingASCII, 16);
+	return _parent->_data + MIN<uint64>(offset, _parent->_dataSize);
 }
 
-Common::SeekableReadStream &GFF3Struct::getData(const Field &field) const {
+size_t GFF3Struct::getDataSize(const Field &field) const {
 	assert(field.extended);
 
-	Common::SeekableReadStream &data = _parent->getFieldData();
-	data.skip(field.data);
+	const uint64 offset = _parent->_header.fieldDataOffset + (uint64) field.data;
+	if (offset >= _parent->_dataSize)
+		return 0;
 
-	return data;
+	return _parent->_dataSize - offset;
 }
 
 // --- Field properties ---
 
 size_t GFF3Struct::getFieldCount() const {
-	return _fields.size();
+	return _fieldCount;
 }
 
 bool GFF3Struct::hasField(const Common::UString &field) const {
 	return getField(field) != 0;
 }
 
-const std::vector<Common::UString> &GFF3Struct::getFieldNames() const {
-	return _fieldNames;
+std::vector<Common::UString> GFF3Struct::getFieldNames() const {
+	std::vector<Common::UString> fieldNames;
+	fieldNames.reserve(_fieldCount);
+
+	for (uint32 i = 0; i < _fieldCount; i++)
+		fieldNames.push_back(_parent->_labels[_parent->_fields[_fieldIndex + i].label]);
+
+	return fieldNames;
 }
 
 GFF3Struct::FieldType GFF3Struct::getFieldType(const Common::UString &field) const {
@@ -427,11 +495,18 @@ GFF3Struct::FieldType GFF3Struct::getFieldType(const Common::UString &field) con
 // --- Field value reader helpers ---
 
 const GFF3Struct::Field *GFF3Struct::getField(const Common::UString &name) const {
-	FieldMap::const_iterator field = _fields.find(name);
-	if (field == _fields.end())
+	Field field;
+	if ((field.label = _parent->getLabelID(name)) == 0xFFFFFFFF)
+		return 0;
+
+	const GFF3File::FieldArray::const_iterator begin = _parent->_fields.begin() + _fieldIndex;
+	const GFF3File::FieldArray::const_iterator end   = begin + _fieldCount;
+
+	GFF3File::FieldArray::const_iterator f = std::lower_bound(begin, end, field);
+	if ((f == end) || (f->label != field.label))
 		return 0;
 
-	return &field->second;
+	return &*f;
 }
 
 char GFF3Struct::getChar(const Common::UString &field, char def) const {
@@ -463,13 +538,13 @@ uint64 GFF3Struct::getUint(const Common::UString &field, uint64 def) const {
 	if (f->type == kFieldTypeSint32)
 		return (uint64) ((int64) ((int32) ((uint32) f->data)));
 	if (f->type == kFieldTypeUint64)
-		return (uint64) getData(*f).readUint64LE();
+		return (uint64) Common::MemoryReadStream(getData(*f), getDataSize(*f)).readUint64LE();
 	if (f->type == kFieldTypeSint64)
-		return ( int64) getData(*f).readUint64LE();
+		return ( int64) Common::MemoryReadStream(getData(*f), getDataSize(*f)).readUint64LE();
 
 	// StrRef, a numerical reference to a string in a talk table
 	if (f->type == kFieldTypeStrRef) {
-		Common::SeekableReadStream &data = getData(*f);
+		Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 		const uint32 size = data.readUint32LE();
 		if (size != 4)
@@ -500,13 +575,13 @@ int64 GFF3Struct::getSint(const Common::UString &field, int64 def) const {
 	if (f->type == kFieldTypeSint32)
 		return (int64) ((int32) ((uint32) f->data));
 	if (f->type == kFieldTypeUint64)
-		return (int64) getData(*f).readUint64LE();
+		return (int64) Common::MemoryReadStream(getData(*f), getDataSize(*f)).readUint64LE();
 	if (f->type == kFieldTypeSint64)
-		return (int64) getData(*f).readUint64LE();
+		return (int64) Common::MemoryReadStream(getData(*f), getDataSize(*f)).readUint64LE();
 
 	// StrRef, a numerical reference to a string in a talk table
 	if (f->type == kFieldTypeStrRef) {
-		Common::SeekableReadStream &data = getData(*f);
+		Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 		const uint32 size = data.readUint32LE();
 		if (size != 4)
@@ -530,7 +605,7 @@ double GFF3Struct::getDouble(const Common::UString &field, double def) const {
 	if (f->type == kFieldTypeFloat)
 		return convertIEEEFloat(f->data);
 	if (f->type == kFieldTypeDouble)
-		return getData(*f).readIEEEDoubleLE();
+		return Common::MemoryReadStream(getData(*f), getDataSize(*f)).readIEEEDoubleLE();
 
 	throw Common::Exception("GFF3: Field is not a double type");
 }
@@ -544,7 +619,7 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 
 	// Direct string
 	if (f->type == kFieldTypeExoString) {
-		Common::SeekableReadStream &data = getData(*f);
+		Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 		const uint32 length = data.readUint32LE();
 		return Common::readStringFixed(data, Common::kEncodingASCII, length);
@@ -558,7 +633,7 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 		 * however, this limit has been lifted, and a full 255 characters
 		 * are available in ResRef string fields. */
 
-		Common::SeekableReadStream &data = getData(*f);
+		Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 		const uint32 length = data.readByte();
 		return Common::readStringFixed(data, Common::kEncodingASCII, length);
@@ -631,7 +706,7 @@ bool GFF3Struct::getLocString(const Common::UString &field, LocString &str) cons
 
 	try {
 
-		Common::SeekableReadStream &data = getData(*f);
+		Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 		const uint32 size = data.readUint32LE();
 		Common::SeekableSubReadStream locStringData(&data, data.pos(), data.pos() + size);
@@ -651,7 +726,7 @@ Common::SeekableReadStream *GFF3Struct::getData(const Common::UString &field) co
 	if (!f)
 		return 0;
 
-	Common::SeekableReadStream &data = getData(*f);
+	Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 	uint32 size = 0;
 	if      ((f->type == kFieldTypeVoid) || (f->type == kFieldTypeExoString))
@@ -673,7 +748,7 @@ void GFF3Struct::getVector(const Common::UString &field,
 	if (f->type != kFieldTypeVector)
 		throw Common::Exception("GFF3: Field is not a vector type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 	x = data.readIEEEFloatLE();
 	y = data.readIEEEFloatLE();
@@ -689,7 +764,7 @@ void GFF3Struct::getOrientation(const Common::UString &field,
 	if (f->type != kFieldTypeOrientation)
 		throw Common::Exception("GFF3: Field is not an orientation type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 	a = data.readIEEEFloatLE();
 	b = data.readIEEEFloatLE();
@@ -706,7 +781,7 @@ void GFF3Struct::getVector(const Common::UString &field,
 	if (f->type != kFieldTypeVector)
 		throw Common::Exception("GFF3: Field is not a vector type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 	x = data.readIEEEFloatLE();
 	y = data.readIEEEFloatLE();
@@ -722,7 +797,7 @@ void GFF3Struct::getOrientation(const Common::UString &field,
 	if (f->type != kFieldTypeOrientation)
 		throw Common::Exception("GFF3: Field is not an orientation type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	Common::MemoryReadStream data(getData(*f), getDataSize(*f));
 
 	a = data.readIEEEFloatLE();
 	b = data.readIEEEFloatLE();
@@ -26,9 +26,9 @@
 #define AURORA_GFF3FILE_H
 
 #include <vector>
-#include <map>
 
 #include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
@@ -43,118 +43,15 @@ namespace Common {
 namespace Aurora {
 
 class LocString;
-class GFF3Struct;
+class GFF3File;
 
-/** A GFF (generic file format) V3.2/V3.3 file, found in all Aurora games
- *  except Sonic Chronicles: The Dark Brotherhood. Even games that have
- *  V4.0/V4.1 GFFs additionally use V3.2/V3.3 files as well.
- *
- *  GFF files store hierarchical data, similar in concept to XML. They are
- *  used whenever such data is useful: to, for example, hold area and object
- *  descriptions, module and campaign specifications or conversations. They
- *  consist of a top-level struct, with a collection of fields of various
- *  types, indexed by a human-readable string name. A field can then be
- *  another struct (which itself will be a collection of fields) or a
- *  list of structs, leading to a recursive, hierarchical structure.
- *
- *  GFF V3.2/V3.3 files come in a multitude of types (ARE, DLG, ...), each
- *  with its own 4-byte type ID ('ARE ', 'DLG ', ...). When specified in
- *  the GFF3File constructor, the loader will enforce that it matches, and
- *  throw an exception should it not. Conversely, an ID of 0xFFFFFFFF means
- *  that no such type ID enforcement should be done. In both cases, the type
- *  ID read from the file can get access through getType().
- *
- *  The GFF V3.2/V3.3 files found in the encrypted premium module archives
- *  of Neverwinter Nights are deliberately broken in various way. When the
- *  constructor parameter repairNWNPremium is set to true, GFF3File will
- *  detect such broken files and automatically repair them. When this
- *  parameter is set to false, no detection will take place, and these
- *  broken files will lead the loader to throw an exception.
+/** A struct within a GFF3.
  *
- *  See also: GFF4File in gff4file.h for the later V4.0/V4.1 versions of
- *  the GFF format.
+ *  The fields of a struct are kept in the GFF3File, sorted by the ID of
+ *  their label, and all field data is read directly out of the GFF3File's
+ *  buffer. Reading a field therefore doesn't change any state, and fields
+ *  can be read from several threads at the same time.
  */
-class GFF3File : boost::noncopyable, public AuroraFile {
-public:
-	/** Take over this stream and read a GFF3 file out of it. */
-	GFF3File(Common::SeekableReadStream *gff3, uint32 id = 0xFFFFFFFF, bool repairNWNPremium = false);
-	/** Request this resource from the ResourceManager and read a GFF3 file out of it. */
-	GFF3File(const Common::UString &gff3, FileType type, uint32 id = 0xFFFFFFFF, bool repairNWNPremium = false);
-	~GFF3File();
-
-	/** Return the GFF3's specific type. */
-	uint32 getType() const;
-
-	/** Returns the top-level struct. */
-	const GFF3Struct &getTopLevel() const;
-
-
-private:
-	/** A GFF3 header. */
-	struct Header {
-		uint32 structOffset;       ///< Offset to the struct definitions.
-		uint32 structCount;        ///< Number of structs.
-		uint32 fieldOffset;        ///< Offset to the field definitions.
-		uint32 fieldCount;         ///< Number of fields.
-		uint32 labelOffset;        ///< Offset to the field labels.
-		uint32 labelCount;         ///< Number of labels.
-		uint32 fieldDataOffset;    ///< Offset to the field data.
-		uint32 fieldDataCount;     ///< Number of field data fields.
-		uint32 fieldIndicesOffset; ///< Offset to the field indices.
-		uint32 fieldIndicesCount;  ///< Number of field indices.
-		uint32 listIndicesOffset;  ///< Offset to the list indices.
-		uint32 listIndicesCount;   ///< Number of list indices.
-
-		Header();
-
-		void read(Common::SeekableReadStream &gff3);
-	};
-
-	typedef std::vector<GFF3Struct *> StructArray;
-	typedef std::vector<GFF3List> ListArray;
-
-
-	Common::SeekableReadStream *_stream;
-
-	Header _header; ///< The GFF3's header.
-
-	/** Should we try to read GFF3 files found in Neverwinter Nights premium modules? */
-	bool   _repairNWNPremium;
-	/** The correctional value for offsets to repair Neverwinter Nights premium modules. */
-	uint32 _offsetCorrection;
-
-	StructArray _structs; ///< Our structs.
-	ListArray   _lists;   ///< Our lists.
-
-	/** To convert list offsets found in GFF3 to real indices. */
-	std::vector<uint32> _listOffsetToIndex;
-
-
-	// .--- Loading helpers
-	void load(uint32 id);
-	void loadHeader(uint32 id);
-	void loadStructs();
-	void loadLists();
-
-	void clear();
-	// '---
-
-	// .--- Helper methods called by GFF3Struct
-	/** Return the GFF3 stream. */
-	Common::SeekableReadStream &getStream(uint32 offset) const;
-	/** Return the GFF3 stream seeked to the start of the field data. */
-	Common::SeekableReadStream &getFieldData() const;
-
-	/** Return a struct within the GFF3. */
-	const GFF3Struct &getStruct(uint32 i) const;
-	/** Return a list within the GFF3. */
-	const GFF3List   &getList  (uint32 i) const;
-	// '---
-
-	friend class GFF3Struct;
-};
-
-/** A struct within a GFF3. */
 class GFF3Struct {
 public:
 	/** The type of a GFF3 field. */
@@ -198,7 +95,7 @@ public:
 	bool hasField(const Common::UString &field) const;
 
 	/** Return a list of all field names in this struct. */
-	const std::vector<Common::UString> &getFieldNames() const;
+	std::vector<Common::UString> getFieldNames() const;
 
 	/** Return the type of this field, or kFieldTypeNone if such a field doesn't exist. */
 	FieldType getFieldType(const Common::UString &field) const;
@@ -240,51 +137,163 @@ private:
 	struct Field {
 		FieldType type;     ///< Type of the field.
 		uint32    data;     ///< Data of the field.
+		uint32    label;    ///< ID of the field's label.
 		bool      extended; ///< Does this field need extended data?
 
 		Field();
-		Field(FieldType t, uint32 d);
-	};
+		Field(FieldType t, uint32 d, uint32 l);
 
-	typedef std::map<Common::UString, Field> FieldMap;
+		bool operator<(const Field &right) const;
+	};
 
 
 	const GFF3File *_parent; ///< The parent GFF3.
 
 	uint32 _id;         ///< The struct's ID.
-	uint32 _fieldIndex; ///< Field / Field indices index.
+	uint32 _fieldIndex; ///< Index of the struct's first field in the parent's field array.
 	uint32 _fieldCount; ///< Field count.
 
-	FieldMap _fields; ///< The fields, indexed by their label.
 
-	/** The names of all fields in this struct. */
-	std::vector<Common::UString> _fieldNames;
-
-
-	// .--- Loader
-	GFF3Struct(const GFF3File &parent, uint32 offset);
+	GFF3Struct(const GFF3File &parent, uint32 id, uint32 fieldIndex, uint32 fieldCount);
 	~GFF3Struct();
 
-	void load(uint32 offset);
-
-	void readField  (Common::SeekableReadStream &data, uint32 index);
-	void readFields (Common::SeekableReadStream &data, uint32 index, uint32 count);
-	void readIndices(Common::SeekableReadStream &data,
-	                 std::vector<uint32> &indices, uint32 count) const;
-
-	Common::UString readLabel(Common::SeekableReadStream &data, uint32 index) const;
-	// '---
-
 	// .--- Field and field data accessors
 	/** Returns the field with this tag. */
 	const Field *getField(const Common::UString &name) const;
 	/** Returns the extended field data for this field. */
-	Common::SeekableReadStream &getData(const Field &field) const;
+	const byte *getData(const Field &field) const;
+	/** Returns the size of the extended field data available to this field. */
+	size_t getDataSize(const Field &field) const;
 	// '---
 
 	friend class GFF3File;
 };
 
+/** A GFF (generic file format) V3.2/V3.3 file, found in all Aurora games
+ *  except Sonic Chronicles: The Dark Brotherhood. Even games that have
+ *  V4.0/V4.1 GFFs additionally use V3.2/V3.3 files as well.
+ *
+ *  GFF files store hierarchical data, similar in concept to XML. They are
+ *  used whenever such data is useful: to, for example, hold area and object
+ *  descriptions, module and campaign specifications or conversations. They
+ *  consist of a top-level struct, with a collection of fields of various
+ *  types, indexed by a human-readable string name. A field can then be
+ *  another struct (which itself will be a collection of fields) or a
+ *  list of structs, leading to a recursive, hierarchical structure.
+ *
+ *  GFF V3.2/V3.3 files come in a multitude of types (ARE, DLG, ...), each
+ *  with its own 4-byte type ID ('ARE ', 'DLG ', ...). When specified in
+ *  the GFF3File constructor, the loader will enforce that it matches, and
+ *  throw an exception should it not. Conversely, an ID of 0xFFFFFFFF means
+ *  that no such type ID enforcement should be done. In both cases, the type
+ *  ID read from the file can get access through getType().
+ *
+ *  The GFF V3.2/V3.3 files found in the encrypted premium module archives
+ *  of Neverwinter Nights are deliberately broken in various way. When the
+ *  constructor parameter repairNWNPremium is set to true, GFF3File will
+ *  detect such broken files and automatically repair them. When this
+ *  parameter is set to false, no detection will take place, and these
+ *  broken files will lead the loader to throw an exception.
+ *
+ *  See also: GFF4File in gff4file.h for the later V4.0/V4.1 versions of
+ *  the GFF format.
+ */
+class GFF3File : boost::noncopyable, public AuroraFile {
+public:
+	/** Take over this stream and read a GFF3 file out of it. */
+	GFF3File(Common::SeekableReadStream *gff3, uint32 id = 0xFFFFFFFF, bool repairNWNPremium = false);
+	/** Request this resource from the ResourceManager and read a GFF3 file out of it. */
+	GFF3File(const Common::UString &gff3, FileType type, uint32 id = 0xFFFFFFFF, bool repairNWNPremium = false);
+	~GFF3File();
+
+	/** Return the GFF3's specific type. */
+	uint32 getType() const;
+
+	/** Returns the top-level struct. */
+	const GFF3Struct &getTopLevel() const;
+
+
+private:
+	/** A GFF3 header. */
+	struct Header {
+		uint32 structOffset;       ///< Offset to the struct definitions.
+		uint32 structCount;        ///< Number of structs.
+		uint32 fieldOffset;        ///< Offset to the field definitions.
+		uint32 fieldCount;         ///< Number of fields.
+		uint32 labelOffset;        ///< Offset to the field labels.
+		uint32 labelCount;         ///< Number of labels.
+		uint32 fieldDataOffset;    ///< Offset to the field data.
+		uint32 fieldDataCount;     ///< Number of field data fields.
+		uint32 fieldIndicesOffset; ///< Offset to the field indices.
+		uint32 fieldIndicesCount;  ///< Number of field indices.
+		uint32 listIndicesOffset;  ///< Offset to the list indices.
+		uint32 listIndicesCount;   ///< Number of list indices.
+
+		Header();
+
+		void read(Common::SeekableReadStream &gff3);
+	};
+
+	typedef std::vector<GFF3Struct *> StructArray;
+	typedef std::vector<GFF3List> ListArray;
+	typedef std::vector<GFF3Struct::Field> FieldArray;
+
+	typedef boost::unordered_map<Common::UString, uint32, Common::hashUStringCaseSensitive> LabelMap;
+
+
+	/** The GFF3 stream, only used while loading. */
+	Common::SeekableReadStream *_stream;
+
+	byte  *_data;     ///< The whole GFF3 file.
+	size_t _dataSize; ///< The size of the GFF3 file.
+
+	Header _header; ///< The GFF3's header.
+
+	/** Should we try to read GFF3 files found in Neverwinter Nights premium modules? */
+	bool   _repairNWNPremium;
+	/** The correctional value for offsets to repair Neverwinter Nights premium modules. */
+	uint32 _offsetCorrection;
+
+	StructArray _structs; ///< Our structs.
+	ListArray   _lists;   ///< Our lists.
+
+	/** The fields of all structs, one struct after the other, each sorted by label. */
+	FieldArray _fields;
+
+	std::vector<Common::UString> _labels; ///< All distinct field labels.
+	LabelMap _labelIDs; ///< The IDs of all field labels.
+
+	/** To convert list offsets found in GFF3 to real indices. */
+	std::vector<uint32> _listOffsetToIndex;
+
+
+	// .--- Loading helpers
+	void load(uint32 id);
+	void loadHeader(uint32 id);
+	void loadData();
+	void loadStructs();
+	void loadLists();
+
+	void   readField (uint32 index, std::vector<uint32> &labelIDs);
+	void   readFields(uint32 index, uint32 count, std::vector<uint32> &labelIDs);
+	uint32 readLabel (uint32 index, std::vector<uint32> &labelIDs);
+
+	void clear();
+	// '---
+
+	// .--- Helper methods called by GFF3Struct
+	/** Return the ID of this field label, or 0xFFFFFFFF if no field has this label. */
+	uint32 getLabelID(const Common::UString &label) const;
+
+	/** Return a struct within the GFF3. */
+	const GFF3Struct &getStruct(uint32 i) const;
+	/** Return a list within the GFF3. */
+	const GFF3List   &getList  (uint32 i) const;
+	// '---
+
+	friend class GFF3Struct;
+};
+
 } // End of namespace Aurora
 
 #endif // AURORA_GFF3FILE_H
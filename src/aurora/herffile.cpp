@@ -163,9 +163,7 @@ Common::SeekableReadStream *HERFFile::getResource(uint32 index, bool tryNoCopy)
 	if (tryNoCopy)
 		return new Common::SeekableSubReadStream(_herf, res.offset, res.offset + res.size);
 
-	_herf->seek(res.offset);
-
-	return _herf->readStream(res.size);
+	return _herf->readStreamAt(res.offset, res.size);
 }
 
 Common::HashAlgo HERFFile::getNameHashAlgo() const {
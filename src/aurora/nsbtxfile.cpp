@@ -343,6 +343,8 @@ Common::SeekableReadStream *NSBTXFile::getResource(uint32 index, bool UNUSED(try
 	Common::MemoryWriteStreamDynamic stream(false, getITEXSize(_textures[index]));
 
 	try {
+		Common::StackLock lock(_mutex);
+
 		ReadContext ctx(*_nsbtx, _textures[index], stream);
 		writeITEXHeader(ctx);
 
@@ -30,6 +30,7 @@
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/types.h"
 #include "src/aurora/archive.h"
@@ -116,6 +117,9 @@ private:
 	/** The name of the NSBTX file. */
 	Common::SeekableSubReadStreamEndian *_nsbtx;
 
+	/** Converting a texture seeks around in the NSBTX stream, so only one thread may do it at a time. */
+	mutable Common::Mutex _mutex;
+
 	/** External list of resource names and types. */
 	ResourceList _resources;
 
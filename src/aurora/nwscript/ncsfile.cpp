@@ -28,6 +28,8 @@
  * a mirror (<https://github.com/xoreos/xoreos-docs>).
  */
 
+#include "src/common/atomic.h"
+
 #include <boost/make_shared.hpp>
 
 #include "src/common/util.h"
@@ -43,6 +45,7 @@
 #include "src/aurora/nwscript/ncsfile.h"
 #include "src/aurora/nwscript/object.h"
 #include "src/aurora/nwscript/functionman.h"
+#include "src/aurora/nwscript/scriptcache.h"
 
 using Common::kDebugScripts;
 
@@ -58,7 +61,14 @@ namespace Aurora {
 
 namespace NWScript {
 
+/** The number of times NCSStacks allocated memory so far. */
+static boost::atomic<uint64> stackAllocations(0);
+
 NCSStack::NCSStack() {
+	// Enough for most scripts, so that the stack doesn't need to grow while running
+	reserve(kInitialSize);
+	stackAllocations++;
+
 	reset();
 }
 
@@ -94,9 +104,12 @@ void NCSStack::push(const Variable &obj) {
 	if (_stackPtr == 0x7FFFFFFF) // Like this will ever happen :P
 		throw Common::Exception("NCSStack: Stack overflow");
 
-	if (_stackPtr == (int32)size() - 1)
+	if (_stackPtr == (int32)size() - 1) {
+		if (size() == capacity())
+			stackAllocations++;
+
 		push_back(obj);
-	else
+	} else
 		at(_stackPtr + 1) = obj;
 
 	_stackPtr++;
@@ -156,8 +169,12 @@ void NCSStack::setStackPtr(int32 pos) {
 
 	_stackPtr = (pos / -4) - 1;
 
-	if ((int32)size() < (_stackPtr + 1))
+	if ((int32)size() < (_stackPtr + 1)) {
+		if ((int32)capacity() < (_stackPtr + 1))
+			stackAllocations++;
+
 		resize(_stackPtr + 1);
+	}
 }
 
 int32 NCSStack::getBasePtr() {
@@ -171,6 +188,10 @@ void NCSStack::setBasePtr(int32 pos) {
 	_basePtr = (pos / -4) - 1;
 }
 
+uint64 NCSStack::getAllocations() {
+	return stackAllocations.load();
+}
+
 void NCSStack::print() const {
 	if (!DebugMan.isEnabled(kDebugScripts, 3))
 		return;
@@ -188,6 +209,9 @@ void NCSStack::print() const {
 }
 
 
+const NCSFile::Opcode *NCSFile::_opcodes = 0;
+size_t NCSFile::_opcodeListSize = 0;
+
 #define OPCODE(x) { &NCSFile::x, #x }
 #define OPCODE0() { 0, "" }
 
@@ -274,28 +298,40 @@ void NCSFile::setupOpcodes() {
 
 #undef OPCODE
 
-NCSFile::NCSFile(Common::SeekableReadStream *ncs) : _owner(0), _triggerer(0) {
-	_script = ncs;
+NCSFile::Instruction::Instruction() : address(0), opcode(0), type(kInstTypeNone), proc(0),
+	argFloat(0.0f), branch(0) {
+
+	args[0] = args[1] = args[2] = 0;
+}
+
+NCSFile::Program::Program() : size(0) {
+}
+
+
+NCSFile::NCSFile(Common::SeekableReadStream *ncs) : _pc(0), _owner(0), _triggerer(0) {
+	setupOpcodes();
 
 	try {
-		load();
+		_program.reset(load(*ncs));
 	} catch (...) {
-		delete _script;
+		delete ncs;
+		throw;
 	}
+
+	delete ncs;
+
+	reset();
 }
 
-NCSFile::NCSFile(const Common::UString &ncs) : _name(ncs), _script(0),
-	_owner(0), _triggerer(0) {
+NCSFile::NCSFile(const Common::UString &ncs) : _name(ncs), _pc(0), _owner(0), _triggerer(0) {
+	setupOpcodes();
 
-	_script = ResMan.getResource(ncs, kFileTypeNCS);
-	if (!_script)
-		throw Common::Exception("No such NCS \"%s\"", ncs.c_str());
+	_program = ScriptCacheMan.get(ncs);
 
-	load();
+	reset();
 }
 
 NCSFile::~NCSFile() {
-	delete _script;
 }
 
 const Common::UString &NCSFile::getName() const {
@@ -318,28 +354,201 @@ ScriptState NCSFile::getEmptyState() {
 	return state;
 }
 
-void NCSFile::load() {
-	readHeader(*_script);
+NCSFile::Program *NCSFile::load(Common::SeekableReadStream &ncs) {
+	uint32 id, version;
+	readHeader(ncs, id, version);
 
-	if (_id != kNCSTag)
+	if (id != kNCSTag)
 		throw Common::Exception("Try to load non-NCS file");
 
-	if (_version != kVersion10)
-		throw Common::Exception("Unsupported NCS file version %08X", _version);
+	if (version != kVersion10)
+		throw Common::Exception("Unsupported NCS file version %08X", version);
 
-	byte lengthOpcode = _script->readByte();
+	byte lengthOpcode = ncs.readByte();
 	if (lengthOpcode != 0x42)
 		throw Common::Exception("Script size opcode != 0x42 (0x%02X)", lengthOpcode);
 
-	uint32 length = _script->readUint32BE();
-	if (length > ((uint32) _script->size()))
-		throw Common::Exception("Script size %u > stream size %u", length, (uint)_script->size());
-	if (length < ((uint32) _script->size()))
-		warning("TODO: NCSFile::load(): Script size %u < stream size %u", length, (uint)_script->size());
+	uint32 length = ncs.readUint32BE();
+	if (length > ((uint32) ncs.size()))
+		throw Common::Exception("Script size %u > stream size %u", length, (uint)ncs.size());
+	if (length < ((uint32) ncs.size()))
+		warning("TODO: NCSFile::load(): Script size %u < stream size %u", length, (uint)ncs.size());
 
 	setupOpcodes();
 
-	reset();
+	Program *program = new Program;
+
+	try {
+		decode(ncs, *program);
+	} catch (...) {
+		delete program;
+		throw;
+	}
+
+	return program;
+}
+
+NCSFile::ProgramPtr NCSFile::load(const Common::UString &ncs) {
+	Common::SeekableReadStream *script = ResMan.getResource(ncs, kFileTypeNCS);
+	if (!script)
+		throw Common::Exception("No such NCS \"%s\"", ncs.c_str());
+
+	ProgramPtr program;
+
+	try {
+		program.reset(load(*script));
+	} catch (...) {
+		delete script;
+		throw;
+	}
+
+	delete script;
+	return program;
+}
+
+void NCSFile::decode(Common::SeekableReadStream &ncs, Program &program) {
+	program.instructions.clear();
+	program.constants.clear();
+
+	program.size = ncs.size();
+
+	ncs.seek(13); // 8 byte header + 5 byte program size dummy op
+
+	// Running off the end of the script, even mid-instruction, just ends it
+	while ((program.size - ncs.pos()) >= 2) {
+		Instruction instr;
+
+		instr.address = ncs.pos();
+		instr.opcode  = ncs.readByte();
+		instr.type    = (InstructionType) ncs.readByte();
+
+		try {
+			if ((instr.opcode >= _opcodeListSize) || (!_opcodes[instr.opcode].proc))
+				throw Common::Exception("NCSFile::executeStep(): Illegal instruction 0x%02x", instr.opcode);
+
+			instr.proc = _opcodes[instr.opcode].proc;
+
+			decodeArguments(ncs, program, instr);
+
+		} catch (Common::Exception &e) {
+			/* We don't know where the next instruction would start, so we have to stop
+			 * here. This is only an error if the script actually reaches this point. */
+
+			program.decodeError = e;
+
+			instr.proc = &NCSFile::o_invalid;
+			program.instructions.push_back(instr);
+			break;
+		}
+
+		program.instructions.push_back(instr);
+	}
+
+	// Resolve the targets of all jumps
+	std::vector<Instruction>::iterator i;
+	for (i = program.instructions.begin(); i != program.instructions.end(); ++i)
+		if ((i->opcode == 0x1D) || (i->opcode == 0x1E) || (i->opcode == 0x1F) || (i->opcode == 0x25))
+			i->branch = findInstruction(program, i->address + i->args[0]);
+}
+
+void NCSFile::decodeArguments(Common::SeekableReadStream &ncs, Program &program, Instruction &instr) {
+	switch (instr.opcode) {
+		case 0x01: // CPDOWNSP
+		case 0x03: // CPTOPSP
+		case 0x26: // CPDOWNBP
+		case 0x27: // CPTOPBP
+		case 0x30: // WRITEARRAY
+		case 0x32: // READARRAY
+		case 0x37: // GETREF
+		case 0x39: // GETREFARRAY
+			instr.args[0] = ncs.readSint32BE();
+			instr.args[1] = ncs.readSint16BE();
+			break;
+
+		case 0x04: // CONST
+			switch (instr.type) {
+				case kInstTypeInt:
+					instr.args[0] = ncs.readSint32BE();
+					break;
+
+				case kInstTypeFloat:
+					instr.argFloat = ncs.readIEEEFloatBE();
+					break;
+
+				case kInstTypeString:
+				case kInstTypeResource:
+					instr.branch = program.constants.size();
+					program.constants.push_back(Common::readStringFixed(ncs, Common::kEncodingASCII, ncs.readUint16BE()));
+					break;
+
+				case kInstTypeObject:
+					instr.args[0] = (int32) ncs.readUint32BE();
+					break;
+
+				default:
+					throw Common::Exception("NCSFile::o_const(): Illegal type %d", instr.type);
+			}
+			break;
+
+		case 0x05: // ACTION
+			instr.args[0] = ncs.readUint16BE();
+			instr.args[1] = ncs.readByte();
+			break;
+
+		case 0x0B: // EQ
+		case 0x0C: // NEQ
+			// Comparisons between two structs (or two vectors) come with the size of the type
+			if (instr.type == kInstTypeStructStruct)
+				instr.args[0] = ncs.readUint16BE();
+			break;
+
+		case 0x1B: // MOVSP
+		case 0x1D: // JMP
+		case 0x1E: // JSR
+		case 0x1F: // JZ
+		case 0x23: // DECSP
+		case 0x24: // INCSP
+		case 0x25: // JNZ
+		case 0x28: // DECBP
+		case 0x29: // INCBP
+			instr.args[0] = ncs.readSint32BE();
+			break;
+
+		case 0x21: // DESTRUCT
+			instr.args[0] = ncs.readSint16BE();
+			instr.args[1] = ncs.readSint16BE();
+			instr.args[2] = ncs.readSint16BE();
+			break;
+
+		case 0x2C: // STORESTATE
+			instr.args[0] = (int32) ncs.readUint32BE();
+			instr.args[1] = (int32) ncs.readUint32BE();
+			break;
+
+		default:
+			break;
+	}
+}
+
+size_t NCSFile::findInstruction(const Program &program, uint32 address) {
+	// Jumping past the end of the script ends it
+	if (address >= program.size)
+		return program.instructions.size();
+
+	size_t low = 0, high = program.instructions.size();
+	while (low < high) {
+		const size_t mid = low + (high - low) / 2;
+
+		if (program.instructions[mid].address < address)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if ((low < program.instructions.size()) && (program.instructions[low].address == address))
+		return low;
+
+	return SIZE_MAX;
 }
 
 void NCSFile::reset() {
@@ -351,7 +560,7 @@ void NCSFile::reset() {
 	_storedState.setType(kTypeVoid);
 	_return.setType(kTypeVoid);
 
-	_script->seek(13); // 8 byte header + 5 byte program size dummy op
+	_pc = 0;
 }
 
 const Variable &NCSFile::run(Object *owner, Object *triggerer) {
@@ -364,7 +573,9 @@ const Variable &NCSFile::run(const ScriptState &state, Object *owner, Object *tr
 
 	reset();
 
-	_script->seek(state.offset);
+	_pc = findInstruction(*_program, state.offset);
+	if (_pc == SIZE_MAX)
+		throw Common::Exception("NCSFile::run(): No instruction at offset %u", state.offset);
 
 	// Push global variables
 	std::vector<class Variable>::const_reverse_iterator var;
@@ -401,47 +612,41 @@ const Variable &NCSFile::execute(Object *owner, Object *triggerer) {
 }
 
 bool NCSFile::executeStep() {
-	byte opcode, type;
-
-	try {
-		opcode = _script->readByte();
-		type   = _script->readByte();
-	} catch (...) {
+	if (_pc >= _program->instructions.size())
 		return false;
-	}
 
-	if ((opcode >= _opcodeListSize) || (!_opcodes[opcode].proc))
-		throw Common::Exception("NCSFile::executeStep(): Illegal instruction 0x%02x", opcode);
+	const Instruction &instr = _program->instructions[_pc++];
 
-	debugC(kDebugScripts, 1, "NWScript opcode %s [0x%02X]", _opcodes[opcode].desc, opcode);
+	debugC(kDebugScripts, 1, "NWScript opcode %s [0x%02X]", _opcodes[instr.opcode].desc, instr.opcode);
 
-	try {
-		(this->*(_opcodes[opcode].proc))((InstructionType)type);
-	} catch (Common::Exception &UNUSED(e)) {
-		throw;
-	}
+	(this->*(instr.proc))(instr);
 
 	_stack.print();
-	debugC(kDebugScripts, 2, "[RETURN: %d]",
-	       _returnOffsets.empty() ? -1 : _returnOffsets.top());
+
+	if (DebugMan.isEnabled(kDebugScripts, 2)) {
+		int32 returnAddress = -1;
+		if (!_returnOffsets.empty())
+			returnAddress = (_returnOffsets.top() < _program->instructions.size()) ?
+			                _program->instructions[_returnOffsets.top()].address : _program->size;
+
+		debugC(kDebugScripts, 2, "[RETURN: %d]", returnAddress);
+	}
 
 	return true;
 }
 
-void NCSFile::decompile() {
-	uint32 oldScriptPos = _script->pos();
-	_script->seek(13); // 8 byte header + 5 byte program size dummy op
-
-	// TODO
+void NCSFile::jump(const Instruction &instr) {
+	if (instr.branch == SIZE_MAX)
+		throw Common::Exception("NCSFile::jump(): No instruction at offset %d", instr.address + instr.args[0]);
 
-	_script->seek(oldScriptPos);
+	_pc = instr.branch;
 }
 
 // OPCODES!
 
 /** RSADD: push an empty variable onto the stack. */
-void NCSFile::o_rsadd(InstructionType type) {
-	switch (type) {
+void NCSFile::o_rsadd(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
 			_stack.push(kTypeInt);
 			break;
@@ -477,24 +682,24 @@ void NCSFile::o_rsadd(InstructionType type) {
 			_stack.push(kTypeArray);
 			break;
 		default:
-			throw Common::Exception("NCSFile::o_rsadd(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_rsadd(): Illegal type %d", instr.type);
 	}
 }
 
 /** CONST: push a constant (predetermined value) variable onto the stack. */
-void NCSFile::o_const(InstructionType type) {
-	switch (type) {
+void NCSFile::o_const(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
-			_stack.push(_script->readSint32BE());
+			_stack.push(instr.args[0]);
 			break;
 
 		case kInstTypeFloat:
-			_stack.push(_script->readIEEEFloatBE());
+			_stack.push(instr.argFloat);
 			break;
 
 		case kInstTypeString:
 		case kInstTypeResource: {
-			_stack.push(Common::readStringFixed(*_script, Common::kEncodingASCII, _script->readUint16BE()));
+			_stack.push(_program->constants[instr.branch]);
 			break;
 		}
 
@@ -507,7 +712,7 @@ void NCSFile::o_const(InstructionType type) {
 			 * magic values. They *should* all have the same effect, though.
 			 */
 
-			uint32 objectID = _script->readUint32BE();
+			uint32 objectID = (uint32) instr.args[0];
 
 			if      (objectID == kScriptObjectSelf)
 				_stack.push(_owner);
@@ -524,7 +729,7 @@ void NCSFile::o_const(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_const(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_const(): Illegal type %d", instr.type);
 	}
 }
 
@@ -625,12 +830,12 @@ void NCSFile::callEngine(Aurora::NWScript::FunctionContext &ctx,
 }
 
 /** ACTION: call a game-specific engine function. */
-void NCSFile::o_action(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_action(): Illegal type %d", type);
+void NCSFile::o_action(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_action(): Illegal type %d", instr.type);
 
-	uint16 routineNumber = _script->readUint16BE();
-	uint8  argCount      = _script->readByte();
+	uint16 routineNumber = instr.args[0];
+	uint8  argCount      = instr.args[1];
 
 	Aurora::NWScript::FunctionContext ctx = FunctionMan.createContext(routineNumber);
 
@@ -644,9 +849,9 @@ void NCSFile::o_action(InstructionType type) {
 }
 
 /** LOGAND: perform a logical boolean AND (&&). */
-void NCSFile::o_logand(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_logand(): Illegal type %d", type);
+void NCSFile::o_logand(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_logand(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -658,9 +863,9 @@ void NCSFile::o_logand(InstructionType type) {
 }
 
 /** LOGOR: perform a logical boolean OR (||). */
-void NCSFile::o_logor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_logor(): Illegal type %d", type);
+void NCSFile::o_logor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_logor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -672,9 +877,9 @@ void NCSFile::o_logor(InstructionType type) {
 }
 
 /** INCOR: perform a bit-wise inclusive OR (|). */
-void NCSFile::o_incor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_incor(): Illegal type %d", type);
+void NCSFile::o_incor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_incor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -686,9 +891,9 @@ void NCSFile::o_incor(InstructionType type) {
 }
 
 /** EXCOR: perform a bit-wise exclusive OR (^). */
-void NCSFile::o_excor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_excor(): Illegal type %d", type);
+void NCSFile::o_excor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_excor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -700,9 +905,9 @@ void NCSFile::o_excor(InstructionType type) {
 }
 
 /** BOOLAND: perform a bit-wise AND (&). */
-void NCSFile::o_booland(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_booland(): Illegal type %d", type);
+void NCSFile::o_booland(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_booland(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -714,13 +919,13 @@ void NCSFile::o_booland(InstructionType type) {
 }
 
 /** EQ: compare the top-most stack elements for equality (==). */
-void NCSFile::o_eq(InstructionType type) {
+void NCSFile::o_eq(const Instruction &instr) {
 	size_t n = 1;
 
-	if (type == kInstTypeStructStruct) {
+	if (instr.type == kInstTypeStructStruct) {
 		// Comparisons between two structs (or two vectors) come with the size of the type
 
-		const size_t size = _script->readUint16BE();
+		const size_t size = instr.args[0];
 
 		if ((size % 4) != 0)
 			throw Common::Exception("NCSFile::o_eq(): size %% 4 != 0");
@@ -743,13 +948,13 @@ void NCSFile::o_eq(InstructionType type) {
 }
 
 /** NEQ: compare the top-most stack elements for inequality (!=). */
-void NCSFile::o_neq(InstructionType type) {
+void NCSFile::o_neq(const Instruction &instr) {
 	size_t n = 1;
 
-	if (type == kInstTypeStructStruct) {
+	if (instr.type == kInstTypeStructStruct) {
 		// Comparisons between two structs (or two vectors) come with the size of the type
 
-		const size_t size = _script->readUint16BE();
+		const size_t size = instr.args[0];
 
 		if ((size % 4) != 0)
 			throw Common::Exception("NCSFile::o_neq(): size %% 4 != 0");
@@ -772,8 +977,8 @@ void NCSFile::o_neq(InstructionType type) {
 }
 
 /** GEQ: compare the top-most stack elements, greater-or-equal (>=). */
-void NCSFile::o_geq(InstructionType type) {
-	switch (type) {
+void NCSFile::o_geq(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -795,13 +1000,13 @@ void NCSFile::o_geq(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_geq(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_geq(): Illegal type %d", instr.type);
 	}
 }
 
 /** GT: compare the top-most stack elements, greater (>). */
-void NCSFile::o_gt(InstructionType type) {
-	switch (type) {
+void NCSFile::o_gt(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -823,13 +1028,13 @@ void NCSFile::o_gt(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_gt(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_gt(): Illegal type %d", instr.type);
 	}
 }
 
 /** LT: compare the top-most stack elements, less (<). */
-void NCSFile::o_lt(InstructionType type) {
-	switch (type) {
+void NCSFile::o_lt(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -851,13 +1056,13 @@ void NCSFile::o_lt(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_lt(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_lt(): Illegal type %d", instr.type);
 	}
 }
 
 /** LEQ: compare the top-most stack elements, less-or-equal (<=). */
-void NCSFile::o_leq(InstructionType type) {
-	switch (type) {
+void NCSFile::o_leq(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -879,14 +1084,14 @@ void NCSFile::o_leq(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_leq(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_leq(): Illegal type %d", instr.type);
 	}
 }
 
 /** SHLEFT: shift the top-most stack element to the left (<<). */
-void NCSFile::o_shleft(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_shleft(): Illegal type %d", type);
+void NCSFile::o_shleft(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_shleft(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -898,15 +1103,15 @@ void NCSFile::o_shleft(InstructionType type) {
 }
 
 /** SHRIGHT: signed-shift the top-most stack element to the right (>>>). */
-void NCSFile::o_shright(InstructionType type) {
+void NCSFile::o_shright(const Instruction &instr) {
 	/* According to Skywing's NWNScriptLib
 	 * (<https://github.com/SkywingvL/nwn2dev-public/blob/master/NWNScriptLib/NWScriptVM.cpp#L2233>):
 	 * "The operation implemented here is actually a complex sequence that, if
 	 *  the amount to be shifted is negative, involves both a front-loaded and
 	 *  end-loaded negate built on top of a signed shift." */
 
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_shright(): Illegal type %d", type);
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_shright(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -924,14 +1129,14 @@ void NCSFile::o_shright(InstructionType type) {
 }
 
 /** USHRIGHT: shift the top-most stack element to the right (>>). */
-void NCSFile::o_ushright(InstructionType type) {
+void NCSFile::o_ushright(const Instruction &instr) {
 	/* According to Skywing's NWNScriptLib
 	 * (<https://github.com/SkywingvL/nwn2dev-public/blob/master/NWNScriptLib/NWScriptVM.cpp#L2272>):
 	 * "While this operator may have originally been intended to implement
 	 *  an unsigned shift, it actually performs an arithmetic (signed) shift." */
 
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_ushright(): Illegal type %d", type);
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_ushright(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -943,9 +1148,9 @@ void NCSFile::o_ushright(InstructionType type) {
 }
 
 /** MOD: calculate the remainder (modulo) of an integer division (%). */
-void NCSFile::o_mod(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_mod(): Illegal type %d", type);
+void NCSFile::o_mod(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_mod(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -963,8 +1168,8 @@ void NCSFile::o_mod(InstructionType type) {
 }
 
 /** NEQ: negate the top-most stack element (unary -). */
-void NCSFile::o_neg(InstructionType type) {
-	switch (type) {
+void NCSFile::o_neg(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
 			try {
 				_stack.push(-_stack.pop().getInt());
@@ -982,14 +1187,14 @@ void NCSFile::o_neg(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_neg(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_neg(): Illegal type %d", instr.type);
 	}
 }
 
 /** COMP: calculate the 1-complement of the top-most stack element (~). */
-void NCSFile::o_comp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_comp(): Illegal type %d", type);
+void NCSFile::o_comp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_comp(): Illegal type %d", instr.type);
 
 	try {
 		_stack.push(~_stack.pop().getInt());
@@ -999,88 +1204,83 @@ void NCSFile::o_comp(InstructionType type) {
 }
 
 /** MOVSP: pop elements off the stack. */
-void NCSFile::o_movsp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_movsp(): Illegal type %d", type);
+void NCSFile::o_movsp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_movsp(): Illegal type %d", instr.type);
 
-	_stack.setStackPtr(_stack.getStackPtr() - _script->readSint32BE());
+	_stack.setStackPtr(_stack.getStackPtr() - instr.args[0]);
 }
 
 /** JMP: jump directly to a different script offset. */
-void NCSFile::o_jmp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jmp(): Illegal type %d", type);
+void NCSFile::o_jmp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jmp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	_script->skip(offset - 6);
+	jump(instr);
 }
 
 /** JZ: jump conditionally if the top-most stack element is 0. */
-void NCSFile::o_jz(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jz(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jz(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jz(): Illegal type %d", instr.type);
 
 	if (!_stack.pop().getInt())
-		_script->skip(offset - 6);
+		jump(instr);
 }
 
 /** NOT: boolean-negate the top-most stack element (!). */
-void NCSFile::o_not(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_not(): Illegal type %d", type);
+void NCSFile::o_not(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_not(): Illegal type %d", instr.type);
 
 	_stack.push(!_stack.pop().getInt());
 }
 
 /** DECSP: decrement the value of a stack element (--). */
-void NCSFile::o_decsp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_decsp(): Illegal type %d", type);
+void NCSFile::o_decsp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_decsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelSP(offset, _stack.getRelSP(offset).getInt() - 1);
 }
 
 /** INCSP: increment the value of a stack element (++). */
-void NCSFile::o_incsp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_incsp(): Illegal type %d", type);
+void NCSFile::o_incsp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_incsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelSP(offset, _stack.getRelSP(offset).getInt() + 1);
 }
 
 /** JNZ: jump conditionally if the top-most stack element is not 0. */
-void NCSFile::o_jnz(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jnz(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jnz(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jnz(): Illegal type %d", instr.type);
 
 	if (_stack.pop().getInt())
-		_script->skip(offset - 6);
+		jump(instr);
 }
 
 /** DECBP: decrement the value of a base-pointer stack element (--). */
-void NCSFile::o_decbp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_decbp(): Illegal type %d", type);
+void NCSFile::o_decbp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_decbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelBP(offset, _stack.getRelBP(offset).getInt() - 1);
 }
 
 /** INCBP: increment the value of a base-pointer stack element (++). */
-void NCSFile::o_incbp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_incbp(): Illegal type %d", type);
+void NCSFile::o_incbp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_incbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelBP(offset, _stack.getRelBP(offset).getInt() + 1);
 }
@@ -1089,9 +1289,9 @@ void NCSFile::o_incbp(InstructionType type) {
  *
  *  Used to create an anchor point to access global variables.
  */
-void NCSFile::o_savebp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_savebp(): Illegal type %d", type);
+void NCSFile::o_savebp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_savebp(): Illegal type %d", instr.type);
 
 	_stack.push(_stack.getBasePtr());
 	_stack.setBasePtr(_stack.getStackPtr());
@@ -1101,25 +1301,30 @@ void NCSFile::o_savebp(InstructionType type) {
  *
  *  Destroy the global variables anchor point after use.
  */
-void NCSFile::o_restorebp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_restorebp(): Illegal type %d", type);
+void NCSFile::o_restorebp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_restorebp(): Illegal type %d", instr.type);
 
 	_stack.setBasePtr(_stack.pop().getInt());
 }
 
+/** An instruction that couldn't be decoded. */
+void NCSFile::o_invalid(const Instruction &UNUSED(instr)) {
+	throw _program->decodeError;
+}
+
 /** NOP: no operation. */
-void NCSFile::o_nop(InstructionType UNUSED(type)) {
+void NCSFile::o_nop(const Instruction &UNUSED(instr)) {
 	// Nothing! Yay!
 }
 
 /** CPDOWNSP: copy a value into an existing stack element. */
-void NCSFile::o_cpdownsp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal type %d", type);
+void NCSFile::o_cpdownsp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal size %d", size);
@@ -1135,12 +1340,12 @@ void NCSFile::o_cpdownsp(InstructionType type) {
 }
 
 /** CPTOPSP: push a copy of a stack element on top of the stack. */
-void NCSFile::o_cptopsp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cptopsp(): Illegal type %d", type);
+void NCSFile::o_cptopsp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cptopsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cptopsp(): Illegal size %d", size);
@@ -1153,8 +1358,8 @@ void NCSFile::o_cptopsp(InstructionType type) {
 }
 
 /** ADD: add the top-most stack elements (+). */
-void NCSFile::o_add(InstructionType type) {
-	switch (type) {
+void NCSFile::o_add(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1188,8 +1393,9 @@ void NCSFile::o_add(InstructionType type) {
 		}
 
 		case kInstTypeStringString: {
-			Variable op2 = _stack.pop();
-			Variable op1 = _stack.pop();
+			// Const, so that reading the strings doesn't unshare them
+			const Variable op2 = _stack.pop();
+			const Variable op1 = _stack.pop();
 
 			_stack.push(op1.getString() + op2.getString());
 			break;
@@ -1210,13 +1416,13 @@ void NCSFile::o_add(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_add(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_add(): Illegal type %d", instr.type);
 	}
 }
 
 /** SUB: subtract the top-most stack elements (-). */
-void NCSFile::o_sub(InstructionType type) {
-	switch (type) {
+void NCSFile::o_sub(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1264,13 +1470,13 @@ void NCSFile::o_sub(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_sub(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_sub(): Illegal type %d", instr.type);
 	}
 }
 
 /** MUL: multiply the top-most stack elements (*). */
-void NCSFile::o_mul(InstructionType type) {
-	switch (type) {
+void NCSFile::o_mul(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1328,13 +1534,13 @@ void NCSFile::o_mul(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_mul(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_mul(): Illegal type %d", instr.type);
 	}
 }
 
 /** DIV: divide the top-most stack elements (/). */
-void NCSFile::o_div(InstructionType type) {
-	switch (type) {
+void NCSFile::o_div(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1413,13 +1619,13 @@ void NCSFile::o_div(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_div(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_div(): Illegal type %d", instr.type);
 	}
 }
 
 /** STORESTATEALL: unused, obsolete opcode. Hopefully. */
-void NCSFile::o_storestateall(InstructionType type) {
-	uint8  offset = (uint8) type;
+void NCSFile::o_storestateall(const Instruction &instr) {
+	uint8  offset = (uint8) instr.type;
 
 	// TODO: NCSFile::o_storestateall(): See o_storestate.
 	//       Supposedly obsolete. Whether it's used anywhere remains to be seen.
@@ -1427,37 +1633,35 @@ void NCSFile::o_storestateall(InstructionType type) {
 }
 
 /** JSR: call a subroutine. */
-void NCSFile::o_jsr(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jsr(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jsr(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jsr(): Illegal type %d", instr.type);
 
 	// Push the current script position
-	_returnOffsets.push(_script->pos());
+	_returnOffsets.push(_pc);
 
-	_script->skip(offset - 6);
+	jump(instr);
 }
 
 /** RETN: return from a subroutine call. */
-void NCSFile::o_retn(InstructionType UNUSED(type)) {
-	uint32 returnAddress = _script->size();
+void NCSFile::o_retn(const Instruction &UNUSED(instr)) {
+	size_t returnAddress = _program->instructions.size();
 	if (!_returnOffsets.empty()) {
 		returnAddress = _returnOffsets.top();
 		_returnOffsets.pop();
 	}
 
-	_script->seek(returnAddress);
+	_pc = returnAddress;
 }
 
 /** DESTRUCT: remove elements from the stack.
  *
  *  Used to isolate struct elements.
  */
-void NCSFile::o_destruct(InstructionType UNUSED(type)) {
-	int16 stackSize        = _script->readSint16BE();
-	int16 dontRemoveOffset = _script->readSint16BE();
-	int16 dontRemoveSize   = _script->readSint16BE();
+void NCSFile::o_destruct(const Instruction &instr) {
+	int16 stackSize        = instr.args[0];
+	int16 dontRemoveOffset = instr.args[1];
+	int16 dontRemoveSize   = instr.args[2];
 
 	if ((stackSize % 4) != 0)
 		throw Common::Exception("NCSFile::o_destruct(): Illegal stack size %d", stackSize);
@@ -1488,12 +1692,12 @@ void NCSFile::o_destruct(InstructionType UNUSED(type)) {
  *
  *  Used to write into a global variable.
  */
-void NCSFile::o_cpdownbp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal type %d", type);
+void NCSFile::o_cpdownbp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE() - 4;
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0] - 4;
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal size %d", size);
@@ -1512,12 +1716,12 @@ void NCSFile::o_cpdownbp(InstructionType type) {
  *
  *  Used to read from a global variable.
  */
-void NCSFile::o_cptopbp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cptopbp(): Illegal type %d", type);
+void NCSFile::o_cptopbp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cptopbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE() - 4;
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0] - 4;
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cptopbp(): Illegal size %d", size);
@@ -1535,10 +1739,10 @@ void NCSFile::o_cptopbp(InstructionType type) {
  *  Used to create the "action" variables when calling an engine function that
  *  assigns a function to an object, or delays a function, or similar.
  */
-void NCSFile::o_storestate(InstructionType type) {
-	uint8  offset = (uint8) type;
-	uint32 sizeBP = _script->readUint32BE();
-	uint32 sizeSP = _script->readUint32BE();
+void NCSFile::o_storestate(const Instruction &instr) {
+	uint8  offset = (uint8) instr.type;
+	uint32 sizeBP = instr.args[0];
+	uint32 sizeSP = instr.args[1];
 
 	if ((sizeBP % 4) != 0)
 		throw Common::Exception("NCSFile::o_storestate(): Illegal BP size %d", sizeBP);
@@ -1548,7 +1752,7 @@ void NCSFile::o_storestate(InstructionType type) {
 	_storedState.setType(kTypeScriptState);
 	ScriptState &state = _storedState.getScriptState();
 
-	state.offset = _script->pos() - 10 + offset;
+	state.offset = instr.address + offset;
 
 	sizeBP /= 4;
 	sizeSP /= 4;
@@ -1571,12 +1775,12 @@ void NCSFile::o_storestate(InstructionType type) {
  *
  *  The index is popped off the stack, but the value written remains.
  */
-void NCSFile::o_writearray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_writearray(): Illegal type %d", type);
+void NCSFile::o_writearray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_writearray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_writearray(): Invalid size %d", size);
@@ -1606,12 +1810,12 @@ void NCSFile::o_writearray(InstructionType type) {
  *  The index is popped off the stack, and the value read out of the
  *  array is pushed on top.
  */
-void NCSFile::o_readarray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_readarray(): Illegal type %d", type);
+void NCSFile::o_readarray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_readarray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_readarray(): Invalid size %d", size);
@@ -1638,12 +1842,12 @@ void NCSFile::o_readarray(InstructionType type) {
  *  The offset to the variable to create a reference to is passed
  *  as a direct argument to the instruction.
  */
-void NCSFile::o_getref(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_getref(): Illegal type %d", type);
+void NCSFile::o_getref(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_getref(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_getref(): Invalid size %d", size);
@@ -1669,12 +1873,12 @@ void NCSFile::o_getref(InstructionType type) {
  *  The index is popped off the stack, and the reference to the
  *  variable inside the array is pushed on top.
  */
-void NCSFile::o_getrefarray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_getrefarray(): Illegal type %d", type);
+void NCSFile::o_getrefarray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_getrefarray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_getrefarray(): Invalid size %d", size);
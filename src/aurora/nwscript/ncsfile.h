@@ -28,7 +28,11 @@
 #include <vector>
 #include <stack>
 
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include "src/common/types.h"
+#include "src/common/error.h"
 
 #include "src/aurora/types.h"
 #include "src/aurora/aurorafile.h"
@@ -48,6 +52,8 @@ namespace NWScript {
 
 class NCSStack : public std::vector<Variable> {
 public:
+	static const size_t kInitialSize = 64;
+
 	NCSStack();
 	~NCSStack();
 
@@ -73,12 +79,15 @@ public:
 
 	void print() const;
 
+	/** Return the number of times all stacks allocated memory so far. */
+	static uint64 getAllocations();
+
 private:
 	int32 _stackPtr;
 	int32 _basePtr;
 };
 
-#define DECLARE_OPCODE(x) void x(InstructionType type)
+#define DECLARE_OPCODE(x) void x(const Instruction &instr)
 
 /** An NCS, BioWare's NWN Compile Script. */
 class NCSFile : public AuroraFile {
@@ -109,6 +118,11 @@ public:
 	static ScriptState getEmptyState();
 
 private:
+	struct Program;
+
+	/** A decoded script, shared between all instances running it. */
+	typedef boost::shared_ptr<const Program> ProgramPtr;
+
 	enum InstructionType {
 		// Unary
 		kInstTypeNone        =  0,
@@ -157,10 +171,53 @@ private:
 		kInstTypeFloatVector            = 60
 	};
 
+	struct Instruction;
+
+	typedef void (NCSFile::*OpcodeProc)(const Instruction &instr);
+	struct Opcode {
+		OpcodeProc proc;
+		const char *desc;
+	};
+
+	/** A decoded instruction, with all its direct arguments already read. */
+	struct Instruction {
+		uint32 address; ///< The offset of the instruction within the script.
+
+		uint8 opcode;
+		InstructionType type;
+
+		OpcodeProc proc; ///< The method executing this instruction.
+
+		int32 args[3];   ///< The instruction's direct arguments.
+		float argFloat;  ///< A float constant.
+		size_t branch;   ///< The index of the jump target, or of a string constant.
+
+		Instruction();
+	};
+
+	/** The immutable part of a script, as loaded from the NCS file. */
+	struct Program : boost::noncopyable {
+		uint32 size; ///< The size of the script in bytes.
+
+		/** The whole script, decoded into instructions. */
+		std::vector<Instruction> instructions;
+		/** All string constants the script uses. */
+		std::vector<Variable> constants;
+
+		/** Why the instructions following the decoded ones couldn't be decoded. */
+		Common::Exception decodeError;
+
+		Program();
+	};
+
 	Common::UString _name;
 
+	ProgramPtr _program;
+
 	NCSStack _stack;
-	Common::SeekableReadStream *_script;
+
+	/** The index of the instruction to execute next. */
+	size_t _pc;
 
 	Variable _return;
 
@@ -169,20 +226,25 @@ private:
 
 	VariableContainer _env;
 
-	std::stack<uint32> _returnOffsets;
+	std::stack<size_t> _returnOffsets; ///< Indices of the instructions to return to.
 
 	Variable _storedState;
 
-	typedef void (NCSFile::*OpcodeProc)(InstructionType type);
-	struct Opcode {
-		OpcodeProc proc;
-		const char *desc;
-	};
-	const Opcode *_opcodes;
-	size_t _opcodeListSize;
-	void setupOpcodes();
+	static const Opcode *_opcodes;
+	static size_t _opcodeListSize;
+	static void setupOpcodes();
+
+	/** Load and decode the script found in this stream. */
+	static Program *load(Common::SeekableReadStream &ncs);
+	/** Load and decode the script with this name. */
+	static ProgramPtr load(const Common::UString &ncs);
 
-	void load();
+	/** Decode the whole script into instructions. */
+	static void decode(Common::SeekableReadStream &ncs, Program &program);
+	/** Decode the direct arguments of one instruction. */
+	static void decodeArguments(Common::SeekableReadStream &ncs, Program &program, Instruction &instr);
+	/** Find the index of the instruction at this offset within the script. */
+	static size_t findInstruction(const Program &program, uint32 address);
 
 	/** Reset the script for another execution. */
 	void reset();
@@ -192,11 +254,13 @@ private:
 	/** Execute one script step. */
 	bool executeStep();
 
-	void decompile(); // TODO
+	/** Continue execution at the target of this jump instruction. */
+	void jump(const Instruction &instr);
 
 	void callEngine(Aurora::NWScript::FunctionContext &ctx, uint32 function, uint8 argCount);
 
 	// Opcode declarations
+	DECLARE_OPCODE(o_invalid);
 	DECLARE_OPCODE(o_nop);
 	DECLARE_OPCODE(o_cpdownsp);
 	DECLARE_OPCODE(o_rsadd);
@@ -246,6 +310,8 @@ private:
 	DECLARE_OPCODE(o_readarray);
 	DECLARE_OPCODE(o_getref);
 	DECLARE_OPCODE(o_getrefarray);
+
+	friend class ScriptCache;
 };
 
 #undef DECLARE_OPCODE
@@ -0,0 +1,90 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of loaded NWScript scripts.
+ */
+
+#include "src/aurora/resman.h"
+
+#include "src/aurora/nwscript/scriptcache.h"
+
+DECLARE_SINGLETON(Aurora::NWScript::ScriptCache)
+
+namespace Aurora {
+
+namespace NWScript {
+
+ScriptCache::Statistics::Statistics() : hits(0), misses(0), count(0) {
+}
+
+
+ScriptCache::ScriptCache() : _generation(0) {
+}
+
+ScriptCache::~ScriptCache() {
+}
+
+void ScriptCache::clear() {
+	Common::StackLock lock(_mutex);
+
+	_programs.clear();
+
+	_statistics.count = 0;
+}
+
+ScriptCache::Statistics ScriptCache::getStatistics() const {
+	Common::StackLock lock(_mutex);
+
+	return _statistics;
+}
+
+NCSFile::ProgramPtr ScriptCache::get(const Common::UString &ncs) {
+	Common::StackLock lock(_mutex);
+
+	// The resources changed, so any of the scripts might have, too
+	if (_generation != ResMan.getGeneration()) {
+		_programs.clear();
+		_statistics.count = 0;
+
+		_generation = ResMan.getGeneration();
+	}
+
+	ProgramMap::const_iterator p = _programs.find(ncs);
+	if (p != _programs.end()) {
+		_statistics.hits++;
+
+		return p->second;
+	}
+
+	_statistics.misses++;
+
+	// Scripts that fail to load aren't cached, so that they throw each time
+	NCSFile::ProgramPtr program = NCSFile::load(ncs);
+
+	_programs.insert(std::make_pair(ncs, program));
+	_statistics.count = _programs.size();
+
+	return program;
+}
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
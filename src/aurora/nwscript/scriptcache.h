@@ -0,0 +1,105 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of loaded NWScript scripts.
+ */
+
+#ifndef AURORA_NWSCRIPT_SCRIPTCACHE_H
+#define AURORA_NWSCRIPT_SCRIPTCACHE_H
+
+#include <map>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/singleton.h"
+#include "src/common/mutex.h"
+
+#include "src/aurora/nwscript/ncsfile.h"
+
+namespace Aurora {
+
+namespace NWScript {
+
+/** A cache of loaded NWScript scripts.
+ *
+ *  Scripts are run very often, with every heartbeat, perception or
+ *  dialogue condition. Instead of reading and decoding the script
+ *  every time, an NCSFile constructed by name takes the decoded script
+ *  out of this cache. Only the state of a single run of the script is
+ *  kept in the NCSFile itself.
+ *
+ *  A decoded script is immutable and shared between all NCSFile
+ *  instances running it. It stays valid as long as one of them exists,
+ *  even if the cache is cleared in the meantime.
+ *
+ *  Whenever resources are added to or removed from the ResourceManager,
+ *  a script of the same name might now be a different script. The whole
+ *  cache is then thrown away.
+ *
+ *  All methods are thread-safe.
+ */
+class ScriptCache : public Common::Singleton<ScriptCache> {
+public:
+	/** Statistics about the cache's usage. */
+	struct Statistics {
+		uint64 hits;   ///< Number of requests that found the script in the cache.
+		uint64 misses; ///< Number of requests that had to load the script.
+
+		size_t count; ///< Number of scripts currently in the cache.
+
+		Statistics();
+	};
+
+	ScriptCache();
+	~ScriptCache();
+
+	/** Remove all scripts from the cache. */
+	void clear();
+
+	/** Return the current cache statistics. */
+	Statistics getStatistics() const;
+
+private:
+	typedef std::map<Common::UString, NCSFile::ProgramPtr, Common::UString::iless> ProgramMap;
+
+	ProgramMap _programs;
+
+	/** The resource generation the cached scripts were loaded in. */
+	uint32 _generation;
+
+	Statistics _statistics;
+
+	mutable Common::Mutex _mutex;
+
+	/** Return the decoded script with this name, loading it if necessary. */
+	NCSFile::ProgramPtr get(const Common::UString &ncs);
+
+	friend class NCSFile;
+};
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
+
+/** Shortcut for accessing the script cache. */
+#define ScriptCacheMan Aurora::NWScript::ScriptCache::instance()
+
+#endif // AURORA_NWSCRIPT_SCRIPTCACHE_H
@@ -22,6 +22,8 @@
  *  NWScript variable.
  */
 
+#include "src/common/atomic.h"
+
 #include <boost/make_shared.hpp>
 
 #include "src/common/error.h"
@@ -34,6 +36,22 @@ namespace Aurora {
 
 namespace NWScript {
 
+/** The number of strings allocated by string variables so far. */
+static boost::atomic<uint64> stringAllocations(0);
+
+static boost::shared_ptr<Common::UString> allocateString(const Common::UString &str) {
+	stringAllocations++;
+
+	return boost::make_shared<Common::UString>(str);
+}
+
+/** The string all new string variables start out with. */
+static const boost::shared_ptr<Common::UString> &getEmptyString() {
+	static const boost::shared_ptr<Common::UString> emptyString = allocateString("");
+
+	return emptyString;
+}
+
 Variable::Variable(Type type) : _type(kTypeVoid) {
 	setType(type);
 }
@@ -90,10 +108,9 @@ Variable::~Variable() {
 
 void Variable::setType(Type type) {
 	_array.reset();
+	_string.reset();
 
-	if      (_type == kTypeString)
-		delete _value._string;
-	else if (_type == kTypeEngineType)
+	if      (_type == kTypeEngineType)
 		delete _value._engineType;
 	else if (_type == kTypeScriptState)
 		delete _value._scriptState;
@@ -118,7 +135,7 @@ void Variable::setType(Type type) {
 			break;
 
 		case kTypeString:
-			_value._string = new Common::UString;
+			_string = getEmptyString();
 			break;
 
 		case kTypeObject:
@@ -156,7 +173,7 @@ Variable &Variable::operator=(const Variable &var) {
 	setType(var._type);
 
 	if      (_type == kTypeString)
-		*_value._string = *var._value._string;
+		_string = var._string;
 	else if (_type == kTypeEngineType)
 		*this = var._value._engineType;
 	else if (_type == kTypeScriptState)
@@ -191,7 +208,10 @@ Variable &Variable::operator=(const Common::UString &value) {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't assign a string value to a non-string variable");
 
-	*_value._string = value;
+	if (_string.unique())
+		*_string = value;
+	else
+		_string = allocateString(value);
 
 	return *this;
 }
@@ -242,7 +262,7 @@ bool Variable::operator==(const Variable &var) const {
 			return _value._float == var._value._float;
 
 		case kTypeString:
-			return *_value._string == *var._value._string;
+			return (_string == var._string) || (*_string == *var._string);
 
 		case kTypeObject:
 			return _value._object == var._value._object;
@@ -288,14 +308,25 @@ const Common::UString &Variable::getString() const {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't get a string value from a non-string variable");
 
-	return *_value._string;
+	return *_string;
 }
 
 Common::UString &Variable::getString() {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't get a string value from a non-string variable");
 
-	return *_value._string;
+	unshareString();
+
+	return *_string;
+}
+
+void Variable::unshareString() {
+	if (!_string.unique())
+		_string = allocateString(*_string);
+}
+
+uint64 Variable::getStringAllocations() {
+	return stringAllocations.load();
 }
 
 Object *Variable::getObject() const {
@@ -52,6 +52,12 @@ struct ScriptState {
 	std::vector<class Variable> locals;
 };
 
+/** A variable within an NWScript script.
+ *
+ *  Strings are shared between copies of a variable, and only copied once
+ *  a variable holding a shared string is changed. Pushing strings around
+ *  the script stack therefore doesn't need to copy them.
+ */
 class Variable {
 public:
 	typedef std::vector< boost::shared_ptr<Variable> > Array;
@@ -85,6 +91,10 @@ public:
 
 	int32 getInt() const;
 	float getFloat() const;
+	/** Return the string for modification.
+	 *
+	 *  The reference is only valid until the variable is copied or changed.
+	 */
 	Common::UString &getString();
 	const Common::UString &getString() const;
 	Object *getObject() const;
@@ -106,13 +116,15 @@ public:
 	Variable *getReference() const;
 	void setReference(Variable *reference);
 
+	/** Return the number of strings all string variables allocated so far. */
+	static uint64 getStringAllocations();
+
 private:
 	Type _type;
 
 	union {
 		int32 _int;
 		float _float;
-		Common::UString *_string;
 		Object *_object;
 		float _vector[3];
 		ScriptState *_scriptState;
@@ -121,6 +133,12 @@ private:
 	} _value;
 
 	boost::shared_ptr<Array> _array;
+
+	/** The string value, shared with all copies of this variable. */
+	boost::shared_ptr<Common::UString> _string;
+
+	/** Make sure the string isn't shared with any other variable. */
+	void unshareString();
 };
 
 } // End of namespace NWScript
@@ -0,0 +1,209 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of decoded archive resources.
+ */
+
+#include <cassert>
+
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/readstream.h"
+#include "src/common/memreadstream.h"
+
+#include "src/aurora/rescache.h"
+
+namespace Aurora {
+
+/** A MemoryReadStream over cached resource data, keeping the data alive. */
+class CachedReadStream : public Common::MemoryReadStream {
+public:
+	CachedReadStream(const boost::shared_ptr<void> &owner, const byte *data, size_t size) :
+		Common::MemoryReadStream(data, size), _owner(owner) {
+	}
+
+	~CachedReadStream() {
+	}
+
+private:
+	boost::shared_ptr<void> _owner;
+};
+
+
+ResourceCache::Key::Key(uint64 h, uint32 p, const void *a, uint32 i) :
+	hash(h), priority(p), archive(a), index(i) {
+
+}
+
+bool ResourceCache::Key::operator<(const Key &right) const {
+	if (hash     != right.hash)
+		return hash     < right.hash;
+	if (priority != right.priority)
+		return priority < right.priority;
+	if (archive  != right.archive)
+		return archive  < right.archive;
+
+	return index < right.index;
+}
+
+
+ResourceCache::Statistics::Statistics() : hits(0), misses(0), evictions(0), count(0), size(0), maxSize(0) {
+}
+
+
+ResourceCache::Data::Data(byte *d, size_t s) : data(d), size(s) {
+}
+
+ResourceCache::Data::~Data() {
+	delete[] data;
+}
+
+
+ResourceCache::Entry::Entry(const Key &k, const DataPtr &d) : key(k), data(d) {
+}
+
+
+ResourceCache::ResourceCache(size_t maxSize) {
+	_statistics.maxSize = maxSize;
+}
+
+ResourceCache::~ResourceCache() {
+}
+
+void ResourceCache::setMaxSize(size_t maxSize) {
+	Common::StackLock lock(_mutex);
+
+	_statistics.maxSize = maxSize;
+
+	evict(maxSize);
+}
+
+void ResourceCache::clear() {
+	Common::StackLock lock(_mutex);
+
+	_entries.clear();
+	_entryMap.clear();
+
+	_statistics.count = 0;
+	_statistics.size  = 0;
+}
+
+Common::SeekableReadStream *ResourceCache::get(const Key &key) {
+	Common::StackLock lock(_mutex);
+
+	EntryMap::iterator e = _entryMap.find(key);
+	if (e == _entryMap.end()) {
+		_statistics.misses++;
+		return 0;
+	}
+
+	_statistics.hits++;
+
+	// Move the entry to the front of the list, marking it as the most recently used
+	_entries.splice(_entries.begin(), _entries, e->second);
+
+	return createView(e->second->data);
+}
+
+Common::SeekableReadStream *ResourceCache::add(const Key &key, Common::SeekableReadStream *stream) {
+	assert(stream);
+
+	const size_t size = stream->size();
+
+	{
+		Common::StackLock lock(_mutex);
+
+		// Don't cache resources that would take up too much of the cache
+		if ((size == 0) || (size == Common::SeekableReadStream::kSizeInvalid) || (size > (_statistics.maxSize / 4)))
+			return stream;
+	}
+
+	// If the stream owns a buffer with the resource data, just take that over
+	Common::MemoryReadStream *memoryStream = dynamic_cast<Common::MemoryReadStream *>(stream);
+	byte *data = memoryStream ? memoryStream->releaseData() : 0;
+
+	if (!data) {
+		// Otherwise, read the resource data, outside the lock
+		data = new byte[size];
+
+		try {
+			stream->seek(0);
+			if (stream->read(data, size) != size)
+				throw Common::Exception(Common::kReadError);
+
+		} catch (...) {
+			delete[] data;
+			delete stream;
+			throw;
+		}
+	}
+
+	delete stream;
+
+	DataPtr dataPtr(new Data(data, size));
+
+	Common::StackLock lock(_mutex);
+
+	// Another thread might have added the same resource in the meantime
+	EntryMap::iterator e = _entryMap.find(key);
+	if (e != _entryMap.end()) {
+		_statistics.size -= e->second->data->size;
+		_statistics.count--;
+
+		_entries.erase(e->second);
+		_entryMap.erase(e);
+	}
+
+	evict((_statistics.maxSize > size) ? (_statistics.maxSize - size) : 0);
+
+	_entries.push_front(Entry(key, dataPtr));
+	_entryMap.insert(std::make_pair(key, _entries.begin()));
+
+	_statistics.size += size;
+	_statistics.count++;
+
+	return createView(dataPtr);
+}
+
+ResourceCache::Statistics ResourceCache::getStatistics() const {
+	Common::StackLock lock(_mutex);
+
+	return _statistics;
+}
+
+void ResourceCache::evict(size_t maxSize) {
+	while (!_entries.empty() && (_statistics.size > maxSize)) {
+		const Entry &entry = _entries.back();
+
+		_statistics.size -= entry.data->size;
+		_statistics.count--;
+		_statistics.evictions++;
+
+		_entryMap.erase(entry.key);
+		_entries.pop_back();
+	}
+}
+
+Common::SeekableReadStream *ResourceCache::createView(const DataPtr &data) {
+	return new CachedReadStream(data, data->data, data->size);
+}
+
+} // End of namespace Aurora
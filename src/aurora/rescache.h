@@ -0,0 +1,146 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of decoded archive resources.
+ */
+
+#ifndef AURORA_RESCACHE_H
+#define AURORA_RESCACHE_H
+
+#include <list>
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/mutex.h"
+
+namespace Common {
+	class SeekableReadStream;
+}
+
+namespace Aurora {
+
+/** A size-bounded cache of decoded archive resources.
+ *
+ *  Resources within compressed or encrypted archives need to be decoded
+ *  each time they are requested. The ResourceCache keeps the decoded data
+ *  of the most recently used resources around, evicting the least recently
+ *  used ones once the cache grows too large.
+ *
+ *  Cached resources are handed out as read-only views on the shared decoded
+ *  data. The data stays valid as long as a view exists, even if the resource
+ *  has been evicted from the cache in the meantime.
+ *
+ *  All methods are thread-safe.
+ */
+class ResourceCache : boost::noncopyable {
+public:
+	/** The identity of a cached resource. */
+	struct Key {
+		uint64 hash;     ///< The hashed name of the resource.
+		uint32 priority; ///< The priority of the resource.
+
+		const void *archive; ///< The archive the resource is found in.
+		uint32      index;   ///< The index of the resource within the archive.
+
+		Key(uint64 h, uint32 p, const void *a, uint32 i);
+
+		bool operator<(const Key &right) const;
+	};
+
+	/** Statistics about the cache's usage. */
+	struct Statistics {
+		uint64 hits;      ///< Number of requests that found the resource in the cache.
+		uint64 misses;    ///< Number of requests that didn't find the resource in the cache.
+		uint64 evictions; ///< Number of resources that were evicted to make room.
+
+		size_t count;   ///< Number of resources currently in the cache.
+		size_t size;    ///< Size of all resources currently in the cache, in bytes.
+		size_t maxSize; ///< Maximum size of the cache, in bytes.
+
+		Statistics();
+	};
+
+	static const size_t kDefaultMaxSize = 64 * 1024 * 1024;
+
+	ResourceCache(size_t maxSize = kDefaultMaxSize);
+	~ResourceCache();
+
+	/** Set the maximum size of the cache, in bytes. 0 disables the cache. */
+	void setMaxSize(size_t maxSize);
+
+	/** Remove all resources from the cache. */
+	void clear();
+
+	/** Return a view of a cached resource, or 0 if the resource is not in the cache. */
+	Common::SeekableReadStream *get(const Key &key);
+
+	/** Add a decoded resource to the cache.
+	 *
+	 *  @param  key The identity of the resource.
+	 *  @param  stream The decoded resource. The cache takes over this stream.
+	 *  @return A stream of the resource's contents.
+	 */
+	Common::SeekableReadStream *add(const Key &key, Common::SeekableReadStream *stream);
+
+	/** Return the current cache statistics. */
+	Statistics getStatistics() const;
+
+private:
+	/** The decoded data of a resource. */
+	struct Data : boost::noncopyable {
+		byte  *data;
+		size_t size;
+
+		Data(byte *d, size_t s);
+		~Data();
+	};
+
+	typedef boost::shared_ptr<Data> DataPtr;
+
+	struct Entry {
+		Key     key;
+		DataPtr data;
+
+		Entry(const Key &k, const DataPtr &d);
+	};
+
+	/** All cached resources, the most recently used one first. */
+	typedef std::list<Entry> EntryList;
+	typedef std::map<Key, EntryList::iterator> EntryMap;
+
+	EntryList _entries;
+	EntryMap  _entryMap;
+
+	Statistics _statistics;
+
+	mutable Common::Mutex _mutex;
+
+	void evict(size_t maxSize);
+
+	static Common::SeekableReadStream *createView(const DataPtr &data);
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_RESCACHE_H
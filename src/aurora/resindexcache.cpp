@@ -0,0 +1,421 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of archive resource indices.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/endianness.h"
+#include "src/common/filepath.h"
+#include "src/common/mappedfile.h"
+#include "src/common/writefile.h"
+#include "src/common/memwritestream.h"
+
+#include "src/aurora/resindexcache.h"
+
+static const uint32 kCacheID      = MKTAG('X', 'R', 'I', 'C');
+static const uint32 kCacheVersion = MKTAG('V', '1', '.', '0');
+
+static const uint32 kHeaderSize   = 40;
+static const uint32 kArchiveSize  = 32;
+static const uint32 kPartSize     = 40;
+static const uint32 kResourceSize = 24;
+
+namespace Aurora {
+
+ResourceIndexCache::Part::Part() : size(0), modTime(0), hashAlgo(Common::kHashNone) {
+}
+
+ResourceIndexCache::Entry::Entry() : size(0), modTime(0), record(0xFFFFFFFF), used(false) {
+}
+
+
+ResourceIndexCache::ResourceIndexCache() : _data(0), _dataSize(0), _loaded(false), _changed(false) {
+}
+
+ResourceIndexCache::~ResourceIndexCache() {
+	clear();
+}
+
+void ResourceIndexCache::clear() {
+	_entries.clear();
+
+	_mapping.reset();
+	_data     = 0;
+	_dataSize = 0;
+
+	_file.clear();
+
+	_loaded  = false;
+	_changed = false;
+}
+
+bool ResourceIndexCache::isLoaded() const {
+	return _loaded;
+}
+
+void ResourceIndexCache::load(const Common::UString &file) {
+	clear();
+
+	_file   = file;
+	_loaded = true;
+
+	if (!Common::FilePath::isRegularFile(_file))
+		return;
+
+	try {
+		_mapping = Common::MappedFile::map(_file);
+		if (!_mapping)
+			throw Common::Exception(Common::kOpenError);
+
+		_data     = _mapping->getData();
+		_dataSize = _mapping->size();
+
+		parse();
+
+	} catch (Common::Exception &e) {
+		e.add("Failed loading resource index cache \"%s\"", _file.c_str());
+		Common::printException(e, "WARNING: ");
+
+		// Start with an empty cache instead
+		_entries.clear();
+
+		_mapping.reset();
+		_data     = 0;
+		_dataSize = 0;
+	}
+}
+
+void ResourceIndexCache::parse() {
+	if (_dataSize < kHeaderSize)
+		throw Common::Exception("Resource index cache too small");
+
+	if ((READ_BE_UINT32(_data) != kCacheID) || (READ_BE_UINT32(_data + 4) != kCacheVersion))
+		throw Common::Exception("Invalid resource index cache header");
+
+	const uint32 archiveCount   = READ_LE_UINT32(_data +  8);
+	const uint32 archiveOffset  = READ_LE_UINT32(_data + 12);
+	const uint32 partCount      = READ_LE_UINT32(_data + 16);
+	const uint32 partOffset     = READ_LE_UINT32(_data + 20);
+	const uint32 resourceCount  = READ_LE_UINT32(_data + 24);
+	const uint32 resourceOffset = READ_LE_UINT32(_data + 28);
+	const uint32 stringsOffset  = READ_LE_UINT32(_data + 32);
+	const uint32 stringsSize    = READ_LE_UINT32(_data + 36);
+
+	if (((uint64) archiveOffset  + (uint64) archiveCount  * kArchiveSize  > _dataSize) ||
+	    ((uint64) partOffset     + (uint64) partCount     * kPartSize     > _dataSize) ||
+	    ((uint64) resourceOffset + (uint64) resourceCount * kResourceSize > _dataSize) ||
+	    ((uint64) stringsOffset  + (uint64) stringsSize                   > _dataSize))
+		throw Common::Exception("Resource index cache tables out of range");
+
+	for (uint32 i = 0; i < archiveCount; i++) {
+		const byte *archive = _data + archiveOffset + i * kArchiveSize;
+
+		const uint32 firstPart  = READ_LE_UINT32(archive + 24);
+		const uint32 partsCount = READ_LE_UINT32(archive + 28);
+
+		if ((uint64) firstPart + partsCount > partCount)
+			throw Common::Exception("Resource index cache part index out of range");
+
+		for (uint32 j = firstPart; j < (firstPart + partsCount); j++) {
+			const byte *part = _data + partOffset + j * kPartSize;
+
+			if ((uint64) READ_LE_UINT32(part + 28) + READ_LE_UINT32(part + 32) > resourceCount)
+				throw Common::Exception("Resource index cache resource index out of range");
+		}
+
+		Entry &entry = _entries[readString(READ_LE_UINT32(archive), READ_LE_UINT32(archive + 4))];
+
+		entry.size    = READ_LE_UINT64(archive +  8);
+		entry.modTime = READ_LE_UINT64(archive + 16);
+		entry.record  = i;
+	}
+}
+
+Common::UString ResourceIndexCache::readString(uint32 offset, uint32 length) const {
+	const uint32 stringsOffset = READ_LE_UINT32(_data + 32);
+	const uint32 stringsSize   = READ_LE_UINT32(_data + 36);
+
+	if ((uint64) offset + length > stringsSize)
+		throw Common::Exception("Resource index cache string out of range");
+
+	return Common::UString((const char *) _data + stringsOffset + offset, length);
+}
+
+void ResourceIndexCache::readParts(const Entry &entry, PartList &parts) const {
+	if (entry.record == 0xFFFFFFFF) {
+		parts = entry.parts;
+		return;
+	}
+
+	const uint32 archiveOffset  = READ_LE_UINT32(_data + 12);
+	const uint32 partOffset     = READ_LE_UINT32(_data + 20);
+	const uint32 resourceOffset = READ_LE_UINT32(_data + 28);
+
+	const byte *archive = _data + archiveOffset + entry.record * kArchiveSize;
+
+	const uint32 firstPart = READ_LE_UINT32(archive + 24);
+	const uint32 partCount = READ_LE_UINT32(archive + 28);
+
+	parts.resize(partCount);
+	for (uint32 i = 0; i < partCount; i++) {
+		const byte *part = _data + partOffset + (firstPart + i) * kPartSize;
+
+		parts[i].name     = readString(READ_LE_UINT32(part), READ_LE_UINT32(part + 4));
+		parts[i].size     = READ_LE_UINT64(part +  8);
+		parts[i].modTime  = READ_LE_UINT64(part + 16);
+		parts[i].hashAlgo = (Common::HashAlgo) READ_LE_UINT32(part + 24);
+
+		const uint32 firstResource = READ_LE_UINT32(part + 28);
+		const uint32 resourceCount = READ_LE_UINT32(part + 32);
+
+		parts[i].resources.clear();
+		for (uint32 j = 0; j < resourceCount; j++) {
+			const byte *resource = _data + resourceOffset + (firstResource + j) * kResourceSize;
+
+			parts[i].resources.push_back(Archive::Resource());
+			Archive::Resource &res = parts[i].resources.back();
+
+			res.hash  = READ_LE_UINT64(resource);
+			res.type  = (FileType) READ_LE_UINT32(resource + 8);
+			res.index = READ_LE_UINT32(resource + 12);
+			res.name  = readString(READ_LE_UINT32(resource + 16), READ_LE_UINT32(resource + 20));
+		}
+	}
+}
+
+bool ResourceIndexCache::find(const Common::UString &path, uint64 size, uint64 modTime,
+                              PartList &parts) const {
+
+	EntryMap::const_iterator entry = _entries.find(path);
+	if (entry == _entries.end())
+		return false;
+
+	entry->second.used = true;
+
+	if ((entry->second.size != size) || (entry->second.modTime != modTime))
+		return false;
+
+	try {
+		readParts(entry->second, parts);
+	} catch (Common::Exception &e) {
+		e.add("Failed reading resource index cache entry \"%s\"", path.c_str());
+		Common::printException(e, "WARNING: ");
+
+		parts.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void ResourceIndexCache::add(const Common::UString &path, uint64 size, uint64 modTime,
+                             const PartList &parts) {
+
+	Entry &entry = _entries[path];
+
+	entry.size    = size;
+	entry.modTime = modTime;
+	entry.record  = 0xFFFFFFFF;
+	entry.parts   = parts;
+	entry.used    = true;
+
+	_changed = true;
+}
+
+/** Add a string to the string pool, returning its offset and length. */
+static void addString(std::vector<byte> &strings, const Common::UString &str,
+                      uint32 &offset, uint32 &length) {
+
+	offset = strings.size();
+	length = std::strlen(str.c_str());
+
+	strings.insert(strings.end(), (const byte *) str.c_str(), (const byte *) str.c_str() + length);
+}
+
+void ResourceIndexCache::save() {
+	if (!_loaded || _file.empty())
+		return;
+
+	// Drop all archives that weren't used in this session
+	for (EntryMap::iterator e = _entries.begin(); e != _entries.end(); ) {
+		if (!e->second.used) {
+			_entries.erase(e++);
+			_changed = true;
+		} else
+			++e;
+	}
+
+	if (!_changed)
+		return;
+
+	Common::UString tempFile;
+
+	try {
+		std::vector<PartList> archives;
+		archives.reserve(_entries.size());
+
+		for (EntryMap::const_iterator e = _entries.begin(); e != _entries.end(); ++e) {
+			archives.push_back(PartList());
+			readParts(e->second, archives.back());
+		}
+
+		Common::UString directory = Common::FilePath::getDirectory(_file);
+		if (!directory.empty())
+			Common::FilePath::createDirectories(directory);
+
+		// Only make the complete file visible, so that a crash can't leave a broken cache behind
+		tempFile = Common::FilePath::getTemporaryFile(_file);
+		write(tempFile, archives);
+
+		/* All entries are in memory now, so the old cache file can be unmapped. Some systems
+		 * won't let us replace a file while it's still mapped. */
+		std::vector<PartList>::iterator archive = archives.begin();
+		for (EntryMap::iterator e = _entries.begin(); e != _entries.end(); ++e, ++archive) {
+			e->second.record = 0xFFFFFFFF;
+			e->second.parts.swap(*archive);
+		}
+
+		_mapping.reset();
+		_data     = 0;
+		_dataSize = 0;
+
+		// Some systems also won't let us rename over an existing file
+		if (std::rename(tempFile.c_str(), _file.c_str()) != 0) {
+			std::remove(_file.c_str());
+
+			if (std::rename(tempFile.c_str(), _file.c_str()) != 0)
+				throw Common::Exception("Can't rename \"%s\" to \"%s\"", tempFile.c_str(), _file.c_str());
+		}
+
+	} catch (Common::Exception &e) {
+		if (!tempFile.empty())
+			std::remove(tempFile.c_str());
+
+		e.add("Failed writing resource index cache \"%s\"", _file.c_str());
+		Common::printException(e, "WARNING: ");
+	}
+
+	_changed = false;
+}
+
+void ResourceIndexCache::write(const Common::UString &file, const std::vector<PartList> &archives) const {
+	uint32 partCount = 0, resourceCount = 0;
+	for (std::vector<PartList>::const_iterator a = archives.begin(); a != archives.end(); ++a) {
+		partCount += a->size();
+		for (PartList::const_iterator p = a->begin(); p != a->end(); ++p)
+			resourceCount += p->resources.size();
+	}
+
+	const uint32 archiveOffset  = kHeaderSize;
+	const uint32 partOffset     = archiveOffset  + _entries.size() * kArchiveSize;
+	const uint32 resourceOffset = partOffset     + partCount       * kPartSize;
+	const uint32 stringsOffset  = resourceOffset + resourceCount   * kResourceSize;
+
+	Common::MemoryWriteStreamDynamic records(true);
+	std::vector<byte> strings;
+
+	// Archive records
+
+	std::vector<PartList>::const_iterator archive = archives.begin();
+
+	uint32 firstPart = 0;
+	for (EntryMap::const_iterator e = _entries.begin(); e != _entries.end(); ++e, ++archive) {
+		uint32 pathOffset, pathLength;
+		addString(strings, e->first, pathOffset, pathLength);
+
+		records.writeUint32LE(pathOffset);
+		records.writeUint32LE(pathLength);
+		records.writeUint64LE(e->second.size);
+		records.writeUint64LE(e->second.modTime);
+		records.writeUint32LE(firstPart);
+		records.writeUint32LE(archive->size());
+
+		firstPart += archive->size();
+	}
+
+	// Part records
+
+	uint32 firstResource = 0;
+	for (archive = archives.begin(); archive != archives.end(); ++archive) {
+		for (PartList::const_iterator p = archive->begin(); p != archive->end(); ++p) {
+			uint32 nameOffset, nameLength;
+			addString(strings, p->name, nameOffset, nameLength);
+
+			records.writeUint32LE(nameOffset);
+			records.writeUint32LE(nameLength);
+			records.writeUint64LE(p->size);
+			records.writeUint64LE(p->modTime);
+			records.writeUint32LE((uint32) p->hashAlgo);
+			records.writeUint32LE(firstResource);
+			records.writeUint32LE(p->resources.size());
+			records.writeUint32LE(0);
+
+			firstResource += p->resources.size();
+		}
+	}
+
+	// Resource records
+
+	for (archive = archives.begin(); archive != archives.end(); ++archive) {
+		for (PartList::const_iterator p = archive->begin(); p != archive->end(); ++p) {
+			for (Archive::ResourceList::const_iterator r = p->resources.begin(); r != p->resources.end(); ++r) {
+				uint32 nameOffset, nameLength;
+				addString(strings, r->name, nameOffset, nameLength);
+
+				records.writeUint64LE(r->hash);
+				records.writeUint32LE((uint32) r->type);
+				records.writeUint32LE(r->index);
+				records.writeUint32LE(nameOffset);
+				records.writeUint32LE(nameLength);
+			}
+		}
+	}
+
+	Common::WriteFile cache;
+	if (!cache.open(file))
+		throw Common::Exception(Common::kOpenError);
+
+	cache.writeUint32BE(kCacheID);
+	cache.writeUint32BE(kCacheVersion);
+	cache.writeUint32LE(_entries.size());
+	cache.writeUint32LE(archiveOffset);
+	cache.writeUint32LE(partCount);
+	cache.writeUint32LE(partOffset);
+	cache.writeUint32LE(resourceCount);
+	cache.writeUint32LE(resourceOffset);
+	cache.writeUint32LE(stringsOffset);
+	cache.writeUint32LE(strings.size());
+
+	if (cache.write(records.getData(), records.size()) != records.size())
+		throw Common::Exception(Common::kWriteError);
+	if (!strings.empty() && (cache.write(&strings[0], strings.size()) != strings.size()))
+		throw Common::Exception(Common::kWriteError);
+
+	cache.flush();
+	cache.close();
+}
+
+} // End of namespace Aurora
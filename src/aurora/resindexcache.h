@@ -0,0 +1,168 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of archive resource indices.
+ */
+
+#ifndef AURORA_RESINDEXCACHE_H
+#define AURORA_RESINDEXCACHE_H
+
+#include <vector>
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/hash.h"
+
+#include "src/aurora/archive.h"
+
+namespace Common {
+	class MappedFile;
+}
+
+namespace Aurora {
+
+/** A persistent on-disk cache of archive resource indices.
+ *
+ *  Indexing an archive means parsing its headers and building a list of
+ *  all the resources it contains. For games with hundreds of archives,
+ *  or with KEY files indexing tens of thousands of resources, this can
+ *  take a noticeable amount of time at every start.
+ *
+ *  The ResourceIndexCache remembers the resource lists of archives,
+ *  keyed by the archive's path, size and modification time. If none of
+ *  these changed, the ResourceManager can use the cached list directly,
+ *  and only needs to open the archive itself once a resource within it
+ *  is actually requested.
+ *
+ *  An archive is stored as a list of parts. Most archives consist of a
+ *  single part, the archive itself. A KEY file, however, has one part
+ *  for each of the BIF files it indexes. Each part has its own size and
+ *  modification time, so that changed BIF files can be detected as well.
+ *
+ *  The cache file has a flat layout: a header, followed by fixed-size
+ *  records for all archives, parts and resources, and finally a string
+ *  pool. It is mapped into memory, and only the archive records are parsed
+ *  immediately. The part and resource records are only decoded when the
+ *  archive is actually requested.
+ *
+ *  When saving, only the archives that were looked up or added during this
+ *  session are written back, so that archives that don't exist anymore are
+ *  dropped. The new cache is written into a temporary file first, which
+ *  then replaces the old cache file.
+ */
+class ResourceIndexCache : boost::noncopyable {
+public:
+	/** A part of a cached archive. */
+	struct Part {
+		Common::UString name; ///< The name of the part (the BIF name for KEY files).
+
+		uint64 size;    ///< The size of the part's file.
+		uint64 modTime; ///< The modification time of the part's file.
+
+		/** With which algorithm the resource names in the part are hashed. */
+		Common::HashAlgo hashAlgo;
+
+		/** The resources found in this part. */
+		Archive::ResourceList resources;
+
+		Part();
+	};
+
+	typedef std::vector<Part> PartList;
+
+	ResourceIndexCache();
+	~ResourceIndexCache();
+
+	/** Clear the cache, without writing it back. */
+	void clear();
+
+	/** Load the cache from this file. A broken or missing file results in an empty cache. */
+	void load(const Common::UString &file);
+	/** Write the cache back into the file it was loaded from, if it was changed.
+	 *
+	 *  Archives that weren't looked up or added since loading are dropped.
+	 */
+	void save();
+
+	/** Was a cache file loaded? */
+	bool isLoaded() const;
+
+	/** Look up an archive in the cache.
+	 *
+	 *  @param  path The absolute path of the archive.
+	 *  @param  size The current size of the archive file.
+	 *  @param  modTime The current modification time of the archive file.
+	 *  @param  parts The cached parts of the archive will be stored here.
+	 *  @return true if the archive was found and is up-to-date.
+	 */
+	bool find(const Common::UString &path, uint64 size, uint64 modTime, PartList &parts) const;
+
+	/** Add (or replace) an archive to the cache. */
+	void add(const Common::UString &path, uint64 size, uint64 modTime, const PartList &parts);
+
+private:
+	/** A cached archive. */
+	struct Entry {
+		uint64 size;    ///< The size of the archive file.
+		uint64 modTime; ///< The modification time of the archive file.
+
+		/** Index of the archive record in the loaded cache data. 0xFFFFFFFF for new entries. */
+		uint32 record;
+
+		/** The parts of the archive, if this is a new entry. */
+		PartList parts;
+
+		/** Was this archive looked up or added since loading the cache? */
+		mutable bool used;
+
+		Entry();
+	};
+
+	typedef std::map<Common::UString, Entry> EntryMap;
+
+	Common::UString _file; ///< The file the cache was loaded from.
+
+	/** The memory mapping of the loaded cache file. */
+	boost::shared_ptr<Common::MappedFile> _mapping;
+
+	const byte *_data;     ///< The raw data of the loaded cache file.
+	uint32      _dataSize; ///< The size of the raw data.
+
+	EntryMap _entries; ///< All cached archives, indexed by path.
+
+	bool _loaded;  ///< Was a cache file loaded?
+	bool _changed; ///< Was the cache changed since loading it?
+
+	void parse();
+	void readParts(const Entry &entry, PartList &parts) const;
+
+	Common::UString readString(uint32 offset, uint32 length) const;
+
+	void write(const Common::UString &file, const std::vector<PartList> &archives) const;
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_RESINDEXCACHE_H
@@ -24,11 +24,18 @@
 
 #include <cassert>
 
+#include <boost/bind.hpp>
+
+#include <SDL_timer.h>
+
 #include "src/common/util.h"
 #include "src/common/error.h"
+#include "src/common/debug.h"
+#include "src/common/configman.h"
 #include "src/common/readstream.h"
 #include "src/common/filepath.h"
 #include "src/common/readfile.h"
+#include "src/common/mappedfile.h"
 #include "src/common/writefile.h"
 
 #include "src/aurora/resman.h"
@@ -66,8 +73,13 @@ ResourceManager::KnownArchive::KnownArchive(ArchiveType t, const Common::UString
 ResourceManager::OpenedArchive::OpenedArchive() : archive(0), known(0), parent(0) {
 }
 
-void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive &a) {
-	archive = &a;
+ResourceManager::OpenedArchive::OpenedArchive(const OpenedArchive &a) :
+	archive(a.archive.load()), known(a.known), parent(a.parent), children(a.children) {
+
+}
+
+void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive *a) {
+	archive = a;
 	known   = &kA;
 
 	if (known->opened)
@@ -90,8 +102,8 @@ void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive &a) {
 }
 
 
-ResourceManager::Resource::Resource() : type(kFileTypeNone), isSmall(false), priority(0),
-		source(kSourceNone), archive(0), archiveIndex(0xFFFFFFFF) {
+ResourceManager::Resource::Resource() : name(0), type(kFileTypeNone), hash(0), isSmall(false), priority(0),
+		source(kSourceNone), archive(0), archiveIndex(0xFFFFFFFF), next(kResourceNone) {
 
 	selfArchive.first = 0;
 }
@@ -101,8 +113,16 @@ bool ResourceManager::Resource::operator<(const Resource &right) const {
 }
 
 
-ResourceManager::ResourceManager() : _hasSmall(false),
-	_hashAlgo(Common::kHashFNV64) {
+ResourceManager::ResourceSlot::ResourceSlot() : hash(0), resource(kResourceNone) {
+}
+
+
+ResourceManager::ResourceManager() : _hasSmall(false), _mapArchives(false),
+	_hashAlgo(Common::kHashFNV64), _resourceSlotsUsed(0), _generation(0),
+	_prefetcher(boost::bind(&ResourceManager::prefetchResource, this, _1, _2)) {
+
+	// The empty name is always the first in the name pool
+	internName("");
 
 	// These file types are archives
 
@@ -179,6 +199,13 @@ void ResourceManager::clear() {
 }
 
 void ResourceManager::clearResources() {
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
+	_indexCache.save();
+	_indexCache.clear();
+
 	_cursorRemap.clear();
 
 	_baseDir.clear();
@@ -188,12 +215,24 @@ void ResourceManager::clearResources() {
 		_knownArchives[i].clear();
 
 	for (OpenedArchives::iterator a = _openedArchives.begin(); a != _openedArchives.end(); ++a)
-		delete a->archive;
+		delete a->archive.load();
 	_openedArchives.clear();
 
-	_resources.clear();
+	_resourceCache.clear();
+
+	_resourceSlots.clear();
+	_resourceSlotsUsed = 0;
+
+	_resourcePool.clear();
+	_freeResources.clear();
+
+	_names.clear();
+	_nameMap.clear();
+	internName("");
 
 	_changes.clear();
+
+	_generation++;
 }
 
 void ResourceManager::setRIMsAreERFs(bool rimsAreERFs) {
@@ -218,7 +257,7 @@ void ResourceManager::setHasSmall(bool hasSmall) {
 }
 
 void ResourceManager::setHashAlgo(Common::HashAlgo algo) {
-	if ((algo != _hashAlgo) && !_resources.empty())
+	if ((algo != _hashAlgo) && (_resourceSlotsUsed != 0))
 		throw Common::Exception("ResourceManager::setHashAlgo(): We already have resources!");
 
 	_hashAlgo = algo;
@@ -231,6 +270,17 @@ void ResourceManager::setCursorRemap(const std::vector<Common::UString> &remap)
 void ResourceManager::registerDataBase(const Common::UString &path) {
 	clearResources();
 
+	if (ConfigMan.getBool("resindexcache", true))
+		_indexCache.load(Common::FilePath::getUserDataFile("resindex.cache"));
+
+	_mapArchives = ConfigMan.getBool("mmaparchives", true);
+
+	_resourceCache.setMaxSize(((size_t) MAX(ConfigMan.getInt("rescachesize", 64), 0)) * 1024 * 1024);
+
+	_prefetcher.setThreadCount(MAX(ConfigMan.getInt("prefetchthreads", 2), 0));
+
+	const uint32 startTime = SDL_GetTicks();
+
 	Common::UString base = Common::FilePath::canonicalize(path);
 
 	if        (Common::FilePath::isDirectory(base)) {
@@ -249,6 +299,8 @@ void ResourceManager::registerDataBase(const Common::UString &path) {
 	} else
 		throw Common::Exception("No such file or directory \"%s\"", path.c_str());
 
+	debugC(Common::kDebugResources, 1, "Indexed data base \"%s\" in %ums",
+	       path.c_str(), SDL_GetTicks() - startTime);
 }
 
 const Common::UString &ResourceManager::getDataBase() const {
@@ -285,12 +337,28 @@ Common::SeekableReadStream *ResourceManager::openArchiveStream(const KnownArchiv
 	if (!archive.resource)
 		throw Common::Exception("Archive without resource reference");
 
-	return getResource(*archive.resource, true);
+	/* BIF, ERF and RIM archives that are plain files are mapped into memory,
+	 * if possible. Uncompressed resources can then be handed out as views
+	 * into the mapping, without any allocation or copying. */
+	const Resource &res = *archive.resource;
+	if (_mapArchives && (res.source == kSourceFile) && !res.isSmall &&
+	    ((archive.type == kArchiveBIF) || (archive.type == kArchiveERF) || (archive.type == kArchiveRIM))) {
+
+		Common::SeekableReadStream *stream = Common::MappedReadStream::open(res.path);
+		if (stream)
+			return stream;
+	}
+
+	return getResource(res, true);
 }
 
 void ResourceManager::indexArchive(const Common::UString &file, uint32 priority,
                                    const std::vector<byte> &password, Common::ChangeID *changeID) {
 
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
 	KnownArchive *knownArchive = findArchive(file);
 	if (!knownArchive)
 		throw Common::Exception("No such archive file \"%s\"", file.c_str());
@@ -302,54 +370,105 @@ void ResourceManager::indexArchive(const Common::UString &file, uint32 priority,
 	if (changeID)
 		change = newChangeSet(*changeID);
 
+	const uint32 startTime = SDL_GetTicks();
+
+	// Only encryption-free archives directly on disk can be cached
+	uint64 size = 0, modTime = 0;
+	const bool cacheable = password.empty() && _indexCache.isLoaded() &&
+	                       isCacheableArchive(knownArchive->type) &&
+	                       getArchiveFileStats(*knownArchive, size, modTime);
+
+	if (cacheable && indexCachedArchive(*knownArchive, size, modTime, priority, change)) {
+		debugC(Common::kDebugResources, 1, "Indexed archive \"%s\" in %ums (cached)",
+		       file.c_str(), SDL_GetTicks() - startTime);
+		return;
+	}
+
+	ResourceIndexCache::PartList cacheParts;
+
 	Archive *archive = 0;
 	try {
-		Common::SeekableReadStream *archiveStream = openArchiveStream(*knownArchive);
+		if (knownArchive->type == kArchiveKEY) {
+			indexKEY(openArchiveStream(*knownArchive), priority, change, cacheable ? &cacheParts : 0);
+		} else {
+			archive = openArchive(*knownArchive, password);
 
-		switch (knownArchive->type) {
-			case kArchiveKEY:
-				indexKEY(archiveStream, priority, change);
-				break;
+			indexArchive(*knownArchive, archive, priority, change);
 
-			case kArchiveNDS:
-				archive = new NDSFile(archiveStream);
-				break;
+			Archive *indexedArchive = archive;
+			archive = 0;
 
-			case kArchiveHERF:
-				archive = new HERFFile(archiveStream);
-				break;
+			if (cacheable && !addCachePart(cacheParts, *knownArchive, *indexedArchive))
+				cacheParts.clear();
+		}
 
-			case kArchiveERF:
-				archive = new ERFFile(archiveStream, password);
-				break;
+	} catch (...) {
+		delete archive;
+		throw;
+	}
 
-			case kArchiveRIM:
-				archive = new RIMFile(archiveStream);
-				break;
+	if (!cacheParts.empty())
+		_indexCache.add(knownArchive->resource->path, size, modTime, cacheParts);
 
-			case kArchiveZIP:
-				archive = new ZIPFile(archiveStream);
-				break;
+	debugC(Common::kDebugResources, 1, "Indexed archive \"%s\" in %ums",
+	       file.c_str(), SDL_GetTicks() - startTime);
+}
 
-			case kArchiveEXE:
-				archive = new PEFile(archiveStream, _cursorRemap);
-				break;
+Archive *ResourceManager::openArchive(const KnownArchive &knownArchive,
+                                      const std::vector<byte> &password) const {
 
-			case kArchiveNSBTX:
-				archive = new NSBTXFile(archiveStream);
-				break;
+	switch (knownArchive.type) {
+		case kArchiveBIF:
+			return new BIFFile(openArchiveStream(knownArchive));
 
-			default:
-				throw Common::Exception("Invalid archive type %d", knownArchive->type);
-		}
+		case kArchiveNDS:
+			return new NDSFile(openArchiveStream(knownArchive));
 
-		if (archive)
-			indexArchive(*knownArchive, archive, priority, change);
+		case kArchiveHERF:
+			return new HERFFile(openArchiveStream(knownArchive));
 
-	} catch (...) {
-		delete archive;
-		throw;
+		case kArchiveERF:
+			return new ERFFile(openArchiveStream(knownArchive), password);
+
+		case kArchiveRIM:
+			return new RIMFile(openArchiveStream(knownArchive));
+
+		case kArchiveZIP:
+			return new ZIPFile(openArchiveStream(knownArchive));
+
+		case kArchiveEXE:
+			return new PEFile(openArchiveStream(knownArchive), _cursorRemap);
+
+		case kArchiveNSBTX:
+			return new NSBTXFile(openArchiveStream(knownArchive));
+
+		default:
+			break;
+	}
+
+	throw Common::Exception("Invalid archive type %d", knownArchive.type);
+}
+
+Archive &ResourceManager::getArchive(OpenedArchive &archive) const {
+	/* If the resource list of this archive came from the index cache, the
+	 * archive itself has not been opened yet. Do that now. */
+
+	Archive *a = archive.archive.load(boost::memory_order_acquire);
+	if (a)
+		return *a;
+
+	/* Only one thread may open the archive. The mutex is recursive, so opening
+	 * an archive that's found within another lazily opened archive is fine. */
+	Common::StackLock lock(_archiveMutex);
+
+	if (!(a = archive.archive.load(boost::memory_order_acquire))) {
+		assert(archive.known);
+
+		a = openArchive(*archive.known, std::vector<byte>());
+		archive.archive.store(a, boost::memory_order_release);
 	}
+
+	return *a;
 }
 
 void ResourceManager::indexArchive(const Common::UString &file, uint32 priority, Common::ChangeID *changeID) {
@@ -393,14 +512,22 @@ uint32 ResourceManager::openKEYBIFs(Common::SeekableReadStream *keyStream,
 	return archives.size();
 }
 
-void ResourceManager::indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change) {
+void ResourceManager::indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change,
+                               ResourceIndexCache::PartList *cacheParts) {
+
 	std::vector<KnownArchive *> archives;
 	std::vector<BIFFile *> bifs;
 
 	const uint32 count = openKEYBIFs(stream, archives, bifs);
 
-	for (uint32 i = 0; i < count; i++)
+	for (uint32 i = 0; i < count; i++) {
 		indexArchive(*archives[i], bifs[i], priority, change);
+
+		if (cacheParts && !addCachePart(*cacheParts, *archives[i], *bifs[i])) {
+			cacheParts->clear();
+			cacheParts = 0;
+		}
+	}
 }
 
 void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
@@ -411,10 +538,18 @@ void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
 		throw Common::Exception("ResourceManager::indexArchive(): Archive uses a different name hashing "
 		                        "algorithm than we do (%d vs. %d)", (int) hashAlgo, (int) _hashAlgo);
 
+	OpenedArchive &opened = addOpenedArchive(knownArchive, archive, change);
+
+	indexArchiveResources(opened, archive->getResources(), hashAlgo, priority, change);
+}
+
+ResourceManager::OpenedArchive &ResourceManager::addOpenedArchive(KnownArchive &knownArchive,
+                                                                  Archive *archive, Change *change) {
+
 	_openedArchives.push_back(OpenedArchive());
 
 	try {
-		_openedArchives.back().set(knownArchive, *archive);
+		_openedArchives.back().set(knownArchive, archive);
 	} catch (...) {
 		_openedArchives.pop_back();
 		throw;
@@ -424,36 +559,123 @@ void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
 	if (change)
 		change->_change->openedArchives.push_back(--_openedArchives.end());
 
-	const Archive::ResourceList &resources = archive->getResources();
+	return _openedArchives.back();
+}
+
+void ResourceManager::indexArchiveResources(OpenedArchive &archive, const Archive::ResourceList &resources,
+                                            Common::HashAlgo hashAlgo, uint32 priority, Change *change) {
+
 	for (Archive::ResourceList::const_iterator resource = resources.begin(); resource != resources.end(); ++resource) {
 		// Build the resource record
 		Resource res;
 		res.priority     = priority;
 		res.source       = kSourceArchive;
-		res.archive      = &_openedArchives.back();
+		res.archive      = &archive;
 		res.archiveIndex = resource->index;
-		res.name         = resource->name;
 		res.type         = resource->type;
 
+		Common::UString name = resource->name;
+
 		// Get the hash or calculate if we have to
-		uint64 hash = (hashAlgo == Common::kHashNone) ? getHash(res.name, res.type) : resource->hash;
+		uint64 hash = (hashAlgo == Common::kHashNone) ? getHash(name, res.type) : resource->hash;
 
 		// Normalize the file types if we can and recalculate the hash
-		if ((res.name != "") && (res.type != kFileTypeNone))
+		if ((name != "") && (res.type != kFileTypeNone))
 			if (normalizeType(res))
-				hash = getHash(res.name, res.type);
+				hash = getHash(name, res.type);
 
 		// Handle "small" files
 		if (_hasSmall && (res.type == kFileTypeSMALL)) {
 			res.isSmall = true;
 
-			res.name = Common::FilePath::getStem(resource->name);
+			name     = Common::FilePath::getStem(resource->name);
 			res.type = TypeMan.getFileType(resource->name);
 		}
 
 		// And add it to our list
-		addResource(res, hash, change);
+		addResource(res, name, hash, change);
+	}
+}
+
+bool ResourceManager::isCacheableArchive(ArchiveType type) const {
+	/* PE files depend on the cursor remap, and NSBTX files are never
+	 * found directly on disk anyway. Lone BIFs are indexed through
+	 * their KEY files. */
+
+	return (type == kArchiveKEY) || (type == kArchiveERF) || (type == kArchiveRIM) ||
+	       (type == kArchiveZIP) || (type == kArchiveHERF) || (type == kArchiveNDS);
+}
+
+bool ResourceManager::getArchiveFileStats(const KnownArchive &archive, uint64 &size, uint64 &modTime) const {
+	if (!archive.resource || (archive.resource->source != kSourceFile) || archive.resource->isSmall)
+		return false;
+
+	const size_t fileSize = Common::FilePath::getFileSize(archive.resource->path);
+	if (fileSize == Common::kFileInvalid)
+		return false;
+
+	size    = fileSize;
+	modTime = Common::FilePath::getModificationTime(archive.resource->path);
+
+	return modTime != 0;
+}
+
+bool ResourceManager::indexCachedArchive(KnownArchive &knownArchive, uint64 size, uint64 modTime,
+                                         uint32 priority, Change *change) {
+
+	ResourceIndexCache::PartList parts;
+	if (!_indexCache.find(knownArchive.resource->path, size, modTime, parts) || parts.empty())
+		return false;
+
+	/* Find the archives of all the parts, and make sure they're still
+	 * up-to-date. Only KEY files are made up of other archives (BIFs).
+	 * If anything is amiss, we fall back to indexing the archive normally. */
+
+	std::vector<KnownArchive *> archives(parts.size(), 0);
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (knownArchive.type == kArchiveKEY) {
+			archives[i] = findArchive(parts[i].name, _knownArchives[kArchiveBIF]);
+			if (!archives[i] || !getArchiveFileStats(*archives[i], size, modTime))
+				return false;
+
+			if ((size != parts[i].size) || (modTime != parts[i].modTime))
+				return false;
+
+		} else
+			archives[i] = &knownArchive;
+
+		if (archives[i]->opened)
+			return false;
+
+		if ((parts[i].hashAlgo != Common::kHashNone) && (parts[i].hashAlgo != _hashAlgo))
+			return false;
 	}
+
+	// Add the resources, but leave the archives unopened until they're needed
+
+	for (size_t i = 0; i < parts.size(); i++) {
+		OpenedArchive &opened = addOpenedArchive(*archives[i], 0, change);
+
+		indexArchiveResources(opened, parts[i].resources, parts[i].hashAlgo, priority, change);
+	}
+
+	return true;
+}
+
+bool ResourceManager::addCachePart(ResourceIndexCache::PartList &parts, const KnownArchive &knownArchive,
+                                   const Archive &archive) const {
+
+	parts.push_back(ResourceIndexCache::Part());
+	ResourceIndexCache::Part &part = parts.back();
+
+	if (!getArchiveFileStats(knownArchive, part.size, part.modTime))
+		return false;
+
+	part.name      = knownArchive.name;
+	part.hashAlgo  = archive.getNameHashAlgo();
+	part.resources = archive.getResources();
+
+	return true;
 }
 
 bool ResourceManager::hasResourceDir(const Common::UString &dir) {
@@ -473,6 +695,10 @@ void ResourceManager::indexResourceFile(const Common::UString &file, uint32 prio
 	if (!Common::FilePath::isRegularFile(path))
 		throw Common::Exception("No such file \"%s\"", file.c_str());
 
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
 	Change *change = 0;
 	if (changeID)
 		change = newChangeSet(*changeID);
@@ -494,6 +720,10 @@ void ResourceManager::indexResourceDir(const Common::UString &dir, const char *g
 	Common::FileList files;
 	files.addDirectory(directory, depth);
 
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
 	Change *change = 0;
 	if (changeID)
 		change = newChangeSet(*changeID);
@@ -517,6 +747,13 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 	if (!change || (change->_change == _changes.end()))
 		return;
 
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
+	// Cached resources might belong to the archives we're removing
+	_resourceCache.clear();
+
 	// Removing all changes in the opened archives list
 	for (OpenedArchiveChanges::iterator oaChange = change->_change->openedArchives.begin();
 	     oaChange != change->_change->openedArchives.end(); ++oaChange) {
@@ -546,7 +783,7 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 				throw Common::Exception("Couldn't find archive in the parent's children list");
 		}
 
-		delete (*oaChange)->archive;
+		delete (*oaChange)->archive.load();
 		_openedArchives.erase(*oaChange);
 	}
 
@@ -568,20 +805,19 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 	for (ResourceChanges::iterator resChange = change->_change->resources.begin();
 	     resChange != change->_change->resources.end(); ++resChange) {
 
+		Resource &res = _resourcePool[*resChange];
+
 		// If the resource still has an archive attached, it was added by a
 		// declareResources() call and needs to be removed manually
-		if (resChange->resIt->selfArchive.first) {
-			if (resChange->resIt->selfArchive.second->opened)
+		if (res.selfArchive.first) {
+			if (res.selfArchive.second->opened)
 				throw Common::Exception("Attempted to deindex an archive resource that's still opened");
 
-			resChange->resIt->selfArchive.first->erase(resChange->resIt->selfArchive.second);
+			res.selfArchive.first->erase(res.selfArchive.second);
 		}
 
-		// Remove the resource, and the name list too if it's empty
-		resChange->hashIt->second.erase(resChange->resIt);
-
-		if (resChange->hashIt->second.empty())
-			_resources.erase(resChange->hashIt);
+		// Remove the resource, and the hash table slot too if it's empty
+		removeResource(*resChange);
 	}
 
 	// Now we can remove the change set from our list of change sets
@@ -592,40 +828,56 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 }
 
 void ResourceManager::addTypeAlias(FileType alias, FileType realType) {
+	Common::StackWriteLock lock(_indexLock);
+
 	_typeAliases[alias] = realType;
 }
 
 void ResourceManager::blacklist(const Common::UString &name, FileType type) {
-	ResourceMap::iterator resList = _resources.find(getHash(name, type));
-	if (resList == _resources.end())
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
+	const size_t slot = findResourceSlot(getHash(name, type));
+	if (slot == SIZE_MAX)
 		return;
 
-	for (ResourceList::iterator res = resList->second.begin(); res != resList->second.end(); ++res)
-		res->priority = 0;
+	for (uint32 r = _resourceSlots[slot].resource; r != kResourceNone; r = _resourcePool[r].next)
+		_resourcePool[r].priority = 0;
+
+	_generation++;
 }
 
 void ResourceManager::declareResource(const Common::UString &name, FileType type) {
+	_prefetcher.cancel();
+
+	Common::StackWriteLock lock(_indexLock);
+
 	bool isSmall = false;
 
-	ResourceMap::iterator resList = _resources.find(getHash(name, type));
-	if (resList == _resources.end()) {
+	size_t slot = findResourceSlot(getHash(name, type));
+	if (slot == SIZE_MAX) {
 		if (_hasSmall) {
 			Common::UString smallName = TypeMan.addFileType(TypeMan.setFileType(name, type), kFileTypeSMALL);
 
-			resList = _resources.find(getHash(smallName));
+			slot    = findResourceSlot(getHash(smallName));
 			isSmall = true;
 		}
 
-		if (resList == _resources.end())
+		if (slot == SIZE_MAX)
 			return;
 	}
 
-	for (ResourceList::iterator r = resList->second.begin(); r != resList->second.end(); ++r) {
-		r->name    = name;
-		r->type    = type;
-		r->isSmall = isSmall;
+	const uint32 nameID = internName(name);
+
+	for (uint32 r = _resourceSlots[slot].resource; r != kResourceNone; r = _resourcePool[r].next) {
+		Resource &res = _resourcePool[r];
+
+		res.name    = nameID;
+		res.type    = type;
+		res.isSmall = isSmall;
 
-		checkResourceIsArchive(*r, 0);
+		checkResourceIsArchive(res, 0);
 	}
 }
 
@@ -652,10 +904,14 @@ bool ResourceManager::hasResource(const Common::UString &name) const {
 }
 
 bool ResourceManager::hasResource(const Common::UString &name, const std::vector<FileType> &types) const {
+	Common::StackReadLock lock(_indexLock);
+
 	return getRes(name, types) != 0;
 }
 
 bool ResourceManager::hasResource(uint64 hash) const {
+	Common::StackReadLock lock(_indexLock);
+
 	return getRes(hash) != 0;
 }
 
@@ -679,6 +935,8 @@ Common::UString ResourceManager::findResourceFile(const Common::UString &name) c
 
 Common::UString ResourceManager::findResourceFile(const Common::UString &name,
                                                   const std::vector<FileType> &types) const {
+	Common::StackReadLock lock(_indexLock);
+
 	const Resource *res = getRes(name, types);
 	if (res && (res->source == kSourceFile))
 		return res->path;
@@ -688,10 +946,10 @@ Common::UString ResourceManager::findResourceFile(const Common::UString &name,
 
 uint32 ResourceManager::getResourceSize(const Resource &res) const {
 	if (res.source == kSourceArchive) {
-		if ((res.archive == 0) || (res.archive->archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
+		if ((res.archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
 			return 0xFFFFFFFF;
 
-		return res.archive->archive->getResourceSize(res.archiveIndex);
+		return getArchive(*res.archive).getResourceSize(res.archiveIndex);
 	}
 
 	if (res.source == kSourceFile)
@@ -701,10 +959,70 @@ uint32 ResourceManager::getResourceSize(const Resource &res) const {
 }
 
 Common::SeekableReadStream *ResourceManager::getArchiveResource(const Resource &res, bool tryNoCopy) const {
-	if ((res.archive == 0) || (res.archive->archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
+	if ((res.archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
 		throw Common::Exception("Archive resource has no archive");
 
-	return res.archive->archive->getResource(res.archiveIndex, tryNoCopy);
+	Archive &archive = getArchive(*res.archive);
+	if (tryNoCopy || !archive.isResourceEncoded(res.archiveIndex))
+		return archive.getResource(res.archiveIndex, tryNoCopy);
+
+	// Look for the decoded resource in the cache first
+	const ResourceCache::Key key(res.hash, res.priority, res.archive, res.archiveIndex);
+
+	Common::SeekableReadStream *stream = _resourceCache.get(key);
+	if (stream)
+		return stream;
+
+	return _resourceCache.add(key, archive.getResource(res.archiveIndex));
+}
+
+PrefetchHandle ResourceManager::prefetch(const std::list<ResourceID> &resources) {
+	ResourcePrefetcher::RequestList requests;
+	for (std::list<ResourceID>::const_iterator r = resources.begin(); r != resources.end(); ++r)
+		requests.push_back(ResourcePrefetcher::Request(r->name, r->type));
+
+	return _prefetcher.prefetch(requests);
+}
+
+PrefetchHandle ResourceManager::prefetch(const Common::UString &name, FileType type) {
+	ResourcePrefetcher::RequestList requests;
+	requests.push_back(ResourcePrefetcher::Request(name, type));
+
+	return _prefetcher.prefetch(requests);
+}
+
+bool ResourceManager::prefetchResource(const Common::UString &name, FileType type) {
+	Common::SeekableReadStream *stream = getResource(name, type);
+	if (!stream)
+		return false;
+
+	/* Read through the whole resource. Encoded resources are now in the
+	 * decoded resource cache, while the data of all other resources is
+	 * at least in the operating system's page cache. */
+
+	try {
+		byte buffer[4096];
+		while (stream->read(buffer, sizeof(buffer)) == sizeof(buffer))
+			;
+	} catch (...) {
+		delete stream;
+		throw;
+	}
+
+	delete stream;
+	return true;
+}
+
+ResourceCache::Statistics ResourceManager::getCacheStatistics() const {
+	return _resourceCache.getStatistics();
+}
+
+void ResourceManager::clearCache() {
+	_resourceCache.clear();
+}
+
+uint32 ResourceManager::getGeneration() const {
+	return _generation;
 }
 
 Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &name, FileType type) const {
@@ -722,6 +1040,8 @@ Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &
 Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &name,
 		const std::vector<FileType> &types, FileType *foundType) const {
 
+	Common::StackReadLock lock(_indexLock);
+
 	const Resource *res = getRes(name, types);
 	if (!res)
 		return 0;
@@ -734,6 +1054,8 @@ Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &
 }
 
 Common::SeekableReadStream *ResourceManager::getResource(uint64 hash, FileType *type) const {
+	Common::StackReadLock lock(_indexLock);
+
 	const Resource *res = getRes(hash);
 	if (!res)
 		return 0;
@@ -759,7 +1081,7 @@ Common::SeekableReadStream *ResourceManager::getResource(const Resource &res, bo
 
 		default:
 			throw Common::Exception("Invalid source for resource \"%s\": (%d)",
-			                        TypeMan.setFileType(res.name, res.type).c_str(), res.source);
+			                        TypeMan.setFileType(getName(res), res.type).c_str(), res.source);
 	}
 
 	// Transparently decompress "small" files
@@ -786,32 +1108,43 @@ Common::SeekableReadStream *ResourceManager::getResource(ResourceType resType,
 void ResourceManager::getAvailableResources(FileType type,
 		std::list<ResourceID> &list) const {
 
-	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
-		if (!r->second.empty() && (r->second.front().type == type)) {
-			list.push_back(ResourceID());
+	std::vector<FileType> types(1, type);
 
-			list.back().name = r->second.front().name;
-			list.back().type = r->second.front().type;
-			list.back().hash = r->first;
-		}
-	}
+	getAvailableResources(types, list);
+}
+
+static bool compareResourceIDHash(const ResourceManager::ResourceID &a, const ResourceManager::ResourceID &b) {
+	return a.hash < b.hash;
 }
 
 void ResourceManager::getAvailableResources(const std::vector<FileType> &types,
 		std::list<ResourceID> &list) const {
 
-	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
+	Common::StackReadLock lock(_indexLock);
+
+	std::list<ResourceID> found;
+
+	for (ResourceSlots::const_iterator s = _resourceSlots.begin(); s != _resourceSlots.end(); ++s) {
+		if (s->resource == kResourceNone)
+			continue;
+
+		const Resource &res = _resourcePool[s->resource];
+
 		for (std::vector<FileType>::const_iterator t = types.begin(); t != types.end(); ++t) {
-			if (!r->second.empty() && (r->second.front().type == *t)) {
-				list.push_back(ResourceID());
+			if (res.type == *t) {
+				found.push_back(ResourceID());
 
-				list.back().name = r->second.front().name;
-				list.back().type = r->second.front().type;
-				list.back().hash = r->first;
+				found.back().name = getName(res);
+				found.back().type = res.type;
+				found.back().hash = s->hash;
 			}
 		}
-
 	}
+
+	// Keep the resources in a stable order, sorted by hash
+	found.sort(compareResourceIDHash);
+
+	list.splice(list.end(), found);
 }
 
 void ResourceManager::getAvailableResources(ResourceType type,
@@ -838,14 +1171,14 @@ Common::UString ResourceManager::getArchiveName(const Resource &resource) const
 			return resource.path;
 
 		case kSourceArchive:
-			return "/" + TypeMan.addFileType(resource.name, resource.type);
+			return "/" + TypeMan.addFileType(getName(resource), resource.type);
 
 		default:
 			break;
 	}
 
 	throw Common::Exception("Invalid source for resource \"%s\": (%d)",
-	                        TypeMan.addFileType(resource.name, resource.type).c_str(),
+	                        TypeMan.addFileType(getName(resource), resource.type).c_str(),
 	                        resource.source);
 }
 
@@ -886,17 +1219,18 @@ inline uint64 ResourceManager::getHash(const Common::UString &name) const {
 	return Common::hashString(name.toLower(), _hashAlgo);
 }
 
-void ResourceManager::checkHashCollision(const Resource &resource, ResourceMap::const_iterator resList) {
-	if (resource.name.empty() || resList->second.empty())
+void ResourceManager::checkHashCollision(const Common::UString &name, FileType type, uint32 resources) {
+	if (name.empty() || (resources == kResourceNone))
 		return;
 
-	Common::UString newName = TypeMan.setFileType(resource.name, resource.type).toLower();
+	Common::UString newName = TypeMan.setFileType(name, type).toLower();
 
-	for (ResourceList::const_iterator r = resList->second.begin(); r != resList->second.end(); ++r) {
-		if (r->name.empty())
+	for (uint32 r = resources; r != kResourceNone; r = _resourcePool[r].next) {
+		const Resource &res = _resourcePool[r];
+		if (res.name == 0)
 			continue;
 
-		Common::UString oldName = TypeMan.setFileType(r->name, r->type).toLower();
+		Common::UString oldName = TypeMan.setFileType(getName(res), res.type).toLower();
 		if (oldName != newName) {
 			warning("ResourceManager: Found hash collision: %s (\"%s\" and \"%s\")",
 					Common::formatHash(getHash(oldName)).c_str(), oldName.c_str(), newName.c_str());
@@ -906,7 +1240,7 @@ void ResourceManager::checkHashCollision(const Resource &resource, ResourceMap::
 }
 
 bool ResourceManager::checkResourceIsArchive(Resource &resource, Change *change) {
-	if ((resource.source == kSourceNone) || resource.name.empty())
+	if ((resource.source == kSourceNone) || (resource.name == 0))
 		return false;
 
 	ArchiveType type = getArchiveType(resource.type);
@@ -936,37 +1270,47 @@ bool ResourceManager::checkResourceIsArchive(Resource &resource, Change *change)
 	return true;
 }
 
-void ResourceManager::addResource(Resource &resource, uint64 hash, Change *change) {
-	ResourceMap::iterator resList = _resources.find(hash);
-	if (resList == _resources.end()) {
-		// We don't have a resource with this name yet, create a new resource list for it
+void ResourceManager::addResource(Resource &resource, const Common::UString &name, uint64 hash, Change *change) {
+	// Find the slot for this hash, or create a new one if we don't have a resource with this name yet
+	size_t slot = findResourceSlot(hash);
+	if (slot == SIZE_MAX)
+		slot = addResourceSlot(hash);
 
-		std::pair<ResourceMap::iterator, bool> result;
+#ifdef CHECK_HASH_COLLISION
+	checkHashCollision(name, resource.type, _resourceSlots[slot].resource);
+#endif
 
-		result = _resources.insert(std::make_pair(hash, ResourceList()));
+	// Add the resource to the pool
+	uint32 id = _resourcePool.size();
+	if (!_freeResources.empty()) {
+		id = _freeResources.back();
+		_freeResources.pop_back();
 
-		resList = result.first;
-	}
+		_resourcePool[id] = resource;
+	} else
+		_resourcePool.push_back(resource);
 
-#ifdef CHECK_HASH_COLLISION
-	checkHashCollision(resource, resList);
-#endif
+	Resource &res = _resourcePool[id];
 
-	// Add the resource to the list
-	resList->second.push_back(resource);
-	Resource *res = &resList->second.back();
+	res.name = internName(name);
+	res.hash = hash;
 
-	checkResourceIsArchive(*res, change);
+	/* Insert the resource into the slot's chain, sorted by priority. A new
+	 * resource goes in front of all other resources with the same priority. */
+	uint32 *link = &_resourceSlots[slot].resource;
+	while ((*link != kResourceNone) && (_resourcePool[*link].priority > res.priority))
+		link = &_resourcePool[*link].next;
+
+	res.next = *link;
+	*link    = id;
+
+	_generation++;
 
 	// Remember the resource in the change set
-	if (change) {
-		change->_change->resources.push_back(ResourceChange());
-		change->_change->resources.back().hashIt = resList;
-		change->_change->resources.back().resIt  = --resList->second.end();
-	}
+	if (change)
+		change->_change->resources.push_back(id);
 
-	// Resort the list by priority
-	resList->second.sort();
+	checkResourceIsArchive(res, change);
 }
 
 void ResourceManager::addResource(const Common::UString &path, Change *change, uint32 priority) {
@@ -974,24 +1318,154 @@ void ResourceManager::addResource(const Common::UString &path, Change *change, u
 	res.priority = priority;
 	res.source   = kSourceFile;
 	res.path     = path;
-	res.name     = Common::FilePath::getStem(path);
 	res.type     = TypeMan.getFileType(path);
 
+	Common::UString name = Common::FilePath::getStem(path);
+
 	// Handle "small" files
 	if (_hasSmall && (res.type == kFileTypeSMALL)) {
-		const Common::UString name = res.name;
+		const Common::UString smallName = name;
 
 		res.isSmall = true;
 
-		res.name = Common::FilePath::getStem(name);
-		res.type = TypeMan.getFileType(name);
+		name     = Common::FilePath::getStem(smallName);
+		res.type = TypeMan.getFileType(smallName);
 	}
 
-	uint64 hash = getHash(res.name, res.type);
+	uint64 hash = getHash(name, res.type);
 	if (normalizeType(res))
-		hash = getHash(res.name, res.type);
+		hash = getHash(name, res.type);
+
+	addResource(res, name, hash, change);
+}
+
+void ResourceManager::removeResource(uint32 resource) {
+	Resource &res = _resourcePool[resource];
+
+	const size_t slot = findResourceSlot(res.hash);
+	if (slot == SIZE_MAX)
+		throw Common::Exception("Resource not found in the hash table");
+
+	// Unlink the resource from the slot's chain
+	uint32 *link = &_resourceSlots[slot].resource;
+	while ((*link != kResourceNone) && (*link != resource))
+		link = &_resourcePool[*link].next;
+
+	if (*link != resource)
+		throw Common::Exception("Resource not found in the hash table");
+
+	*link = res.next;
+
+	// Remove the slot if this was the last resource with this hash
+	if (_resourceSlots[slot].resource == kResourceNone)
+		removeResourceSlot(slot);
+
+	// And free the resource entry, for reuse
+	res = Resource();
+	_freeResources.push_back(resource);
+
+	_generation++;
+}
+
+/** Spread the hash out over all bits we're going to use to index the hash table.
+ *
+ *  Several of the hash algorithms only produce 32-bit hashes, so we can't just
+ *  use the lower bits of the hash directly.
+ */
+static inline size_t getResourceSlotStart(uint64 hash, size_t mask) {
+	hash ^= hash >> 32;
+	hash *= UINT64_C(0x9E3779B97F4A7C15);
+
+	return ((size_t) (hash >> 32)) & mask;
+}
+
+size_t ResourceManager::findResourceSlot(uint64 hash) const {
+	if (_resourceSlots.empty())
+		return SIZE_MAX;
+
+	const size_t mask = _resourceSlots.size() - 1;
+
+	for (size_t slot = getResourceSlotStart(hash, mask); ; slot = (slot + 1) & mask) {
+		if (_resourceSlots[slot].resource == kResourceNone)
+			return SIZE_MAX;
+
+		if (_resourceSlots[slot].hash == hash)
+			return slot;
+	}
+}
+
+size_t ResourceManager::addResourceSlot(uint64 hash) {
+	// Keep the load factor below 3/4
+	if (((_resourceSlotsUsed + 1) * 4) > (_resourceSlots.size() * 3))
+		growResourceSlots();
+
+	const size_t mask = _resourceSlots.size() - 1;
 
-	addResource(res, hash, change);
+	size_t slot = getResourceSlotStart(hash, mask);
+	while (_resourceSlots[slot].resource != kResourceNone)
+		slot = (slot + 1) & mask;
+
+	/* The slot has no resources yet. We mark it as used by setting the hash,
+	 * the caller immediately links in the first resource. */
+	_resourceSlots[slot].hash = hash;
+	_resourceSlotsUsed++;
+
+	return slot;
+}
+
+void ResourceManager::removeResourceSlot(size_t slot) {
+	/* Backward shift deletion: move following entries of the same probe
+	 * sequence into the hole, so that we don't need tombstones. */
+
+	const size_t mask = _resourceSlots.size() - 1;
+
+	size_t hole = slot;
+	for (size_t next = (hole + 1) & mask; _resourceSlots[next].resource != kResourceNone; next = (next + 1) & mask) {
+		const size_t start = getResourceSlotStart(_resourceSlots[next].hash, mask);
+
+		// Can the entry in next be moved into the hole without breaking its probe sequence?
+		const bool movable = (hole <= next) ? ((start <= hole) || (start > next)) : ((start <= hole) && (start > next));
+		if (!movable)
+			continue;
+
+		_resourceSlots[hole] = _resourceSlots[next];
+		hole = next;
+	}
+
+	_resourceSlots[hole] = ResourceSlot();
+	_resourceSlotsUsed--;
+}
+
+void ResourceManager::growResourceSlots() {
+	ResourceSlots oldSlots;
+	oldSlots.swap(_resourceSlots);
+
+	_resourceSlots.resize(MAX<size_t>(oldSlots.size() * 2, 1024));
+
+	const size_t mask = _resourceSlots.size() - 1;
+
+	for (ResourceSlots::const_iterator s = oldSlots.begin(); s != oldSlots.end(); ++s) {
+		if (s->resource == kResourceNone)
+			continue;
+
+		size_t slot = getResourceSlotStart(s->hash, mask);
+		while (_resourceSlots[slot].resource != kResourceNone)
+			slot = (slot + 1) & mask;
+
+		_resourceSlots[slot] = *s;
+	}
+}
+
+uint32 ResourceManager::internName(const Common::UString &name) {
+	std::pair<NameMap::iterator, bool> result = _nameMap.insert(std::make_pair(name, (uint32) _names.size()));
+	if (result.second)
+		_names.push_back(name);
+
+	return result.first->second;
+}
+
+const Common::UString &ResourceManager::getName(const Resource &resource) const {
+	return _names[resource.name];
 }
 
 void ResourceManager::addResources(const Common::FileList &files, Change *change, uint32 priority) {
@@ -1000,11 +1474,15 @@ void ResourceManager::addResources(const Common::FileList &files, Change *change
 }
 
 const ResourceManager::Resource *ResourceManager::getRes(uint64 hash) const {
-	ResourceMap::const_iterator r = _resources.find(hash);
-	if ((r == _resources.end()) || r->second.empty() || (r->second.back().priority == 0))
+	const size_t slot = findResourceSlot(hash);
+	if (slot == SIZE_MAX)
 		return 0;
 
-	return &r->second.back();
+	const Resource &res = _resourcePool[_resourceSlots[slot].resource];
+	if (res.priority == 0)
+		return 0;
+
+	return &res;
 }
 
 const ResourceManager::Resource *ResourceManager::getRes(const Common::UString &name,
@@ -1036,6 +1514,8 @@ const ResourceManager::Resource *ResourceManager::getRes(const Common::UString &
 }
 
 void ResourceManager::dumpResourcesList(const Common::UString &fileName) const {
+	Common::StackReadLock lock(_indexLock);
+
 	Common::WriteFile file;
 
 	if (!file.open(fileName))
@@ -1044,13 +1524,16 @@ void ResourceManager::dumpResourcesList(const Common::UString &fileName) const {
 	file.writeString("                Name                 |        Hash        |     Size    \n");
 	file.writeString("-------------------------------------|--------------------|-------------\n");
 
-	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
-		if (r->second.empty())
-			continue;
+	// Sort the resources by hash, for a stable output
+	std::map<uint64, uint32> resources;
+	for (ResourceSlots::const_iterator s = _resourceSlots.begin(); s != _resourceSlots.end(); ++s)
+		if (s->resource != kResourceNone)
+			resources.insert(std::make_pair(s->hash, s->resource));
 
-		const Resource &res = r->second.back();
+	for (std::map<uint64, uint32>::const_iterator r = resources.begin(); r != resources.end(); ++r) {
+		const Resource &res = _resourcePool[r->second];
 
-		const Common::UString &name = res.name;
+		const Common::UString &name = getName(res);
 		const Common::UString   ext = TypeMan.setFileType("", res.type);
 		const uint64           hash = r->first;
 		const uint32           size = getResourceSize(res);
@@ -27,17 +27,26 @@
 
 #include <list>
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 
+#include "src/common/atomic.h"
+
+#include <boost/unordered/unordered_map.hpp>
+
 #include "src/common/types.h"
 #include "src/common/ustring.h"
 #include "src/common/singleton.h"
 #include "src/common/filelist.h"
 #include "src/common/hash.h"
 #include "src/common/changeid.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/types.h"
+#include "src/aurora/resindexcache.h"
+#include "src/aurora/rescache.h"
+#include "src/aurora/resprefetch.h"
 
 namespace Common {
 	class SeekableReadStream;
@@ -51,6 +60,15 @@ class BIFFile;
 
 /** A resource manager holding information about and handling all request for all
  *  resources usable by the game.
+ *
+ *  Requesting resources (getResource(), getResourceSize(), hasResource()) is
+ *  thread-safe, and can be done from several threads at the same time. Archives
+ *  are read with positional reads, so loading resources does not need a lock.
+ *  The only exception are NSBTX files, which need to seek around while converting
+ *  a texture; they lock themselves for that.
+ *  Adding and removing resources takes the index lock exclusively, and therefore
+ *  waits for all running requests to finish first. Requests made in the meantime
+ *  wait until the index has been changed.
  */
 class ResourceManager : public Common::Singleton<ResourceManager> {
 public:
@@ -338,6 +356,38 @@ public:
 	/** Dump a list of all resources into a file. */
 	void dumpResourcesList(const Common::UString &fileName) const;
 
+	// .--- Prefetching resources
+	/** Prefetch these resources in the background.
+	 *
+	 *  Worker threads read the resources in parallel. Resources that need
+	 *  decoding are kept in the decoded resource cache. All others are not
+	 *  kept, so reading them only brings their data into the operating
+	 *  system's page cache. The returned handle can be used to wait for the
+	 *  prefetch to finish.
+	 *
+	 *  Adding or removing resources cancels all waiting prefetches.
+	 */
+	PrefetchHandle prefetch(const std::list<ResourceID> &resources);
+
+	/** Prefetch this resource in the background. */
+	PrefetchHandle prefetch(const Common::UString &name, FileType type);
+	// '---
+
+	// .--- Decoded resource cache
+	/** Return the statistics of the decoded resource cache. */
+	ResourceCache::Statistics getCacheStatistics() const;
+
+	/** Remove all resources from the decoded resource cache. */
+	void clearCache();
+	// '---
+
+	/** Return a number that changes whenever resources are added or removed.
+	 *
+	 *  Users that keep data derived from resources around can use this to
+	 *  find out whether they need to reload it.
+	 */
+	uint32 getGeneration() const;
+
 
 private:
 	typedef std::vector<FileType> FileTypeList;
@@ -362,8 +412,12 @@ private:
 	};
 
 	struct OpenedArchive {
-		/** The actual archive. */
-		Archive *archive;
+		/** The actual archive.
+		 *
+		 *  If the resources of this archive were taken from the index cache,
+		 *  this is 0 until a resource within the archive is requested.
+		 */
+		boost::atomic<Archive *> archive;
 
 		/** The information we know about this archive. */
 		KnownArchive *known;
@@ -374,8 +428,9 @@ private:
 		std::list<OpenedArchive *> children;
 
 		OpenedArchive();
+		OpenedArchive(const OpenedArchive &a);
 
-		void set(KnownArchive &kA, Archive &a);
+		void set(KnownArchive &kA, Archive *a);
 	};
 
 	/** List of all known archive files. */
@@ -394,8 +449,11 @@ private:
 
 	/** A resource. */
 	struct Resource {
-		Common::UString name; ///< The resource's name.
-		FileType        type; ///< The resource's type.
+		uint32   name; ///< The resource's name, as an index into the name pool.
+		FileType type; ///< The resource's type.
+
+		/** The hash of the resource's name and type. */
+		uint64 hash;
 
 		/** Is this a "small" (compressed Nintendo DS) file? */
 		bool isSmall;
@@ -416,15 +474,39 @@ private:
 		OpenedArchive *archive;      ///< Pointer to the opened archive.
 		uint32         archiveIndex; ///< Index into the archive.
 
+		/** The next resource with the same hash and a lower or equal priority. */
+		uint32 next;
+
 		Resource();
 
 		bool operator<(const Resource &right) const;
 	};
 
-	/** List of resources, sorted by priority. */
-	typedef std::list<Resource> ResourceList;
-	/** Map over resources, indexed by their hashed name. */
-	typedef std::map<uint64, ResourceList> ResourceMap;
+	static const uint32 kResourceNone = 0xFFFFFFFF;
+
+	/** A slot in the resource hash table.
+	 *
+	 *  The hash table uses open addressing with linear probing. Each used
+	 *  slot points to the resource with the highest priority for that hash.
+	 *  All other resources with the same hash are chained, in descending
+	 *  priority, through their next field.
+	 */
+	struct ResourceSlot {
+		uint64 hash;     ///< The hashed name of the resources in this slot.
+		uint32 resource; ///< The top-priority resource. kResourceNone if the slot is empty.
+
+		ResourceSlot();
+	};
+
+	/** The resource hash table. Its size is always a power of 2. */
+	typedef std::vector<ResourceSlot> ResourceSlots;
+	/** The storage of all resources. Adding resources keeps pointers to existing ones valid. */
+	typedef std::deque<Resource> ResourcePool;
+
+	/** Interned resource names. */
+	typedef std::vector<Common::UString> NamePool;
+	/** Map of interned resource names to their index in the name pool. */
+	typedef boost::unordered_map<Common::UString, uint32, Common::hashUStringCaseSensitive> NameMap;
 	// '---
 
 	// .--- Changes
@@ -432,11 +514,8 @@ private:
 	typedef std::pair<KnownArchives *, KnownArchives::iterator> KnownArchiveChange;
 	/** A change produced by indexing/opening an archive. */
 	typedef OpenedArchives::iterator OpenedArchiveChange;
-	/** A change produced by indexing archive resources. */
-	struct ResourceChange {
-		ResourceMap::iterator  hashIt;
-		ResourceList::iterator resIt;
-	};
+	/** A change produced by indexing archive resources, the index into the resource pool. */
+	typedef uint32 ResourceChange;
 
 	typedef std::list<KnownArchiveChange>  KnownArchiveChanges;
 	typedef std::list<OpenedArchiveChange> OpenedArchiveChanges;
@@ -470,6 +549,9 @@ private:
 	/** Do we have "small" files? */
 	bool _hasSmall;
 
+	/** Should archives be mapped into memory, if possible? */
+	bool _mapArchives;
+
 	/** With which hash algorithm are/should the names be hashed? */
 	Common::HashAlgo _hashAlgo;
 
@@ -487,12 +569,36 @@ private:
 	/** The current type aliases, changing one type to another. */
 	std::map<FileType, FileType> _typeAliases;
 
-	ResourceMap   _resources; ///< All currently known resources.
-	ChangeSetList _changes;   ///< Changes produced by indexing the currently known resources.
+	ResourceSlots       _resourceSlots;     ///< Hash table over all currently known resources.
+	size_t              _resourceSlotsUsed; ///< Number of used slots in the hash table.
+	ResourcePool        _resourcePool;      ///< All currently known resources.
+	std::vector<uint32> _freeResources;     ///< Unused entries in the resource pool.
+
+	NamePool _names;   ///< Interned resource names.
+	NameMap  _nameMap; ///< Interned resource names, indexed by name.
+
+	ChangeSetList _changes; ///< Changes produced by indexing the currently known resources.
+
+	uint32 _generation; ///< Changed every time resources are added or removed.
 
 	FileTypeSet  _archiveTypeTypes [kArchiveMAX];  ///< All valid archive types file types.
 	FileTypeList _resourceTypeTypes[kResourceMAX]; ///< All valid resource type file types.
 
+	/** The on-disk cache of archive resource indices. */
+	ResourceIndexCache _indexCache;
+
+	/** The cache of decoded resources from compressed or encrypted archives. */
+	mutable ResourceCache _resourceCache;
+
+	/** The worker threads prefetching resources in the background. */
+	ResourcePrefetcher _prefetcher;
+
+	/** Mutex protecting the lazy opening of archives taken from the index cache. */
+	mutable Common::Mutex _archiveMutex;
+
+	/** Lock protecting the resource index against changes while resources are requested. */
+	mutable Common::ReadWriteLock _indexLock;
+
 
 	void clearResources();
 
@@ -502,21 +608,51 @@ private:
 	// '---
 
 	// .--- Indexing archives
-	void indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change);
+	void indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change,
+	              ResourceIndexCache::PartList *cacheParts);
 	uint32 openKEYBIFs(Common::SeekableReadStream *keyStream,
 	                   std::vector<KnownArchive *> &archives, std::vector<BIFFile *> &bifs);
 
 	void indexArchive(KnownArchive &knownArchive, Archive *archive,
 	                  uint32 priority, Change *change);
+	void indexArchiveResources(OpenedArchive &archive, const Archive::ResourceList &resources,
+	                           Common::HashAlgo hashAlgo, uint32 priority, Change *change);
+
+	OpenedArchive &addOpenedArchive(KnownArchive &knownArchive, Archive *archive, Change *change);
 
 	Common::SeekableReadStream *openArchiveStream(const KnownArchive &archive) const;
+
+	Archive *openArchive(const KnownArchive &knownArchive, const std::vector<byte> &password) const;
+	Archive &getArchive(OpenedArchive &archive) const;
+	// '---
+
+	// .--- Index cache
+	bool isCacheableArchive(ArchiveType type) const;
+	bool getArchiveFileStats(const KnownArchive &archive, uint64 &size, uint64 &modTime) const;
+
+	bool indexCachedArchive(KnownArchive &knownArchive, uint64 size, uint64 modTime,
+	                        uint32 priority, Change *change);
+	bool addCachePart(ResourceIndexCache::PartList &parts, const KnownArchive &knownArchive,
+	                  const Archive &archive) const;
+	// '---
+
+	// .--- Resource hash table
+	size_t findResourceSlot(uint64 hash) const;
+	size_t addResourceSlot(uint64 hash);
+	void removeResourceSlot(size_t slot);
+	void growResourceSlots();
+
+	void removeResource(uint32 resource);
+
+	uint32 internName(const Common::UString &name);
+	const Common::UString &getName(const Resource &resource) const;
 	// '---
 
 	// .--- Adding resources
 
 	bool checkResourceIsArchive(Resource &resource, Change *change);
 
-	void addResource(Resource &resource, uint64 hash, Change *change);
+	void addResource(Resource &resource, const Common::UString &name, uint64 hash, Change *change);
 	void addResource(const Common::UString &path, Change *change, uint32 priority);
 
 	void addResources(const Common::FileList &files, Change *change, uint32 priority);
@@ -532,6 +668,9 @@ private:
 	Common::SeekableReadStream *getArchiveResource(const Resource &res, bool tryNoCopy = false) const;
 
 	uint32 getResourceSize(const Resource &res) const;
+
+	/** Load a resource for the prefetcher, returning whether it was found. */
+	bool prefetchResource(const Common::UString &name, FileType type);
 	// '---
 
 	// .--- Resource utility methods
@@ -544,7 +683,7 @@ private:
 	inline uint64 getHash(const Common::UString &name, FileType type) const;
 	inline uint64 getHash(const Common::UString &name) const;
 
-	void checkHashCollision(const Resource &resource, ResourceMap::const_iterator resList);
+	void checkHashCollision(const Common::UString &name, FileType type, uint32 resources);
 
 	Change *newChangeSet(Common::ChangeID &changeID);
 	// '---
@@ -0,0 +1,216 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Prefetching resources in the background.
+ */
+
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/thread.h"
+
+#include "src/aurora/resprefetch.h"
+
+namespace Aurora {
+
+PrefetchGroup::PrefetchGroup(size_t count) : finished(mutex), remaining(count), found(0) {
+}
+
+
+PrefetchHandle::PrefetchHandle() {
+}
+
+PrefetchHandle::PrefetchHandle(const boost::shared_ptr<PrefetchGroup> &group) : _group(group) {
+}
+
+PrefetchHandle::~PrefetchHandle() {
+}
+
+bool PrefetchHandle::isDone() const {
+	if (!_group)
+		return true;
+
+	Common::StackLock lock(_group->mutex);
+
+	return _group->remaining == 0;
+}
+
+void PrefetchHandle::wait() const {
+	if (!_group)
+		return;
+
+	Common::StackLock lock(_group->mutex);
+
+	while (_group->remaining > 0)
+		_group->finished.wait(100);
+}
+
+size_t PrefetchHandle::getFoundCount() const {
+	if (!_group)
+		return 0;
+
+	Common::StackLock lock(_group->mutex);
+
+	return _group->found;
+}
+
+
+class ResourcePrefetcher::Worker : public Common::Thread {
+public:
+	Worker(ResourcePrefetcher &prefetcher) : _prefetcher(&prefetcher) {
+	}
+
+	~Worker() {
+		destroyThread();
+	}
+
+private:
+	ResourcePrefetcher *_prefetcher;
+
+	void threadMethod() {
+		while (!_killThread)
+			_prefetcher->runTask();
+	}
+};
+
+
+ResourcePrefetcher::Request::Request(const Common::UString &n, FileType t) : name(n), type(t) {
+}
+
+
+ResourcePrefetcher::Task::Task(const Request &r, const boost::shared_ptr<PrefetchGroup> &g) :
+	request(r), group(g) {
+
+}
+
+
+ResourcePrefetcher::ResourcePrefetcher(const LoadFunction &load) : _load(load), _running(0),
+	_newTask(_mutex), _idle(_mutex) {
+
+}
+
+ResourcePrefetcher::~ResourcePrefetcher() {
+	cancel();
+	destroyWorkers();
+}
+
+void ResourcePrefetcher::setThreadCount(size_t count) {
+	if (count == _workers.size())
+		return;
+
+	cancel();
+	destroyWorkers();
+
+	for (size_t i = 0; i < count; i++) {
+		Worker *worker = new Worker(*this);
+		if (!worker->createThread()) {
+			delete worker;
+
+			warning("ResourcePrefetcher: Failed to create worker thread");
+			break;
+		}
+
+		_workers.push_back(worker);
+	}
+}
+
+void ResourcePrefetcher::destroyWorkers() {
+	for (std::list<Worker *>::iterator w = _workers.begin(); w != _workers.end(); ++w)
+		delete *w;
+
+	_workers.clear();
+}
+
+PrefetchHandle ResourcePrefetcher::prefetch(const RequestList &requests) {
+	if (_workers.empty() || requests.empty())
+		return PrefetchHandle();
+
+	boost::shared_ptr<PrefetchGroup> group(new PrefetchGroup(requests.size()));
+
+	Common::StackLock lock(_mutex);
+
+	for (RequestList::const_iterator r = requests.begin(); r != requests.end(); ++r)
+		_tasks.push_back(Task(*r, group));
+
+	_newTask.broadcast();
+
+	return PrefetchHandle(group);
+}
+
+void ResourcePrefetcher::cancel() {
+	Common::StackLock lock(_mutex);
+
+	// Drop all waiting tasks, marking them as finished
+	while (!_tasks.empty()) {
+		finishTask(*_tasks.front().group, false);
+		_tasks.pop_front();
+	}
+
+	// And wait for the running tasks
+	while (_running > 0)
+		_idle.wait(100);
+}
+
+void ResourcePrefetcher::runTask() {
+	Request request("", kFileTypeNone);
+	boost::shared_ptr<PrefetchGroup> group;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (_tasks.empty())
+			_newTask.wait(100);
+
+		if (_tasks.empty())
+			return;
+
+		request = _tasks.front().request;
+		group   = _tasks.front().group;
+
+		_tasks.pop_front();
+		_running++;
+	}
+
+	bool found = false;
+	try {
+		found = _load(request.name, request.type);
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed prefetching resource \"%s\"", request.name.c_str());
+	}
+
+	finishTask(*group, found);
+
+	Common::StackLock lock(_mutex);
+
+	_running--;
+	_idle.broadcast();
+}
+
+void ResourcePrefetcher::finishTask(PrefetchGroup &group, bool found) {
+	Common::StackLock lock(group.mutex);
+
+	if (found)
+		group.found++;
+
+	if (--group.remaining == 0)
+		group.finished.broadcast();
+}
+
+} // End of namespace Aurora
@@ -0,0 +1,144 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Prefetching resources in the background.
+ */
+
+#ifndef AURORA_RESPREFETCH_H
+#define AURORA_RESPREFETCH_H
+
+#include <list>
+#include <deque>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/mutex.h"
+
+#include "src/aurora/types.h"
+
+namespace Aurora {
+
+class ResourcePrefetcher;
+
+/** The state of a group of resources that are prefetched together. */
+struct PrefetchGroup : boost::noncopyable {
+	Common::Mutex     mutex;
+	Common::Condition finished;
+
+	size_t remaining; ///< Number of resources still waiting to be prefetched.
+	size_t found;     ///< Number of resources that were found.
+
+	PrefetchGroup(size_t count);
+};
+
+/** A handle on resources that are prefetched in the background. */
+class PrefetchHandle {
+public:
+	PrefetchHandle();
+	~PrefetchHandle();
+
+	/** Have all resources been prefetched, or was the prefetch cancelled? */
+	bool isDone() const;
+
+	/** Wait until all resources have been prefetched, or the prefetch was cancelled. */
+	void wait() const;
+
+	/** Return the number of resources that were found so far. */
+	size_t getFoundCount() const;
+
+private:
+	boost::shared_ptr<PrefetchGroup> _group;
+
+	PrefetchHandle(const boost::shared_ptr<PrefetchGroup> &group);
+
+	friend class ResourcePrefetcher;
+};
+
+/** A pool of worker threads prefetching resources in the background.
+ *
+ *  The actual loading of a resource is done by a function provided on
+ *  construction. It is expected to read (and, if necessary, decode) the
+ *  resource in such a way that a later, regular request for the same
+ *  resource is fast.
+ */
+class ResourcePrefetcher : boost::noncopyable {
+public:
+	/** A resource to prefetch. */
+	struct Request {
+		Common::UString name;
+		FileType        type;
+
+		Request(const Common::UString &n, FileType t);
+	};
+
+	typedef std::list<Request> RequestList;
+
+	/** Load this resource, returning whether it was found. */
+	typedef boost::function<bool (const Common::UString &, FileType)> LoadFunction;
+
+	ResourcePrefetcher(const LoadFunction &load);
+	~ResourcePrefetcher();
+
+	/** Set the number of worker threads. 0 disables prefetching. */
+	void setThreadCount(size_t count);
+
+	/** Prefetch these resources in the background. */
+	PrefetchHandle prefetch(const RequestList &requests);
+
+	/** Drop all waiting requests and wait for the running ones to finish. */
+	void cancel();
+
+private:
+	class Worker;
+
+	struct Task {
+		Request request;
+		boost::shared_ptr<PrefetchGroup> group;
+
+		Task(const Request &r, const boost::shared_ptr<PrefetchGroup> &g);
+	};
+
+	LoadFunction _load;
+
+	std::list<Worker *> _workers;
+
+	std::deque<Task> _tasks;
+	size_t _running;
+
+	Common::Mutex     _mutex;
+	Common::Condition _newTask;
+	Common::Condition _idle;
+
+	void destroyWorkers();
+
+	/** Wait for a task and run it. Called by the worker threads. */
+	void runTask();
+
+	static void finishTask(PrefetchGroup &group, bool found);
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_RESPREFETCH_H
@@ -30,6 +30,7 @@
 #include <boost/noncopyable.hpp>
 
 #include "src/common/types.h"
+#include "src/common/endianness.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
 
@@ -62,9 +63,20 @@ public:
 	/** Read a multi-bit value from the bit stream. */
 	virtual uint32 getBits(size_t n) = 0;
 
+	/** Read a multi-bit value from the bit stream, without consuming it.
+	 *
+	 *  The bits are returned in the same layout getBits() would return them.
+	 *  If fewer than n bits are left in the stream, the missing bits are
+	 *  filled with 0.
+	 */
+	virtual uint32 peekBits(size_t n) = 0;
+
 	/** Add a bit to the n-bit value x, making it an (n+1)-bit value. */
 	virtual void addBit(uint32 &x, size_t n) = 0;
 
+	/** Are the bits handed out in the order of MSB to LSB? */
+	virtual bool isMSBFirst() const = 0;
+
 protected:
 	BitStream() {
 	}
@@ -198,6 +210,41 @@ public:
 		return v;
 	}
 
+	/** Read a multi-bit value from the bit stream, without consuming it. */
+	uint32 peekBits(size_t n) {
+		if (n == 0)
+			return 0;
+
+		if (n > 32)
+			throw Exception("Too many bits requested to be read");
+
+		// The bits still left in the current value
+		uint64 bits = (_inValue == 0) ? 0 : _value;
+		size_t have = (_inValue == 0) ? 0 : (valueBits - _inValue);
+
+		// If that's not enough, temporarily read in more values
+		const size_t streamPos = _stream->pos();
+
+		while ((have < n) && ((_stream->size() - _stream->pos()) >= (valueBits >> 3))) {
+			const uint64 data = readData();
+
+			if (isMSB2LSB)
+				bits |= (data << (64 - valueBits)) >> have;
+			else
+				bits |= data << have;
+
+			have += valueBits;
+		}
+
+		if (_stream->pos() != streamPos)
+			_stream->seek(streamPos);
+
+		if (isMSB2LSB)
+			return (uint32) (bits >> (64 - n));
+
+		return (uint32) (bits & ((((uint64) 1) << n) - 1));
+	}
+
 	/** Add a bit to the n-bit value x, making it an (n+1)-bit value. */
 	void addBit(uint32 &x, size_t n) {
 		if (n >= 32)
@@ -209,6 +256,11 @@ public:
 			x = (x & ~(1 << n)) | (getBit() << n);
 	}
 
+	/** Are the bits handed out in the order of MSB to LSB? */
+	bool isMSBFirst() const {
+		return isMSB2LSB;
+	}
+
 	/** Rewind the bit stream back to the start. */
 	void rewind() {
 		_stream->seek(0);
@@ -276,6 +328,294 @@ typedef BitStreamImpl<64, false, true > BitStream64BEMSB;
 /** 64-bit big-endian data, LSB to MSB. */
 typedef BitStreamImpl<64, false, false> BitStream64BELSB;
 
+/**
+ * A template implementing a bit stream reading directly out of a memory buffer.
+ *
+ * Like BitStreamImpl, it reads valueBits-wide values from the data and gives
+ * access to their bits, with the same memory layout parameters. However, it
+ * doesn't go through a SeekableReadStream. Instead, values are read straight
+ * out of the buffer into a 64-bit cache, and multi-bit reads, peeks and skips
+ * work on that cache as a whole, instead of going bit by bit.
+ *
+ * All methods are defined here, so code using the concrete types directly
+ * instead of the BitStream interface can have them inlined.
+ */
+template<int valueBits, bool isLE, bool isMSB2LSB>
+class MemoryBitStreamImpl : boost::noncopyable, public BitStream {
+private:
+	const byte *_data;     ///< The data buffer.
+	size_t      _size;     ///< The size of the data buffer in whole values, in bytes.
+	bool _disposeAfterUse; ///< Should we delete the data buffer on destruction?
+
+	size_t _dataPos; ///< Position of the next value to read into the cache, in bytes.
+
+	/** Bits read ahead. If we're reading the bits MSB first, they start at the MSB. */
+	uint64 _cache;
+	size_t _cacheBits; ///< Number of bits in the cache.
+
+	/** Read a data value. */
+	inline uint64 readData(const byte *data) const {
+		if (isLE) {
+			if (valueBits ==  8)
+				return *data;
+			if (valueBits == 16)
+				return READ_LE_UINT16(data);
+			if (valueBits == 32)
+				return READ_LE_UINT32(data);
+			if (valueBits == 64)
+				return READ_LE_UINT64(data);
+		} else {
+			if (valueBits ==  8)
+				return *data;
+			if (valueBits == 16)
+				return READ_BE_UINT16(data);
+			if (valueBits == 32)
+				return READ_BE_UINT32(data);
+			if (valueBits == 64)
+				return READ_BE_UINT64(data);
+		}
+
+		assert(false);
+		return 0;
+	}
+
+	/** Move a data value into its position after n bits of the cache. */
+	static inline uint64 alignData(uint64 data, size_t n) {
+		if (isMSB2LSB)
+			return (data << (64 - valueBits)) >> n;
+
+		return data << n;
+	}
+
+	/** Return the first n bits out of these cached bits. */
+	static inline uint32 extractBits(uint64 bits, size_t n) {
+		if (isMSB2LSB)
+			return (uint32) (bits >> (64 - n));
+
+		return (uint32) (bits & ((((uint64) 1) << n) - 1));
+	}
+
+	/** Fill up the cache with as many whole values as fit. */
+	inline void fillCache() {
+		while (((_cacheBits + valueBits) <= 64) && (_dataPos < _size)) {
+			_cache |= alignData(readData(_data + _dataPos), _cacheBits);
+
+			_dataPos   += valueBits / 8;
+			_cacheBits += valueBits;
+		}
+	}
+
+	/** Remove n bits, which have to be in the cache, from the cache. */
+	inline void consumeBits(size_t n) {
+		assert(n <= _cacheBits);
+
+		if (n >= 64)
+			_cache = 0;
+		else if (isMSB2LSB)
+			_cache <<= n;
+		else
+			_cache >>= n;
+
+		_cacheBits -= n;
+	}
+
+	void checkLayout() const {
+		if ((valueBits != 8) && (valueBits != 16) && (valueBits != 32) && (valueBits != 64))
+			throw Exception("BitStream: Invalid memory layout %d, %d, %d", valueBits, isLE, isMSB2LSB);
+	}
+
+public:
+	/** Create a bit stream over this data buffer and optionally delete it on destruction. */
+	MemoryBitStreamImpl(const byte *data, size_t size, bool disposeAfterUse = false) :
+		_data(data), _size(size & ~((size_t) ((valueBits >> 3) - 1))), _disposeAfterUse(disposeAfterUse),
+		_dataPos(0), _cache(0), _cacheBits(0) {
+
+		checkLayout();
+	}
+
+	/** Create a bit stream over a copy of the rest of this input data stream. */
+	MemoryBitStreamImpl(SeekableReadStream &stream) :
+		_data(0), _size(0), _disposeAfterUse(true), _dataPos(0), _cache(0), _cacheBits(0) {
+
+		checkLayout();
+
+		const size_t size = stream.size() - stream.pos();
+
+		byte *data = new byte[size];
+		if (stream.read(data, size) != size) {
+			delete[] data;
+			throw Exception(kReadError);
+		}
+
+		_data = data;
+		_size = size & ~((size_t) ((valueBits >> 3) - 1));
+	}
+
+	~MemoryBitStreamImpl() {
+		if (_disposeAfterUse)
+			delete[] _data;
+	}
+
+	/** Read a bit from the bit stream. */
+	uint32 getBit() {
+		if (_cacheBits == 0) {
+			fillCache();
+
+			if (_cacheBits == 0)
+				throw Exception("BitStream: End of bit stream reached");
+		}
+
+		const uint32 b = extractBits(_cache, 1);
+		consumeBits(1);
+
+		return b;
+	}
+
+	/** Read a multi-bit value from the bit stream. */
+	uint32 getBits(size_t n) {
+		if (n == 0)
+			return 0;
+
+		if (n > 32)
+			throw Exception("Too many bits requested to be read");
+
+		const uint32 v = peekBits(n);
+		skip(n);
+
+		return v;
+	}
+
+	/** Read a multi-bit value from the bit stream, without consuming it. */
+	uint32 peekBits(size_t n) {
+		if (n == 0)
+			return 0;
+
+		if (n > 32)
+			throw Exception("Too many bits requested to be read");
+
+		if (_cacheBits < n)
+			fillCache();
+
+		if (_cacheBits >= n)
+			return extractBits(_cache, n);
+
+		/* Still not enough bits in the cache. Either we're reading 64-bit values,
+		 * which won't fit into the cache together with the remaining bits, or
+		 * we've reached the end of the data. */
+
+		uint64 bits = _cache;
+		if (_dataPos < _size)
+			bits |= alignData(readData(_data + _dataPos), _cacheBits);
+
+		return extractBits(bits, n);
+	}
+
+	/** Add a bit to the n-bit value x, making it an (n+1)-bit value. */
+	void addBit(uint32 &x, size_t n) {
+		if (n >= 32)
+			throw Exception("Too many bits requested to be read");
+
+		if (isMSB2LSB)
+			x = (x << 1) | getBit();
+		else
+			x = (x & ~(1 << n)) | (getBit() << n);
+	}
+
+	/** Are the bits handed out in the order of MSB to LSB? */
+	bool isMSBFirst() const {
+		return isMSB2LSB;
+	}
+
+	/** Rewind the bit stream back to the start. */
+	void rewind() {
+		_dataPos   = 0;
+		_cache     = 0;
+		_cacheBits = 0;
+	}
+
+	/** Skip the specified amount of bits. */
+	void skip(size_t n) {
+		if (n <= _cacheBits) {
+			consumeBits(n);
+			return;
+		}
+
+		n -= _cacheBits;
+
+		_cache     = 0;
+		_cacheBits = 0;
+
+		// Skip over whole values directly
+		const size_t values = n / valueBits;
+		if (values > ((_size - _dataPos) / (valueBits / 8))) {
+			_dataPos = _size;
+			throw Exception("BitStream: End of bit stream reached");
+		}
+
+		_dataPos += values * (valueBits / 8);
+		n        %= valueBits;
+
+		if (n == 0)
+			return;
+
+		fillCache();
+		if (_cacheBits < n) {
+			consumeBits(_cacheBits);
+			throw Exception("BitStream: End of bit stream reached");
+		}
+
+		consumeBits(n);
+	}
+
+	/** Return the stream position in bits. */
+	size_t pos() const {
+		return _dataPos * 8 - _cacheBits;
+	}
+
+	/** Return the stream size in bits. */
+	size_t size() const {
+		return _size * 8;
+	}
+
+	bool eos() const {
+		return pos() >= size();
+	}
+};
+
+// typedefs for various memory layouts.
+
+/** 8-bit data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<8, false, true > MemoryBitStream8MSB;
+/** 8-bit data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<8, false, false> MemoryBitStream8LSB;
+
+/** 16-bit little-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<16, true , true > MemoryBitStream16LEMSB;
+/** 16-bit little-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<16, true , false> MemoryBitStream16LELSB;
+/** 16-bit big-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<16, false, true > MemoryBitStream16BEMSB;
+/** 16-bit big-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<16, false, false> MemoryBitStream16BELSB;
+
+/** 32-bit little-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<32, true , true > MemoryBitStream32LEMSB;
+/** 32-bit little-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<32, true , false> MemoryBitStream32LELSB;
+/** 32-bit big-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<32, false, true > MemoryBitStream32BEMSB;
+/** 32-bit big-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<32, false, false> MemoryBitStream32BELSB;
+
+/** 64-bit little-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<64, true , true > MemoryBitStream64LEMSB;
+/** 64-bit little-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<64, true , false> MemoryBitStream64LELSB;
+/** 64-bit big-endian data, MSB to LSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<64, false, true > MemoryBitStream64BEMSB;
+/** 64-bit big-endian data, LSB to MSB, read directly out of memory. */
+typedef MemoryBitStreamImpl<64, false, false> MemoryBitStream64BELSB;
+
 } // End of namespace Common
 
 #endif // COMMON_BITSTREAM_H
@@ -39,7 +39,7 @@ DECLARE_SINGLETON(Common::DebugManager)
 namespace Common {
 
 static const char * const kDebugNames[kDebugChannelCount] = {
-	"GGraphics", "GSound", "GVideo", "GEvents", "GScripts",
+	"GGraphics", "GSound", "GVideo", "GEvents", "GScripts", "GResources",
 	"GGLAPI", "GGLWindow", "GGLShader", "GGL3rd", "GGLApp", "GGLOther",
 	"EGraphics", "ESound", "EVideo", "EEvents", "EScripts", "ELogic"
 };
@@ -50,6 +50,7 @@ static const char * const kDebugDescriptions[kDebugChannelCount] = {
 	"Global video (movies) debug channel",
 	"Global events debug channel",
 	"Global scripts debug channel",
+	"Global resource manager debug channel",
 	"OpenGL debug message generated by the GL",
 	"OpenGL debug message generated by the windowing system",
 	"OpenGL debug message generated by the shader compiler",
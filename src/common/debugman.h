@@ -44,6 +44,7 @@ enum DebugChannel {
 	kDebugVideo   , ///< "GVideo", global, non-engine video (movies).
 	kDebugEvents  , ///< "GEvents", global, non-engine events.
 	kDebugScripts , ///< "GScripts", global, non-engine scripts.
+	kDebugResources, ///< "GResources", global resource manager.
 
 	kDebugGLAPI   , ///< "GGLAPI", OpenGL debug message generated by the GL.
 	kDebugGLWindow, ///< "GGLWindow", OpenGL debug message generated by the windowing system.
@@ -23,6 +23,7 @@
  */
 
 #include <list>
+#include <ctime>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
@@ -40,6 +41,7 @@ using boost::filesystem::exists;
 using boost::filesystem::is_regular_file;
 using boost::filesystem::is_directory;
 using boost::filesystem::file_size;
+using boost::filesystem::last_write_time;
 using boost::filesystem::directory_iterator;
 using boost::filesystem::create_directories;
 
@@ -78,6 +80,32 @@ size_t FilePath::getFileSize(const UString &p) {
 	return size;
 }
 
+uint64 FilePath::getModificationTime(const UString &p) {
+	std::time_t modTime = (std::time_t) -1;
+
+	try {
+		modTime = last_write_time(p.c_str());
+	} catch (...) {
+	}
+
+	if ((modTime == ((std::time_t) -1)) || (modTime < 0)) {
+		warning("Failed to get modification time of file \"%s\"", p.c_str());
+		return 0;
+	}
+
+	return (uint64) modTime;
+}
+
+bool FilePath::touch(const UString &p) {
+	try {
+		last_write_time(p.c_str(), std::time(0));
+	} catch (...) {
+		return false;
+	}
+
+	return true;
+}
+
 UString FilePath::getFile(const UString &p) {
 	path file(p.c_str());
 
@@ -110,6 +138,10 @@ UString FilePath::getDirectory(const UString &p) {
 	return file.parent_path().string();
 }
 
+UString FilePath::getTemporaryFile(const UString &p) {
+	return p + "." + boost::filesystem::unique_path("%%%%-%%%%-%%%%").string() + ".tmp";
+}
+
 bool FilePath::isAbsolute(const UString &p) {
 	return boost::filesystem::path(p.c_str()).is_absolute();
 }
@@ -58,6 +58,21 @@ public:
 	 */
 	static size_t getFileSize(const UString &p);
 
+	/** Return a file's last modification time.
+	 *
+	 *  @param  p The file to look up.
+	 *  @return The modification time of the file in seconds since the epoch,
+	 *          or 0 if not a valid file.
+	 */
+	static uint64 getModificationTime(const UString &p);
+
+	/** Set a file's last modification time to now.
+	 *
+	 *  @param  p The file to touch.
+	 *  @return true if the modification time was changed.
+	 */
+	static bool touch(const UString &p);
+
 	/** Return a file name without its path.
 	 *
 	 *  Example: "/path/to/file.ext" > "file.ext"
@@ -104,6 +119,15 @@ public:
 	 */
 	static UString getDirectory(const UString &p);
 
+	/** Return a unique path for a temporary file, right next to the given file.
+	 *
+	 *  Example: "/path/to/file.ext" -> "/path/to/file.ext.1a2b-3c4d-5e6f.tmp"
+	 *
+	 *  @param  p The path of the file.
+	 *  @return The path of the temporary file.
+	 */
+	static UString getTemporaryFile(const UString &p);
+
 	/** Is the given string an absolute path?
 	 *
 	 *  @param  p The path to check.
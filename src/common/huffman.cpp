@@ -24,6 +24,9 @@
 
 #include <cassert>
 
+#include <algorithm>
+#include <map>
+
 #include "src/common/huffman.h"
 #include "src/common/util.h"
 #include "src/common/error.h"
@@ -31,7 +34,35 @@
 
 namespace Common {
 
-Huffman::Symbol::Symbol(uint32 c, uint32 s) : code(c), symbol(s) {
+/** Return a mask with the lowest n bits set. */
+static inline uint32 getMask(uint8 n) {
+	return (n >= 32) ? 0xFFFFFFFF : ((((uint32) 1) << n) - 1);
+}
+
+/** Reverse the order of the lowest n bits in value. */
+static uint32 reverseBits(uint32 value, uint8 n) {
+	uint32 reversed = 0;
+	for (uint8 i = 0; i < n; i++, value >>= 1)
+		reversed = (reversed << 1) | (value & 1);
+
+	return reversed;
+}
+
+
+Huffman::Code::Code(uint32 c, uint8 l) : code(c), length(l) {
+}
+
+Huffman::StreamCode::StreamCode(uint32 b, uint8 l, size_t i) : bits(b), length(l), index(i) {
+}
+
+bool Huffman::StreamCode::operator<(const StreamCode &right) const {
+	if (length != right.length)
+		return length < right.length;
+
+	return index < right.index;
+}
+
+Huffman::TableEntry::TableEntry() : value(0), length(0), bits(0) {
 }
 
 
@@ -59,19 +90,23 @@ void Huffman::init(uint8 maxLength, size_t codeCount, const uint32 *codes,
 
 	assert(maxLength <= 32);
 
-	_codes.resize(maxLength);
+	_maxLength = maxLength;
+	_tableBits = MIN(maxLength, kTableBits);
+
+	_codes.reserve(codeCount);
 	_symbols.resize(codeCount);
 
 	for (size_t i = 0; i < codeCount; i++) {
-		// The symbol. If none were specified, just assume it's identical to the code index
-		uint32 symbol = symbols ? symbols[i] : i;
+		assert((lengths[i] > 0) && (lengths[i] <= maxLength));
 
-		// Put the code and symbol into the correct list
-		_codes[lengths[i] - 1].push_back(Symbol(codes[i], symbol));
+		_codes.push_back(Code(codes[i], lengths[i]));
 
-		// And put the pointer to the symbol/code struct into the symbol list.
-		_symbols[i] = &_codes[lengths[i] - 1].back();
+		// The symbol. If none were specified, just assume it's identical to the code index
+		_symbols[i] = symbols ? symbols[i] : i;
 	}
+
+	createTable(_tableMSB, true);
+	createTable(_tableLSB, false);
 }
 
 Huffman::~Huffman() {
@@ -79,21 +114,157 @@ Huffman::~Huffman() {
 
 void Huffman::setSymbols(const uint32 *symbols) {
 	for (size_t i = 0; i < _symbols.size(); i++)
-		_symbols[i]->symbol = symbols ? *symbols++ : i;
+		_symbols[i] = symbols ? *symbols++ : i;
 }
 
-uint32 Huffman::getSymbol(BitStream &bits) const {
-	uint32 code = 0;
+void Huffman::createTable(Table &table, bool msbFirst) {
+	/* Bring the codes into the order their bits appear in the bitstream.
+	 * When reading LSB to MSB, the first bit of a code is its LSB. */
+
+	StreamCodeList codes;
+	codes.reserve(_codes.size());
 
 	for (size_t i = 0; i < _codes.size(); i++) {
-		bits.addBit(code, i);
+		const Code &code = _codes[i];
+
+		// A code with bits set outside of its length can never be found
+		if ((code.code & ~getMask(code.length)) != 0)
+			continue;
+
+		const uint32 bits = msbFirst ? code.code : reverseBits(code.code, code.length);
+
+		codes.push_back(StreamCode(bits, code.length, i));
+	}
+
+	/* When several codes share a prefix, the shortest one wins. When several
+	 * codes are the same, the first one wins. Sort the codes in that order. */
+	std::sort(codes.begin(), codes.end());
+
+	table.clear();
+	table.resize(((size_t) 1) << _tableBits);
+
+	fillTable(table, 0, _tableBits, 0, codes, msbFirst);
+}
+
+void Huffman::fillTable(Table &table, size_t offset, uint8 tableBits, uint8 consumed,
+                        const StreamCodeList &codes, bool msbFirst) {
+
+	/* Codes that end within this table fill all the entries they are a
+	 * prefix of. Go through them backwards, so that the codes that win
+	 * overwrite the ones they shadow. */
+
+	for (StreamCodeList::const_reverse_iterator c = codes.rbegin(); c != codes.rend(); ++c) {
+		const uint8 length = c->length - consumed;
+		if (length > tableBits)
+			continue;
+
+		const uint32 prefix = (c->bits & getMask(length)) << (tableBits - length);
+		const uint32 count  = ((uint32) 1) << (tableBits - length);
+
+		for (uint32 i = 0; i < count; i++) {
+			const uint32 index = msbFirst ? (prefix | i) : reverseBits(prefix | i, tableBits);
+
+			TableEntry &entry = table[offset + index];
 
-		for (CodeList::const_iterator cCode = _codes[i].begin(); cCode != _codes[i].end(); ++cCode)
-			if (code == cCode->code)
-				return cCode->symbol;
+			entry.value  = c->index;
+			entry.length = length;
+			entry.bits   = 0;
+		}
 	}
 
+	/* Longer codes are grouped by their first bits. Each group is put into
+	 * its own next-level table, unless a shorter code shadows all of it. */
+
+	std::map<uint32, StreamCodeList> groups;
+
+	for (StreamCodeList::const_iterator c = codes.begin(); c != codes.end(); ++c) {
+		const uint8 length = c->length - consumed;
+		if (length <= tableBits)
+			continue;
+
+		const uint32 prefix = (c->bits & getMask(length)) >> (length - tableBits);
+		const uint32 index  = msbFirst ? prefix : reverseBits(prefix, tableBits);
+
+		if (table[offset + index].length > 0)
+			continue;
+
+		groups[index].push_back(*c);
+	}
+
+	for (std::map<uint32, StreamCodeList>::const_iterator g = groups.begin(); g != groups.end(); ++g) {
+		uint8 maxLength = 0;
+		for (StreamCodeList::const_iterator c = g->second.begin(); c != g->second.end(); ++c)
+			maxLength = MAX<uint8>(maxLength, c->length - consumed - tableBits);
+
+		const uint8  nextBits   = MIN(maxLength, kTableBits);
+		const size_t nextOffset = table.size();
+
+		table.resize(nextOffset + (((size_t) 1) << nextBits));
+
+		table[offset + g->first].value = nextOffset;
+		table[offset + g->first].bits  = nextBits;
+
+		fillTable(table, nextOffset, nextBits, consumed + tableBits, g->second, msbFirst);
+	}
+}
+
+uint32 Huffman::getSymbol(BitStream &bits) const {
+#ifdef XOREOS_HUFFMAN_VERIFY
+	const size_t verifyIndex = findCode(bits);
+#endif
+
+	const Table &table = bits.isMSBFirst() ? _tableMSB : _tableLSB;
+
+	size_t offset    = 0;
+	uint8  tableBits = _tableBits;
+
+	while (true) {
+		const TableEntry &entry = table[offset + bits.peekBits(tableBits)];
+
+		if (entry.length > 0) {
+#ifdef XOREOS_HUFFMAN_VERIFY
+			if (entry.value != verifyIndex)
+				throw Exception("Huffman lookup table mismatch: %u != %u",
+				                (uint) entry.value, (uint) verifyIndex);
+#endif
+
+			bits.skip(entry.length);
+			return _symbols[entry.value];
+		}
+
+		// No code and no next-level table
+		if (entry.bits == 0)
+			break;
+
+		bits.skip(tableBits);
+
+		offset    = entry.value;
+		tableBits = entry.bits;
+	}
+
+#ifdef XOREOS_HUFFMAN_VERIFY
+	if (verifyIndex != SIZE_MAX)
+		throw Exception("Huffman lookup table mismatch: invalid != %u", (uint) verifyIndex);
+#endif
+
 	throw Exception("Unknown Huffman code");
 }
 
+size_t Huffman::findCode(BitStream &bits) const {
+	/* Look at the next bits and compare them against all codes, from the
+	 * shortest to the longest, in order. This is slow, but simple. */
+
+	const uint32 peek = bits.peekBits(_maxLength);
+
+	for (uint8 length = 1; length <= _maxLength; length++) {
+		const uint32 code = bits.isMSBFirst() ? (peek >> (_maxLength - length)) : (peek & getMask(length));
+
+		for (size_t i = 0; i < _codes.size(); i++)
+			if ((_codes[i].length == length) && (_codes[i].code == code))
+				return i;
+	}
+
+	return SIZE_MAX;
+}
+
 } // End of namespace Common
@@ -26,7 +26,6 @@
 #define COMMON_HUFFMAN_H
 
 #include <vector>
-#include <list>
 
 #include "src/common/types.h"
 
@@ -43,7 +42,22 @@ struct HuffmanTable {
 	const uint32 *symbols; ///< The symbols, 0 if identical to the codes.
 };
 
-/** Decode a Huffman'd bitstream. */
+/** Decode a Huffman'd bitstream.
+ *
+ *  The codes are decoded with the help of lookup tables, built when the
+ *  decoder is constructed. The first table is indexed by the next few
+ *  bits in the bitstream, which are peeked all at once. Its entries either
+ *  directly name the symbol and the length of its code, or point to a
+ *  second-level table for the longer codes sharing this prefix, and so on.
+ *
+ *  Since the same codes mean different things depending on whether the
+ *  bitstream hands out its bits MSB to LSB or LSB to MSB, there's a set of
+ *  tables for both.
+ *
+ *  When compiled with XOREOS_HUFFMAN_VERIFY defined, each decoded symbol is
+ *  cross-checked against a straight-forward search through all the codes,
+ *  and an exception is thrown on a mismatch.
+ */
 class Huffman {
 public:
 	/** Construct a Huffman decoder.
@@ -66,25 +80,66 @@ public:
 	uint32 getSymbol(BitStream &bits) const;
 
 private:
-	struct Symbol {
+	/** Number of bits used to index the lookup tables. */
+	static const uint8 kTableBits = 9;
+
+	struct Code {
 		uint32 code;
-		uint32 symbol;
+		uint8  length;
 
-		Symbol(uint32 c, uint32 s);
+		Code(uint32 c, uint8 l);
 	};
 
-	typedef std::list<Symbol>     CodeList;
-	typedef std::vector<CodeList> CodeLists;
-	typedef std::vector<Symbol *> SymbolList;
+	/** A code with its bits in the order they appear in the bitstream, first bit as MSB. */
+	struct StreamCode {
+		uint32 bits;
+		uint8  length;
+		size_t index; ///< Index of the code in the code list.
+
+		StreamCode(uint32 b, uint8 l, size_t i);
+
+		/** Sort by priority: first by length, then by index. */
+		bool operator<(const StreamCode &right) const;
+	};
 
-	/** Lists of codes and their symbols, sorted by code length. */
-	CodeLists _codes;
+	/** An entry in a lookup table. */
+	struct TableEntry {
+		uint32 value;  ///< Index of the code, or offset of the next-level table.
+		uint8  length; ///< Remaining length of the code. 0 for next-level tables and invalid codes.
+		uint8  bits;   ///< Index bits of the next-level table. 0 for codes and invalid codes.
 
-	/** Sorted list of pointers to the symbols. */
+		TableEntry();
+	};
+
+	typedef std::vector<Code>       CodeList;
+	typedef std::vector<uint32>     SymbolList;
+	typedef std::vector<StreamCode> StreamCodeList;
+	typedef std::vector<TableEntry> Table;
+
+	/** The codes, in the order they were given. */
+	CodeList _codes;
+	/** The symbols of the codes. */
 	SymbolList _symbols;
 
+	/** Maximal code length. */
+	uint8 _maxLength;
+	/** Index bits of the first-level lookup table. */
+	uint8 _tableBits;
+
+	/** Lookup tables for bitstreams reading MSB to LSB. */
+	Table _tableMSB;
+	/** Lookup tables for bitstreams reading LSB to MSB. */
+	Table _tableLSB;
+
 	void init(uint8 maxLength, size_t codeCount, const uint32 *codes,
 	          const uint8 *lengths, const uint32 *symbols);
+
+	void createTable(Table &table, bool msbFirst);
+	void fillTable(Table &table, size_t offset, uint8 tableBits, uint8 consumed,
+	               const StreamCodeList &codes, bool msbFirst);
+
+	/** Find the code at the start of the bitstream, by searching through all codes. */
+	size_t findCode(BitStream &bits) const;
 };
 
 } // End of namespace Common
@@ -0,0 +1,192 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Read-only memory mappings of files.
+ */
+
+#include "src/common/system.h"
+
+#if defined(WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
+#if defined(UNIX)
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include <cassert>
+
+#include <boost/filesystem/path.hpp>
+
+#include "src/common/mappedfile.h"
+#include "src/common/error.h"
+#include "src/common/ustring.h"
+
+namespace Common {
+
+#if defined(WIN32)
+
+MappedFile::MappedFile() : _data(0), _size(0), _mapping(0) {
+}
+
+MappedFile::~MappedFile() {
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+}
+
+boost::shared_ptr<MappedFile> MappedFile::map(const UString &fileName) {
+	boost::shared_ptr<MappedFile> file;
+
+	HANDLE handle = CreateFileW(boost::filesystem::path(fileName.c_str()).c_str(), GENERIC_READ,
+	                            FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (handle == INVALID_HANDLE_VALUE)
+		return file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || (fileSize.QuadPart <= 0) || (fileSize.QuadPart > 0x7FFFFFFF)) {
+		CloseHandle(handle);
+		return file;
+	}
+
+	HANDLE mapping = CreateFileMappingW(handle, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(handle);
+
+	if (!mapping)
+		return file;
+
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		return file;
+	}
+
+	file.reset(new MappedFile);
+
+	file->_data    = reinterpret_cast<const byte *>(data);
+	file->_size    = (size_t) fileSize.QuadPart;
+	file->_mapping = mapping;
+
+	return file;
+}
+
+#elif defined(UNIX)
+
+MappedFile::MappedFile() : _data(0), _size(0) {
+}
+
+MappedFile::~MappedFile() {
+	if (_data)
+		munmap(const_cast<byte *>(_data), _size);
+}
+
+boost::shared_ptr<MappedFile> MappedFile::map(const UString &fileName) {
+	boost::shared_ptr<MappedFile> file;
+
+	const int fd = ::open(boost::filesystem::path(fileName.c_str()).c_str(), O_RDONLY);
+	if (fd < 0)
+		return file;
+
+	struct stat fileStat;
+	if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size <= 0) || (fileStat.st_size > 0x7FFFFFFF)) {
+		::close(fd);
+		return file;
+	}
+
+	const size_t size = (size_t) fileStat.st_size;
+
+	// The mapping stays valid after closing the file descriptor
+	void *data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		return file;
+
+	file.reset(new MappedFile);
+
+	file->_data = reinterpret_cast<const byte *>(data);
+	file->_size = size;
+
+	return file;
+}
+
+#else
+
+MappedFile::MappedFile() : _data(0), _size(0) {
+}
+
+MappedFile::~MappedFile() {
+}
+
+boost::shared_ptr<MappedFile> MappedFile::map(const UString &UNUSED(fileName)) {
+	// No memory mapping support on this platform
+	return boost::shared_ptr<MappedFile>();
+}
+
+#endif
+
+const byte *MappedFile::getData() const {
+	return _data;
+}
+
+size_t MappedFile::size() const {
+	return _size;
+}
+
+
+MappedReadStream::MappedReadStream(const boost::shared_ptr<MappedFile> &file) :
+	MemoryReadStream(file->getData(), file->size()), _file(file) {
+
+}
+
+MappedReadStream::MappedReadStream(const boost::shared_ptr<MappedFile> &file, size_t offset, size_t size) :
+	MemoryReadStream(file->getData() + offset, size), _file(file) {
+
+	assert((offset <= file->size()) && (size <= (file->size() - offset)));
+}
+
+MappedReadStream::~MappedReadStream() {
+}
+
+MappedReadStream *MappedReadStream::open(const UString &fileName) {
+	boost::shared_ptr<MappedFile> file = MappedFile::map(fileName);
+	if (!file)
+		return 0;
+
+	return new MappedReadStream(file);
+}
+
+MemoryReadStream *MappedReadStream::readStreamAt(size_t offset, size_t dataSize) {
+	if ((offset > size()) || (dataSize > (size() - offset)))
+		throw Exception(kReadError);
+
+	const size_t begin = getData() - _file->getData();
+
+	return new MappedReadStream(_file, begin + offset, dataSize);
+}
+
+} // End of namespace Common
@@ -0,0 +1,98 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Read-only memory mappings of files.
+ */
+
+#ifndef COMMON_MAPPEDFILE_H
+#define COMMON_MAPPEDFILE_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/memreadstream.h"
+
+namespace Common {
+
+class UString;
+
+/** A whole file, mapped read-only into memory.
+ *
+ *  The data is read by the operating system on demand, straight out of
+ *  the page cache, without going through an intermediate buffer.
+ */
+class MappedFile : boost::noncopyable {
+public:
+	~MappedFile();
+
+	/** Map this file into memory.
+	 *
+	 *  @param  fileName The name of the file to map.
+	 *  @return The mapped file, or an empty pointer if the file can't be mapped.
+	 */
+	static boost::shared_ptr<MappedFile> map(const UString &fileName);
+
+	/** Return the mapped data. */
+	const byte *getData() const;
+	/** Return the size of the mapped data. */
+	size_t size() const;
+
+private:
+	const byte *_data; ///< The mapped data.
+	size_t      _size; ///< The size of the mapped data.
+
+#if defined(WIN32)
+	void *_mapping; ///< The file mapping object.
+#endif
+
+	MappedFile();
+};
+
+/** A MemoryReadStream over (a part of) a memory-mapped file.
+ *
+ *  Each stream holds a reference to the mapping, so that it stays valid
+ *  even after the stream it was created from is gone. Reading a part of
+ *  the stream with readStreamAt() returns another view into the same
+ *  mapping, without allocating or copying any data.
+ */
+class MappedReadStream : public MemoryReadStream {
+public:
+	MappedReadStream(const boost::shared_ptr<MappedFile> &file);
+	MappedReadStream(const boost::shared_ptr<MappedFile> &file, size_t offset, size_t size);
+	~MappedReadStream();
+
+	/** Map this file into memory and return a stream over it.
+	 *
+	 *  @param  fileName The name of the file to map.
+	 *  @return A stream over the whole file, or 0 if the file can't be mapped.
+	 */
+	static MappedReadStream *open(const UString &fileName);
+
+	MemoryReadStream *readStreamAt(size_t offset, size_t dataSize);
+
+private:
+	boost::shared_ptr<MappedFile> _file;
+};
+
+} // End of namespace Common
+
+#endif // COMMON_MAPPEDFILE_H
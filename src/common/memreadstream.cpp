@@ -100,6 +100,18 @@ size_t MemoryReadStream::seek(ptrdiff_t offset, Origin whence) {
 	return oldPos;
 }
 
+size_t MemoryReadStream::readAt(size_t offset, void *dataPtr, size_t dataSize) {
+	assert(dataPtr);
+
+	if (offset > _size)
+		throw Exception(kSeekError);
+
+	dataSize = MIN<size_t>(dataSize, _size - offset);
+	std::memcpy(dataPtr, _ptrOrig + offset, dataSize);
+
+	return dataSize;
+}
+
 bool MemoryReadStream::eos() const {
 	return _eos;
 }
@@ -116,6 +128,15 @@ const byte *MemoryReadStream::getData() const {
 	return _ptrOrig;
 }
 
+byte *MemoryReadStream::releaseData() {
+	if (!_disposeMemory)
+		return 0;
+
+	_disposeMemory = false;
+
+	return const_cast<byte *>(_ptrOrig);
+}
+
 
 MemoryReadStreamEndian::MemoryReadStreamEndian(const byte *dataPtr, size_t dataSize,
                                                bool bigEndian, bool disposeMemory) :
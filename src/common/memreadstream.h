@@ -80,8 +80,18 @@ public:
 
 	size_t seek(ptrdiff_t offset, Origin whence = kOriginBegin);
 
+	size_t readAt(size_t offset, void *dataPtr, size_t dataSize);
+
 	const byte *getData() const;
 
+	/** Give up the ownership of the memory buffer and return it.
+	 *
+	 *  The stream stays usable, but the caller is now responsible for
+	 *  delete[]'ing the buffer after the stream is gone. If the stream
+	 *  doesn't own its buffer, 0 is returned instead.
+	 */
+	byte *releaseData();
+
 private:
 	const byte * const _ptrOrig;
 	const byte *_ptr;
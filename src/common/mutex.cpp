@@ -139,4 +139,95 @@ void Condition::signal() {
 	SDL_CondSignal(_condition);
 }
 
+void Condition::broadcast() {
+	SDL_CondBroadcast(_condition);
+}
+
+
+ReadWriteLock::ReadWriteLock() : _condition(_mutex), _readers(0), _writers(0), _waitingWriters(0), _writer(0) {
+}
+
+ReadWriteLock::~ReadWriteLock() {
+	assert((_readers == 0) && (_writers == 0));
+}
+
+bool ReadWriteLock::isWriter() const {
+	return (_writers > 0) && (_writer == SDL_ThreadID());
+}
+
+void ReadWriteLock::lockRead() {
+	StackLock lock(_mutex);
+
+	// The writer can read as well. We count that as another write lock
+	if (isWriter()) {
+		_writers++;
+		return;
+	}
+
+	while ((_writers > 0) || (_waitingWriters > 0))
+		_condition.wait();
+
+	_readers++;
+}
+
+void ReadWriteLock::unlockRead() {
+	StackLock lock(_mutex);
+
+	if (isWriter()) {
+		_writers--;
+		return;
+	}
+
+	assert(_readers > 0);
+
+	if (--_readers == 0)
+		_condition.broadcast();
+}
+
+void ReadWriteLock::lockWrite() {
+	StackLock lock(_mutex);
+
+	if (isWriter()) {
+		_writers++;
+		return;
+	}
+
+	_waitingWriters++;
+
+	while ((_writers > 0) || (_readers > 0))
+		_condition.wait();
+
+	_waitingWriters--;
+
+	_writers = 1;
+	_writer  = SDL_ThreadID();
+}
+
+void ReadWriteLock::unlockWrite() {
+	StackLock lock(_mutex);
+
+	assert(isWriter());
+
+	if (--_writers == 0)
+		_condition.broadcast();
+}
+
+
+StackReadLock::StackReadLock(ReadWriteLock &lock) : _lock(&lock) {
+	_lock->lockRead();
+}
+
+StackReadLock::~StackReadLock() {
+	_lock->unlockRead();
+}
+
+
+StackWriteLock::StackWriteLock(ReadWriteLock &lock) : _lock(&lock) {
+	_lock->lockWrite();
+}
+
+StackWriteLock::~StackWriteLock() {
+	_lock->unlockWrite();
+}
+
 } // End of namespace Common
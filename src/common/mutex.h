@@ -85,6 +85,7 @@ public:
 
 	bool wait(uint32 timeout = 0);
 	void signal();
+	void broadcast();
 
 private:
 	bool _ownMutex;
@@ -93,6 +94,58 @@ private:
 	SDL_cond *_condition;
 };
 
+/** A lock that allows either several readers or a single writer at the same time.
+ *
+ *  Writers are preferred: once a writer is waiting, new readers have to wait
+ *  as well. A read lock must therefore never be taken recursively.
+ *
+ *  The thread holding the write lock may take it again, and may also take
+ *  read locks.
+ */
+class ReadWriteLock : boost::noncopyable {
+public:
+	ReadWriteLock();
+	~ReadWriteLock();
+
+	void lockRead();
+	void unlockRead();
+
+	void lockWrite();
+	void unlockWrite();
+
+private:
+	Mutex     _mutex;
+	Condition _condition;
+
+	uint32 _readers;        ///< Number of threads holding a read lock.
+	uint32 _writers;        ///< Number of times the writer thread holds the lock.
+	uint32 _waitingWriters; ///< Number of threads waiting for the write lock.
+
+	SDL_threadID _writer; ///< The thread holding the write lock.
+
+	bool isWriter() const;
+};
+
+/** Convenience class that read-locks a ReadWriteLock on creation and unlocks it on destruction. */
+class StackReadLock : boost::noncopyable {
+public:
+	StackReadLock(ReadWriteLock &lock);
+	~StackReadLock();
+
+private:
+	ReadWriteLock *_lock;
+};
+
+/** Convenience class that write-locks a ReadWriteLock on creation and unlocks it on destruction. */
+class StackWriteLock : boost::noncopyable {
+public:
+	StackWriteLock(ReadWriteLock &lock);
+	~StackWriteLock();
+
+private:
+	ReadWriteLock *_lock;
+};
+
 } // End of namespace Common
 
 #endif // COMMON_MUTEX_H
@@ -22,6 +22,13 @@
  *  Implementing the stream reading interfaces for files.
  */
 
+#include "src/common/system.h"
+
+#if defined(UNIX)
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
 #include <cassert>
 
 #include "src/common/readfile.h"
@@ -139,4 +146,57 @@ size_t ReadFile::read(void *dataPtr, size_t dataSize) {
 	return std::fread(dataPtr, 1, dataSize, _handle);
 }
 
+#if defined(UNIX)
+
+size_t ReadFile::readAt(size_t offset, void *dataPtr, size_t dataSize) {
+	if (!_handle)
+		return 0;
+
+	assert(dataPtr);
+
+	if (offset > _size)
+		throw Exception(kSeekError);
+
+	dataSize = MIN<size_t>(dataSize, _size - offset);
+
+	/* pread() reads directly from the file descriptor, bypassing the stdio
+	 * buffer. It doesn't touch the file position, so several threads can
+	 * read from the same file at the same time. */
+
+	const int fd = fileno(_handle);
+
+	byte  *data     = reinterpret_cast<byte *>(dataPtr);
+	size_t dataRead = 0;
+
+	while (dataRead < dataSize) {
+		const ssize_t n = pread(fd, data + dataRead, dataSize - dataRead, offset + dataRead);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			throw Exception(kReadError);
+		}
+
+		if (n == 0)
+			break;
+
+		dataRead += n;
+	}
+
+	return dataRead;
+}
+
+#else
+
+size_t ReadFile::readAt(size_t offset, void *dataPtr, size_t dataSize) {
+	if (!_handle)
+		return 0;
+
+	StackLock lock(_readAtMutex);
+
+	return SeekableReadStream::readAt(offset, dataPtr, dataSize);
+}
+
+#endif
+
 } // End of namespace Common
@@ -32,11 +32,20 @@
 #include "src/common/types.h"
 #include "src/common/readstream.h"
 
+#if !defined(UNIX)
+	#include "src/common/mutex.h"
+#endif
+
 namespace Common {
 
 class UString;
 
-/** A simple streaming file reading class. */
+/** A simple streaming file reading class.
+ *
+ *  Apart from the usual sequential reading, ReadFile also supports
+ *  positional reads with readAt(). These don't change the file position
+ *  indicator and can be done from several threads at the same time.
+ */
 class ReadFile : boost::noncopyable, public SeekableReadStream {
 public:
 	ReadFile();
@@ -67,9 +76,16 @@ public:
 	size_t seek(ptrdiff_t offset, Origin whence = kOriginBegin);
 	size_t read(void *dataPtr, size_t dataSize);
 
+	size_t readAt(size_t offset, void *dataPtr, size_t dataSize);
+
 protected:
 	std::FILE *_handle; ///< The actual file handle.
 	size_t _size;       ///< The file's size.
+
+#if !defined(UNIX)
+	/** Without pread(), positional reads need to seek and read under a lock. */
+	Mutex _readAtMutex;
+#endif
 };
 
 } // End of namespace Common
@@ -84,6 +84,36 @@ SeekableReadStream::SeekableReadStream() {
 SeekableReadStream::~SeekableReadStream() {
 }
 
+size_t SeekableReadStream::readAt(size_t offset, void *dataPtr, size_t dataSize) {
+	const size_t oldPos = seek(offset);
+
+	try {
+		dataSize = read(dataPtr, dataSize);
+	} catch (...) {
+		seek(oldPos);
+		throw;
+	}
+
+	seek(oldPos);
+	return dataSize;
+}
+
+MemoryReadStream *SeekableReadStream::readStreamAt(size_t offset, size_t dataSize) {
+	byte *buf = new byte[dataSize];
+
+	try {
+
+		if (readAt(offset, buf, dataSize) != dataSize)
+			throw Exception(kReadError);
+
+	} catch (...) {
+		delete[] buf;
+		throw;
+	}
+
+	return new MemoryReadStream(buf, dataSize, true);
+}
+
 size_t SeekableReadStream::evalSeek(ptrdiff_t offset, Origin whence, size_t pos, size_t begin, size_t size) {
 	switch (whence) {
 		case kOriginEnd:
@@ -169,6 +199,15 @@ size_t SeekableSubReadStream::seek(ptrdiff_t offset, Origin whence) {
 	return oldPos;
 }
 
+size_t SeekableSubReadStream::readAt(size_t offset, void *dataPtr, size_t dataSize) {
+	if (offset > size())
+		throw Exception(kSeekError);
+
+	dataSize = MIN<size_t>(dataSize, size() - offset);
+
+	return _parentStream->readAt(_begin + offset, dataPtr, dataSize);
+}
+
 
 SeekableSubReadStreamEndian::SeekableSubReadStreamEndian(SeekableReadStream *parentStream,
 		size_t begin, size_t end, bool bigEndian, bool disposeParentStream) :
@@ -317,6 +317,35 @@ public:
 		return seek(offset, kOriginCurrent);
 	}
 
+	/** Read data from a specific position in the stream, without changing the
+	 *  stream position indicator.
+	 *
+	 *  Streams that can do this in a thread-safe manner override this method.
+	 *  Currently, these are ReadFile and MemoryReadStream, and a
+	 *  SeekableSubReadStream as long as its parent stream is thread-safe.
+	 *  The default implementation seeks and reads, and is not thread-safe.
+	 *
+	 *  When trying to read from a position outside the stream, a kSeekError
+	 *  exception is thrown.
+	 *
+	 *  @param  offset the position, from the beginning of the stream, to read from.
+	 *  @param  dataPtr pointer to a buffer into which the data is read.
+	 *  @param  dataSize number of bytes to be read.
+	 *  @return the number of bytes which were actually read.
+	 */
+	virtual size_t readAt(size_t offset, void *dataPtr, size_t dataSize);
+
+	/** Read the specified amount of data from a specific position into a new[]'ed
+	 *  buffer which then is wrapped into a MemoryReadStream. Like readAt(), this
+	 *  does not change the stream position indicator.
+	 *
+	 *  Streams over memory-mapped files override this to return a view into the
+	 *  mapping instead, without copying the data.
+	 *
+	 *  When reading fails, a kReadError exception is thrown.
+	 */
+	virtual MemoryReadStream *readStreamAt(size_t offset, size_t dataSize);
+
 	/** Evaluate the seek offset relative to whence into a position from the beginning. */
 	static size_t evalSeek(ptrdiff_t offset, Origin whence, size_t pos, size_t begin, size_t size);
 };
@@ -368,6 +397,8 @@ public:
 
 	size_t seek(ptrdiff_t offset, Origin whence = kOriginBegin);
 
+	size_t readAt(size_t offset, void *dataPtr, size_t dataSize);
+
 protected:
 	SeekableReadStream *_parentStream;
 
@@ -62,6 +62,7 @@ src_common_libcommon_la_SOURCES += \
     src/common/stringmap.h \
     src/common/readline.h \
     src/common/readfile.h \
+    src/common/mappedfile.h \
     src/common/writefile.h \
     src/common/filepath.h \
     src/common/filelist.h \
@@ -79,6 +80,7 @@ src_common_libcommon_la_SOURCES += \
     src/common/systemfonts.h \
     src/common/changeid.h \
     src/common/xml.h \
+    src/common/simd.h \
     $(EMPTY)
 
 src_common_libcommon_la_SOURCES += \
@@ -114,6 +116,7 @@ src_common_libcommon_la_SOURCES += \
     src/common/stringmap.cpp \
     src/common/readline.cpp \
     src/common/readfile.cpp \
+    src/common/mappedfile.cpp \
     src/common/writefile.cpp \
     src/common/filepath.cpp \
     src/common/filelist.cpp \
@@ -128,4 +131,5 @@ src_common_libcommon_la_SOURCES += \
     src/common/systemfonts.cpp \
     src/common/changeid.cpp \
     src/common/xml.cpp \
+    src/common/simd.cpp \
     $(EMPTY)
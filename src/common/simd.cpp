@@ -0,0 +1,49 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Compiler and CPU support for SIMD instructions.
+ */
+
+#include "src/common/simd.h"
+
+namespace Common {
+
+static SIMDLevel detectSIMDLevel() {
+#ifdef COMMON_SIMD_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return kSIMDAVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return kSIMDSSE2;
+#endif
+
+	return kSIMDNone;
+}
+
+SIMDLevel getSIMDLevel() {
+	// Detected on first use, so that it works during static initialization too
+	static const SIMDLevel level = detectSIMDLevel();
+
+	return level;
+}
+
+} // End of namespace Common
@@ -0,0 +1,58 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Compiler and CPU support for SIMD instructions.
+ */
+
+#ifndef COMMON_SIMD_H
+#define COMMON_SIMD_H
+
+/* COMMON_SIMD_X86 is defined if we're compiling for x86 with a compiler that
+ * can build functions for instruction sets beyond the compiler's target.
+ * Such functions have to be marked with COMMON_TARGET(), and must only be
+ * called after getSIMDLevel() reported that the CPU supports them. */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__clang__) && ((__clang_major__ > 3) || ((__clang_major__ == 3) && (__clang_minor__ >= 8)))) || \
+     (!defined(__clang__) && defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+	#define COMMON_SIMD_X86 1
+	#define COMMON_TARGET(x) __attribute__((__target__(x)))
+
+	#include <immintrin.h>
+#endif
+
+namespace Common {
+
+/** The SIMD instruction sets a CPU supports. Each level includes all lower levels. */
+enum SIMDLevel {
+	kSIMDNone, ///< No SIMD instructions we know about.
+	kSIMDSSE2, ///< x86 SSE2.
+	kSIMDAVX2  ///< x86 AVX2.
+};
+
+/** Return the highest SIMD level supported by the CPU we're running on.
+ *
+ *  Without COMMON_SIMD_X86, this is always kSIMDNone.
+ */
+SIMDLevel getSIMDLevel();
+
+} // End of namespace Common
+
+#endif // COMMON_SIMD_H
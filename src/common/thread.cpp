@@ -24,8 +24,6 @@
  *  See also threads.h for the global threading system helpers.
  */
 
-#include <SDL_timer.h>
-
 #include "src/common/thread.h"
 
 namespace Common {
@@ -33,8 +31,7 @@ namespace Common {
 Thread::Thread() {
 	_thread = 0;
 
-	_killThread    = false;
-	_threadRunning = false;
+	_killThread = false;
 }
 
 Thread::~Thread() {
@@ -42,7 +39,7 @@ Thread::~Thread() {
 }
 
 bool Thread::createThread() {
-	if (_threadRunning)
+	if (_thread)
 		// Already running, nothing to do
 		return true;
 
@@ -53,47 +50,25 @@ bool Thread::createThread() {
 	return true;
 }
 
-bool Thread::destroyThread() {
-	if (!_threadRunning)
-		return true;
+void Thread::destroyThread() {
+	if (!_thread)
+		return;
 
-	// Signal the thread that it should die
+	// Signal the thread that it should die, and wait for it to finish
 	_killThread = true;
 
-	// Wait a whole second for the thread to finish on its own
-	for (int i = 0; _threadRunning && (i < 100); i++)
-		SDL_Delay(10);
-
-	if (!_threadRunning) {
-		// Wait for everything to settle
-		SDL_WaitThread(_thread, 0);
-
-		_killThread    = false;
-		_threadRunning = false;
-
-		return true;
-	}
-
-	/// FIXME: not sure if the thread is really killed
-
-	_killThread    = false;
-	_threadRunning = false;
+	SDL_WaitThread(_thread, 0);
 
-	return false;
+	_thread     = 0;
+	_killThread = false;
 }
 
 int Thread::threadHelper(void *obj) {
 	Thread *thread = static_cast<Thread *>(obj);
 
-	// The thread is running.
-	thread->_threadRunning = true;
-
 	// Run the thread
 	thread->threadMethod();
 
-	// Thread thread is not running.
-	thread->_threadRunning = false;
-
 	return 0;
 }
 
@@ -40,7 +40,8 @@ public:
 	virtual ~Thread();
 
 	bool createThread();
-	bool destroyThread();
+	/** Signal the thread to stop, and wait until it finished. */
+	void destroyThread();
 
 protected:
 	volatile bool _killThread;
@@ -48,8 +49,6 @@ protected:
 private:
 	SDL_Thread *_thread;
 
-	bool _threadRunning;
-
 	virtual void threadMethod() = 0;
 
 	static int threadHelper(void *obj);
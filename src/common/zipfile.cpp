@@ -133,28 +133,28 @@ const ZipFile::IFile &ZipFile::getIFile(uint32 index) const {
 }
 
 void ZipFile::getFileProperties(SeekableReadStream &zip, const IFile &file,
-		uint16 &compMethod, uint32 &compSize, uint32 &realSize) const {
+		uint16 &compMethod, uint32 &compSize, uint32 &realSize, size_t &dataOffset) const {
 
-	zip.seek(file.offset);
+	static const size_t kLocalHeaderSize = 30;
 
-	uint32 tag = zip.readUint32LE();
+	// Read the local file header with a positional read, so that this is thread-safe
+	byte header[kLocalHeaderSize];
+	if (zip.readAt(file.offset, header, kLocalHeaderSize) != kLocalHeaderSize)
+		throw Exception(kReadError);
+
+	uint32 tag = READ_LE_UINT32(header);
 	if (tag != 0x04034B50)
 		throw Exception("Unknown ZIP record %08X", tag);
 
-	zip.skip(4);
-
-	compMethod = zip.readUint16LE();
+	compMethod = READ_LE_UINT16(header + 8);
 
-	zip.skip(8);
+	compSize = READ_LE_UINT32(header + 18);
+	realSize = READ_LE_UINT32(header + 22);
 
-	compSize = zip.readUint32LE();
-	realSize = zip.readUint32LE();
+	uint16 nameLength  = READ_LE_UINT16(header + 26);
+	uint16 extraLength = READ_LE_UINT16(header + 28);
 
-	uint16 nameLength  = zip.readUint16LE();
-	uint16 extraLength = zip.readUint16LE();
-
-	zip.skip(nameLength);
-	zip.skip(extraLength);
+	dataOffset = file.offset + kLocalHeaderSize + nameLength + extraLength;
 }
 
 size_t ZipFile::getFileSize(uint32 index) const {
@@ -168,12 +168,28 @@ SeekableReadStream *ZipFile::getFile(uint32 index, bool tryNoCopy) const {
 	uint32 compSize;
 	uint32 realSize;
 
-	getFileProperties(*_zip, file, compMethod, compSize, realSize);
+	size_t dataOffset;
+
+	getFileProperties(*_zip, file, compMethod, compSize, realSize, dataOffset);
 
 	if (tryNoCopy && (compMethod == 0))
-		return new SeekableSubReadStream(_zip, _zip->pos(), _zip->pos() + compSize);
+		return new SeekableSubReadStream(_zip, dataOffset, dataOffset + compSize);
+
+	MemoryReadStream *compStream = _zip->readStreamAt(dataOffset, compSize);
+	if (compMethod == 0)
+		return compStream;
+
+	SeekableReadStream *fileStream = 0;
+
+	try {
+		fileStream = decompressFile(*compStream, compMethod, compSize, realSize);
+	} catch (...) {
+		delete compStream;
+		throw;
+	}
 
-	return decompressFile(*_zip, compMethod, compSize, realSize);
+	delete compStream;
+	return fileStream;
 }
 
 SeekableReadStream *ZipFile::decompressFile(SeekableReadStream &zip, uint32 method,
@@ -85,7 +85,7 @@ private:
 
 	const IFile &getIFile(uint32 index) const;
 	void getFileProperties(SeekableReadStream &zip, const IFile &file,
-			uint16 &compMethod, uint32 &compSize, uint32 &realSize) const;
+			uint16 &compMethod, uint32 &compSize, uint32 &realSize, size_t &dataOffset) const;
 };
 
 } // End of namespace Common
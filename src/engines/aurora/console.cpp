@@ -37,6 +37,10 @@
 #include "src/aurora/resman.h"
 #include "src/aurora/talkman.h"
 
+#include "src/aurora/nwscript/variable.h"
+#include "src/aurora/nwscript/ncsfile.h"
+#include "src/aurora/nwscript/scriptcache.h"
+
 #include "src/graphics/graphics.h"
 #include "src/graphics/font.h"
 #include "src/graphics/camera.h"
@@ -725,6 +729,18 @@ Console::Console(Engine &engine, const Common::UString &font, int fontHeight) :
 			"Usage: quit\nQuit xoreos entirely");
 	registerCommand("dumpreslist", boost::bind(&Console::cmdDumpResList, this, _1),
 			"Usage: dumpreslist <file>\nDump the current list of resources to file");
+	registerCommand("rescache"   , boost::bind(&Console::cmdResCache   , this, _1),
+			"Usage: rescache [clear]\nPrint the statistics of the decoded resource cache, or clear it");
+	registerCommand("scriptcache", boost::bind(&Console::cmdScriptCache, this, _1),
+			"Usage: scriptcache [clear]\nPrint the statistics of the loaded script cache, or clear it");
+	registerCommand("scriptalloc", boost::bind(&Console::cmdScriptAlloc, this, _1),
+			"Usage: scriptalloc\nPrint how often script variables and stacks allocated memory");
+	registerCommand("texloader"  , boost::bind(&Console::cmdTexLoader  , this, _1),
+			"Usage: texloader\nPrint the statistics of the background texture loading");
+	registerCommand("texcache"   , boost::bind(&Console::cmdTexCache   , this, _1),
+			"Usage: texcache\nPrint the statistics of the on-disk texture cache");
+	registerCommand("texmem"     , boost::bind(&Console::cmdTexMem     , this, _1),
+			"Usage: texmem\nPrint how much memory the textures use");
 	registerCommand("dumpres"    , boost::bind(&Console::cmdDumpRes    , this, _1),
 			"Usage: dumpres <resource>\nDump a resource to file");
 	registerCommand("dumptga"    , boost::bind(&Console::cmdDumpTGA    , this, _1),
@@ -1205,6 +1221,97 @@ void Console::cmdDumpResList(const CommandLine &cl) {
 		printf("Failed dumping list of resources to file \"%s\"", file.c_str());
 }
 
+void Console::cmdResCache(const CommandLine &cl) {
+	if (cl.args == "clear") {
+		ResMan.clearCache();
+		printf("Cleared the decoded resource cache");
+		return;
+	}
+
+	if (!cl.args.empty()) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	const Aurora::ResourceCache::Statistics stats = ResMan.getCacheStatistics();
+
+	printf("Resources: %u (%.2f of %.2f MB)", (uint) stats.count,
+	       stats.size / (1024.0 * 1024.0), stats.maxSize / (1024.0 * 1024.0));
+	printf("Hits     : %s", Common::composeString(stats.hits).c_str());
+	printf("Misses   : %s", Common::composeString(stats.misses).c_str());
+	printf("Evictions: %s", Common::composeString(stats.evictions).c_str());
+}
+
+void Console::cmdScriptCache(const CommandLine &cl) {
+	if (cl.args == "clear") {
+		ScriptCacheMan.clear();
+		printf("Cleared the loaded script cache");
+		return;
+	}
+
+	if (!cl.args.empty()) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	const Aurora::NWScript::ScriptCache::Statistics stats = ScriptCacheMan.getStatistics();
+
+	const uint64 requests = stats.hits + stats.misses;
+	const double hitRate  = (requests > 0) ? ((100.0 * stats.hits) / requests) : 0.0;
+
+	printf("Scripts  : %u", (uint) stats.count);
+	printf("Hits     : %s (%.1f%%)", Common::composeString(stats.hits).c_str(), hitRate);
+	printf("Misses   : %s", Common::composeString(stats.misses).c_str());
+}
+
+void Console::cmdScriptAlloc(const CommandLine &UNUSED(cl)) {
+	printf("Strings  : %s", Common::composeString(Aurora::NWScript::Variable::getStringAllocations()).c_str());
+	printf("Stacks   : %s", Common::composeString(Aurora::NWScript::NCSStack::getAllocations()).c_str());
+}
+
+void Console::cmdTexLoader(const CommandLine &UNUSED(cl)) {
+	const Graphics::Aurora::TextureLoader::Statistics stats = TextureMan.getLoaderStatistics();
+
+	const uint32 finished = stats.decoded + stats.failed;
+	const double average  = (finished > 0) ? (stats.totalLatency / (double) finished) : 0.0;
+
+	printf("Threads : %u", (uint) stats.threads);
+	printf("Queued  : %u (%u being decoded)", (uint) (stats.queued + stats.decoding), (uint) stats.decoding);
+	printf("Decoded : %u (%u failed)", stats.decoded, stats.failed);
+	printf("Latency : %.1f ms average, %u ms maximum, %u ms last", average, stats.maxLatency, stats.lastLatency);
+}
+
+void Console::cmdTexCache(const CommandLine &UNUSED(cl)) {
+	if (!TextureMan.getCache().isEnabled()) {
+		printf("The texture cache is disabled");
+		return;
+	}
+
+	const Graphics::Aurora::TextureCache::Statistics stats = TextureMan.getCache().getStatistics();
+
+	const double hitTime  = (stats.hits   > 0) ? (stats.hitTime  / (1000.0 * stats.hits  )) : 0.0;
+	const double missTime = (stats.misses > 0) ? (stats.missTime / (1000.0 * stats.misses)) : 0.0;
+
+	printf("Hits    : %u, %.3f ms average, %.1f ms total", stats.hits, hitTime, stats.hitTime / 1000.0);
+	printf("Misses  : %u, %.3f ms average, %.1f ms total", stats.misses, missTime, stats.missTime / 1000.0);
+	printf("Stored  : %u (%u failed)", stats.stored, stats.failures);
+	printf("Removed : %u", stats.pruned);
+}
+
+void Console::cmdTexMem(const CommandLine &UNUSED(cl)) {
+	const Graphics::Aurora::TextureManager::MemoryStatistics stats = TextureMan.getMemoryStatistics();
+
+	printf("Textures : %u (%u unused)", (uint) stats.textures, (uint) stats.unusedTextures);
+	printf("Graphics : %s (%s unused), budget %s",
+	       Common::FilePath::getHumanReadableSize(stats.textureMemory).c_str(),
+	       Common::FilePath::getHumanReadableSize(stats.unusedMemory).c_str(),
+	       Common::FilePath::getHumanReadableSize(stats.textureBudget).c_str());
+	printf("Images   : %s, budget %s",
+	       Common::FilePath::getHumanReadableSize(stats.imageMemory).c_str(),
+	       Common::FilePath::getHumanReadableSize(stats.imageBudget).c_str());
+	printf("Evicted  : %u", stats.evictions);
+}
+
 void Console::cmdDumpRes(const CommandLine &cl) {
 	if (cl.args.empty()) {
 		printCommandHelp(cl.cmd);
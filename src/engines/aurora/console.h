@@ -287,6 +287,12 @@ private:
 	void cmdClose      (const CommandLine &cl);
 	void cmdQuit       (const CommandLine &cl);
 	void cmdDumpResList(const CommandLine &cl);
+	void cmdResCache   (const CommandLine &cl);
+	void cmdScriptCache(const CommandLine &cl);
+	void cmdScriptAlloc(const CommandLine &cl);
+	void cmdTexLoader  (const CommandLine &cl);
+	void cmdTexCache   (const CommandLine &cl);
+	void cmdTexMem     (const CommandLine &cl);
 	void cmdDumpRes    (const CommandLine &cl);
 	void cmdDumpTGA    (const CommandLine &cl);
 	void cmdDump2DA    (const CommandLine &cl);
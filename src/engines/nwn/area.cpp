@@ -23,10 +23,13 @@
  */
 
 #include <cassert>
+#include <set>
 
 #include "src/common/util.h"
 #include "src/common/error.h"
+#include "src/common/debug.h"
 
+#include "src/aurora/resman.h"
 #include "src/aurora/gff3file.h"
 #include "src/aurora/2dafile.h"
 #include "src/aurora/2dareg.h"
@@ -38,6 +41,8 @@
 
 #include "src/sound/sound.h"
 
+#include "src/events/events.h"
+
 #include "src/engines/aurora/util.h"
 #include "src/engines/aurora/model.h"
 
@@ -392,6 +397,8 @@ void Area::loadTile(const Aurora::GFF3Struct &t, Tile &tile) {
 }
 
 void Area::loadModels() {
+	const uint32 startTime = EventMan.getTimestamp();
+
 	loadTileModels();
 
 	for (ObjectList::iterator o = _objects.begin(); o != _objects.end(); ++o) {
@@ -406,6 +413,9 @@ void Area::loadModels() {
 				_objectMap.insert(std::make_pair(*id, &object));
 		}
 	}
+
+	debugC(Common::kDebugEngineGraphics, 1, "Loaded the models of area \"%s\" in %ums",
+	       _resRef.c_str(), EventMan.getTimestamp() - startTime);
 }
 
 void Area::unloadModels() {
@@ -446,7 +456,27 @@ void Area::unloadTileset() {
 	_tileset = 0;
 }
 
+void Area::prefetchTileModels() {
+	std::set<Common::UString> models;
+	for (std::vector<Tile>::const_iterator t = _tiles.begin(); t != _tiles.end(); ++t)
+		models.insert(_tileset->getTile(t->tileID).model);
+
+	std::list<Aurora::ResourceManager::ResourceID> resources;
+	for (std::set<Common::UString>::const_iterator m = models.begin(); m != models.end(); ++m) {
+		resources.push_back(Aurora::ResourceManager::ResourceID());
+
+		resources.back().name = *m;
+		resources.back().type = Aurora::kFileTypeMDL;
+		resources.back().hash = 0;
+	}
+
+	ResMan.prefetch(resources);
+}
+
 void Area::loadTiles() {
+	// Page the tile models in from disk in the background, while we're loading them one by one
+	prefetchTileModels();
+
 	for (uint32 y = 0; y < _height; y++) {
 		for (uint32 x = 0; x < _width; x++) {
 			uint32 n = y * _width + x;
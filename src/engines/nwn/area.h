@@ -229,6 +229,8 @@ private:
 	void loadTileset();
 	void unloadTileset();
 
+	void prefetchTileModels();
+
 	void loadTiles();
 	void unloadTiles();
 
@@ -22,6 +22,8 @@
  *  The scrolling background image panel in Sonic Chronicles: The Dark Brotherhood.
  */
 
+#include <boost/bind.hpp>
+
 #include "src/common/util.h"
 #include "src/common/ustring.h"
 #include "src/common/error.h"
@@ -91,9 +93,15 @@ void AreaBackground::render(Graphics::RenderPass pass) {
 	glEnd();
 }
 
+static Graphics::ImageDecoder *decodeCBGT(Common::SeekableReadStream *cbgt, Common::SeekableReadStream *pal,
+                                           Common::SeekableReadStream *twoda) {
+
+	return new Graphics::CBGT(*cbgt, *pal, *twoda);
+}
+
 void AreaBackground::loadTexture(const Common::UString &name) {
 	Common::SeekableReadStream *cbgt = 0, *pal = 0, *twoda = 0;
-	Graphics::CBGT *image = 0;
+	Graphics::ImageDecoder *image = 0;
 
 	try {
 		if (!(cbgt  = ResMan.getResource(name, Aurora::kFileTypeCBGT)))
@@ -103,7 +111,18 @@ void AreaBackground::loadTexture(const Common::UString &name) {
 		if (!(twoda = ResMan.getResource(name, Aurora::kFileType2DA)))
 			throw Common::Exception("No such 2DA");
 
-		image    = new Graphics::CBGT(*cbgt, *pal, *twoda);
+		Graphics::Aurora::TextureCache &cache = TextureMan.getCache();
+		Graphics::Aurora::TextureCache::Key cacheKey;
+
+		if (cache.isEnabled()) {
+			cacheKey.add(*cbgt);
+			cacheKey.add(*pal);
+			cacheKey.add(*twoda);
+			cacheKey.add((uint32) Aurora::kFileTypeCBGT);
+		}
+
+		image = cache.get(cacheKey, boost::bind(&decodeCBGT, cbgt, pal, twoda));
+
 		_texture = TextureMan.add(Graphics::Aurora::Texture::create(image, Aurora::kFileTypeCBGT), name);
 
 	} catch (Common::Exception &e) {
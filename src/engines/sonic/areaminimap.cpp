@@ -22,6 +22,8 @@
  *  The area mini map in Sonic Chronicles: The Dark Brotherhood.
  */
 
+#include <boost/bind.hpp>
+
 #include "src/common/ustring.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
@@ -61,9 +63,13 @@ void AreaMiniMap::hide() {
 		_miniMap->hide();
 }
 
+static Graphics::ImageDecoder *decodeNBFS(Common::SeekableReadStream *nbfs, Common::SeekableReadStream *nbfp) {
+	return new Graphics::NBFS(*nbfs, *nbfp, kScreenWidth, kScreenHeight);
+}
+
 void AreaMiniMap::loadMiniMap(const Common::UString &name) {
 	Common::SeekableReadStream *nbfs = 0, *nbfp = 0;
-	Graphics::NBFS *image = 0;
+	Graphics::ImageDecoder *image = 0;
 	Graphics::Aurora::TextureHandle texture;
 
 	try {
@@ -72,7 +78,17 @@ void AreaMiniMap::loadMiniMap(const Common::UString &name) {
 		if (!(nbfp = ResMan.getResource(name, Aurora::kFileTypeNBFP)))
 			throw Common::Exception("No such NBFP");
 
-		image   = new Graphics::NBFS(*nbfs, *nbfp, kScreenWidth, kScreenHeight);
+		Graphics::Aurora::TextureCache &cache = TextureMan.getCache();
+		Graphics::Aurora::TextureCache::Key cacheKey;
+
+		if (cache.isEnabled()) {
+			cacheKey.add(*nbfs);
+			cacheKey.add(*nbfp);
+			cacheKey.add((uint32) Aurora::kFileTypeNBFS);
+		}
+
+		image = cache.get(cacheKey, boost::bind(&decodeNBFS, nbfs, nbfp));
+
 		texture = TextureMan.add(Graphics::Aurora::Texture::create(image, Aurora::kFileTypeNBFS), name);
 
 	} catch (Common::Exception &e) {
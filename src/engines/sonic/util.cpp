@@ -26,6 +26,8 @@
 
 #include <vector>
 
+#include <boost/bind.hpp>
+
 #include "src/common/error.h"
 #include "src/common/ustring.h"
 #include "src/common/readstream.h"
@@ -45,6 +47,12 @@ namespace Engines {
 
 namespace Sonic {
 
+static Graphics::ImageDecoder *decodeNCGR(const std::vector<Common::SeekableReadStream *> &ncgrs,
+                                           uint32 width, uint32 height, Common::SeekableReadStream *nclr) {
+
+	return new Graphics::NCGR(ncgrs, width, height, *nclr);
+}
+
 Graphics::Aurora::TextureHandle loadNCGR(const Common::UString &name, const Common::UString &nclr,
                                          uint32 width, uint32 height, ...) {
 
@@ -75,8 +83,29 @@ Graphics::Aurora::TextureHandle loadNCGR(const Common::UString &name, const Comm
 
 		va_end(va);
 
+		Graphics::Aurora::TextureCache &cache = TextureMan.getCache();
+		Graphics::Aurora::TextureCache::Key cacheKey;
+
+		Graphics::ImageDecoder *image = 0;
+
+		if (cache.isEnabled()) {
+			cacheKey.add(*nclrStream);
+			for (std::vector<Common::SeekableReadStream *>::iterator n = ncgrs.begin(); n != ncgrs.end(); ++n) {
+				if (*n)
+					cacheKey.add(**n);
+				else
+					cacheKey.add(0);
+			}
+
+			cacheKey.add((uint32) ::Aurora::kFileTypeNCGR);
+			cacheKey.add(width);
+			cacheKey.add(height);
+		}
+
+		image = cache.get(cacheKey, boost::bind(&decodeNCGR, boost::cref(ncgrs), width, height, nclrStream));
+
 		Graphics::Aurora::Texture *texture = 0;
-		texture = Graphics::Aurora::Texture::create(new Graphics::NCGR(ncgrs, width, height, *nclrStream));
+		texture = Graphics::Aurora::Texture::create(image);
 		handle  = TextureMan.add(texture, name);
 
 	} catch (...) {
@@ -47,8 +47,7 @@ void RequestManager::init() {
 }
 
 void RequestManager::deinit() {
-	if (!destroyThread())
-		warning("RequestManager::deinit(): Requests thread had to be killed");
+	destroyThread();
 
 	clearList();
 }
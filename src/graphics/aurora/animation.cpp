@@ -22,6 +22,8 @@
  *  An animation to be applied to a model.
  */
 
+#include "src/common/util.h"
+#include "src/common/maths.h"
 #include "src/common/readstream.h"
 #include "src/common/debug.h"
 
@@ -32,6 +34,7 @@
 #include "src/graphics/aurora/modelnode.h"
 #include "src/graphics/aurora/animation.h"
 #include "src/graphics/aurora/animnode.h"
+#include "src/graphics/aurora/keyframe.h"
 
 using Common::kDebugGraphics;
 
@@ -73,11 +76,15 @@ void Animation::update(Model *model, float UNUSED(lastFrame), float nextFrame) {
 	//       for event in _events event->fire()
 
 
+	std::vector<AnimationTarget> &targets = model->getAnimationTargets(*this);
+
 	float scale = model->getAnimationScale(_name);
-	for (NodeList::iterator n = nodeList.begin(); n != nodeList.end(); ++n) {
+
+	std::vector<AnimationTarget>::iterator t = targets.begin();
+	for (NodeList::iterator n = nodeList.begin(); (n != nodeList.end()) && (t != targets.end()); ++n, ++t) {
 		ModelNode *animNode = (*n)->_nodedata;
-		ModelNode *target = model->getNode(animNode->getName());
-		if (!target)
+		AnimationTarget &target = *t;
+		if (!target.node)
 			continue;
 
 		// Update position and orientation based on time
@@ -88,6 +95,14 @@ void Animation::update(Model *model, float UNUSED(lastFrame), float nextFrame) {
 	}
 }
 
+void Animation::resolveTargets(Model &model, std::vector<AnimationTarget> &targets) const {
+	targets.clear();
+	targets.reserve(nodeList.size());
+
+	for (NodeList::const_iterator n = nodeList.begin(); n != nodeList.end(); ++n)
+		targets.push_back(AnimationTarget(model.getNode((*n)->_nodedata->getName())));
+}
+
 void Animation::addAnimNode(AnimNode *node) {
 	nodeList.push_back(node);
 	nodeMap.insert(std::make_pair(node->getName(), node));
@@ -132,79 +147,101 @@ static void normQuaternion(float  xIn , float  yIn , float  zIn , float  qIn,
 	qOut = qIn / magnitude;
 }
 
-void Animation::interpolatePosition(ModelNode *animNode, ModelNode *target, float time, float scale) const {
-	// If only one keyframe, don't interpolate, just set the only position
-	if (animNode->_positionFrames.size() == 1) {
-		const PositionKeyFrame &pos = animNode->_positionFrames[0];
-		target->setPosition(pos.x * scale, pos.y * scale, pos.z * scale);
-		return;
+/** Spherically interpolate between two quaternions, along the shorter arc. */
+static void slerpQuaternion(const QuaternionKeyFrame &last, const QuaternionKeyFrame &next, float f,
+                            float &x, float &y, float &z, float &q) {
+
+	float cosAngle = dotQuaternion(last.x, last.y, last.z, last.q, next.x, next.y, next.z, next.q);
+
+	/* If the angle is > 90°, we need to flip the direction of one quaternion to
+	   get a smooth transition instead of wild jumps. */
+	float dir = 1.0f;
+	if (cosAngle <= 0.0f) {
+		cosAngle = -cosAngle;
+		dir      = -1.0f;
 	}
 
-	size_t lastFrame = 0;
-	for (size_t i = 0; i < animNode->_positionFrames.size(); i++) {
-		const PositionKeyFrame &pos = animNode->_positionFrames[i];
-		if (pos.time >= time)
-			break;
+	float weightLast = 1.0f - f;
+	float weightNext = f;
 
-		lastFrame = i;
+	// For (nearly) identical orientations, linear interpolation is precise enough
+	if (cosAngle < 0.9995f) {
+		const float angle    = acos(cosAngle);
+		const float sinAngle = sin(angle);
+
+		weightLast = sin((1.0f - f) * angle) / sinAngle;
+		weightNext = sin(f * angle) / sinAngle;
 	}
 
-	const PositionKeyFrame &last = animNode->_positionFrames[lastFrame];
-	if (lastFrame + 1 >= animNode->_positionFrames.size() || last.time >= time) {
-		target->setPosition(last.x * scale, last.y * scale, last.z * scale);
+	weightNext *= dir;
+
+	x = weightLast * last.x + weightNext * next.x;
+	y = weightLast * last.y + weightNext * next.y;
+	z = weightLast * last.z + weightNext * next.z;
+	q = weightLast * last.q + weightNext * next.q;
+
+	// Normalize the result to counter accumulating imprecisions
+	normQuaternion(x, y, z, q, x, y, z, q);
+}
+
+/** Return the angle, in degrees, of the rotation represented by a quaternion's w component. */
+static float getQuaternionAngle(float q) {
+	return Common::rad2deg(acos(CLIP(q, -1.0f, 1.0f)) * 2.0);
+}
+
+void Animation::interpolatePosition(ModelNode *animNode, AnimationTarget &target, float time, float scale) const {
+	const std::vector<PositionKeyFrame> &frames = animNode->_positionFrames;
+
+	// If only one keyframe, don't interpolate, just set the only position
+	if (frames.size() == 1) {
+		const PositionKeyFrame &pos = frames[0];
+		target.node->setPosition(pos.x * scale, pos.y * scale, pos.z * scale);
+		return;
+	}
+
+	const size_t lastFrame = findLastKeyFrame(frames, time, target.positionFrame);
+
+	const PositionKeyFrame &last = frames[lastFrame];
+	if (lastFrame + 1 >= frames.size() || last.time >= time) {
+		target.node->setPosition(last.x * scale, last.y * scale, last.z * scale);
 		return;
 	}
 
-	const PositionKeyFrame &next = animNode->_positionFrames[lastFrame + 1];
+	const PositionKeyFrame &next = frames[lastFrame + 1];
 
 	const float f = (time - last.time) / (next.time - last.time);
 	const float x = f * next.x + (1.0f - f) * last.x;
 	const float y = f * next.y + (1.0f - f) * last.y;
 	const float z = f * next.z + (1.0f - f) * last.z;
-	target->setPosition(x * scale, y * scale, z * scale);
+	target.node->setPosition(x * scale, y * scale, z * scale);
 }
 
-void Animation::interpolateOrientation(ModelNode *animNode, ModelNode *target, float time) const {
+void Animation::interpolateOrientation(ModelNode *animNode, AnimationTarget &target, float time) const {
+	const std::vector<QuaternionKeyFrame> &frames = animNode->_orientationFrames;
+
 	// If only one keyframe, don't interpolate just set the only orientation
-	if (animNode->_orientationFrames.size() == 1) {
-		const QuaternionKeyFrame &ori = animNode->_orientationFrames[0];
-		target->setOrientation(ori.x, ori.y, ori.z, Common::rad2deg(acos(ori.q) * 2.0));
+	if (frames.size() == 1) {
+		const QuaternionKeyFrame &ori = frames[0];
+		target.node->setOrientation(ori.x, ori.y, ori.z, getQuaternionAngle(ori.q));
 		return;
 	}
 
-	size_t lastFrame = 0;
-	for (size_t i = 0; i < animNode->_orientationFrames.size(); i++) {
-		const QuaternionKeyFrame &ori = animNode->_orientationFrames[i];
-		if (ori.time >= time)
-			break;
-
-		lastFrame = i;
-	}
+	const size_t lastFrame = findLastKeyFrame(frames, time, target.orientationFrame);
 
-	const QuaternionKeyFrame &last = animNode->_orientationFrames[lastFrame];
-	if (lastFrame + 1 >= animNode->_orientationFrames.size() || last.time >= time) {
-		target->setOrientation(last.x, last.y, last.z, Common::rad2deg(acos(last.q) * 2.0));
+	const QuaternionKeyFrame &last = frames[lastFrame];
+	if (lastFrame + 1 >= frames.size() || last.time >= time) {
+		target.node->setOrientation(last.x, last.y, last.z, getQuaternionAngle(last.q));
 		return;
 	}
 
-	const QuaternionKeyFrame &next = animNode->_orientationFrames[lastFrame + 1];
+	const QuaternionKeyFrame &next = frames[lastFrame + 1];
 
 	const float f = (time - last.time) / (next.time - last.time);
 
-	/* If the angle is > 90°, we need to flip the direction of one quaternion to
-	   get a smooth transition instead of wild jumps. */
-	const float angle = acos(dotQuaternion(last.x, last.y, last.z, last.q, next.x, next.y, next.z, next.q));
-	const float dir   = (angle >= (M_PI / 2)) ? -1.0f : 1.0f;
-
-	float x = f * dir * next.x + (1.0f - f) * last.x;
-	float y = f * dir * next.y + (1.0f - f) * last.y;
-	float z = f * dir * next.z + (1.0f - f) * last.z;
-	float q = f * dir * next.q + (1.0f - f) * last.q;
-
-	// Normalize the result for slightly better results
-	normQuaternion(x, y, z, q, x, y, z, q);
+	float x, y, z, q;
+	slerpQuaternion(last, next, f, x, y, z, q);
 
-	target->setOrientation(x, y, z, Common::rad2deg(acos(q) * 2.0));
+	target.node->setOrientation(x, y, z, getQuaternionAngle(q));
 }
 
 } // End of namespace Aurora
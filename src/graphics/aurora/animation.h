@@ -26,6 +26,7 @@
 #define GRAPHICS_AURORA_ANIMATION_H
 
 #include <list>
+#include <vector>
 #include <map>
 
 #include "src/common/ustring.h"
@@ -47,6 +48,7 @@ namespace Graphics {
 namespace Aurora {
 
 class AnimNode;
+struct AnimationTarget;
 
 class Animation {
 public:
@@ -66,6 +68,9 @@ public:
 	/** Update the model position and orientation */
 	void update(Model *model, float lastFrame, float nextFrame);
 
+	/** Find the model's nodes this animation animates, in the order of the animation's nodes. */
+	void resolveTargets(Model &model, std::vector<AnimationTarget> &targets) const;
+
 	// Nodes
 
 	void addAnimNode(AnimNode *node);
@@ -92,8 +97,8 @@ protected:
 	float _transtime;
 
 private:
-	void interpolatePosition(ModelNode *animNode, ModelNode *target, float time, float scale) const;
-	void interpolateOrientation(ModelNode *animNode, ModelNode *target, float time) const;
+	void interpolatePosition(ModelNode *animNode, AnimationTarget &target, float time, float scale) const;
+	void interpolateOrientation(ModelNode *animNode, AnimationTarget &target, float time) const;
 };
 
 } // End of namespace Aurora
@@ -34,12 +34,14 @@ namespace Graphics {
 
 namespace Aurora {
 
-FPS::FPS(const FontHandle &font) : Text(font, "0 fps"), _fps(0) {
+FPS::FPS(const FontHandle &font) : Text(font, "0 fps"), _fps(0),
+	_drawnObjects(0), _culledObjects(0) {
 	init();
 }
 
 FPS::FPS(const FontHandle &font, float r, float g, float b, float a) :
-	Text(font, "0 fps", r, g, b, a), _fps(0) {
+	Text(font, "0 fps", r, g, b, a), _fps(0),
+	_drawnObjects(0), _culledObjects(0) {
 
 	init();
 }
@@ -58,12 +60,19 @@ void FPS::render(RenderPass pass) {
 	if (pass == kRenderPassOpaque)
 		return;
 
-	uint32 fps = GfxMan.getFPS();
+	uint32 fps    = GfxMan.getFPS();
+	uint32 drawn  = GfxMan.getDrawnObjectCount();
+	uint32 culled = GfxMan.getCulledObjectCount();
 
-	if (fps != _fps) {
-		_fps = fps;
+	if ((fps != _fps) || (drawn != _drawnObjects) || (culled != _culledObjects)) {
+		_fps           = fps;
+		_drawnObjects  = drawn;
+		_culledObjects = culled;
 
-		set(Common::UString::format("%d fps", _fps));
+		if ((_drawnObjects == 0) && (_culledObjects == 0))
+			set(Common::UString::format("%d fps", _fps));
+		else
+			set(Common::UString::format("%d fps, %u drawn, %u culled", _fps, _drawnObjects, _culledObjects));
 	}
 
 	Text::render(pass);
@@ -46,6 +46,9 @@ public:
 private:
 	uint32 _fps;
 
+	uint32 _drawnObjects;  ///< Number of world objects drawn in the last frame.
+	uint32 _culledObjects; ///< Number of world objects culled in the last frame.
+
 	void init();
 
 	void notifyResized(int oldWidth, int oldHeight, int newWidth, int newHeight);
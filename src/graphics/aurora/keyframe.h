@@ -0,0 +1,80 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Finding the keyframes of an animation track to interpolate between.
+ */
+
+#ifndef GRAPHICS_AURORA_KEYFRAME_H
+#define GRAPHICS_AURORA_KEYFRAME_H
+
+#include <algorithm>
+#include <vector>
+
+namespace Graphics {
+
+namespace Aurora {
+
+template<typename T>
+bool isKeyFrameBefore(const T &frame, float time) {
+	return frame.time < time;
+}
+
+/** Is this keyframe the one to interpolate from for this time?
+ *
+ *  That's the last keyframe before the time, or the very first one
+ *  if there is no keyframe before the time.
+ */
+template<typename T>
+bool isLastKeyFrame(const std::vector<T> &frames, size_t frame, float time) {
+	if ((frame != 0) && (frames[frame].time >= time))
+		return false;
+
+	return ((frame + 1) >= frames.size()) || (frames[frame + 1].time >= time);
+}
+
+/** Find the keyframe to interpolate from for this time.
+ *
+ *  Between two updates, the time usually only moves forward a tiny bit. So we
+ *  first check the keyframe we found last time and the one following it, and
+ *  only do a binary search over all keyframes if neither matches.
+ */
+template<typename T>
+size_t findLastKeyFrame(const std::vector<T> &frames, float time, size_t &cursor) {
+	if (cursor < frames.size()) {
+		if (isLastKeyFrame(frames, cursor, time))
+			return cursor;
+
+		if (((cursor + 1) < frames.size()) && isLastKeyFrame(frames, cursor + 1, time))
+			return ++cursor;
+	}
+
+	typename std::vector<T>::const_iterator next =
+		std::lower_bound(frames.begin(), frames.end(), time, isKeyFrameBefore<T>);
+
+	cursor = (next != frames.begin()) ? ((next - frames.begin()) - 1) : 0;
+	return cursor;
+}
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_AURORA_KEYFRAME_H
@@ -31,6 +31,9 @@
 #include "src/common/debug.h"
 
 #include "src/graphics/camera.h"
+#include "src/graphics/graphics.h"
+#include "src/graphics/frustum.h"
+#include "src/graphics/spatialindex.h"
 
 #include "src/graphics/aurora/model.h"
 #include "src/graphics/aurora/textureman.h"
@@ -43,6 +46,11 @@
 
 using Common::kDebugGraphics;
 
+/** How many poses per second of animation to sample for the animation bounding box. */
+static const uint32 kAnimationBoundSampleRate = 15;
+/** The maximum number of poses to sample for the animation bounding box. */
+static const uint32 kAnimationBoundMaxSamples = 64;
+
 namespace Graphics {
 
 namespace Aurora {
@@ -60,6 +68,10 @@ Model::Model(ModelType type) : Renderable((RenderableType) type),
 	_orientation[2] = 0.0f;
 	_orientation[3] = 0.0f;
 
+	_worldIndexProxy = SpatialIndex::kInvalidProxy;
+
+	_animationBoundAnimation = 0;
+
 	_center[0] = 0.0f; _center[1] = 0.0f; _center[2] = 0.0f;
 
 	// TODO: Is this the same as modelScale for non-UI?
@@ -135,6 +147,17 @@ bool Model::isIn(float x1, float y1, float z1, float x2, float y2, float z2) con
 	return _absoluteBoundBox.isIn(x1, y1, z1, x2, y2, z2);
 }
 
+bool Model::isInFrustum(const Frustum &frustum) const {
+	if (_type == kModelTypeGUIFront)
+		return true;
+
+	// Animated nodes can move outside of the bounding box of the current pose
+	if (_currentAnimation && (_animationBoundAnimation == _currentAnimation))
+		return frustum.isIn(_absoluteAnimationBoundBox);
+
+	return frustum.isIn(_absoluteBoundBox);
+}
+
 float Model::getWidth() const {
 	return _boundBox.getWidth() * _scale[0];
 }
@@ -344,9 +367,9 @@ void Model::createAbsolutePosition() {
 	_absolutePosition.rotate(_orientation[3], _orientation[0], _orientation[1], _orientation[2]);
 	_absolutePosition.scale(_scale[0], _scale[1], _scale[2]);
 
-	_absoluteBoundBox = _boundBox;
-	_absoluteBoundBox.transform(_absolutePosition);
-	_absoluteBoundBox.absolutize();
+	createAbsoluteBound();
+
+	updateWorldIndex();
 }
 
 const std::list<Common::UString> &Model::getStates() const {
@@ -381,6 +404,12 @@ void Model::setState(const Common::UString &name) {
 
 	_currentState = state;
 
+	_animationTargets.clear();
+	_animationBounds.clear();
+
+	_animationBoundBox.clear();
+	_animationBoundAnimation = 0;
+
 	createBound();
 
 	if (visible) {
@@ -490,6 +519,17 @@ void Model::attachModel(const Common::UString &nodeName, Model *model) {
 	}
 }
 
+Model::AnimationTargets &Model::getAnimationTargets(const Animation &anim) {
+	AnimationTargetMap::iterator t = _animationTargets.find(&anim);
+	if (t != _animationTargets.end())
+		return t->second;
+
+	t = _animationTargets.insert(std::make_pair(&anim, AnimationTargets())).first;
+	anim.resolveTargets(*this, t->second);
+
+	return t->second;
+}
+
 Animation *Model::getAnimation(const Common::UString &anim) {
 
 	AnimationMap::iterator n = _animationMap.find(anim);
@@ -521,6 +561,28 @@ float Model::getAnimationScale(const Common::UString &anim) {
 	return 1.0f;
 }
 
+void Model::show() {
+	Renderable::show();
+
+	if ((_type == kModelTypeObject) && (_worldIndexProxy == SpatialIndex::kInvalidProxy))
+		_worldIndexProxy = GfxMan.addToWorldIndex(this, _absoluteBoundBox);
+}
+
+void Model::hide() {
+	if (_worldIndexProxy != SpatialIndex::kInvalidProxy) {
+		GfxMan.removeFromWorldIndex(_worldIndexProxy);
+
+		_worldIndexProxy = SpatialIndex::kInvalidProxy;
+	}
+
+	Renderable::hide();
+}
+
+void Model::updateWorldIndex() {
+	if (_worldIndexProxy != SpatialIndex::kInvalidProxy)
+		GfxMan.updateWorldIndex(_worldIndexProxy, _absoluteBoundBox);
+}
+
 void Model::calculateDistance() {
 	if (_type == kModelTypeGUIFront) {
 		_distance = _position[2];
@@ -570,6 +632,10 @@ void Model::manageAnimations(float dt) {
 	if (!_currentAnimation)
 		return;
 
+	// Find out how far this animation moves the nodes, for culling
+	if (_animationBoundAnimation != _currentAnimation)
+		createAnimationBound();
+
 	// The loop of the animation ended: make sure to play the last frame
 	if ((lastFrame < _animationLoopLength) && (nextFrame >= _animationLoopLength)) {
 		_currentAnimation->update(this, lastFrame, _animationLoopLength);
@@ -740,6 +806,11 @@ void Model::doDestroy() {
 void Model::finalize() {
 	_currentState = 0;
 
+	// Resolve the nodes of the default state, which stand in for missing data in other states
+	for (StateList::iterator s = _stateList.begin(); s != _stateList.end(); ++s)
+		for (NodeList::iterator n = (*s)->nodeList.begin(); n != (*s)->nodeList.end(); ++n)
+			(*n)->_rootStateNode = getNode("", (*n)->_name);
+
 	createStateNamesList();
 	setState();
 
@@ -781,6 +852,23 @@ void Model::createBound() {
 	if (!_currentState)
 		return;
 
+	addPoseBound(_boundBox);
+
+	float minX, minY, minZ, maxX, maxY, maxZ;
+	_boundBox.getMin(minX, minY, minZ);
+	_boundBox.getMax(maxX, maxY, maxZ);
+
+	_center[0] = minX + ((maxX - minX) / 2.0f);
+	_center[1] = minY + ((maxY - minY) / 2.0f);
+	_center[2] = minZ + ((maxZ - minZ) / 2.0f);
+
+
+	createAbsoluteBound();
+
+	updateWorldIndex();
+}
+
+void Model::addPoseBound(Common::BoundingBox &bound) {
 	for (NodeList::iterator n = _currentState->rootNodes.begin();
 	     n != _currentState->rootNodes.end(); ++n) {
 
@@ -788,21 +876,51 @@ void Model::createBound() {
 
 		(*n)->createAbsoluteBound(position);
 
-		_boundBox.add((*n)->getAbsoluteBound());
+		bound.add((*n)->getAbsoluteBound());
 	}
+}
 
-	float minX, minY, minZ, maxX, maxY, maxZ;
-	_boundBox.getMin(minX, minY, minZ);
-	_boundBox.getMax(maxX, maxY, maxZ);
+void Model::createAnimationBound() {
+	_animationBoundAnimation = _currentAnimation;
+	if (!_currentState || !_currentAnimation)
+		return;
 
-	_center[0] = minX + ((maxX - minX) / 2.0f);
-	_center[1] = minY + ((maxY - minY) / 2.0f);
-	_center[2] = minZ + ((maxZ - minZ) / 2.0f);
+	AnimationBoundMap::iterator b = _animationBounds.find(_currentAnimation);
+	if (b == _animationBounds.end()) {
+		b = _animationBounds.insert(std::make_pair(_currentAnimation, _boundBox)).first;
+
+		/* Sample the animation and unite the bounding boxes of all poses.
+		 * Rotating nodes are only approximated between the samples. */
+
+		const float length = _currentAnimation->getLength();
+		const uint32 steps = CLIP<uint32>(length * kAnimationBoundSampleRate, 1, kAnimationBoundMaxSamples);
+
+		for (uint32 i = 0; i <= steps; i++) {
+			_currentAnimation->update(this, 0.0f, (length * i) / steps);
+
+			addPoseBound(b->second);
+		}
 
+		// Return to the pose the model's bounding box is created in, then to the current frame
+		_currentAnimation->update(this, 0.0f, 0.0f);
+		createBound();
+
+		_currentAnimation->update(this, 0.0f, _animationLoopTime);
+	}
 
+	_animationBoundBox = b->second;
+
+	createAbsoluteBound();
+}
+
+void Model::createAbsoluteBound() {
 	_absoluteBoundBox = _boundBox;
 	_absoluteBoundBox.transform(_absolutePosition);
 	_absoluteBoundBox.absolutize();
+
+	_absoluteAnimationBoundBox = _animationBoundBox;
+	_absoluteAnimationBoundBox.transform(_absolutePosition);
+	_absoluteAnimationBoundBox.absolutize();
 }
 
 void Model::readValue(Common::SeekableReadStream &stream, uint32 &value) {
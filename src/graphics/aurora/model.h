@@ -80,6 +80,12 @@ public:
 	bool isIn(float x, float y, float z) const;
 	/** Does the line from x1.y1.z1 to x2.y2.z2 intersect with model's bounding box? */
 	bool isIn(float x1, float y1, float z1, float x2, float y2, float z2) const;
+	/** Is the model's bounding box at least partially within the view frustum?
+	 *
+	 *  While an animation is playing, the box covering the whole course of
+	 *  the animation is checked instead.
+	 */
+	bool isInFrustum(const Frustum &frustum) const;
 
 
 	// Positioning
@@ -177,6 +183,9 @@ public:
 	void render(RenderPass pass);
 	void advanceTime(float dt);
 
+	void show();
+	void hide();
+
 
 protected:
 	typedef std::list<ModelNode *> NodeList;
@@ -244,6 +253,28 @@ protected:
 	/** The model's box after translate/rotate. */
 	Common::BoundingBox _absoluteBoundBox;
 
+	/** The model's bounding box over the whole course of the current animation. */
+	Common::BoundingBox _animationBoundBox;
+	/** The model's animation box after translate/rotate. */
+	Common::BoundingBox _absoluteAnimationBoundBox;
+
+	/** The animation _animationBoundBox was created for. */
+	const Animation *_animationBoundAnimation;
+
+	/** The model's proxy in the GraphicsManager's world object index. */
+	uint32 _worldIndexProxy;
+
+	typedef std::vector<AnimationTarget> AnimationTargets;
+	typedef std::map<const Animation *, AnimationTargets> AnimationTargetMap;
+
+	/** The nodes animated by each animation, resolved for the current state. */
+	AnimationTargetMap _animationTargets;
+
+	typedef std::map<const Animation *, Common::BoundingBox> AnimationBoundMap;
+
+	/** The bounding box over the whole course of each animation, for the current state. */
+	AnimationBoundMap _animationBounds;
+
 
 	// Rendering
 
@@ -284,15 +315,27 @@ private:
 	void createStateNamesList(std::list<Common::UString> *stateNames = 0);
 	/** Create the model's bounding box. */
 	void createBound();
+	/** Add the bounding boxes of all nodes, in their current pose, to this box. */
+	void addPoseBound(Common::BoundingBox &bound);
+	/** Create the model's bounding box over the whole course of the current animation. */
+	void createAnimationBound();
+	/** Transform the model's bounding boxes into their absolute positions. */
+	void createAbsoluteBound();
 
 	void createAbsolutePosition();
 
+	/** Update the model's bounding box in the world object index. */
+	void updateWorldIndex();
+
 	void manageAnimations(float dt);
 
 	Animation *selectDefaultAnimation() const;
 
 	void setCurrentAnimation(Animation *anim);
 
+	/** Return the nodes animated by this animation, resolving them if necessary. */
+	AnimationTargets &getAnimationTargets(const Animation &anim);
+
 public:
 	// General loading helpers
 
@@ -307,6 +350,7 @@ public:
 	                      uint32 offset, uint32 count, std::vector<T> &values);
 
 	friend class ModelNode;
+	friend class Animation;
 };
 
 } // End of namespace Aurora
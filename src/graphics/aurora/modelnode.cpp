@@ -61,7 +61,8 @@ ModelNode::Mesh::Mesh() : shininess(1.0f), alpha(1.0f), tilefade(0), render(fals
 
 
 ModelNode::ModelNode(Model &model) :
-	_model(&model), _parent(0), _attachedModel(0), _level(0), _render(false), _mesh(0) {
+	_model(&model), _parent(0), _attachedModel(0), _level(0), _render(false), _mesh(0),
+	_rootStateNode(0) {
 
 	_position[0] = 0.0f; _position[1] = 0.0f; _position[2] = 0.0f;
 	_rotation[0] = 0.0f; _rotation[1] = 0.0f; _rotation[2] = 0.0f;
@@ -238,7 +239,7 @@ void ModelNode::setEnvironmentMap(const Common::UString &environmentMap) {
 
 	if (!environmentMap.empty()) {
 		try {
-			_mesh->data->envMap = TextureMan.get(environmentMap);
+			_mesh->data->envMap = TextureMan.getAsync(environmentMap);
 		} catch (...) {
 		}
 	}
@@ -272,6 +273,17 @@ void ModelNode::loadTextures(const std::vector<Common::UString> &textures) {
 
 	Common::UString envMap;
 
+	// Decode all textures of this node in parallel
+	std::vector<Common::UString> preload;
+	preload.reserve(textures.size());
+
+	for (std::vector<Common::UString>::const_iterator t = textures.begin(); t != textures.end(); ++t)
+		if (!t->empty() && (*t != "NULL"))
+			preload.push_back(*t);
+
+	if (preload.size() > 1)
+		TextureMan.preload(preload);
+
 	for (size_t t = 0; t != textures.size(); t++) {
 
 		try {
@@ -306,7 +318,7 @@ void ModelNode::loadTextures(const std::vector<Common::UString> &textures) {
 	envMap.trim();
 	if (!envMap.empty()) {
 		try {
-			_mesh->data->envMap = TextureMan.get(envMap);
+			_mesh->data->envMap = TextureMan.getAsync(envMap);
 		} catch (...) {
 			Common::exceptionDispatcherWarning();
 		}
@@ -395,11 +407,8 @@ void ModelNode::createAbsoluteBound(Common::BoundingBox parentPosition) {
 	_absoluteBoundBox.add(_boundBox);
 
 	// If this node is empty, add the root state node
-	if (_boundBox.empty()) {
-		ModelNode *rootStateNode = _model->getNode("", _name);
-		if (rootStateNode)
-			_absoluteBoundBox.add(rootStateNode->_boundBox);
-	}
+	if (_boundBox.empty() && _rootStateNode)
+		_absoluteBoundBox.add(_rootStateNode->_boundBox);
 
 	_absoluteBoundBox.absolutize();
 
@@ -561,10 +570,9 @@ void ModelNode::render(RenderPass pass) {
 	Mesh *mesh = _mesh;
 	bool doRender = _render;
 	if (!_model->getState().empty() && !renderableMesh(mesh)) {
-		ModelNode *rootStateNode = _model->getNode("", _name);
-		if (rootStateNode && renderableMesh(rootStateNode->_mesh)) {
-			mesh = rootStateNode->_mesh;
-			doRender = rootStateNode->_render;
+		if (_rootStateNode && renderableMesh(_rootStateNode->_mesh)) {
+			mesh = _rootStateNode->_mesh;
+			doRender = _rootStateNode->_render;
 		}
 	}
 
@@ -44,6 +44,7 @@ namespace Graphics {
 namespace Aurora {
 
 class Model;
+class ModelNode;
 
 struct PositionKeyFrame {
 	float time;
@@ -60,6 +61,16 @@ struct QuaternionKeyFrame {
 	float q;
 };
 
+/** A model node animated by an animation. */
+struct AnimationTarget {
+	ModelNode *node; ///< The animated node.
+
+	size_t positionFrame;    ///< The position keyframe that was sampled last.
+	size_t orientationFrame; ///< The orientation keyframe that was sampled last.
+
+	AnimationTarget(ModelNode *n = 0) : node(n), positionFrame(0), orientationFrame(0) { }
+};
+
 class ModelNode {
 public:
 	ModelNode(Model &model);
@@ -199,6 +210,9 @@ protected:
 
 	Mesh *_mesh;
 
+	/** The node with the same name in the model's default state. */
+	ModelNode *_rootStateNode;
+
 	Common::BoundingBox _boundBox;
 	Common::BoundingBox _absoluteBoundBox;
 
@@ -27,6 +27,8 @@ src_graphics_aurora_libaurora_la_SOURCES += \
     src/graphics/aurora/texture.h \
     src/graphics/aurora/texturehandle.h \
     src/graphics/aurora/textureman.h \
+    src/graphics/aurora/textureloader.h \
+    src/graphics/aurora/texturecache.h \
     src/graphics/aurora/pltfile.h \
     src/graphics/aurora/cursor.h \
     src/graphics/aurora/cursorman.h \
@@ -48,6 +50,7 @@ src_graphics_aurora_libaurora_la_SOURCES += \
     src/graphics/aurora/model.h \
     src/graphics/aurora/animnode.h \
     src/graphics/aurora/animation.h \
+    src/graphics/aurora/keyframe.h \
     src/graphics/aurora/model_nwn.h \
     src/graphics/aurora/model_nwn2.h \
     src/graphics/aurora/model_kotor.h \
@@ -61,6 +64,8 @@ src_graphics_aurora_libaurora_la_SOURCES += \
     src/graphics/aurora/texture.cpp \
     src/graphics/aurora/texturehandle.cpp \
     src/graphics/aurora/textureman.cpp \
+    src/graphics/aurora/textureloader.cpp \
+    src/graphics/aurora/texturecache.cpp \
     src/graphics/aurora/pltfile.cpp \
     src/graphics/aurora/cursor.cpp \
     src/graphics/aurora/cursorman.cpp \
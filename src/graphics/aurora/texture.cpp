@@ -24,6 +24,8 @@
 
 #include <cassert>
 
+#include <boost/bind.hpp>
+
 #include "src/common/types.h"
 #include "src/common/util.h"
 #include "src/common/strutil.h"
@@ -32,6 +34,8 @@
 
 #include "src/graphics/aurora/texture.h"
 #include "src/graphics/aurora/pltfile.h"
+#include "src/graphics/aurora/textureloader.h"
+#include "src/graphics/aurora/textureman.h"
 
 #include "src/graphics/types.h"
 #include "src/graphics/graphics.h"
@@ -55,11 +59,13 @@ namespace Graphics {
 
 namespace Aurora {
 
-Texture::Texture() : _type(::Aurora::kFileTypeNone), _image(0), _txi(0), _width(0), _height(0) {
+Texture::Texture() : _type(::Aurora::kFileTypeNone), _image(0), _txi(0), _width(0), _height(0),
+	_hasAlpha(false), _isCubeMap(false), _memorySize(0), _imageSize(0) {
 }
 
 Texture::Texture(const Common::UString &name, ImageDecoder *image, ::Aurora::FileType type, TXI *txi) :
-	_name(name), _type(type), _image(0), _txi(0), _width(0), _height(0) {
+	_name(name), _type(type), _image(0), _txi(0), _width(0), _height(0),
+	_hasAlpha(false), _isCubeMap(false), _memorySize(0), _imageSize(0) {
 
 	set(name, image, type, txi);
 	addToQueues();
@@ -71,6 +77,8 @@ Texture::~Texture() {
 	if (_textureID != 0)
 		GfxMan.abandon(&_textureID, 1);
 
+	setMemorySize(0, 0);
+
 	delete _txi;
 	delete _image;
 }
@@ -84,10 +92,11 @@ uint32 Texture::getHeight() const {
 }
 
 bool Texture::hasAlpha() const {
-	if (!_image)
-		return false;
+	return _hasAlpha;
+}
 
-	return _image->hasAlpha();
+bool Texture::isCubeMap() const {
+	return _isCubeMap;
 }
 
 bool Texture::isDynamic() const {
@@ -99,22 +108,30 @@ const TXI &Texture::getTXI() const {
 	if (_txi)
 		return *_txi;
 
-	if (_image)
-		return _image->getTXI();
-
 	return kEmptyTXI;
 }
 
+bool Texture::hasImage() const {
+	return _image != 0;
+}
+
 const ImageDecoder &Texture::getImage() const {
 	assert(_image);
 
 	return *_image;
 }
 
+size_t Texture::getMemorySize() const {
+	return _memorySize;
+}
+
 bool Texture::reload() {
 	if (_name.empty())
 		return false;
 
+	// Drop any unfinished background loading, we're loading the texture anew
+	_loadJob.reset();
+
 	::Aurora::FileType type = ::Aurora::kFileTypeNone;
 	ImageDecoder *image = 0;
 	TXI *txi = 0;
@@ -139,10 +156,27 @@ bool Texture::reload() {
 }
 
 bool Texture::dumpTGA(const Common::UString &fileName) const {
-	if (!_image)
-		return false;
+	// Make sure the render thread doesn't drop the image while we're dumping it
+	GfxMan.lockFrame();
+
+	bool result = false;
+	if (_image) {
+		result = _image->dumpTGA(fileName);
+	} else if (!_name.empty() && !isDynamic()) {
+		// The image was dropped after uploading, load it again
+		try {
+			ImageDecoder *image = loadImage(_name);
+
+			result = image->dumpTGA(fileName);
+			delete image;
+
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to reload texture \"%s\"", _name.c_str());
+		}
+	}
 
-	return _image->dumpTGA(fileName);
+	GfxMan.unlockFrame();
+	return result;
 }
 
 void Texture::doDestroy() {
@@ -155,6 +189,12 @@ void Texture::doDestroy() {
 }
 
 void Texture::doRebuild() {
+	adoptLoaded();
+
+	// The image might have been dropped after an earlier upload
+	if (!_image && (_width > 0))
+		restoreImage();
+
 	if (!_image)
 		// No image
 		return;
@@ -163,12 +203,14 @@ void Texture::doRebuild() {
 	if (_textureID == 0)
 		glGenTextures(1, &_textureID);
 
-	if (_image->isCubeMap()) {
+	if (_image->isCubeMap())
 		createCubeMapTexture();
-		return;
-	}
+	else
+		create2DTexture();
 
-	create2DTexture();
+	// Once uploaded, we only need the image again when the GL context is recreated
+	if (canDropImage() && TextureMan.isOverImageBudget())
+		dropImage();
 }
 
 void Texture::setWrap(GLenum target, GLint wrapModeX, GLint wrapModeY) {
@@ -300,11 +342,15 @@ Texture *Texture::createPLT(const Common::UString &name, Common::SeekableReadStr
 	return texture;
 }
 
-Texture *Texture::create(const Common::UString &name) {
-	::Aurora::FileType type = ::Aurora::kFileTypeNone;
-	ImageDecoder *image = 0;
+void Texture::load(const Common::UString &name, ::Aurora::FileType &type, TXI *&txi,
+                   ImageDecoder *&image, Common::SeekableReadStream *&plt) {
+
+	type  = ::Aurora::kFileTypeNone;
+	txi   = 0;
+	image = 0;
+	plt   = 0;
+
 	ImageDecoder *layers[6] = { 0, 0, 0, 0, 0, 0 };
-	TXI *txi = 0;
 
 	try {
 		txi = loadTXI(name);
@@ -332,8 +378,10 @@ Texture *Texture::create(const Common::UString &name) {
 			// PLT needs extra handling, since they're their own Texture class
 			if (type == ::Aurora::kFileTypePLT) {
 				delete txi;
+				txi = 0;
 
-				return createPLT(name, imageStream);
+				plt = imageStream;
+				return;
 			}
 
 			image = loadImage(imageStream, type, txi);
@@ -343,16 +391,149 @@ Texture *Texture::create(const Common::UString &name) {
 		delete txi;
 		delete image;
 
+		txi   = 0;
+		image = 0;
+
 		for (size_t i = 0; i < ARRAYSIZE(layers); i++)
 			delete layers[i];
 
 		e.add("Failed to create texture \"%s\" (%d)", name.c_str(), type);
 		throw;
 	}
+}
+
+Texture *Texture::create(const Common::UString &name) {
+	::Aurora::FileType type;
+	TXI *txi;
+	ImageDecoder *image;
+	Common::SeekableReadStream *plt;
+
+	load(name, type, txi, image, plt);
+
+	if (plt)
+		return createPLT(name, plt);
 
 	return new Texture(name, image, type, txi);
 }
 
+Texture *Texture::create(const Common::UString &name, TextureLoadJob &job) {
+	::Aurora::FileType type;
+	TXI *txi;
+	ImageDecoder *image;
+	Common::SeekableReadStream *plt;
+
+	job.take(type, txi, image, plt);
+
+	if (plt)
+		return createPLT(name, plt);
+
+	return new Texture(name, image, type, txi);
+}
+
+Texture *Texture::createPending(const Common::UString &name, const boost::shared_ptr<TextureLoadJob> &job) {
+	Texture *texture = new Texture;
+
+	texture->_name    = name;
+	texture->_loadJob = job;
+
+	texture->addToQueues();
+
+	return texture;
+}
+
+bool Texture::isPending() const {
+	return _loadJob || isInQueue(kQueueNewTexture);
+}
+
+bool Texture::isReadyToBuild() const {
+	return !_loadJob || _loadJob->isDone();
+}
+
+void Texture::finishLoading() {
+	if (!_loadJob)
+		return;
+
+	_loadJob->wait();
+
+	GfxMan.lockFrame();
+	adoptLoaded();
+	GfxMan.unlockFrame();
+}
+
+void Texture::adoptLoaded() {
+	if (!_loadJob || !_loadJob->isDone())
+		return;
+
+	boost::shared_ptr<TextureLoadJob> job = _loadJob;
+	_loadJob.reset();
+
+	::Aurora::FileType type = ::Aurora::kFileTypeNone;
+	TXI *txi = 0;
+	ImageDecoder *image = 0;
+	Common::SeekableReadStream *plt = 0;
+
+	try {
+		if (job->isCancelled())
+			// No worker thread got to it in time, so we have to decode it ourselves
+			load(_name, type, txi, image, plt);
+		else
+			job->take(type, txi, image, plt);
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to load texture \"%s\" in the background", _name.c_str());
+		return;
+	}
+
+	if (plt) {
+		warning("Texture \"%s\" is a PLT, which can't be loaded in the background", _name.c_str());
+
+		delete plt;
+		delete txi;
+		return;
+	}
+
+	set(_name, image, type, txi);
+}
+
+bool Texture::canDropImage() const {
+	// We can only load the image again if it came from a resource of that name
+	return !_name.empty() && !isDynamic() && !_loadJob;
+}
+
+void Texture::dropImage() {
+	delete _image;
+	_image = 0;
+
+	setMemorySize(_memorySize, 0);
+}
+
+void Texture::restoreImage() {
+	if (_name.empty() || isDynamic())
+		return;
+
+	::Aurora::FileType type = ::Aurora::kFileTypeNone;
+	ImageDecoder *image = 0;
+	TXI *txi = 0;
+
+	try {
+
+		// The TXI file influences how the image is loaded, but we keep the one we already have
+		txi   = loadTXI  (_name);
+		image = loadImage(_name, type, txi);
+
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to reload texture \"%s\"", _name.c_str());
+	}
+
+	delete txi;
+
+	if (!image)
+		return;
+
+	_image = image;
+
+	setMemorySize(_memorySize, _imageSize + getImageDataSize(*_image));
+}
+
 Texture *Texture::create(ImageDecoder *image, ::Aurora::FileType type, TXI *txi) {
 	if (!image)
 		throw Common::Exception("Can't create a texture from an empty image");
@@ -374,6 +555,40 @@ void Texture::set(const Common::UString &name, ImageDecoder *image, ::Aurora::Fi
 
 	_width  = _image->getMipMap(0).width;
 	_height = _image->getMipMap(0).height;
+
+	_hasAlpha  = _image->hasAlpha();
+	_isCubeMap = _image->isCubeMap();
+
+	/* Keep our own copy of an embedded TXI, so that we can still
+	 * answer questions about it after the image has been dropped. */
+	if (!_txi && !_image->getTXI().empty())
+		_txi = new TXI(_image->getTXI());
+
+	const size_t imageSize = getImageDataSize(*_image);
+
+	// If the image has no mip maps, OpenGL generates them, adding about a third
+	size_t memorySize = imageSize;
+	if (_image->getMipMapCount() == 1)
+		memorySize += memorySize / 3;
+
+	setMemorySize(memorySize, imageSize);
+}
+
+size_t Texture::getImageDataSize(const ImageDecoder &image) {
+	size_t size = 0;
+
+	for (size_t i = 0; i < image.getLayerCount(); i++)
+		for (size_t j = 0; j < image.getMipMapCount(); j++)
+			size += image.getMipMap(j, i).size;
+
+	return size;
+}
+
+void Texture::setMemorySize(size_t memorySize, size_t imageSize) {
+	TextureMan.updateMemory(_memorySize, memorySize, _imageSize, imageSize);
+
+	_memorySize = memorySize;
+	_imageSize  = imageSize;
 }
 
 ImageDecoder *Texture::loadImage(const Common::UString &name) {
@@ -439,21 +654,53 @@ ImageDecoder *Texture::loadImage(Common::SeekableReadStream *imageStream, ::Auro
 	// Check for a cube map, but only those that don't use a file for each side
 	const bool isCubeMap = txi && txi->getFeatures().cube && (txi->getFeatures().fileRange == 0);
 
+	/* Formats that need real work to decode can be taken from the texture cache instead.
+	 * Everything that influences the decoded data is part of the cache key. */
+	TextureCache &cache = TextureMan.getCache();
+	const bool cacheable = cache.isEnabled() &&
+		((type == ::Aurora::kFileTypeTPC) || (type == ::Aurora::kFileTypeTXB) || (type == ::Aurora::kFileTypeSBM));
+
+	ImageDecoder *image = 0;
+	try {
+		if (cacheable) {
+			TextureCache::Key cacheKey;
+
+			cacheKey.add(*imageStream);
+			cacheKey.add((uint32) type);
+			cacheKey.add(isCubeMap ? 1 : 0);
+			cacheKey.add(GfxMan.needManualDeS3TC() ? 1 : 0);
+
+			image = cache.get(cacheKey, boost::bind(&Texture::decodeImage, boost::ref(*imageStream), type, isCubeMap));
+		} else
+			image = decodeImage(*imageStream, type, isCubeMap);
+
+	} catch (...) {
+		delete imageStream;
+		throw;
+	}
+
+	delete imageStream;
+	return image;
+}
+
+ImageDecoder *Texture::decodeImage(Common::SeekableReadStream &imageStream, ::Aurora::FileType type,
+                                   bool isCubeMap) {
+
 	ImageDecoder *image = 0;
 	try {
 		// Loading the different image formats
 		if      (type == ::Aurora::kFileTypeTGA)
-			image = new TGA(*imageStream, isCubeMap);
+			image = new TGA(imageStream, isCubeMap);
 		else if (type == ::Aurora::kFileTypeDDS)
-			image = new DDS(*imageStream);
+			image = new DDS(imageStream);
 		else if (type == ::Aurora::kFileTypeTPC)
-			image = new TPC(*imageStream);
+			image = new TPC(imageStream);
 		else if (type == ::Aurora::kFileTypeTXB)
-			image = new TXB(*imageStream);
+			image = new TXB(imageStream);
 		else if (type == ::Aurora::kFileTypeSBM)
-			image = new SBM(*imageStream);
+			image = new SBM(imageStream);
 		else if (type == ::Aurora::kFileTypeXEOSITEX)
-			image = new XEOSITEX(*imageStream);
+			image = new XEOSITEX(imageStream);
 		else
 			throw Common::Exception("Unsupported image resource type %d", (int) type);
 
@@ -466,12 +713,9 @@ ImageDecoder *Texture::loadImage(Common::SeekableReadStream *imageStream, ::Auro
 
 	} catch (...) {
 		delete image;
-		delete imageStream;
-
 		throw;
 	}
 
-	delete imageStream;
 	return image;
 }
 
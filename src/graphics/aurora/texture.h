@@ -25,6 +25,8 @@
 #ifndef GRAPHICS_AURORA_TEXTURE_H
 #define GRAPHICS_AURORA_TEXTURE_H
 
+#include <boost/shared_ptr.hpp>
+
 #include "src/common/ustring.h"
 
 #include "src/graphics/types.h"
@@ -43,6 +45,8 @@ class TXI;
 
 namespace Aurora {
 
+class TextureLoadJob;
+
 /** A texture. */
 class Texture : public Graphics::Texture {
 public:
@@ -53,17 +57,39 @@ public:
 
 	bool hasAlpha() const;
 
+	/** Is this a cube map texture? */
+	bool isCubeMap() const;
+
 	/** Is this a dynamic texture, or a shared static one? */
 	virtual bool isDynamic() const;
 
 	/** Return the TXI. */
 	const TXI &getTXI() const;
-	/** Return the image. */
+
+	/** Is the decoded image still in memory? */
+	bool hasImage() const;
+	/** Return the image.
+	 *
+	 *  Textures loaded from resources might drop their decoded image once it
+	 *  has been uploaded, so this is only valid if hasImage() is true.
+	 */
 	const ImageDecoder &getImage() const;
 
+	/** Return the approximate size of the texture data in graphics memory, in bytes. */
+	size_t getMemorySize() const;
+
 	/** Try to reload the texture. */
 	virtual bool reload();
 
+	/** Is the texture still being loaded or waiting to be uploaded, and can't be used yet? */
+	bool isPending() const;
+
+	/** Wait for a texture loaded in the background to finish, and take over its image. */
+	void finishLoading();
+
+	// GLContainer
+	bool isReadyToBuild() const;
+
 	/** Dump the texture into a TGA. */
 	bool dumpTGA(const Common::UString &fileName) const;
 
@@ -77,6 +103,22 @@ public:
 	static Texture *create(const Common::UString &name);
 	/** Take over the image and create a texture from it. */
 	static Texture *create(ImageDecoder *image, ::Aurora::FileType type = ::Aurora::kFileTypeNone, TXI *txi = 0);
+	/** Create a texture from the data decoded by this finished background loading job. */
+	static Texture *create(const Common::UString &name, TextureLoadJob &job);
+
+	/** Create an empty placeholder texture, taking over the image once the loading job has finished.
+	 *
+	 *  Until then, the texture has no image, no TXI and a size of 0x0.
+	 */
+	static Texture *createPending(const Common::UString &name, const boost::shared_ptr<TextureLoadJob> &job);
+
+	/** Read and decode the TXI and image of a texture resource.
+	 *
+	 *  PLT files are not decoded, since they need their own Texture class.
+	 *  Their data is returned in the plt stream instead.
+	 */
+	static void load(const Common::UString &name, ::Aurora::FileType &type, TXI *&txi,
+	                 ImageDecoder *&image, Common::SeekableReadStream *&plt);
 
 
 protected:
@@ -89,6 +131,15 @@ protected:
 	uint32 _width;
 	uint32 _height;
 
+	bool _hasAlpha;
+	bool _isCubeMap;
+
+	size_t _memorySize; ///< Approximate size of the texture data in graphics memory.
+	size_t _imageSize;  ///< Size of the decoded image data we keep in memory.
+
+	/** The job loading the texture in the background, if it hasn't been taken over yet. */
+	boost::shared_ptr<TextureLoadJob> _loadJob;
+
 
 	Texture();
 	Texture(const Common::UString &name, ImageDecoder *image, ::Aurora::FileType type, TXI *txi = 0);
@@ -99,6 +150,22 @@ protected:
 	void removeFromQueues();
 	void refresh();
 
+	/** Take over the image of the background loading job, if it has finished. */
+	void adoptLoaded();
+
+	/** Can the image be dropped after uploading, and be reloaded from the resources when needed again? */
+	bool canDropImage() const;
+	/** Drop the decoded image. */
+	void dropImage();
+	/** Reload a dropped image from the resources. */
+	void restoreImage();
+
+	/** Update the amount of memory the texture uses, and tell the TextureManager about it. */
+	void setMemorySize(size_t memorySize, size_t imageSize);
+
+	/** Return the size of all the image data within this image. */
+	static size_t getImageDataSize(const ImageDecoder &image);
+
 
 	// GLContainer
 	void doRebuild();
@@ -120,6 +187,9 @@ protected:
 
 	static ImageDecoder *loadImage(const Common::UString &name, ::Aurora::FileType &type, TXI *txi);
 
+	static ImageDecoder *decodeImage(Common::SeekableReadStream &imageStream, ::Aurora::FileType type,
+	                                 bool isCubeMap);
+
 	static Texture *createPLT(const Common::UString &name, Common::SeekableReadStream *imageStream);
 };
 
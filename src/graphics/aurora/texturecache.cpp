@@ -0,0 +1,500 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of decoded texture images.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+#include <algorithm>
+
+#include <SDL_timer.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/hash.h"
+#include "src/common/endianness.h"
+#include "src/common/filepath.h"
+#include "src/common/filelist.h"
+#include "src/common/mappedfile.h"
+#include "src/common/memreadstream.h"
+#include "src/common/writefile.h"
+
+#include "src/graphics/images/decoder.h"
+#include "src/graphics/images/txi.h"
+
+#include "src/graphics/aurora/texturecache.h"
+
+static const uint32 kCacheID      = MKTAG('X', 'T', 'X', 'C');
+static const uint32 kCacheVersion = MKTAG('V', '1', '.', '0');
+
+static const uint32 kHeaderSize = 48;
+static const uint32 kMipMapSize = 16;
+
+/** Mip map data is aligned to this many bytes within the cache file. */
+static const uint32 kDataAlignment = 16;
+
+static const uint32 kFlagCompressed = 1 << 0;
+static const uint32 kFlagHasAlpha   = 1 << 1;
+static const uint32 kFlagCubeMap    = 1 << 2;
+static const uint32 kFlagHasTXI     = 1 << 3;
+
+namespace Graphics {
+
+namespace Aurora {
+
+/** An image read out of a memory-mapped cache file.
+ *
+ *  The mip maps are copied out of the mapping. Users of images modify
+ *  the mip maps in place, or replace them when decompressing, so they
+ *  can't point into a read-only mapping.
+ */
+class CachedImage : public ImageDecoder {
+public:
+	CachedImage(const Common::MappedFile &file, uint64 key) {
+		const byte  *data = file.getData();
+		const size_t size = file.size();
+
+		if (size < kHeaderSize)
+			throw Common::Exception("Texture cache file too small");
+
+		if ((READ_BE_UINT32(data) != kCacheID) || (READ_BE_UINT32(data + 4) != kCacheVersion))
+			throw Common::Exception("Invalid texture cache file header");
+
+		if ((READ_LE_UINT32(data + 8) != (uint32) key) || (READ_LE_UINT32(data + 12) != (uint32) (key >> 32)))
+			throw Common::Exception("Texture cache file key mismatch");
+
+		const uint32 flags       = READ_LE_UINT32(data + 16);
+		const uint32 layerCount  = READ_LE_UINT32(data + 32);
+		const uint32 mipMapCount = READ_LE_UINT32(data + 36);
+		const uint32 txiOffset   = READ_LE_UINT32(data + 40);
+		const uint32 txiSize     = READ_LE_UINT32(data + 44);
+
+		if ((layerCount == 0) || (mipMapCount == 0) || ((mipMapCount % layerCount) != 0) ||
+		    (mipMapCount > ((size - kHeaderSize) / kMipMapSize)))
+			throw Common::Exception("Invalid texture cache file mip maps");
+
+		if ((txiOffset > size) || (txiSize > (size - txiOffset)))
+			throw Common::Exception("Invalid texture cache file TXI");
+
+		// Check all mip maps first, before allocating anything
+		for (uint32 i = 0; i < mipMapCount; i++) {
+			const byte *mipMap = data + kHeaderSize + i * kMipMapSize;
+
+			const uint32 mipMapSize   = READ_LE_UINT32(mipMap +  8);
+			const uint32 mipMapOffset = READ_LE_UINT32(mipMap + 12);
+
+			if ((mipMapOffset > size) || (mipMapSize > (size - mipMapOffset)))
+				throw Common::Exception("Invalid texture cache file mip map data");
+		}
+
+		_compressed = (flags & kFlagCompressed) != 0;
+		_hasAlpha   = (flags & kFlagHasAlpha  ) != 0;
+		_isCubeMap  = (flags & kFlagCubeMap   ) != 0;
+
+		_format    = (PixelFormat   ) READ_LE_UINT32(data + 20);
+		_formatRaw = (PixelFormatRaw) READ_LE_UINT32(data + 24);
+		_dataType  = (PixelDataType ) READ_LE_UINT32(data + 28);
+
+		_layerCount = layerCount;
+
+		if (flags & kFlagHasTXI) {
+			Common::MemoryReadStream txi(data + txiOffset, txiSize);
+
+			_txi.load(txi);
+		}
+
+		_mipMaps.reserve(mipMapCount);
+		for (uint32 i = 0; i < mipMapCount; i++) {
+			const byte *mipMap = data + kHeaderSize + i * kMipMapSize;
+
+			_mipMaps.push_back(new MipMap(this));
+
+			_mipMaps.back()->width  = READ_LE_UINT32(mipMap + 0);
+			_mipMaps.back()->height = READ_LE_UINT32(mipMap + 4);
+			_mipMaps.back()->size   = READ_LE_UINT32(mipMap + 8);
+			_mipMaps.back()->data   = new byte[_mipMaps.back()->size];
+
+			std::memcpy(_mipMaps.back()->data, data + READ_LE_UINT32(mipMap + 12), _mipMaps.back()->size);
+		}
+	}
+};
+
+
+TextureCache::Key::Key() : _hash(0xCBF29CE484222325LL) {
+}
+
+void TextureCache::Key::add(Common::SeekableReadStream &stream) {
+	const size_t pos = stream.pos();
+
+	stream.seek(0);
+
+	byte buffer[4096];
+	size_t n;
+
+	while ((n = stream.read(buffer, sizeof(buffer))) > 0)
+		for (size_t i = 0; i < n; i++)
+			_hash = Common::hashFNV64(_hash, buffer[i]);
+
+	// Also hash the size, so that two concatenated streams can't collide with differently split ones
+	add((uint32) stream.size());
+
+	stream.seek(pos);
+}
+
+void TextureCache::Key::add(uint32 value) {
+	for (int i = 0; i < 4; i++, value >>= 8)
+		_hash = Common::hashFNV64(_hash, value & 0xFF);
+}
+
+uint64 TextureCache::Key::get() const {
+	return _hash;
+}
+
+
+TextureCache::Statistics::Statistics() : hits(0), misses(0), stored(0), failures(0), pruned(0),
+	hitTime(0), missTime(0) {
+
+}
+
+
+TextureCache::TextureCache() : _tempCount(0), _maxSize(0), _scanned(false), _size(0), _useCounter(0) {
+}
+
+TextureCache::~TextureCache() {
+}
+
+void TextureCache::setDirectory(const Common::UString &directory) {
+	Common::StackLock lock(_mutex);
+
+	_directory = directory;
+
+	_scanned = false;
+	_entries.clear();
+	_size = 0;
+}
+
+void TextureCache::setMaxSize(uint64 size) {
+	Common::StackLock lock(_mutex);
+
+	_maxSize = size;
+}
+
+bool TextureCache::isEnabled() const {
+	Common::StackLock lock(_mutex);
+
+	return !_directory.empty();
+}
+
+Common::UString TextureCache::getFileName(uint64 key) const {
+	return _directory + "/" + Common::UString::format("%08X%08X.xtc", (uint32) (key >> 32), (uint32) key);
+}
+
+ImageDecoder *TextureCache::find(const Key &key) {
+	const uint64 startTime = getTime();
+
+	Common::UString fileName;
+	{
+		Common::StackLock lock(_mutex);
+
+		if (_directory.empty())
+			return 0;
+
+		fileName = getFileName(key.get());
+	}
+
+	ImageDecoder *image = 0;
+	size_t size = 0;
+
+	if (Common::FilePath::isRegularFile(fileName)) {
+		try {
+			boost::shared_ptr<Common::MappedFile> file = Common::MappedFile::map(fileName);
+			if (file) {
+				image = new CachedImage(*file, key.get());
+				size  = file->size();
+			}
+
+		} catch (Common::Exception &e) {
+			e.add("Failed reading texture cache file \"%s\"", fileName.c_str());
+			Common::printException(e, "WARNING: ");
+
+			image = 0;
+		}
+	}
+
+	if (image)
+		Common::FilePath::touch(fileName);
+
+	Common::StackLock lock(_mutex);
+
+	if (image) {
+		_statistics.hits++;
+		_statistics.hitTime += getTime() - startTime;
+
+		if (_scanned)
+			use(Common::FilePath::getFile(fileName), size);
+	} else
+		_statistics.misses++;
+
+	return image;
+}
+
+void TextureCache::store(const Key &key, const ImageDecoder &image, uint64 decodeTime) {
+	Common::UString fileName, tempName;
+	{
+		Common::StackLock lock(_mutex);
+
+		_statistics.missTime += decodeTime;
+
+		if (_directory.empty())
+			return;
+
+		fileName = getFileName(key.get());
+		tempName = fileName + Common::UString::format(".%u.tmp", _tempCount++);
+	}
+
+	const size_t layerCount  = image.getLayerCount();
+	const size_t mipMapCount = image.getMipMapCount();
+
+	bool success = false;
+	uint64 size = 0;
+
+	try {
+		const TXI &txi = image.getTXI();
+
+		uint32 flags = 0;
+		if (image.isCompressed())
+			flags |= kFlagCompressed;
+		if (image.hasAlpha())
+			flags |= kFlagHasAlpha;
+		if (image.isCubeMap())
+			flags |= kFlagCubeMap;
+		if (!txi.empty())
+			flags |= kFlagHasTXI;
+
+		const uint32 txiOffset = kHeaderSize + layerCount * mipMapCount * kMipMapSize;
+		const uint32 txiSize   = std::strlen(txi.getSource().c_str());
+
+		Common::FilePath::createDirectories(_directory);
+
+		Common::WriteFile cache;
+		if (!cache.open(tempName))
+			throw Common::Exception(Common::kOpenError);
+
+		cache.writeUint32BE(kCacheID);
+		cache.writeUint32BE(kCacheVersion);
+		cache.writeUint32LE((uint32) key.get());
+		cache.writeUint32LE((uint32) (key.get() >> 32));
+		cache.writeUint32LE(flags);
+		cache.writeUint32LE((uint32) image.getFormat());
+		cache.writeUint32LE((uint32) image.getFormatRaw());
+		cache.writeUint32LE((uint32) image.getDataType());
+		cache.writeUint32LE(layerCount);
+		cache.writeUint32LE(layerCount * mipMapCount);
+		cache.writeUint32LE(txiOffset);
+		cache.writeUint32LE(txiSize);
+
+		uint32 offset = txiOffset + txiSize;
+		for (size_t i = 0; i < layerCount; i++) {
+			for (size_t j = 0; j < mipMapCount; j++) {
+				const ImageDecoder::MipMap &mipMap = image.getMipMap(j, i);
+
+				offset += (kDataAlignment - (offset % kDataAlignment)) % kDataAlignment;
+
+				cache.writeUint32LE(mipMap.width);
+				cache.writeUint32LE(mipMap.height);
+				cache.writeUint32LE(mipMap.size);
+				cache.writeUint32LE(offset);
+
+				offset += mipMap.size;
+			}
+		}
+
+		cache.write(txi.getSource().c_str(), txiSize);
+
+		static const byte kPadding[kDataAlignment] = { 0 };
+
+		offset = txiOffset + txiSize;
+		for (size_t i = 0; i < layerCount; i++) {
+			for (size_t j = 0; j < mipMapCount; j++) {
+				const ImageDecoder::MipMap &mipMap = image.getMipMap(j, i);
+
+				const uint32 padding = (kDataAlignment - (offset % kDataAlignment)) % kDataAlignment;
+
+				cache.write(kPadding, padding);
+				if (cache.write(mipMap.data, mipMap.size) != mipMap.size)
+					throw Common::Exception(Common::kWriteError);
+
+				offset += padding + mipMap.size;
+			}
+		}
+
+		size = offset;
+
+		cache.flush();
+		cache.close();
+
+		/* Only make the complete file visible, in case another thread or process is reading it.
+		 * If renaming fails because somebody else already stored the same image, that's fine. */
+		if (std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+			std::remove(tempName.c_str());
+
+			if (!Common::FilePath::isRegularFile(fileName))
+				throw Common::Exception("Can't rename \"%s\" to \"%s\"", tempName.c_str(), fileName.c_str());
+		}
+
+		success = true;
+
+	} catch (Common::Exception &e) {
+		std::remove(tempName.c_str());
+
+		e.add("Failed writing texture cache file \"%s\"", fileName.c_str());
+		Common::printException(e, "WARNING: ");
+	}
+
+	Common::StackLock lock(_mutex);
+
+	if (!success) {
+		_statistics.failures++;
+		return;
+	}
+
+	_statistics.stored++;
+
+	scan();
+	use(Common::FilePath::getFile(fileName), size);
+
+	if ((_maxSize > 0) && (_size > _maxSize))
+		prune(Common::FilePath::getFile(fileName));
+}
+
+ImageDecoder *TextureCache::get(const Key &key, const DecodeFunction &decode) {
+	ImageDecoder *image = find(key);
+	if (image)
+		return image;
+
+	const uint64 startTime = getTime();
+
+	image = decode();
+
+	store(key, *image, getTime() - startTime);
+
+	return image;
+}
+
+void TextureCache::scan() {
+	if (_scanned)
+		return;
+
+	_scanned = true;
+
+	_entries.clear();
+	_size = 0;
+
+	Common::FileList files;
+	files.addDirectory(_directory);
+
+	// The modification time of a file is the last time it was used in an earlier run
+	std::vector< std::pair<uint64, Common::UString> > used;
+	for (Common::FileList::const_iterator f = files.begin(); f != files.end(); ++f)
+		if (Common::FilePath::getExtension(*f) == ".xtc")
+			used.push_back(std::make_pair(Common::FilePath::getModificationTime(*f), *f));
+
+	std::sort(used.begin(), used.end());
+
+	for (std::vector< std::pair<uint64, Common::UString> >::const_iterator f = used.begin(); f != used.end(); ++f) {
+		const size_t size = Common::FilePath::getFileSize(f->second);
+		if (size == Common::kFileInvalid)
+			continue;
+
+		Entry &entry = _entries[Common::FilePath::getFile(f->second)];
+
+		entry.size    = size;
+		entry.lastUse = ++_useCounter;
+
+		_size += size;
+	}
+}
+
+void TextureCache::use(const Common::UString &file, uint64 size) {
+	EntryMap::iterator e = _entries.find(file);
+	if (e == _entries.end()) {
+		e = _entries.insert(std::make_pair(file, Entry())).first;
+
+		e->second.size = 0;
+	}
+
+	_size -= e->second.size;
+	_size += size;
+
+	e->second.size    = size;
+	e->second.lastUse = ++_useCounter;
+}
+
+void TextureCache::prune(const Common::UString &keep) {
+	std::vector< std::pair<uint64, Common::UString> > files;
+
+	files.reserve(_entries.size());
+	for (EntryMap::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+		if (e->first != keep)
+			files.push_back(std::make_pair(e->second.lastUse, e->first));
+
+	// Oldest first
+	std::sort(files.begin(), files.end());
+
+	for (size_t i = 0; (i < files.size()) && (_size > _maxSize); i++) {
+		EntryMap::iterator e = _entries.find(files[i].second);
+
+		const Common::UString fileName = _directory + "/" + e->first;
+
+		/* A reader might still be copying out of the file. On systems where
+		 * such a file can't be removed, we just try again next time. */
+		if (std::remove(fileName.c_str()) != 0) {
+			if (Common::FilePath::isRegularFile(fileName))
+				continue;
+		} else
+			_statistics.pruned++;
+
+		_size -= e->second.size;
+		_entries.erase(e);
+	}
+}
+
+TextureCache::Statistics TextureCache::getStatistics() const {
+	Common::StackLock lock(_mutex);
+
+	return _statistics;
+}
+
+uint64 TextureCache::getTime() {
+	const uint64 counter   = SDL_GetPerformanceCounter();
+	const uint64 frequency = SDL_GetPerformanceFrequency();
+
+	return (counter / frequency) * 1000000 + ((counter % frequency) * 1000000) / frequency;
+}
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
@@ -0,0 +1,178 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of decoded texture images.
+ */
+
+#ifndef GRAPHICS_AURORA_TEXTURECACHE_H
+#define GRAPHICS_AURORA_TEXTURECACHE_H
+
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/mutex.h"
+
+namespace Common {
+	class SeekableReadStream;
+}
+
+namespace Graphics {
+
+class ImageDecoder;
+
+namespace Aurora {
+
+/** A persistent on-disk cache of decoded texture images.
+ *
+ *  Several image formats need quite a bit of work before their data can
+ *  be uploaded to the graphics card: deswizzling, flipping, expanding
+ *  palettes or combining tiles. The TextureCache stores the final,
+ *  upload-ready mip maps of such images, together with their embedded
+ *  TXI, so that later runs can skip the decoding entirely.
+ *
+ *  Each image is stored in a file of its own, named after its key. The
+ *  key is a hash over all the data the image was decoded from, and over
+ *  everything else that influences the decoding. The files are
+ *  memory-mapped when read, and the mip maps copied straight out of the
+ *  mapping.
+ *
+ *  All cache files together are kept within a size budget. When storing
+ *  an image pushes the cache over it, the least recently used files are
+ *  removed. Reading a file from the cache updates its modification time,
+ *  so that this order persists across runs.
+ *
+ *  The cache is thread-safe.
+ */
+class TextureCache : boost::noncopyable {
+public:
+	/** The key identifying an image in the cache. */
+	class Key {
+	public:
+		Key();
+
+		/** Add the whole contents of a stream. Its position stays unchanged. */
+		void add(Common::SeekableReadStream &stream);
+		/** Add a value that influences the decoding. */
+		void add(uint32 value);
+
+		/** Return the hash value of the key. */
+		uint64 get() const;
+
+	private:
+		uint64 _hash;
+	};
+
+	/** Decode an image, returning a new ImageDecoder. */
+	typedef boost::function<ImageDecoder *()> DecodeFunction;
+
+	/** Statistics about the cache's usage. */
+	struct Statistics {
+		uint32 hits;     ///< Number of images found in the cache.
+		uint32 misses;   ///< Number of images that had to be decoded.
+		uint32 stored;   ///< Number of images written to the cache.
+		uint32 failures; ///< Number of images that couldn't be written to the cache.
+		uint32 pruned;   ///< Number of images removed to stay within the size budget.
+
+		uint64 hitTime;  ///< Total time spent reading cached images, in microseconds.
+		uint64 missTime; ///< Total time spent decoding uncached images, in microseconds.
+
+		Statistics();
+	};
+
+	TextureCache();
+	~TextureCache();
+
+	/** Set the directory the cache files are kept in. An empty directory disables the cache. */
+	void setDirectory(const Common::UString &directory);
+
+	/** Set the maximum size of all cache files together, in bytes. 0 means no limit. */
+	void setMaxSize(uint64 size);
+
+	/** Is the cache enabled? */
+	bool isEnabled() const;
+
+	/** Get an image, either out of the cache or by decoding it.
+	 *
+	 *  If the image is not in the cache, it is decoded and then stored in
+	 *  the cache. If the cache is disabled, the image is just decoded.
+	 *
+	 *  @param  key The key identifying the image.
+	 *  @param  decode The function decoding the image.
+	 *  @return The image. Throws if decoding failed.
+	 */
+	ImageDecoder *get(const Key &key, const DecodeFunction &decode);
+
+	/** Return the cache's usage statistics. */
+	Statistics getStatistics() const;
+
+private:
+	/** A file in the cache. */
+	struct Entry {
+		uint64 size;    ///< The size of the file in bytes.
+		uint64 lastUse; ///< When the file was last used, as a value of _useCounter.
+	};
+
+	/** All cache files, by file name without the directory. */
+	typedef std::map<Common::UString, Entry> EntryMap;
+
+	Common::UString _directory; ///< The directory the cache files are kept in.
+
+	uint32 _tempCount; ///< Number of temporary files created so far.
+
+	uint64 _maxSize; ///< The maximum size of all cache files together.
+
+	bool     _scanned; ///< Have the files in the directory been collected yet?
+	EntryMap _entries; ///< All files in the cache.
+	uint64   _size;    ///< The size of all files in the cache.
+
+	uint64 _useCounter; ///< Counting up with each use of a cache file.
+
+	Statistics _statistics;
+
+	mutable Common::Mutex _mutex;
+
+	Common::UString getFileName(uint64 key) const;
+
+	/** Look up an image in the cache, returning 0 if it's not in there. */
+	ImageDecoder *find(const Key &key);
+	/** Add a freshly decoded image, which took decodeTime microseconds, to the cache. */
+	void store(const Key &key, const ImageDecoder &image, uint64 decodeTime);
+
+	/** Collect all files in the cache directory, if that hasn't happened yet. */
+	void scan();
+	/** Note that this cache file has just been used. */
+	void use(const Common::UString &file, uint64 size);
+	/** Remove the least recently used files, except keep, until the cache is within its budget again. */
+	void prune(const Common::UString &keep);
+
+	/** Return the current time, in microseconds, for measuring decoding times. */
+	static uint64 getTime();
+};
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_AURORA_TEXTURECACHE_H
@@ -26,6 +26,7 @@
 #define GRAPHICS_AURORA_TEXTUREHANDLE_H
 
 #include <map>
+#include <list>
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
@@ -35,18 +36,28 @@ namespace Graphics {
 namespace Aurora {
 
 class Texture;
+struct ManagedTexture;
+
+typedef std::map<Common::UString, ManagedTexture *> TextureMap;
+typedef std::list<TextureMap::iterator> TextureList;
 
 /** A managed texture, storing how often it's referenced. */
 struct ManagedTexture {
 	Texture *texture;
 	uint32 referenceCount;
 
+	/** Was the texture given a generated name, so that nobody can ask for it again? */
+	bool anonymous;
+
+	/** Is the texture unreferenced, but kept around in case it's needed again? */
+	bool unused;
+	/** The texture's position in the list of unused textures. */
+	TextureList::iterator unusedPosition;
+
 	ManagedTexture(Texture *t);
 	~ManagedTexture();
 };
 
-typedef std::map<Common::UString, ManagedTexture *> TextureMap;
-
 /** A handle to a texture. */
 class TextureHandle {
 public:
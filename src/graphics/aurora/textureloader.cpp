@@ -0,0 +1,330 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Decoding textures in the background.
+ */
+
+#include <cassert>
+
+#include <algorithm>
+
+#include "src/common/util.h"
+#include "src/common/thread.h"
+#include "src/common/readstream.h"
+
+#include "src/graphics/images/decoder.h"
+#include "src/graphics/images/txi.h"
+
+#include "src/graphics/aurora/textureloader.h"
+#include "src/graphics/aurora/texture.h"
+
+#include "src/events/events.h"
+
+namespace Graphics {
+
+namespace Aurora {
+
+TextureLoadJob::TextureLoadJob(const Common::UString &name) : _name(name),
+	_state(kStateQueued), _queueTime(0), _type(::Aurora::kFileTypeNone),
+	_txi(0), _image(0), _plt(0), _failed(false), _cancelled(false), _finished(_mutex) {
+
+	_done.store(false);
+}
+
+TextureLoadJob::~TextureLoadJob() {
+	delete _txi;
+	delete _image;
+	delete _plt;
+}
+
+const Common::UString &TextureLoadJob::getName() const {
+	return _name;
+}
+
+bool TextureLoadJob::isDone() const {
+	return _done.load();
+}
+
+bool TextureLoadJob::isCancelled() const {
+	return _done.load() && _cancelled;
+}
+
+void TextureLoadJob::wait() {
+	Common::StackLock lock(_mutex);
+
+	while (!_done.load())
+		_finished.wait(100);
+}
+
+void TextureLoadJob::take(::Aurora::FileType &type, TXI *&txi, ImageDecoder *&image,
+                          Common::SeekableReadStream *&plt) {
+
+	assert(_done.load());
+
+	if (_failed)
+		throw _error;
+
+	type  = _type;
+	txi   = _txi;
+	image = _image;
+	plt   = _plt;
+
+	_txi   = 0;
+	_image = 0;
+	_plt   = 0;
+}
+
+
+TextureLoader::Statistics::Statistics() : threads(0), queued(0), decoding(0), decoded(0), failed(0),
+	lastLatency(0), maxLatency(0), totalLatency(0) {
+
+}
+
+
+class TextureLoader::Worker : public Common::Thread {
+public:
+	Worker(TextureLoader &loader) : _loader(&loader) {
+	}
+
+	~Worker() {
+		destroyThread();
+	}
+
+private:
+	TextureLoader *_loader;
+
+	void threadMethod() {
+		while (!_killThread)
+			_loader->runJob();
+	}
+};
+
+
+TextureLoader::TextureLoader() : _newJob(_mutex), _idle(_mutex) {
+}
+
+TextureLoader::~TextureLoader() {
+	cancel();
+	destroyWorkers();
+}
+
+void TextureLoader::setThreadCount(size_t count) {
+	if (count == _workers.size())
+		return;
+
+	cancel();
+	destroyWorkers();
+
+	for (size_t i = 0; i < count; i++) {
+		Worker *worker = new Worker(*this);
+		if (!worker->createThread()) {
+			delete worker;
+
+			warning("TextureLoader: Failed to create worker thread");
+			break;
+		}
+
+		_workers.push_back(worker);
+	}
+
+	Common::StackLock lock(_mutex);
+	_statistics.threads = _workers.size();
+}
+
+void TextureLoader::destroyWorkers() {
+	for (std::list<Worker *>::iterator w = _workers.begin(); w != _workers.end(); ++w)
+		delete *w;
+
+	_workers.clear();
+}
+
+bool TextureLoader::isEnabled() const {
+	return !_workers.empty();
+}
+
+TextureLoader::JobPtr TextureLoader::queue(const Common::UString &name) {
+	JobPtr job(new TextureLoadJob(name));
+
+	job->_queueTime = EventMan.getTimestamp();
+
+	_queue.push_back(job);
+	_statistics.queued++;
+
+	_newJob.signal();
+
+	return job;
+}
+
+void TextureLoader::removeFromQueue(const JobPtr &job) {
+	std::deque<JobPtr>::iterator j = std::find(_queue.begin(), _queue.end(), job);
+	if (j == _queue.end())
+		return;
+
+	_queue.erase(j);
+	_statistics.queued--;
+}
+
+void TextureLoader::preload(const Common::UString &name) {
+	if (!isEnabled())
+		return;
+
+	Common::StackLock lock(_mutex);
+
+	if (_preloaded.find(name) != _preloaded.end())
+		return;
+
+	_preloaded.insert(std::make_pair(name, queue(name)));
+}
+
+TextureLoader::JobPtr TextureLoader::take(const Common::UString &name) {
+	Common::StackLock lock(_mutex);
+
+	JobMap::iterator p = _preloaded.find(name);
+	if (p == _preloaded.end())
+		return JobPtr();
+
+	JobPtr job = p->second;
+	_preloaded.erase(p);
+
+	if (job->_state == TextureLoadJob::kStateQueued) {
+		// Not started yet. Decoding it directly is faster than waiting for it
+		removeFromQueue(job);
+		return JobPtr();
+	}
+
+	return job;
+}
+
+TextureLoader::JobPtr TextureLoader::load(const Common::UString &name) {
+	Common::StackLock lock(_mutex);
+
+	JobMap::iterator p = _preloaded.find(name);
+	if (p != _preloaded.end()) {
+		JobPtr job = p->second;
+		_preloaded.erase(p);
+
+		return job;
+	}
+
+	return queue(name);
+}
+
+void TextureLoader::cancel() {
+	Common::StackLock lock(_mutex);
+
+	/* Jobs handed out by load() might still be waited on, so we can't just drop
+	 * them. Instead, they're marked as cancelled and finished. */
+
+	while (!_queue.empty()) {
+		JobPtr job = _queue.front();
+		_queue.pop_front();
+
+		_statistics.queued--;
+
+		job->_state     = TextureLoadJob::kStateDone;
+		job->_failed    = true;
+		job->_cancelled = true;
+		job->_error     = Common::Exception("Loading texture \"%s\" was cancelled", job->_name.c_str());
+
+		finishJob(*job);
+	}
+
+	_preloaded.clear();
+
+	// And wait for the jobs being decoded right now
+	while (_statistics.decoding > 0)
+		_idle.wait(100);
+}
+
+TextureLoader::Statistics TextureLoader::getStatistics() const {
+	Common::StackLock lock(_mutex);
+
+	return _statistics;
+}
+
+void TextureLoader::runJob() {
+	JobPtr job;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (_queue.empty())
+			_newJob.wait(100);
+
+		if (_queue.empty())
+			return;
+
+		job = _queue.front();
+		_queue.pop_front();
+
+		job->_state = TextureLoadJob::kStateDecoding;
+
+		_statistics.queued--;
+		_statistics.decoding++;
+	}
+
+	try {
+		Texture::load(job->_name, job->_type, job->_txi, job->_image, job->_plt);
+	} catch (Common::Exception &e) {
+		job->_failed = true;
+		job->_error  = e;
+	} catch (std::exception &e) {
+		job->_failed = true;
+		job->_error  = Common::Exception(e);
+	} catch (...) {
+		job->_failed = true;
+		job->_error  = Common::Exception("Unknown exception");
+	}
+
+	const uint32 latency = EventMan.getTimestamp() - job->_queueTime;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		job->_state = TextureLoadJob::kStateDone;
+
+		_statistics.decoding--;
+
+		if (job->_failed)
+			_statistics.failed++;
+		else
+			_statistics.decoded++;
+
+		_statistics.lastLatency   = latency;
+		_statistics.maxLatency    = MAX(_statistics.maxLatency, latency);
+		_statistics.totalLatency += latency;
+
+		_idle.broadcast();
+	}
+
+	finishJob(*job);
+}
+
+void TextureLoader::finishJob(TextureLoadJob &job) {
+	Common::StackLock lock(job._mutex);
+
+	job._done.store(true);
+	job._finished.broadcast();
+}
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
@@ -0,0 +1,210 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Decoding textures in the background.
+ */
+
+#ifndef GRAPHICS_AURORA_TEXTURELOADER_H
+#define GRAPHICS_AURORA_TEXTURELOADER_H
+
+#include <list>
+#include <deque>
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/atomic.h"
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/mutex.h"
+#include "src/common/error.h"
+
+#include "src/aurora/types.h"
+
+namespace Common {
+	class SeekableReadStream;
+}
+
+namespace Graphics {
+
+class ImageDecoder;
+class TXI;
+
+namespace Aurora {
+
+class TextureLoader;
+
+/** A texture resource that is decoded in the background. */
+class TextureLoadJob : boost::noncopyable {
+public:
+	TextureLoadJob(const Common::UString &name);
+	~TextureLoadJob();
+
+	/** Return the name of the texture resource. */
+	const Common::UString &getName() const;
+
+	/** Has the decoding finished, successfully or not? */
+	bool isDone() const;
+	/** Was the job cancelled before a worker thread started decoding it? */
+	bool isCancelled() const;
+	/** Wait until the decoding has finished. */
+	void wait();
+
+	/** Take over the decoded data. Throws if the decoding failed.
+	 *
+	 *  PLT files aren't decoded, since they need to be their own kind of texture.
+	 *  Their raw data is returned in the plt stream instead.
+	 */
+	void take(::Aurora::FileType &type, TXI *&txi, ImageDecoder *&image, Common::SeekableReadStream *&plt);
+
+private:
+	enum State {
+		kStateQueued,   ///< Waiting for a worker thread.
+		kStateDecoding, ///< Being decoded by a worker thread.
+		kStateDone      ///< Finished.
+	};
+
+	Common::UString _name;
+
+	State _state;
+	uint32 _queueTime; ///< Timestamp of when the job was queued.
+
+	::Aurora::FileType _type;
+	TXI *_txi;
+	ImageDecoder *_image;
+	Common::SeekableReadStream *_plt;
+
+	bool _failed;
+	bool _cancelled;
+	Common::Exception _error;
+
+	boost::atomic<bool> _done;
+
+	Common::Mutex     _mutex;
+	Common::Condition _finished;
+
+	friend class TextureLoader;
+};
+
+/** A pool of worker threads decoding textures in the background.
+ *
+ *  Reading and decoding a texture image can take a long time, especially
+ *  when it has to be decompressed. A game loading an area full of models
+ *  would then spend most of its time waiting for textures, one after the
+ *  other.
+ *
+ *  The TextureLoader decodes textures on worker threads instead. The
+ *  resulting jobs are either kept until the texture is actually requested,
+ *  or handed out right away to be adopted by a placeholder texture once
+ *  they are done.
+ */
+class TextureLoader : boost::noncopyable {
+public:
+	typedef boost::shared_ptr<TextureLoadJob> JobPtr;
+
+	/** Statistics about the background decoding. */
+	struct Statistics {
+		size_t threads; ///< Number of worker threads.
+
+		size_t queued;   ///< Number of textures waiting to be decoded.
+		size_t decoding; ///< Number of textures being decoded right now.
+
+		uint32 decoded; ///< Number of textures successfully decoded.
+		uint32 failed;  ///< Number of textures that failed to decode.
+
+		uint32 lastLatency;  ///< Time in ms from queueing to finish for the last texture.
+		uint32 maxLatency;   ///< Maximum time in ms from queueing to finish.
+		uint64 totalLatency; ///< Sum of all times in ms from queueing to finish.
+
+		Statistics();
+	};
+
+	TextureLoader();
+	~TextureLoader();
+
+	/** Set the number of worker threads. 0 disables background decoding. */
+	void setThreadCount(size_t count);
+
+	/** Is background decoding enabled? */
+	bool isEnabled() const;
+
+	/** Start decoding this texture in the background, to be picked up with take() later. */
+	void preload(const Common::UString &name);
+
+	/** Take a preloaded texture out of the loader.
+	 *
+	 *  If the texture is still waiting for a worker thread, it is dropped and
+	 *  an empty pointer is returned. The caller can then decode the texture
+	 *  itself, instead of waiting for it.
+	 */
+	JobPtr take(const Common::UString &name);
+
+	/** Decode this texture in the background, returning the job right away.
+	 *
+	 *  If the texture is already being preloaded, that job is returned instead.
+	 */
+	JobPtr load(const Common::UString &name);
+
+	/** Cancel all waiting jobs, drop all finished jobs not yet picked up,
+	 *  and wait for the jobs currently being decoded.
+	 *
+	 *  Cancelled jobs handed out by load() are marked as done, without any
+	 *  decoded data. Their owner has to decode the texture itself.
+	 */
+	void cancel();
+
+	/** Return the current statistics. */
+	Statistics getStatistics() const;
+
+private:
+	class Worker;
+
+	typedef std::map<Common::UString, JobPtr> JobMap;
+
+	std::list<Worker *> _workers;
+
+	std::deque<JobPtr> _queue; ///< Jobs waiting for a worker thread.
+	JobMap _preloaded;         ///< Preloaded jobs not yet taken.
+
+	Statistics _statistics;
+
+	mutable Common::Mutex _mutex;
+	Common::Condition     _newJob;
+	Common::Condition     _idle;
+
+	void destroyWorkers();
+
+	JobPtr queue(const Common::UString &name);
+	void removeFromQueue(const JobPtr &job);
+
+	/** Wait for a job and run it. Called by the worker threads. */
+	void runJob();
+
+	/** Mark the job as done and wake up everybody waiting for it. */
+	static void finishJob(TextureLoadJob &job);
+};
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_AURORA_TEXTURELOADER_H
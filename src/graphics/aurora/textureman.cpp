@@ -25,6 +25,8 @@
 #include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/uuid.h"
+#include "src/common/configman.h"
+#include "src/common/filepath.h"
 
 #include "src/graphics/aurora/textureman.h"
 #include "src/graphics/aurora/texture.h"
@@ -35,6 +37,8 @@
 
 #include "src/events/requests.h"
 
+#include "src/aurora/resman.h"
+
 DECLARE_SINGLETON(Graphics::Aurora::TextureManager)
 
 namespace Graphics {
@@ -79,7 +83,24 @@ static GLenum kTextureUnit[] = {
 static const size_t kTextureUnitCount = ARRAYSIZE(kTextureUnit);
 
 
-TextureManager::TextureManager() : _recordNewTextures(false) {
+TextureManager::MemoryStatistics::MemoryStatistics() : textures(0), unusedTextures(0),
+	textureMemory(0), unusedMemory(0), imageMemory(0), textureBudget(0), imageBudget(0), evictions(0) {
+}
+
+
+TextureManager::TextureManager() : _textureBudget(0), _imageBudget(0),
+	_textureMemory(0), _imageMemory(0), _evictions(0), _recordNewTextures(false) {
+
+	// Budgets are configured in MB
+	_textureBudget = ((size_t) MAX(ConfigMan.getInt("texturebudget"     , 256), 0)) * 1024 * 1024;
+	_imageBudget   = ((size_t) MAX(ConfigMan.getInt("textureimagebudget",   0), 0)) * 1024 * 1024;
+
+	if (ConfigMan.getBool("texturecache", false))
+		_cache.setDirectory(Common::FilePath::getUserDataFile("texturecache"));
+
+	_cache.setMaxSize(((uint64) MAX(ConfigMan.getInt("texturecachesize", 1024), 0)) * 1024 * 1024);
+
+	_loader.setThreadCount(MAX(ConfigMan.getInt("texturethreads", 2), 0));
 }
 
 TextureManager::~TextureManager() {
@@ -89,7 +110,10 @@ TextureManager::~TextureManager() {
 void TextureManager::clear() {
 	Common::StackLock lock(_mutex);
 
+	_loader.cancel();
+
 	_bogusTextures.clear();
+	_unusedTextures.clear();
 
 	for (TextureMap::iterator t = _textures.begin(); t != _textures.end(); ++t)
 		delete t->second;
@@ -127,11 +151,18 @@ TextureHandle TextureManager::add(Texture *texture, Common::UString name) {
 	ManagedTexture *managedTexture = 0;
 	TextureMap::iterator textureIterator = _textures.end();
 
-	if (name.empty())
+	const bool anonymous = name.empty();
+	if (anonymous)
 		name = Common::generateIDRandomString();
 
+	// An unused texture of the same name is only kept around for get(), so it can make way
+	TextureMap::iterator unused = _textures.find(name);
+	if ((unused != _textures.end()) && unused->second->unused)
+		remove(unused);
+
 	try {
 		managedTexture = new ManagedTexture(texture);
+		managedTexture->anonymous = anonymous;
 
 		std::pair<TextureMap::iterator, bool> result;
 
@@ -162,7 +193,12 @@ TextureHandle TextureManager::get(Common::UString name) {
 	if (texture == _textures.end()) {
 		std::pair<TextureMap::iterator, bool> result;
 
-		ManagedTexture *managedTexture = new ManagedTexture(Texture::create(name));
+		// Pick up the texture if it has been preloaded
+		TextureLoader::JobPtr job = _loader.take(name);
+		if (job)
+			job->wait();
+
+		ManagedTexture *managedTexture = new ManagedTexture(job ? Texture::create(name, *job) : Texture::create(name));
 
 		if (managedTexture->texture->isDynamic())
 			name = name + "#" + Common::generateIDRandomString();
@@ -170,6 +206,16 @@ TextureHandle TextureManager::get(Common::UString name) {
 		result = _textures.insert(std::make_pair(name, managedTexture));
 
 		texture = result.first;
+
+		// The new texture might push the unused ones over the budget
+		evict();
+
+	} else {
+		markUsed(texture);
+
+		if (texture->second->texture->isPending())
+			// A placeholder for a texture loaded in the background. We need the real data now
+			texture->second->texture->finishLoading();
 	}
 
 	if (_recordNewTextures)
@@ -178,6 +224,61 @@ TextureHandle TextureManager::get(Common::UString name) {
 	return TextureHandle(texture);
 }
 
+TextureHandle TextureManager::getAsync(Common::UString name) {
+	Common::StackLock lock(_mutex);
+
+	if (_bogusTextures.find(name) != _bogusTextures.end())
+		return TextureHandle();
+
+	TextureMap::iterator texture = _textures.find(name);
+	if (texture != _textures.end()) {
+		markUsed(texture);
+
+		if (_recordNewTextures)
+			_newTextureNames.push_back(name);
+
+		return TextureHandle(texture);
+	}
+
+	// PLT textures are dynamic and need their own Texture class, so we can't create a placeholder
+	if (!_loader.isEnabled() || ResMan.hasResource(name, ::Aurora::kFileTypePLT))
+		return get(name);
+
+	ManagedTexture *managedTexture = new ManagedTexture(Texture::createPending(name, _loader.load(name)));
+
+	texture = _textures.insert(std::make_pair(name, managedTexture)).first;
+
+	if (_recordNewTextures)
+		_newTextureNames.push_back(name);
+
+	return TextureHandle(texture);
+}
+
+void TextureManager::preload(const std::vector<Common::UString> &names) {
+	Common::StackLock lock(_mutex);
+
+	if (!_loader.isEnabled())
+		return;
+
+	for (std::vector<Common::UString>::const_iterator n = names.begin(); n != names.end(); ++n) {
+		if (n->empty() || (_bogusTextures.find(*n) != _bogusTextures.end()))
+			continue;
+
+		if (_textures.find(*n) != _textures.end())
+			continue;
+
+		_loader.preload(*n);
+	}
+}
+
+TextureLoader::Statistics TextureManager::getLoaderStatistics() const {
+	return _loader.getStatistics();
+}
+
+TextureCache &TextureManager::getCache() {
+	return _cache;
+}
+
 TextureHandle TextureManager::getIfExist(const Common::UString &name) {
 	Common::StackLock lock(_mutex);
 
@@ -185,8 +286,11 @@ TextureHandle TextureManager::getIfExist(const Common::UString &name) {
 		return TextureHandle();
 
 	TextureMap::iterator texture = _textures.find(name);
-	if (texture != _textures.end())
+	if (texture != _textures.end()) {
+		markUsed(texture);
+
 		return TextureHandle(texture);
+	}
 
 	return TextureHandle();
 }
@@ -222,8 +326,17 @@ void TextureManager::release(TextureHandle &texture) {
 
 	if (!texture._empty && (texture._it != _textures.end())) {
 		if (--texture._it->second->referenceCount == 0) {
-			delete texture._it->second;
-			_textures.erase(texture._it);
+			ManagedTexture &managed = *texture._it->second;
+
+			/* Keep textures that can be requested again around, in case they are.
+			 * Models and GUIs are often destroyed only to be recreated soon after. */
+			if ((_textureBudget > 0) && !managed.anonymous && !managed.texture->isDynamic()) {
+				managed.unused         = true;
+				managed.unusedPosition = _unusedTextures.insert(_unusedTextures.end(), texture._it);
+
+				evict();
+			} else
+				remove(texture._it);
 		}
 	}
 
@@ -231,6 +344,64 @@ void TextureManager::release(TextureHandle &texture) {
 	texture._it    = _textures.end();
 }
 
+void TextureManager::markUsed(TextureMap::iterator texture) {
+	ManagedTexture &managed = *texture->second;
+	if (!managed.unused)
+		return;
+
+	_unusedTextures.erase(managed.unusedPosition);
+	managed.unused = false;
+}
+
+void TextureManager::evict() {
+	while (!_unusedTextures.empty() && (_textureMemory.load() > _textureBudget)) {
+		remove(_unusedTextures.front());
+
+		_evictions++;
+	}
+}
+
+void TextureManager::remove(TextureMap::iterator texture) {
+	markUsed(texture);
+
+	delete texture->second;
+	_textures.erase(texture);
+}
+
+void TextureManager::updateMemory(size_t oldMemory, size_t newMemory, size_t oldImage, size_t newImage) {
+	_textureMemory += newMemory;
+	_textureMemory -= oldMemory;
+
+	_imageMemory += newImage;
+	_imageMemory -= oldImage;
+}
+
+bool TextureManager::isOverImageBudget() const {
+	return _imageMemory.load() > _imageBudget;
+}
+
+TextureManager::MemoryStatistics TextureManager::getMemoryStatistics() {
+	Common::StackLock lock(_mutex);
+
+	MemoryStatistics stats;
+
+	stats.textures       = _textures.size();
+	stats.unusedTextures = _unusedTextures.size();
+
+	stats.textureMemory = _textureMemory.load();
+	stats.imageMemory   = _imageMemory.load();
+
+	for (TextureList::const_iterator t = _unusedTextures.begin(); t != _unusedTextures.end(); ++t)
+		stats.unusedMemory += (*t)->second->texture->getMemorySize();
+
+	stats.textureBudget = _textureBudget;
+	stats.imageBudget   = _imageBudget;
+
+	stats.evictions = _evictions;
+
+	return stats;
+}
+
 void TextureManager::reloadAll() {
 	Common::StackLock lock(_mutex);
 
@@ -282,11 +453,17 @@ void TextureManager::set(const TextureHandle &handle, TextureMode mode) {
 		return;
 	}
 
+	// Not loaded or not uploaded yet
+	if (handle._it->second->texture->isPending()) {
+		set();
+		return;
+	}
+
 	TextureID id = handle._it->second->texture->getID();
 	if (id == 0)
 		warning("Empty texture ID for texture \"%s\"", handle._it->first.c_str());
 
-	if (handle._it->second->texture->getImage().isCubeMap()) {
+	if (handle._it->second->texture->isCubeMap()) {
 		glBindTexture(GL_TEXTURE_CUBE_MAP, id);
 
 		glDisable(GL_TEXTURE_2D);
@@ -300,7 +477,7 @@ void TextureManager::set(const TextureHandle &handle, TextureMode mode) {
 
 	switch (mode) {
 		case kModeEnvironmentMapReflective:
-			if (handle._it->second->texture->getImage().isCubeMap()) {
+			if (handle._it->second->texture->isCubeMap()) {
 				glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
 				glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
 				glTexGeni(GL_R, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
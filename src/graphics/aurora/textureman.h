@@ -27,6 +27,9 @@
 
 #include <set>
 #include <list>
+#include <vector>
+
+#include "src/common/atomic.h"
 
 #include "src/common/types.h"
 #include "src/common/singleton.h"
@@ -34,6 +37,8 @@
 #include "src/common/ustring.h"
 
 #include "src/graphics/aurora/texturehandle.h"
+#include "src/graphics/aurora/textureloader.h"
+#include "src/graphics/aurora/texturecache.h"
 
 namespace Graphics {
 
@@ -48,6 +53,23 @@ public:
 		kModeEnvironmentMapReflective ///< A reflective environment map.
 	};
 
+	/** Statistics about the memory the textures use. */
+	struct MemoryStatistics {
+		size_t textures;       ///< Number of managed textures.
+		size_t unusedTextures; ///< Number of unreferenced textures kept around.
+
+		size_t textureMemory; ///< Approximate graphics memory used by all textures.
+		size_t unusedMemory;  ///< Approximate graphics memory used by unreferenced textures.
+		size_t imageMemory;   ///< Memory used by decoded images kept around after uploading.
+
+		size_t textureBudget; ///< Graphics memory above which unreferenced textures are evicted.
+		size_t imageBudget;   ///< Memory above which decoded images are dropped after uploading.
+
+		uint32 evictions; ///< Number of unreferenced textures evicted to stay within the budget.
+
+		MemoryStatistics();
+	};
+
 	TextureManager();
 	~TextureManager();
 
@@ -71,6 +93,27 @@ public:
 	/** Retrieve this named texture, returning an empty handle if it's not managed. */
 	TextureHandle getIfExist(const Common::UString &name);
 
+	/** Retrieve this named texture, loading it in the background if it's not yet managed.
+	 *
+	 *  The returned texture is only a placeholder until the loading has finished.
+	 *  It has no image, no TXI and a size of 0x0, and it is rendered as untextured.
+	 *  This is only useful for callers that don't need to look at the texture's
+	 *  properties right away.
+	 */
+	TextureHandle getAsync(Common::UString name);
+
+	/** Start loading these textures in the background, ahead of their use by get(). */
+	void preload(const std::vector<Common::UString> &names);
+
+	/** Return the statistics of the background texture loading. */
+	TextureLoader::Statistics getLoaderStatistics() const;
+
+	/** Return the on-disk cache of decoded texture images. */
+	TextureCache &getCache();
+
+	/** Return statistics about the memory the textures use. */
+	MemoryStatistics getMemoryStatistics();
+
 	/** Start recording all names of newly created textures. */
 	void startRecordNewTextures();
 	/** Stop the recording of texture names, and return a list of previously recorded names. */
@@ -95,8 +138,22 @@ public:
 private:
 	TextureMap _textures;
 
+	/** Unreferenced textures, kept around in case they're needed again. Least recently used first. */
+	TextureList _unusedTextures;
+
+	size_t _textureBudget; ///< Graphics memory above which unreferenced textures are evicted.
+	size_t _imageBudget;   ///< Memory above which decoded images are dropped after uploading.
+
+	boost::atomic<size_t> _textureMemory; ///< Approximate graphics memory used by all textures.
+	boost::atomic<size_t> _imageMemory;   ///< Memory used by all decoded images.
+
+	uint32 _evictions;
+
 	std::set<Common::UString> _bogusTextures;
 
+	TextureCache  _cache;
+	TextureLoader _loader;
+
 	Common::Mutex _mutex;
 
 	bool _recordNewTextures;
@@ -105,7 +162,20 @@ private:
 	void assign(TextureHandle &texture, const TextureHandle &from);
 	void release(TextureHandle &texture);
 
+	/** A texture is being referenced again, remove it from the list of unused textures. */
+	void markUsed(TextureMap::iterator texture);
+	/** Delete unused textures, least recently used first, until we're within the budget again. */
+	void evict();
+	/** Delete this managed texture. */
+	void remove(TextureMap::iterator texture);
+
+	/** Update the memory statistics. Called by the textures themselves. */
+	void updateMemory(size_t oldMemory, size_t newMemory, size_t oldImage, size_t newImage);
+	/** Are the decoded images using more memory than they're allowed to? */
+	bool isOverImageBudget() const;
+
 	friend class TextureHandle;
+	friend class Texture;
 };
 
 } // End of namespace Aurora
@@ -0,0 +1,118 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A view frustum, for culling objects outside the visible area.
+ */
+
+#include <cmath>
+
+#include "src/common/matrix4x4.h"
+#include "src/common/boundingbox.h"
+
+#include "src/graphics/frustum.h"
+
+namespace Graphics {
+
+Frustum::Frustum() {
+	// Default to planes that contain everything
+	for (int i = 0; i < kPlaneMAX; i++) {
+		_planes[i][0] = 0.0f;
+		_planes[i][1] = 0.0f;
+		_planes[i][2] = 0.0f;
+		_planes[i][3] = 1.0f;
+	}
+}
+
+Frustum::~Frustum() {
+}
+
+void Frustum::set(const Common::Matrix4x4 &projection, const Common::Matrix4x4 &modelview) {
+	const Common::Matrix4x4 clip = projection * modelview;
+
+	for (int i = 0; i < 4; i++) {
+		const float row0 = clip(0, i);
+		const float row1 = clip(1, i);
+		const float row2 = clip(2, i);
+		const float row3 = clip(3, i);
+
+		_planes[kPlaneLeft  ][i] = row3 + row0;
+		_planes[kPlaneRight ][i] = row3 - row0;
+		_planes[kPlaneBottom][i] = row3 + row1;
+		_planes[kPlaneTop   ][i] = row3 - row1;
+		_planes[kPlaneNear  ][i] = row3 + row2;
+		_planes[kPlaneFar   ][i] = row3 - row2;
+	}
+
+	for (int i = 0; i < kPlaneMAX; i++)
+		normalizePlane(_planes[i]);
+}
+
+void Frustum::normalizePlane(float *plane) {
+	const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+	if (length == 0.0f)
+		return;
+
+	plane[0] /= length;
+	plane[1] /= length;
+	plane[2] /= length;
+	plane[3] /= length;
+}
+
+bool Frustum::isIn(float x, float y, float z) const {
+	for (int i = 0; i < kPlaneMAX; i++) {
+		const float *plane = _planes[i];
+
+		if ((plane[0] * x + plane[1] * y + plane[2] * z + plane[3]) < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::isIn(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const {
+	for (int i = 0; i < kPlaneMAX; i++) {
+		const float *plane = _planes[i];
+
+		/* Check the corner of the box that lies farthest along the plane's normal.
+		 * If even that one is behind the plane, the whole box is outside. */
+		const float x = (plane[0] >= 0.0f) ? maxX : minX;
+		const float y = (plane[1] >= 0.0f) ? maxY : minY;
+		const float z = (plane[2] >= 0.0f) ? maxZ : minZ;
+
+		if ((plane[0] * x + plane[1] * y + plane[2] * z + plane[3]) < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::isIn(const Common::BoundingBox &box) const {
+	if (box.empty())
+		return true;
+
+	float minX, minY, minZ, maxX, maxY, maxZ;
+	box.getMin(minX, minY, minZ);
+	box.getMax(maxX, maxY, maxZ);
+
+	return isIn(minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+} // End of namespace Graphics
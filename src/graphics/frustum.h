@@ -0,0 +1,77 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A view frustum, for culling objects outside the visible area.
+ */
+
+#ifndef GRAPHICS_FRUSTUM_H
+#define GRAPHICS_FRUSTUM_H
+
+namespace Common {
+	class Matrix4x4;
+	class BoundingBox;
+}
+
+namespace Graphics {
+
+/** A view frustum, for culling objects outside the visible area.
+ *
+ *  The frustum is described by its six clipping planes, extracted from
+ *  a combined projection and modelview matrix (Gribb and Hartmann). All
+ *  planes face inwards, so that a point is inside the frustum if it is
+ *  in front of each of the planes.
+ */
+class Frustum {
+public:
+	Frustum();
+	~Frustum();
+
+	/** Extract the frustum planes out of a projection and a modelview matrix. */
+	void set(const Common::Matrix4x4 &projection, const Common::Matrix4x4 &modelview);
+
+	/** Is this point within the frustum? */
+	bool isIn(float x, float y, float z) const;
+
+	/** Is the axis-aligned box from min to max at least partially within the frustum? */
+	bool isIn(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const;
+	/** Is this (absolutized) bounding box at least partially within the frustum? */
+	bool isIn(const Common::BoundingBox &box) const;
+
+private:
+	enum Plane {
+		kPlaneLeft   = 0,
+		kPlaneRight     ,
+		kPlaneBottom    ,
+		kPlaneTop       ,
+		kPlaneNear      ,
+		kPlaneFar       ,
+		kPlaneMAX
+	};
+
+	/** The plane equations, as a, b, c and d in ax + by + cz + d = 0. */
+	float _planes[kPlaneMAX][4];
+
+	void normalizePlane(float *plane);
+};
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_FRUSTUM_H
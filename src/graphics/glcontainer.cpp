@@ -50,6 +50,10 @@ void GLContainer::rebuild() {
 	_built = true;
 }
 
+bool GLContainer::isReadyToBuild() const {
+	return true;
+}
+
 void GLContainer::destroy() {
 	if (!_built)
 		return;
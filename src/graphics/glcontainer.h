@@ -40,6 +40,9 @@ public:
 	void rebuild();
 	void destroy();
 
+	/** Is the container ready to be built? Containers that aren't stay in the new texture queue. */
+	virtual bool isReadyToBuild() const;
+
 protected:
 	virtual void doRebuild() = 0;
 	virtual void doDestroy() = 0;
@@ -70,6 +70,8 @@ GraphicsManager::GraphicsManager() : Events::Notifyable() {
 
 	_debugGL = false;
 
+	_textureUploadBudget = 0;
+
 	_needManualDeS3TC        = false;
 	_supportMultipleTextures = false;
 	_multipleTextureCount    = 0;
@@ -101,6 +103,9 @@ GraphicsManager::GraphicsManager() : Events::Notifyable() {
 
 	_lastSampled = 0;
 
+	_drawnObjects  = 0;
+	_culledObjects = 0;
+
 	glCompressedTexImage2D = 0;
 }
 
@@ -117,6 +122,8 @@ void GraphicsManager::init() {
 
 	_debugGL = ConfigMan.getBool("debuggl", false);
 
+	_textureUploadBudget = MAX(ConfigMan.getInt("textureuploads", 0), 0);
+
 	if (!setupSDLGL())
 		throw Common::Exception("Failed initializing the OpenGL renderer");
 
@@ -189,6 +196,14 @@ uint32 GraphicsManager::getFPS() const {
 	return _fpsCounter->getFPS();
 }
 
+uint32 GraphicsManager::getDrawnObjectCount() const {
+	return _drawnObjects;
+}
+
+uint32 GraphicsManager::getCulledObjectCount() const {
+	return _culledObjects;
+}
+
 bool GraphicsManager::setFSAA(int level) {
 	// Force calling it from the main thread
 	if (!Common::isMainThread()) {
@@ -801,27 +816,53 @@ Renderable *GraphicsManager::getWorldObjectAt(float x, float y) const {
 
 	Renderable *object = 0;
 
-	QueueMan.lockQueue(kQueueVisibleWorldObject);
-	const std::list<Queueable *> &objects = QueueMan.getQueue(kQueueVisibleWorldObject);
+	Common::StackLock lock(_worldIndexMutex);
 
-	for (std::list<Queueable *>::const_iterator o = objects.begin(); o != objects.end(); ++o) {
-		Renderable &r = static_cast<Renderable &>(**o);
+	std::vector<Renderable *> candidates;
+	_worldIndex.findLine(x1, y1, z1, x2, y2, z2, candidates);
+
+	for (std::vector<Renderable *>::const_iterator o = candidates.begin(); o != candidates.end(); ++o) {
+		Renderable &r = **o;
 
 		if (!r.isClickable())
 			// Object isn't clickable, don't check
 			continue;
 
-		// If the line intersects with the object, return it
-		if (r.isIn(x1, y1, z1, x2, y2, z2)) {
+		// Of all the objects the line intersects with, return the closest one
+		if (r.isIn(x1, y1, z1, x2, y2, z2) && (!object || (r < *object)))
 			object = &r;
-			break;
-		}
 	}
 
-	QueueMan.unlockQueue(kQueueVisibleWorldObject);
 	return object;
 }
 
+uint32 GraphicsManager::addToWorldIndex(Renderable *object, const Common::BoundingBox &box) {
+	Common::StackLock lock(_worldIndexMutex);
+
+	return _worldIndex.add(object, box);
+}
+
+void GraphicsManager::updateWorldIndex(uint32 proxy, const Common::BoundingBox &box) {
+	Common::StackLock lock(_worldIndexMutex);
+
+	_worldIndex.update(proxy, box);
+}
+
+void GraphicsManager::removeFromWorldIndex(uint32 proxy) {
+	Common::StackLock lock(_worldIndexMutex);
+
+	_worldIndex.remove(proxy);
+}
+
+void GraphicsManager::getWorldObjectsIn(float minX, float minY, float minZ,
+                                        float maxX, float maxY, float maxZ,
+                                        std::vector<Renderable *> &objects) const {
+
+	Common::StackLock lock(_worldIndexMutex);
+
+	_worldIndex.findBox(minX, minY, minZ, maxX, maxY, maxZ, objects);
+}
+
 Renderable *GraphicsManager::getObjectAt(float x, float y) {
 	Renderable *object = 0;
 
@@ -842,10 +883,27 @@ void GraphicsManager::buildNewTextures() {
 		return;
 	}
 
-	for (std::list<Queueable *>::const_iterator t = text.begin(); t != text.end(); ++t)
-		static_cast<GLContainer *>(*t)->rebuild();
+	size_t built = 0;
+
+	std::list<Queueable *>::const_iterator t = text.begin();
+	while (t != text.end()) {
+		GLContainer &container = static_cast<GLContainer &>(**t);
+		++t;
+
+		// Still waiting for its data, try again next frame
+		if (!container.isReadyToBuild())
+			continue;
+
+		// Spread the uploading of many textures over several frames
+		if ((_textureUploadBudget > 0) && (built >= _textureUploadBudget))
+			break;
+
+		container.rebuild();
+		QueueMan.kickOut(kQueueNewTexture, container);
+
+		built++;
+	}
 
-	QueueMan.clearQueue(kQueueNewTexture);
 	QueueMan.unlockQueue(kQueueNewTexture);
 }
 
@@ -886,6 +944,9 @@ bool GraphicsManager::playVideo() {
 }
 
 bool GraphicsManager::renderWorld() {
+	_drawnObjects  = 0;
+	_culledObjects = 0;
+
 	if (QueueMan.isQueueEmpty(kQueueVisibleWorldObject))
 		return false;
 
@@ -917,6 +978,8 @@ bool GraphicsManager::renderWorld() {
 	_modelview.rotate(-cOrient[2], 0.0f, 0.0f, 1.0f);
 	_modelview.translate(-cPos[0], -cPos[1], -cPos[2]);
 
+	_frustum.set(_projection, _modelview);
+
 	QueueMan.lockQueue(kQueueVisibleWorldObject);
 	const std::list<Queueable *> &objects = QueueMan.getQueue(kQueueVisibleWorldObject);
 
@@ -939,21 +1002,36 @@ bool GraphicsManager::renderWorld() {
 		static_cast<Renderable *>(*o)->advanceTime(elapsedTime);
 	}
 
-	// Draw opaque objects
+	// Collect the objects that are within the view frustum
+	_visibleWorldObjects.clear();
 	for (std::list<Queueable *>::const_reverse_iterator o = objects.rbegin();
 	     o != objects.rend(); ++o) {
 
+		Renderable *object = static_cast<Renderable *>(*o);
+
+		if (object->isInFrustum(_frustum))
+			_visibleWorldObjects.push_back(object);
+		else
+			_culledObjects++;
+	}
+
+	_drawnObjects = _visibleWorldObjects.size();
+
+	// Draw opaque objects
+	for (std::vector<Renderable *>::const_iterator o = _visibleWorldObjects.begin();
+	     o != _visibleWorldObjects.end(); ++o) {
+
 		glPushMatrix();
-		static_cast<Renderable *>(*o)->render(kRenderPassOpaque);
+		(*o)->render(kRenderPassOpaque);
 		glPopMatrix();
 	}
 
 	// Draw transparent objects
-	for (std::list<Queueable *>::const_reverse_iterator o = objects.rbegin();
-	     o != objects.rend(); ++o) {
+	for (std::vector<Renderable *>::const_iterator o = _visibleWorldObjects.begin();
+	     o != _visibleWorldObjects.end(); ++o) {
 
 		glPushMatrix();
-		static_cast<Renderable *>(*o)->render(kRenderPassTransparent);
+		(*o)->render(kRenderPassTransparent);
 		glPopMatrix();
 	}
 
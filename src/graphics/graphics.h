@@ -32,6 +32,8 @@
 
 #include "src/graphics/windowman.h"
 #include "src/graphics/types.h"
+#include "src/graphics/frustum.h"
+#include "src/graphics/spatialindex.h"
 
 #include "src/common/types.h"
 #include "src/common/singleton.h"
@@ -81,6 +83,11 @@ public:
 	/** How many frames per second to we render at the moments? */
 	uint32 getFPS() const;
 
+	/** Return the number of world objects drawn in the last frame. */
+	uint32 getDrawnObjectCount() const;
+	/** Return the number of world objects culled by the view frustum in the last frame. */
+	uint32 getCulledObjectCount() const;
+
 	/** Enable/Disable face culling. */
 	void setCullFace(bool enabled, GLenum mode = GL_BACK);
 
@@ -106,6 +113,24 @@ public:
 	/** Get the object at this screen position. */
 	Renderable *getObjectAt(float x, float y);
 
+	/** Add a visible world object with this bounding box to the spatial index.
+	 *
+	 *  @return A proxy ID, used to update or remove the object later.
+	 */
+	uint32 addToWorldIndex(Renderable *object, const Common::BoundingBox &box);
+	/** Update the bounding box of an object in the spatial index. */
+	void updateWorldIndex(uint32 proxy, const Common::BoundingBox &box);
+	/** Remove an object from the spatial index. */
+	void removeFromWorldIndex(uint32 proxy);
+
+	/** Find all indexed world objects that might intersect the box from min to max.
+	 *
+	 *  The objects are only roughly checked, with their bounding box slightly
+	 *  enlarged. Callers need to do their own exact test, if necessary.
+	 */
+	void getWorldObjectsIn(float minX, float minY, float minZ, float maxX, float maxY, float maxZ,
+	                       std::vector<Renderable *> &objects) const;
+
 	/** Recalculate all object distances to the camera and resort the objects. */
 	void recalculateObjectDistances();
 
@@ -149,6 +174,9 @@ private:
 
 	bool _debugGL; ///< Should we create an OpenGL debug context?
 
+	/** Maximum number of new textures to build each frame. 0 means no limit. */
+	size_t _textureUploadBudget;
+
 	// Extensions
 	bool   _needManualDeS3TC;        ///< Do we need to do manual S3TC DXTn decompression?
 	bool   _supportMultipleTextures; ///< Do we have support for multiple textures?
@@ -174,6 +202,17 @@ private:
 	Common::Matrix4x4 _modelview;     ///< Our base modelview matrix (i.e camera view).
 	Common::Matrix4x4 _modelviewInv;  ///< The inverse of our modelview matrix.
 
+	Frustum _frustum; ///< The current view frustum.
+
+	/** The world objects within the view frustum, collected anew each frame. */
+	std::vector<Renderable *> _visibleWorldObjects;
+
+	uint32 _drawnObjects; ///< Number of world objects drawn in the last frame.
+	uint32 _culledObjects; ///< Number of world objects culled in the last frame.
+
+	SpatialIndex _worldIndex; ///< Spatial index over the visible world objects.
+	mutable Common::Mutex _worldIndexMutex; ///< A mutex protecting the spatial index.
+
 	boost::atomic<uint32> _frameLock;
 	boost::atomic<bool>   _frameEndSignal;
 
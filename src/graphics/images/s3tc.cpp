@@ -22,198 +22,474 @@
  *  Manual S3TC DXTn decompression methods.
  */
 
+/* The DXTn blocks are decoded in two steps. First, the two RGB565 end points
+ * of each block's color part are expanded into a palette of four RGBA colors.
+ * This is done for a whole row of blocks at once, using SSE2 or AVX2 kernels
+ * if the CPU supports them. Which kernel is used is decided at runtime.
+ * Then, the 2-bit color indices and the alpha values of each block are
+ * looked up and written into the image.
+ *
+ * The interpolated palette colors match those of the old floating point
+ * implementation bit for bit. It weighted the end points with 0.333333f and
+ * 0.666666f, slightly less than 1/3 and 2/3. So whenever the exact third is
+ * an integer and the second end point is the larger one, the truncated
+ * result was one less. Subtracting (b > a) before dividing reproduces that.
+ */
+
+#include <cstring>
+
+#include <vector>
+
 #include "src/common/util.h"
+#include "src/common/error.h"
 #include "src/common/readstream.h"
+#include "src/common/simd.h"
 
 #include "src/graphics/images/s3tc.h"
 
 namespace Graphics {
 
-static uint32 convert565To8888(uint16 color) {
-	return ((color & 0x1F) << 11) | ((color & 0x7E0) << 13) | ((color & 0xF800) << 16) | 0xFF;
-}
-
-static uint32 interpolate32(double weight, uint32 color_0, uint32 color_1) {
-	byte r[3], g[3], b[3], a[3];
-	r[0] = color_0 >> 24;
-	r[1] = color_1 >> 24;
-	r[2] = (byte)((1.0f - weight) * (double)r[0] + weight * (double)r[1]);
-	g[0] = (color_0 >> 16) & 0xFF;
-	g[1] = (color_1 >> 16) & 0xFF;
-	g[2] = (byte)((1.0f - weight) * (double)g[0] + weight * (double)g[1]);
-	b[0] = (color_0 >> 8) & 0xFF;
-	b[1] = (color_1 >> 8) & 0xFF;
-	b[2] = (byte)((1.0f - weight) * (double)b[0] + weight * (double)b[1]);
-	a[0] = color_0 & 0xFF;
-	a[1] = color_1 & 0xFF;
-	a[2] = (byte)((1.0f - weight) * (double)a[0] + weight * (double)a[1]);
-	return r[2] << 24 | g[2] << 16 | b[2] << 8 | a[2];
-}
-
-struct DXT1Texel {
-	uint16 color_0;
-	uint16 color_1;
-	uint32 pixels;
+/** The size of a DXT1 block, and of the color part of a DXT3/DXT5 block. */
+static const uint32 kColorBlockSize = 8;
+/** The size of a DXT3/DXT5 block. */
+static const uint32 kAlphaBlockSize = 16;
+
+/** The size of an expanded 4-color palette, in bytes. */
+static const uint32 kPaletteSize = 4 * 4;
+
+static inline byte interpolateThird(byte a, byte b) {
+	return (2 * a + b - ((b > a) ? 1 : 0)) / 3;
+}
+
+static inline byte interpolateTwoThirds(byte a, byte b) {
+	return (a + 2 * b - ((b > a) ? 1 : 0)) / 3;
+}
+
+/** Expand the end points of one color block into a palette of four RGBA colors.
+ *
+ *  In DXT1 mode, a block whose first end point is not greater than the
+ *  second one has a 3-color palette with a transparent fourth color.
+ *  Otherwise, the colors are fully opaque in DXT1 mode and have an alpha
+ *  of 0 in DXT3/DXT5 mode.
+ */
+static void expandColors(byte *palette, const byte *block, bool dxt1) {
+	const uint16 color0 = READ_LE_UINT16(block + 0);
+	const uint16 color1 = READ_LE_UINT16(block + 2);
+
+	const byte alpha = dxt1 ? 0xFF : 0x00;
+
+	palette[0] = (color0 >> 8) & 0xF8;
+	palette[1] = (color0 >> 3) & 0xFC;
+	palette[2] = (color0 << 3) & 0xF8;
+	palette[3] = alpha;
+
+	palette[4] = (color1 >> 8) & 0xF8;
+	palette[5] = (color1 >> 3) & 0xFC;
+	palette[6] = (color1 << 3) & 0xF8;
+	palette[7] = alpha;
+
+	if (!dxt1 || (color0 > color1)) {
+		for (int i = 0; i < 4; i++) {
+			palette[ 8 + i] = interpolateThird    (palette[i], palette[4 + i]);
+			palette[12 + i] = interpolateTwoThirds(palette[i], palette[4 + i]);
+		}
+	} else {
+		for (int i = 0; i < 4; i++) {
+			palette[ 8 + i] = (palette[i] + palette[4 + i]) >> 1;
+			palette[12 + i] = 0;
+		}
+	}
+}
+
+#ifdef COMMON_SIMD_X86
+
+/* The SIMD kernels keep one block per 32-bit lane, with each color channel
+ * in a separate register. The channel values never exceed 765, so the
+ * division by 3 can be done with a 16-bit multiply-high by 0xAAAB. */
+
+/** Return (2 * a + b + bias) / 3, where bias is either 0 or -1. */
+COMMON_TARGET("sse2") static inline __m128i interpolateSSE2(__m128i a, __m128i b, __m128i bias) {
+	const __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_add_epi32(a, a), b), bias);
+
+	return _mm_srli_epi32(_mm_mulhi_epu16(sum, _mm_set1_epi32(0xAAAB)), 1);
+}
+
+COMMON_TARGET("sse2") static inline __m128i packColorSSE2(__m128i r, __m128i g, __m128i b, __m128i a) {
+	return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+	                    _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+}
+
+COMMON_TARGET("sse2") static inline __m128i selectSSE2(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/** Expand the palettes of four color blocks at once. */
+COMMON_TARGET("sse2") static void expandColorsSSE2(byte *palettes, const byte *blocks, uint32 blockSize, bool dxt1) {
+	const __m128i colors = _mm_set_epi32((int32) READ_LE_UINT32(blocks + 3 * blockSize),
+	                                     (int32) READ_LE_UINT32(blocks + 2 * blockSize),
+	                                     (int32) READ_LE_UINT32(blocks + 1 * blockSize),
+	                                     (int32) READ_LE_UINT32(blocks + 0 * blockSize));
+
+	const __m128i color0 = _mm_and_si128(colors, _mm_set1_epi32(0xFFFF));
+	const __m128i color1 = _mm_srli_epi32(colors, 16);
+
+	const __m128i mask5 = _mm_set1_epi32(0xF8);
+	const __m128i mask6 = _mm_set1_epi32(0xFC);
+
+	const __m128i r0 = _mm_and_si128(_mm_srli_epi32(color0, 8), mask5);
+	const __m128i g0 = _mm_and_si128(_mm_srli_epi32(color0, 3), mask6);
+	const __m128i b0 = _mm_and_si128(_mm_slli_epi32(color0, 3), mask5);
+	const __m128i r1 = _mm_and_si128(_mm_srli_epi32(color1, 8), mask5);
+	const __m128i g1 = _mm_and_si128(_mm_srli_epi32(color1, 3), mask6);
+	const __m128i b1 = _mm_and_si128(_mm_slli_epi32(color1, 3), mask5);
+
+	const __m128i alpha = dxt1 ? _mm_set1_epi32(0xFF) : _mm_setzero_si128();
+
+	const __m128i p0 = packColorSSE2(r0, g0, b0, alpha);
+	const __m128i p1 = packColorSSE2(r1, g1, b1, alpha);
+
+	const __m128i biasR = _mm_cmpgt_epi32(r1, r0);
+	const __m128i biasG = _mm_cmpgt_epi32(g1, g0);
+	const __m128i biasB = _mm_cmpgt_epi32(b1, b0);
+
+	__m128i p2 = packColorSSE2(interpolateSSE2(r0, r1, biasR), interpolateSSE2(g0, g1, biasG),
+	                           interpolateSSE2(b0, b1, biasB), alpha);
+	__m128i p3 = packColorSSE2(interpolateSSE2(r1, r0, biasR), interpolateSSE2(g1, g0, biasG),
+	                           interpolateSSE2(b1, b0, biasB), alpha);
+
+	if (dxt1) {
+		const __m128i fourColors = _mm_cmpgt_epi32(color0, color1);
+
+		const __m128i half = packColorSSE2(_mm_srli_epi32(_mm_add_epi32(r0, r1), 1),
+		                                   _mm_srli_epi32(_mm_add_epi32(g0, g1), 1),
+		                                   _mm_srli_epi32(_mm_add_epi32(b0, b1), 1), alpha);
+
+		p2 = selectSSE2(fourColors, p2, half);
+		p3 = _mm_and_si128(fourColors, p3);
+	}
+
+	// Transpose from one register per palette entry to one register per block
+	const __m128i t0 = _mm_unpacklo_epi32(p0, p1);
+	const __m128i t1 = _mm_unpacklo_epi32(p2, p3);
+	const __m128i t2 = _mm_unpackhi_epi32(p0, p1);
+	const __m128i t3 = _mm_unpackhi_epi32(p2, p3);
+
+	_mm_storeu_si128((__m128i *) (palettes + 0 * kPaletteSize), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128((__m128i *) (palettes + 1 * kPaletteSize), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128((__m128i *) (palettes + 2 * kPaletteSize), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128((__m128i *) (palettes + 3 * kPaletteSize), _mm_unpackhi_epi64(t2, t3));
+}
+
+/** Return (2 * a + b + bias) / 3, where bias is either 0 or -1. */
+COMMON_TARGET("avx2") static inline __m256i interpolateAVX2(__m256i a, __m256i b, __m256i bias) {
+	const __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(a, a), b), bias);
+
+	return _mm256_srli_epi32(_mm256_mulhi_epu16(sum, _mm256_set1_epi32(0xAAAB)), 1);
+}
+
+COMMON_TARGET("avx2") static inline __m256i packColorAVX2(__m256i r, __m256i g, __m256i b, __m256i a) {
+	return _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+	                       _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_slli_epi32(a, 24)));
+}
+
+/** Expand the palettes of eight color blocks at once. */
+COMMON_TARGET("avx2") static void expandColorsAVX2(byte *palettes, const byte *blocks, uint32 blockSize, bool dxt1) {
+	const __m256i colors = _mm256_set_epi32((int32) READ_LE_UINT32(blocks + 7 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 6 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 5 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 4 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 3 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 2 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 1 * blockSize),
+	                                        (int32) READ_LE_UINT32(blocks + 0 * blockSize));
+
+	const __m256i color0 = _mm256_and_si256(colors, _mm256_set1_epi32(0xFFFF));
+	const __m256i color1 = _mm256_srli_epi32(colors, 16);
+
+	const __m256i mask5 = _mm256_set1_epi32(0xF8);
+	const __m256i mask6 = _mm256_set1_epi32(0xFC);
+
+	const __m256i r0 = _mm256_and_si256(_mm256_srli_epi32(color0, 8), mask5);
+	const __m256i g0 = _mm256_and_si256(_mm256_srli_epi32(color0, 3), mask6);
+	const __m256i b0 = _mm256_and_si256(_mm256_slli_epi32(color0, 3), mask5);
+	const __m256i r1 = _mm256_and_si256(_mm256_srli_epi32(color1, 8), mask5);
+	const __m256i g1 = _mm256_and_si256(_mm256_srli_epi32(color1, 3), mask6);
+	const __m256i b1 = _mm256_and_si256(_mm256_slli_epi32(color1, 3), mask5);
+
+	const __m256i alpha = dxt1 ? _mm256_set1_epi32(0xFF) : _mm256_setzero_si256();
+
+	const __m256i p0 = packColorAVX2(r0, g0, b0, alpha);
+	const __m256i p1 = packColorAVX2(r1, g1, b1, alpha);
+
+	const __m256i biasR = _mm256_cmpgt_epi32(r1, r0);
+	const __m256i biasG = _mm256_cmpgt_epi32(g1, g0);
+	const __m256i biasB = _mm256_cmpgt_epi32(b1, b0);
+
+	__m256i p2 = packColorAVX2(interpolateAVX2(r0, r1, biasR), interpolateAVX2(g0, g1, biasG),
+	                           interpolateAVX2(b0, b1, biasB), alpha);
+	__m256i p3 = packColorAVX2(interpolateAVX2(r1, r0, biasR), interpolateAVX2(g1, g0, biasG),
+	                           interpolateAVX2(b1, b0, biasB), alpha);
+
+	if (dxt1) {
+		const __m256i fourColors = _mm256_cmpgt_epi32(color0, color1);
+
+		const __m256i half = packColorAVX2(_mm256_srli_epi32(_mm256_add_epi32(r0, r1), 1),
+		                                   _mm256_srli_epi32(_mm256_add_epi32(g0, g1), 1),
+		                                   _mm256_srli_epi32(_mm256_add_epi32(b0, b1), 1), alpha);
+
+		p2 = _mm256_blendv_epi8(half, p2, fourColors);
+		p3 = _mm256_and_si256(fourColors, p3);
+	}
+
+	// Transpose within each 128-bit lane, then reorder the lanes when storing
+	const __m256i t0 = _mm256_unpacklo_epi32(p0, p1);
+	const __m256i t1 = _mm256_unpacklo_epi32(p2, p3);
+	const __m256i t2 = _mm256_unpackhi_epi32(p0, p1);
+	const __m256i t3 = _mm256_unpackhi_epi32(p2, p3);
+
+	const __m256i q0 = _mm256_unpacklo_epi64(t0, t1); // Blocks 0 and 4
+	const __m256i q1 = _mm256_unpackhi_epi64(t0, t1); // Blocks 1 and 5
+	const __m256i q2 = _mm256_unpacklo_epi64(t2, t3); // Blocks 2 and 6
+	const __m256i q3 = _mm256_unpackhi_epi64(t2, t3); // Blocks 3 and 7
+
+	_mm256_storeu_si256((__m256i *) (palettes + 0 * kPaletteSize), _mm256_permute2x128_si256(q0, q1, 0x20));
+	_mm256_storeu_si256((__m256i *) (palettes + 2 * kPaletteSize), _mm256_permute2x128_si256(q2, q3, 0x20));
+	_mm256_storeu_si256((__m256i *) (palettes + 4 * kPaletteSize), _mm256_permute2x128_si256(q0, q1, 0x31));
+	_mm256_storeu_si256((__m256i *) (palettes + 6 * kPaletteSize), _mm256_permute2x128_si256(q2, q3, 0x31));
+}
+
+#endif // COMMON_SIMD_X86
+
+/** Expand the color palettes of a row of blocks.
+ *
+ *  @param palettes  Receives count palettes of kPaletteSize bytes each.
+ *  @param blocks    The color part of the first block.
+ *  @param count     The number of blocks.
+ *  @param blockSize The distance between two blocks, in bytes.
+ *  @param dxt1      Expand in DXT1 mode, with 3-color blocks and alpha?
+ */
+static void expandColorRow(byte *palettes, const byte *blocks, uint32 count, uint32 blockSize, bool dxt1) {
+	uint32 n = 0;
+
+#ifdef COMMON_SIMD_X86
+	const Common::SIMDLevel simd = Common::getSIMDLevel();
+
+	if (simd >= Common::kSIMDAVX2)
+		for (; (n + 8) <= count; n += 8)
+			expandColorsAVX2(palettes + n * kPaletteSize, blocks + n * blockSize, blockSize, dxt1);
+
+	if (simd >= Common::kSIMDSSE2)
+		for (; (n + 4) <= count; n += 4)
+			expandColorsSSE2(palettes + n * kPaletteSize, blocks + n * blockSize, blockSize, dxt1);
+#endif
+
+	for (; n < count; n++)
+		expandColors(palettes + n * kPaletteSize, blocks + n * blockSize, dxt1);
+}
+
+/** Information about the image a row of blocks is decoded into. */
+struct BlockTarget {
+	byte *dest;
+	uint32 width;
+	uint32 height;
+	uint32 pitch;
+
+	uint32 blockWidth;  ///< Number of pixels per block row.
+	uint32 blockHeight; ///< Number of pixel rows per block.
+
+	BlockTarget(byte *d, uint32 w, uint32 h, uint32 p) : dest(d), width(w), height(h), pitch(p),
+		blockWidth(MIN<uint32>(w, 4)), blockHeight(MIN<uint32>(h, 4)) {
+	}
 };
 
-#define READ_DXT1_TEXEL(x) \
-	x.color_0 = src.readUint16LE(); \
-	x.color_1 = src.readUint16LE(); \
-	x.pixels = src.readUint32BE()
+/** Look up the color indices of a block in its palette.
+ *
+ *  The resulting pixels are stored in rows of 4, in the order they are
+ *  written into the image by writeBlock().
+ */
+static void decodeColors(byte *pixels, const byte *palette, const byte *block, const BlockTarget &target) {
+	uint32 indices = READ_BE_UINT32(block + 4);
 
-void decompressDXT1(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
-	for (int32 ty = height; ty > 0; ty -= 4) {
-		for (uint32 tx = 0; tx < width; tx += 4) {
-			DXT1Texel tex;
-			READ_DXT1_TEXEL(tex);
-			uint32 blended[4];
-
-			blended[0] = convert565To8888(tex.color_0);
-			blended[1] = convert565To8888(tex.color_1);
-
-			if (tex.color_0 > tex.color_1) {
-				blended[2] = interpolate32(0.333333f, blended[0], blended[1]);
-				blended[3] = interpolate32(0.666666f, blended[0], blended[1]);
-			} else {
-				blended[2] = interpolate32(0.5f, blended[0], blended[1]);
-				blended[3] = 0;
-			}
+	if ((target.blockWidth == 4) && (target.blockHeight == 4)) {
+		for (uint32 i = 0; i < 16; i++, indices >>= 2)
+			std::memcpy(pixels + i * 4, palette + (indices & 3) * 4, 4);
 
-			uint32 cpx = tex.pixels;
-			uint32 blockWidth = MIN<uint32>(width, 4);
-			uint32 blockHeight = MIN<uint32>(height, 4);
+		return;
+	}
 
-			for (byte y = 0; y < blockHeight; ++y) {
-				for (byte x = 0; x < blockWidth; ++x) {
-					const uint32 destX = tx + x;
-					const uint32 destY = height - 1 - (ty - blockHeight + y);
+	for (uint32 y = 0; y < target.blockHeight; y++) {
+		for (uint32 x = 0; x < target.blockWidth; x++, indices >>= 2)
+			std::memcpy(pixels + (y * 4 + x) * 4, palette + (indices & 3) * 4, 4);
+	}
+}
 
-					const uint32 pixel =  blended[cpx & 3];
+/** Write a decoded block into the image, clipping it at the image edges. */
+static void writeBlock(const BlockTarget &target, const byte *pixels, uint32 tx, int32 ty) {
+	const uint32 count = MIN<uint32>(target.blockWidth, target.width - tx);
 
-					cpx >>= 2;
+	if ((count == 4) && (target.blockHeight == 4) && (ty >= 4)) {
+		byte *dest = target.dest + (target.height - ty) * target.pitch + tx * 4;
 
-					if ((destX < width) && (destY < height))
-						WRITE_BE_UINT32(dest + destY * pitch + destX * 4, pixel);
-				}
-			}
+		for (uint32 y = 0; y < 4; y++, dest += target.pitch)
+			std::memcpy(dest, pixels + (3 - y) * 16, 16);
+
+		return;
+	}
+
+	for (uint32 y = 0; y < target.blockHeight; y++) {
+		const int32 destY = (int32) target.height - 1 - (ty - (int32) target.blockHeight + (int32) y);
+		if ((destY < 0) || ((uint32) destY >= target.height))
+			continue;
+
+		std::memcpy(target.dest + destY * target.pitch + tx * 4, pixels + y * 16, count * 4);
+	}
+}
+
+static void decodeDXT1(const BlockTarget &target, const byte *src) {
+	const uint32 blockCount = (target.width + 3) / 4;
+	if ((blockCount == 0) || (target.height == 0))
+		return;
+
+	std::vector<byte> palettes(blockCount * kPaletteSize);
+
+	for (int32 ty = target.height; ty > 0; ty -= 4) {
+		expandColorRow(&palettes[0], src, blockCount, kColorBlockSize, true);
+
+		for (uint32 i = 0, tx = 0; i < blockCount; i++, tx += 4, src += kColorBlockSize) {
+			byte pixels[16 * 4];
+
+			decodeColors(pixels, &palettes[i * kPaletteSize], src, target);
+			writeBlock(target, pixels, tx, ty);
 		}
 	}
 }
 
-struct DXT23Texel : public DXT1Texel {
-	uint16 alpha[4];
-};
+static void decodeDXT3(const BlockTarget &target, const byte *src) {
+	const uint32 blockCount = (target.width + 3) / 4;
+	if ((blockCount == 0) || (target.height == 0))
+		return;
 
-#define READ_DXT3_TEXEL(x) \
-	x.alpha[0] = src.readUint16LE(); \
-	x.alpha[1] = src.readUint16LE(); \
-	x.alpha[2] = src.readUint16LE(); \
-	x.alpha[3] = src.readUint16LE(); \
-	READ_DXT1_TEXEL(x)
+	std::vector<byte> palettes(blockCount * kPaletteSize);
 
-void decompressDXT3(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
-	for (int32 ty = height; ty > 0; ty -= 4) {
-		for (uint32 tx = 0; tx < width; tx += 4) {
-			DXT23Texel tex;
-			uint32 blended[4];
-			READ_DXT3_TEXEL(tex);
-
-			blended[0] = convert565To8888(tex.color_0) & 0xFFFFFF00;
-			blended[1] = convert565To8888(tex.color_1) & 0xFFFFFF00;
-			blended[2] = interpolate32(0.333333f, blended[0], blended[1]);
-			blended[3] = interpolate32(0.666666f, blended[0], blended[1]);
-
-			uint32 cpx = tex.pixels;
-			uint32 blockWidth = MIN<uint32>(width, 4);
-			uint32 blockHeight = MIN<uint32>(height, 4);
-
-			for (byte y = 0; y < blockHeight; ++y) {
-				for (byte x = 0; x < blockWidth; ++x) {
-					const uint32 destX = tx + x;
-					const uint32 destY = height - 1 - (ty - blockHeight + y);
-
-					const uint32 alpha = (tex.alpha[y] >> (x * 4)) & 0xF;
-					const uint32 pixel = blended[cpx & 3] | alpha << 4;
-
-					cpx >>= 2;
-
-					if ((destX < width) && (destY < height))
-						WRITE_BE_UINT32(dest + destY * pitch + destX * 4, pixel);
-				}
+	for (int32 ty = target.height; ty > 0; ty -= 4) {
+		expandColorRow(&palettes[0], src + 8, blockCount, kAlphaBlockSize, false);
+
+		for (uint32 i = 0, tx = 0; i < blockCount; i++, tx += 4, src += kAlphaBlockSize) {
+			byte pixels[16 * 4];
+
+			decodeColors(pixels, &palettes[i * kPaletteSize], src + 8, target);
+
+			for (uint32 y = 0; y < target.blockHeight; y++) {
+				const uint16 alpha = READ_LE_UINT16(src + y * 2);
+
+				for (uint32 x = 0; x < target.blockWidth; x++)
+					pixels[(y * 4 + x) * 4 + 3] = ((alpha >> (x * 4)) & 0xF) << 4;
 			}
+
+			writeBlock(target, pixels, tx, ty);
 		}
 	}
 }
 
-struct DXT45Texel : public DXT1Texel {
-	byte alpha_0;
-	byte alpha_1;
-	uint64 alphabl;
-};
+static void decodeDXT5(const BlockTarget &target, const byte *src) {
+	const uint32 blockCount = (target.width + 3) / 4;
+	if ((blockCount == 0) || (target.height == 0))
+		return;
 
-static uint64 readUint48LE(Common::SeekableReadStream &src) {
-	uint64 output = src.readUint32LE();
-	return output | ((uint64)src.readUint16LE() << 32);
-}
+	std::vector<byte> palettes(blockCount * kPaletteSize);
 
-#define READ_DXT5_TEXEL(x) \
-	x.alpha_0 = src.readByte(); \
-	x.alpha_1 = src.readByte(); \
-	x.alphabl = readUint48LE(src); \
-	READ_DXT1_TEXEL(x)
+	for (int32 ty = target.height; ty > 0; ty -= 4) {
+		expandColorRow(&palettes[0], src + 8, blockCount, kAlphaBlockSize, false);
+
+		for (uint32 i = 0, tx = 0; i < blockCount; i++, tx += 4, src += kAlphaBlockSize) {
+			byte pixels[16 * 4];
+
+			decodeColors(pixels, &palettes[i * kPaletteSize], src + 8, target);
 
-void decompressDXT5(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
-	for (int32 ty = height; ty > 0; ty -= 4) {
-		for (uint32 tx = 0; tx < width; tx += 4) {
-			uint32 blended[4];
 			byte alphab[8];
-			DXT45Texel tex;
-			READ_DXT5_TEXEL(tex);
-
-			alphab[0] = tex.alpha_0;
-			alphab[1] = tex.alpha_1;
-
-			if (tex.alpha_0 > tex.alpha_1) {
-				alphab[2] = (byte)((6.0f * (double)alphab[0] + 1.0f * (double)alphab[1] + 3.0f) / 7.0f);
-				alphab[3] = (byte)((5.0f * (double)alphab[0] + 2.0f * (double)alphab[1] + 3.0f) / 7.0f);
-				alphab[4] = (byte)((4.0f * (double)alphab[0] + 3.0f * (double)alphab[1] + 3.0f) / 7.0f);
-				alphab[5] = (byte)((3.0f * (double)alphab[0] + 4.0f * (double)alphab[1] + 3.0f) / 7.0f);
-				alphab[6] = (byte)((2.0f * (double)alphab[0] + 5.0f * (double)alphab[1] + 3.0f) / 7.0f);
-				alphab[7] = (byte)((1.0f * (double)alphab[0] + 6.0f * (double)alphab[1] + 3.0f) / 7.0f);
+
+			alphab[0] = src[0];
+			alphab[1] = src[1];
+
+			if (alphab[0] > alphab[1]) {
+				for (int j = 1; j < 7; j++)
+					alphab[j + 1] = ((7 - j) * alphab[0] + j * alphab[1] + 3) / 7;
 			} else {
-				alphab[2] = (byte)((4.0f * (double)alphab[0] + 1.0f * (double)alphab[1] + 2.0f) / 5.0f);
-				alphab[3] = (byte)((3.0f * (double)alphab[0] + 2.0f * (double)alphab[1] + 2.0f) / 5.0f);
-				alphab[4] = (byte)((2.0f * (double)alphab[0] + 3.0f * (double)alphab[1] + 2.0f) / 5.0f);
-				alphab[5] = (byte)((1.0f * (double)alphab[0] + 4.0f * (double)alphab[1] + 2.0f) / 5.0f);
+				for (int j = 1; j < 5; j++)
+					alphab[j + 1] = ((5 - j) * alphab[0] + j * alphab[1] + 2) / 5;
+
 				alphab[6] = 0;
 				alphab[7] = 255;
 			}
 
-			blended[0] = convert565To8888(tex.color_0) & 0xFFFFFF00;
-			blended[1] = convert565To8888(tex.color_1) & 0xFFFFFF00;
-			blended[2] = interpolate32(0.333333f, blended[0], blended[1]);
-			blended[3] = interpolate32(0.666666f, blended[0], blended[1]);
+			const uint64 alphabl = READ_LE_UINT32(src + 2) | ((uint64) READ_LE_UINT16(src + 6) << 32);
 
-			uint32 cpx = tex.pixels;
-			uint32 blockWidth = MIN<uint32>(width, 4);
-			uint32 blockHeight = MIN<uint32>(height, 4);
+			for (uint32 y = 0; y < target.blockHeight; y++)
+				for (uint32 x = 0; x < target.blockWidth; x++)
+					pixels[(y * 4 + x) * 4 + 3] = alphab[(alphabl >> (3 * (4 * (3 - y) + x))) & 7];
 
-			for (byte y = 0; y < blockHeight; ++y) {
-				for (byte x = 0; x < blockWidth; ++x) {
-					const uint32 destX = tx + x;
-					const uint32 destY = height - 1 - (ty - blockHeight + y);
+			writeBlock(target, pixels, tx, ty);
+		}
+	}
+}
 
-					const uint32 alpha = alphab[(tex.alphabl >> (3 * (4 * (3 - y) + x))) & 7];
-					const uint32 pixel = blended[cpx & 3] | alpha;
+/** Return the size of the DXTn data for an image of these dimensions. */
+static uint32 getDataSize(uint32 width, uint32 height, uint32 blockSize) {
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
 
-					cpx >>= 2;
+/** Read all the DXTn data for an image of these dimensions out of a stream. */
+static void readData(std::vector<byte> &data, Common::SeekableReadStream &src,
+                     uint32 width, uint32 height, uint32 blockSize) {
 
-					if ((destX < width) && (destY < height))
-						WRITE_BE_UINT32(dest + destY * pitch + destX * 4, pixel);
-				}
-			}
-		}
-	}
+	data.resize(getDataSize(width, height, blockSize));
+	if (data.empty())
+		return;
+
+	if (src.read(&data[0], data.size()) != data.size())
+		throw Common::Exception(Common::kReadError);
+}
+
+void decompressDXT1(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch) {
+	if (size < getDataSize(width, height, kColorBlockSize))
+		throw Common::Exception(Common::kReadError);
+
+	decodeDXT1(BlockTarget(dest, width, height, pitch), src);
+}
+
+void decompressDXT3(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch) {
+	if (size < getDataSize(width, height, kAlphaBlockSize))
+		throw Common::Exception(Common::kReadError);
+
+	decodeDXT3(BlockTarget(dest, width, height, pitch), src);
+}
+
+void decompressDXT5(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch) {
+	if (size < getDataSize(width, height, kAlphaBlockSize))
+		throw Common::Exception(Common::kReadError);
+
+	decodeDXT5(BlockTarget(dest, width, height, pitch), src);
+}
+
+void decompressDXT1(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
+	std::vector<byte> data;
+	readData(data, src, width, height, kColorBlockSize);
+
+	decodeDXT1(BlockTarget(dest, width, height, pitch), data.empty() ? 0 : &data[0]);
+}
+
+void decompressDXT3(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
+	std::vector<byte> data;
+	readData(data, src, width, height, kAlphaBlockSize);
+
+	decodeDXT3(BlockTarget(dest, width, height, pitch), data.empty() ? 0 : &data[0]);
+}
+
+void decompressDXT5(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch) {
+	std::vector<byte> data;
+	readData(data, src, width, height, kAlphaBlockSize);
+
+	decodeDXT5(BlockTarget(dest, width, height, pitch), data.empty() ? 0 : &data[0]);
 }
 
 } // End of namespace Graphics
@@ -37,6 +37,16 @@ void decompressDXT1(byte *dest, Common::SeekableReadStream &src, uint32 width, u
 void decompressDXT3(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch);
 void decompressDXT5(byte *dest, Common::SeekableReadStream &src, uint32 width, uint32 height, uint32 pitch);
 
+/** Decompress DXTn data directly out of memory.
+ *
+ *  The data is expected to hold all the blocks of the image, row by row.
+ *  If size is too small for an image of these dimensions, a kReadError
+ *  exception is thrown.
+ */
+void decompressDXT1(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch);
+void decompressDXT3(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch);
+void decompressDXT5(byte *dest, const byte *src, uint32 size, uint32 width, uint32 height, uint32 pitch);
+
 } // End of namespace Graphics
 
 #endif // GRAPHICS_IMAGES_S3TC_H
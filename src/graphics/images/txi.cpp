@@ -109,6 +109,10 @@ bool TXI::empty() const {
 	return _empty;
 }
 
+const Common::UString &TXI::getSource() const {
+	return _source;
+}
+
 void TXI::load(Common::SeekableReadStream &stream) {
 	_empty = false;
 
@@ -118,6 +122,9 @@ void TXI::load(Common::SeekableReadStream &stream) {
 		if (line.empty())
 			break;
 
+		_source += line;
+		_source += '\n';
+
 		if (_mode == kModeUpperLeftCoords) {
 			std::sscanf(line.c_str(), "%f %f %f",
 					&_features.upperLeftCoords[_curCoords].x,
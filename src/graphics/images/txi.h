@@ -128,6 +128,9 @@ public:
 
 	bool empty() const;
 
+	/** Return the text lines this TXI was parsed from, each terminated by a line feed. */
+	const Common::UString &getSource() const;
+
 	const Features &getFeatures() const;
 	Features &getFeatures();
 
@@ -142,6 +145,8 @@ private:
 
 	Mode _mode;
 
+	Common::UString _source;
+
 	Features _features;
 
 	uint32 _curCoords;
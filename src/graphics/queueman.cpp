@@ -100,6 +100,10 @@ void QueueManager::clearQueue(QueueType queue) {
 	unlockQueue(queue);
 }
 
+void QueueManager::kickOut(QueueType queue, Queueable &q) {
+	q.removeFromQueue(queue);
+}
+
 void QueueManager::clearAllQueues() {
 	for (int i = 0; i < kQueueMAX; i++)
 		clearQueue((QueueType) i);
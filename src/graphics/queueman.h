@@ -53,6 +53,9 @@ public:
 	void sortQueue(QueueType queue);
 	void clearQueue(QueueType queue);
 
+	/** Remove this object from the queue. */
+	void kickOut(QueueType queue, Queueable &q);
+
 	void clearAllQueues();
 
 private:
@@ -133,6 +133,10 @@ bool Renderable::isIn(float UNUSED(x1), float UNUSED(y1), float UNUSED(z1),
 	return false;
 }
 
+bool Renderable::isInFrustum(const Frustum &UNUSED(frustum)) const {
+	return true;
+}
+
 void Renderable::lockFrame() {
 	GfxMan.lockFrame();
 }
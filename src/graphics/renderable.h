@@ -36,6 +36,8 @@
 
 namespace Graphics {
 
+class Frustum;
+
 /** An object that can be displayed by the graphics manager. */
 class Renderable : boost::noncopyable, public Queueable {
 public:
@@ -81,6 +83,13 @@ public:
 	/** Does the line from x1.y1.z1 to x2.y2.z2 intersect with the object? */
 	virtual bool isIn(float x1, float y1, float z1, float x2, float y2, float z2) const;
 
+	/** Is the object at least partially within the view frustum?
+	 *
+	 *  Objects that return false here are skipped when rendering the world.
+	 *  By default, objects are always considered to be within the frustum.
+	 */
+	virtual bool isInFrustum(const Frustum &frustum) const;
+
 protected:
 	QueueType _queueExists;
 	QueueType _queueVisible;
@@ -35,6 +35,8 @@ src_graphics_libgraphics_la_SOURCES += \
     src/graphics/texture.h \
     src/graphics/font.h \
     src/graphics/camera.h \
+    src/graphics/frustum.h \
+    src/graphics/spatialindex.h \
     src/graphics/renderable.h \
     src/graphics/resolution.h \
     src/graphics/object.h \
@@ -57,6 +59,8 @@ src_graphics_libgraphics_la_SOURCES += \
     src/graphics/texture.cpp \
     src/graphics/font.cpp \
     src/graphics/camera.cpp \
+    src/graphics/frustum.cpp \
+    src/graphics/spatialindex.cpp \
     src/graphics/renderable.cpp \
     src/graphics/yuv_to_rgb.cpp \
     src/graphics/ttf.cpp \
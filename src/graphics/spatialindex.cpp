@@ -0,0 +1,488 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A spatial index over the bounding boxes of renderable objects.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+
+#include "src/common/util.h"
+#include "src/common/boundingbox.h"
+
+#include "src/graphics/spatialindex.h"
+
+/** How much larger than the objects' bounding boxes the boxes in the leaves are. */
+static const float kMargin = 0.25f;
+
+namespace Graphics {
+
+SpatialIndex::Node::Node() : object(0), parent(kNull), child1(kNull), child2(kNull), height(-1) {
+	min[0] = min[1] = min[2] = 0.0f;
+	max[0] = max[1] = max[2] = 0.0f;
+}
+
+bool SpatialIndex::Node::isLeaf() const {
+	return child1 == kNull;
+}
+
+
+SpatialIndex::SpatialIndex() : _root(kNull), _freeList(kNull), _count(0) {
+}
+
+SpatialIndex::~SpatialIndex() {
+}
+
+void SpatialIndex::clear() {
+	_nodes.clear();
+
+	_root     = kNull;
+	_freeList = kNull;
+	_count    = 0;
+}
+
+size_t SpatialIndex::size() const {
+	return _count;
+}
+
+uint32 SpatialIndex::allocateNode() {
+	if (_freeList == kNull) {
+		_nodes.push_back(Node());
+
+		_nodes.back().height = 0;
+		return _nodes.size() - 1;
+	}
+
+	const uint32 node = _freeList;
+	_freeList = _nodes[node].parent;
+
+	_nodes[node] = Node();
+	_nodes[node].height = 0;
+
+	return node;
+}
+
+void SpatialIndex::freeNode(uint32 node) {
+	_nodes[node] = Node();
+
+	_nodes[node].parent = _freeList;
+	_freeList = node;
+}
+
+uint32 SpatialIndex::add(Renderable *object, const Common::BoundingBox &box) {
+	const uint32 leaf = allocateNode();
+
+	Node &node = _nodes[leaf];
+
+	node.object = object;
+
+	box.getMin(node.min[0], node.min[1], node.min[2]);
+	box.getMax(node.max[0], node.max[1], node.max[2]);
+
+	for (int i = 0; i < 3; i++) {
+		node.min[i] -= kMargin;
+		node.max[i] += kMargin;
+	}
+
+	insertLeaf(leaf);
+
+	_count++;
+	return leaf;
+}
+
+void SpatialIndex::remove(uint32 proxy) {
+	if ((proxy >= _nodes.size()) || !_nodes[proxy].isLeaf() || (_nodes[proxy].height != 0))
+		return;
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+
+	_count--;
+}
+
+void SpatialIndex::update(uint32 proxy, const Common::BoundingBox &box) {
+	if ((proxy >= _nodes.size()) || !_nodes[proxy].isLeaf() || (_nodes[proxy].height != 0))
+		return;
+
+	float min[3], max[3];
+	box.getMin(min[0], min[1], min[2]);
+	box.getMax(max[0], max[1], max[2]);
+
+	// Still within the enlarged box, nothing to do
+	if (contains(_nodes[proxy], min, max))
+		return;
+
+	removeLeaf(proxy);
+
+	Node &node = _nodes[proxy];
+	for (int i = 0; i < 3; i++) {
+		node.min[i] = min[i] - kMargin;
+		node.max[i] = max[i] + kMargin;
+	}
+
+	insertLeaf(proxy);
+}
+
+void SpatialIndex::insertLeaf(uint32 leaf) {
+	if (_root == kNull) {
+		_root = leaf;
+		_nodes[leaf].parent = kNull;
+		return;
+	}
+
+	// Walk down the tree, looking for the sibling that would result in the smallest cost
+	uint32 index = _root;
+	while (!_nodes[index].isLeaf()) {
+		const Node &node   = _nodes[index];
+		const Node &child1 = _nodes[node.child1];
+		const Node &child2 = _nodes[node.child2];
+		const Node &leafNode = _nodes[leaf];
+
+		const float area         = getArea(node);
+		const float combinedArea = getCombinedArea(node, leafNode);
+
+		// Cost of creating a new parent for this node and the new leaf
+		const float cost = 2.0f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = getCombinedArea(child1, leafNode) + inheritanceCost;
+		if (!child1.isLeaf())
+			cost1 -= getArea(child1);
+
+		float cost2 = getCombinedArea(child2, leafNode) + inheritanceCost;
+		if (!child2.isLeaf())
+			cost2 -= getArea(child2);
+
+		if ((cost < cost1) && (cost < cost2))
+			break;
+
+		index = (cost1 < cost2) ? node.child1 : node.child2;
+	}
+
+	const uint32 sibling   = index;
+	const uint32 oldParent = _nodes[sibling].parent;
+	const uint32 newParent = allocateNode();
+
+	Node &parent = _nodes[newParent];
+
+	parent.parent = oldParent;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	parent.height = _nodes[sibling].height + 1;
+	combine(parent, _nodes[sibling], _nodes[leaf]);
+
+	if (oldParent != kNull) {
+		if (_nodes[oldParent].child1 == sibling)
+			_nodes[oldParent].child1 = newParent;
+		else
+			_nodes[oldParent].child2 = newParent;
+	} else
+		_root = newParent;
+
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf   ].parent = newParent;
+
+	refit(newParent);
+}
+
+void SpatialIndex::removeLeaf(uint32 leaf) {
+	if (leaf == _root) {
+		_root = kNull;
+		return;
+	}
+
+	const uint32 parent      = _nodes[leaf].parent;
+	const uint32 grandParent = _nodes[parent].parent;
+	const uint32 sibling     = (_nodes[parent].child1 == leaf) ? _nodes[parent].child2 : _nodes[parent].child1;
+
+	_nodes[leaf].parent = kNull;
+
+	if (grandParent == kNull) {
+		_root = sibling;
+		_nodes[sibling].parent = kNull;
+
+		freeNode(parent);
+		return;
+	}
+
+	// Put the sibling in the place of the parent
+	if (_nodes[grandParent].child1 == parent)
+		_nodes[grandParent].child1 = sibling;
+	else
+		_nodes[grandParent].child2 = sibling;
+
+	_nodes[sibling].parent = grandParent;
+
+	freeNode(parent);
+
+	refit(grandParent);
+}
+
+void SpatialIndex::refit(uint32 node) {
+	while (node != kNull) {
+		node = balance(node);
+
+		Node &n = _nodes[node];
+
+		n.height = 1 + MAX(_nodes[n.child1].height, _nodes[n.child2].height);
+		combine(n, _nodes[n.child1], _nodes[n.child2]);
+
+		node = n.parent;
+	}
+}
+
+uint32 SpatialIndex::balance(uint32 iA) {
+	Node &a = _nodes[iA];
+	if (a.isLeaf() || (a.height < 2))
+		return iA;
+
+	const uint32 iB = a.child1;
+	const uint32 iC = a.child2;
+
+	Node &b = _nodes[iB];
+	Node &c = _nodes[iC];
+
+	const int32 balanceFactor = c.height - b.height;
+
+	if (balanceFactor > 1) {
+		// Rotate C up
+
+		const uint32 iF = c.child1;
+		const uint32 iG = c.child2;
+
+		Node &f = _nodes[iF];
+		Node &g = _nodes[iG];
+
+		c.child1 = iA;
+		c.parent = a.parent;
+		a.parent = iC;
+
+		if (c.parent != kNull) {
+			if (_nodes[c.parent].child1 == iA)
+				_nodes[c.parent].child1 = iC;
+			else
+				_nodes[c.parent].child2 = iC;
+		} else
+			_root = iC;
+
+		if (f.height > g.height) {
+			c.child2 = iF;
+			a.child2 = iG;
+			g.parent = iA;
+
+			combine(a, b, g);
+			combine(c, a, f);
+
+			a.height = 1 + MAX(b.height, g.height);
+			c.height = 1 + MAX(a.height, f.height);
+		} else {
+			c.child2 = iG;
+			a.child2 = iF;
+			f.parent = iA;
+
+			combine(a, b, f);
+			combine(c, a, g);
+
+			a.height = 1 + MAX(b.height, f.height);
+			c.height = 1 + MAX(a.height, g.height);
+		}
+
+		return iC;
+	}
+
+	if (balanceFactor < -1) {
+		// Rotate B up
+
+		const uint32 iD = b.child1;
+		const uint32 iE = b.child2;
+
+		Node &d = _nodes[iD];
+		Node &e = _nodes[iE];
+
+		b.child1 = iA;
+		b.parent = a.parent;
+		a.parent = iB;
+
+		if (b.parent != kNull) {
+			if (_nodes[b.parent].child1 == iA)
+				_nodes[b.parent].child1 = iB;
+			else
+				_nodes[b.parent].child2 = iB;
+		} else
+			_root = iB;
+
+		if (d.height > e.height) {
+			b.child2 = iD;
+			a.child1 = iE;
+			e.parent = iA;
+
+			combine(a, c, e);
+			combine(b, a, d);
+
+			a.height = 1 + MAX(c.height, e.height);
+			b.height = 1 + MAX(a.height, d.height);
+		} else {
+			b.child2 = iE;
+			a.child1 = iD;
+			d.parent = iA;
+
+			combine(a, c, d);
+			combine(b, a, e);
+
+			a.height = 1 + MAX(c.height, d.height);
+			b.height = 1 + MAX(a.height, e.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+void SpatialIndex::combine(Node &node, const Node &a, const Node &b) const {
+	for (int i = 0; i < 3; i++) {
+		node.min[i] = MIN(a.min[i], b.min[i]);
+		node.max[i] = MAX(a.max[i], b.max[i]);
+	}
+}
+
+float SpatialIndex::getCombinedArea(const Node &a, const Node &b) {
+	const float x = MAX(a.max[0], b.max[0]) - MIN(a.min[0], b.min[0]);
+	const float y = MAX(a.max[1], b.max[1]) - MIN(a.min[1], b.min[1]);
+	const float z = MAX(a.max[2], b.max[2]) - MIN(a.min[2], b.min[2]);
+
+	return x * y + y * z + z * x;
+}
+
+float SpatialIndex::getArea(const Node &node) {
+	const float x = node.max[0] - node.min[0];
+	const float y = node.max[1] - node.min[1];
+	const float z = node.max[2] - node.min[2];
+
+	return x * y + y * z + z * x;
+}
+
+bool SpatialIndex::contains(const Node &node, const float *min, const float *max) {
+	for (int i = 0; i < 3; i++)
+		if ((min[i] < node.min[i]) || (max[i] > node.max[i]))
+			return false;
+
+	return true;
+}
+
+/** Does the line from start to start + dir intersect the node's box? */
+static bool intersectsLine(const float *min, const float *max, const float *start, const float *dir) {
+	float tMin = 0.0f;
+	float tMax = 1.0f;
+
+	for (int i = 0; i < 3; i++) {
+		if (ABS(dir[i]) < 1e-6f) {
+			// Parallel to this slab
+			if ((start[i] < min[i]) || (start[i] > max[i]))
+				return false;
+
+			continue;
+		}
+
+		float t1 = (min[i] - start[i]) / dir[i];
+		float t2 = (max[i] - start[i]) / dir[i];
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		tMin = MAX(tMin, t1);
+		tMax = MIN(tMax, t2);
+
+		if (tMin > tMax)
+			return false;
+	}
+
+	return true;
+}
+
+void SpatialIndex::findLine(float x1, float y1, float z1, float x2, float y2, float z2,
+                            std::vector<Renderable *> &objects) const {
+
+	if (_root == kNull)
+		return;
+
+	const float start[3] = { x1, y1, z1 };
+	const float dir  [3] = { x2 - x1, y2 - y1, z2 - z1 };
+
+	std::vector<uint32> stack;
+	stack.reserve(64);
+	stack.push_back(_root);
+
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		if (!intersectsLine(node.min, node.max, start, dir))
+			continue;
+
+		if (node.isLeaf()) {
+			objects.push_back(node.object);
+			continue;
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+
+void SpatialIndex::findBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ,
+                           std::vector<Renderable *> &objects) const {
+
+	if (_root == kNull)
+		return;
+
+	const float min[3] = { minX, minY, minZ };
+	const float max[3] = { maxX, maxY, maxZ };
+
+	std::vector<uint32> stack;
+	stack.reserve(64);
+	stack.push_back(_root);
+
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		bool overlaps = true;
+		for (int i = 0; i < 3; i++)
+			if ((max[i] < node.min[i]) || (min[i] > node.max[i]))
+				overlaps = false;
+
+		if (!overlaps)
+			continue;
+
+		if (node.isLeaf()) {
+			objects.push_back(node.object);
+			continue;
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+
+} // End of namespace Graphics
@@ -0,0 +1,145 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A spatial index over the bounding boxes of renderable objects.
+ */
+
+#ifndef GRAPHICS_SPATIALINDEX_H
+#define GRAPHICS_SPATIALINDEX_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "src/common/types.h"
+
+namespace Common {
+	class BoundingBox;
+}
+
+namespace Graphics {
+
+class Renderable;
+
+/** A spatial index over the bounding boxes of renderable objects.
+ *
+ *  The index is a dynamic bounding volume hierarchy: a binary tree of
+ *  axis-aligned boxes, where each leaf holds one object and each inner
+ *  node encloses both its children. New objects are inserted at the place
+ *  where they enlarge the tree the least, and the tree is kept balanced
+ *  with rotations, so that ray and box queries only need to visit a
+ *  logarithmic number of nodes.
+ *
+ *  The boxes stored in the leaves are slightly larger than the objects'
+ *  actual bounding boxes. An object moving by a small distance will then
+ *  usually still be contained within its leaf's box, and the tree does not
+ *  need to be changed at all.
+ *
+ *  Queries only return candidates, whose stored boxes match. Callers need
+ *  to do their own, exact test on the returned objects.
+ *
+ *  The index does not do any locking of its own.
+ */
+class SpatialIndex : boost::noncopyable {
+public:
+	static const uint32 kInvalidProxy = 0xFFFFFFFF;
+
+	SpatialIndex();
+	~SpatialIndex();
+
+	/** Remove all objects from the index. */
+	void clear();
+
+	/** Return the number of objects in the index. */
+	size_t size() const;
+
+	/** Add an object with this (absolutized) bounding box to the index.
+	 *
+	 *  @return A proxy ID, used to update or remove the object later.
+	 */
+	uint32 add(Renderable *object, const Common::BoundingBox &box);
+	/** Remove the object with this proxy ID from the index. */
+	void remove(uint32 proxy);
+	/** Update the bounding box of the object with this proxy ID. */
+	void update(uint32 proxy, const Common::BoundingBox &box);
+
+	/** Find all objects whose bounding box intersects the line from x1.y1.z1 to x2.y2.z2. */
+	void findLine(float x1, float y1, float z1, float x2, float y2, float z2,
+	              std::vector<Renderable *> &objects) const;
+	/** Find all objects whose bounding box intersects the box from min to max. */
+	void findBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ,
+	             std::vector<Renderable *> &objects) const;
+
+private:
+	static const uint32 kNull = 0xFFFFFFFF;
+
+	/** A node in the tree. */
+	struct Node {
+		float min[3]; ///< Minimum coordinates of the node's box.
+		float max[3]; ///< Maximum coordinates of the node's box.
+
+		Renderable *object; ///< The object of a leaf node.
+
+		uint32 parent; ///< The parent node, or the next free node for unused nodes.
+		uint32 child1; ///< The first child of an inner node.
+		uint32 child2; ///< The second child of an inner node.
+
+		/** Height of the node in the tree. 0 for leaves, -1 for unused nodes. */
+		int32 height;
+
+		Node();
+
+		bool isLeaf() const;
+	};
+
+	std::vector<Node> _nodes;
+
+	uint32 _root;     ///< The root node of the tree.
+	uint32 _freeList; ///< The first unused node.
+
+	size_t _count; ///< The number of objects in the index.
+
+	uint32 allocateNode();
+	void freeNode(uint32 node);
+
+	void insertLeaf(uint32 leaf);
+	void removeLeaf(uint32 leaf);
+
+	/** Fix the boxes and heights from this node up to the root. */
+	void refit(uint32 node);
+	/** Rebalance the tree around this node, returning the node now in its place. */
+	uint32 balance(uint32 node);
+
+	/** Set the node's box to enclose both of these nodes' boxes. */
+	void combine(Node &node, const Node &a, const Node &b) const;
+
+	/** Half the surface area of a box enclosing both boxes. */
+	static float getCombinedArea(const Node &a, const Node &b);
+	/** Half the surface area of a node's box. */
+	static float getArea(const Node &node);
+
+	/** Does the node's box completely contain this box? */
+	static bool contains(const Node &node, const float *min, const float *max);
+};
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_SPATIALINDEX_H
@@ -86,9 +86,21 @@
 // BASIS, AND BROWN UNIVERSITY HAS NO OBLIGATION TO PROVIDE MAINTENANCE,
 // SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
 
+/* The vectorized conversion paths compute the same values as the lookup
+ * tables, bit for bit. The chroma contributions in the tables are the
+ * products of the centered chroma values and the color matrix factors,
+ * truncated toward zero. Since the chroma values never exceed 128 in
+ * magnitude, these can be computed exactly with a 16-bit multiply-high
+ * on the absolute value, adding the factor's integer part separately.
+ * The ITU luminance scaling, (c - 16) * 255 / 219, is likewise exact as
+ * c + (c * 36 / 219), again with a 16-bit multiply-high.
+ *
+ * Which path is used is decided at runtime, depending on the CPU. */
+
 #include "src/common/error.h"
 #include "src/common/singleton.h"
 #include "src/common/util.h"
+#include "src/common/simd.h"
 
 #include "src/graphics/yuv_to_rgb.h"
 
@@ -96,6 +108,190 @@ DECLARE_SINGLETON(Graphics::YUVToRGBManager)
 
 namespace Graphics {
 
+#ifdef COMMON_SIMD_X86
+
+// Fractional parts of the color matrix factors, times 65536
+static const uint16 kCrRFrac = 26302; // 0.419 / 0.299 - 1
+static const uint16 kCrGFrac = 46767; // 0.299 / 0.419
+static const uint16 kCbGFrac = 22571; // 0.114 / 0.331
+static const uint16 kCbBFrac = 50686; // 0.587 / 0.331 - 1
+
+// 36 / 219 times 65536, rounded so that the ITU scaling is exact
+static const uint16 kITUFrac = 10776;
+
+/** Multiply the centered chroma values by (intPart + frac / 65536), truncating toward zero. */
+COMMON_TARGET("sse2") static inline __m128i mulChromaSSE2(__m128i c, uint16 frac, bool intPart) {
+	const __m128i sign = _mm_srai_epi16(c, 15);
+	const __m128i abs  = _mm_sub_epi16(_mm_xor_si128(c, sign), sign);
+
+	__m128i m = _mm_mulhi_epu16(abs, _mm_set1_epi16(frac));
+	if (intPart)
+		m = _mm_add_epi16(m, abs);
+
+	return _mm_sub_epi16(_mm_xor_si128(m, sign), sign);
+}
+
+/** Map luminance plus chroma contribution to a final color value, in 16 bits. */
+COMMON_TARGET("sse2") static inline __m128i mapColorSSE2(__m128i y, __m128i offset, bool itu) {
+	__m128i c = _mm_add_epi16(y, offset);
+	if (!itu)
+		return c; // Clamped when packing to bytes
+
+	c = _mm_min_epi16(_mm_max_epi16(c, _mm_set1_epi16(16)), _mm_set1_epi16(235));
+	c = _mm_sub_epi16(c, _mm_set1_epi16(16));
+
+	return _mm_add_epi16(c, _mm_mulhi_epu16(c, _mm_set1_epi16(kITUFrac)));
+}
+
+/** Convert 16 pixels of a line, with the chroma contributions already spread to each pixel. */
+COMMON_TARGET("sse2") static inline void convertPixelsSSE2(byte *dst, const byte *ySrc, const byte *aSrc,
+		__m128i rLo, __m128i rHi, __m128i gLo, __m128i gHi, __m128i bLo, __m128i bHi, bool itu) {
+
+	const __m128i zero = _mm_setzero_si128();
+
+	const __m128i y   = _mm_loadu_si128((const __m128i *) ySrc);
+	const __m128i yLo = _mm_unpacklo_epi8(y, zero);
+	const __m128i yHi = _mm_unpackhi_epi8(y, zero);
+
+	const __m128i r = _mm_packus_epi16(mapColorSSE2(yLo, rLo, itu), mapColorSSE2(yHi, rHi, itu));
+	const __m128i g = _mm_packus_epi16(mapColorSSE2(yLo, gLo, itu), mapColorSSE2(yHi, gHi, itu));
+	const __m128i b = _mm_packus_epi16(mapColorSSE2(yLo, bLo, itu), mapColorSSE2(yHi, bHi, itu));
+	const __m128i a = aSrc ? _mm_loadu_si128((const __m128i *) aSrc) : _mm_set1_epi8((char) 0xFF);
+
+	const __m128i bgLo = _mm_unpacklo_epi8(b, g);
+	const __m128i bgHi = _mm_unpackhi_epi8(b, g);
+	const __m128i raLo = _mm_unpacklo_epi8(r, a);
+	const __m128i raHi = _mm_unpackhi_epi8(r, a);
+
+	_mm_storeu_si128((__m128i *) (dst +  0), _mm_unpacklo_epi16(bgLo, raLo));
+	_mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(bgLo, raLo));
+	_mm_storeu_si128((__m128i *) (dst + 32), _mm_unpacklo_epi16(bgHi, raHi));
+	_mm_storeu_si128((__m128i *) (dst + 48), _mm_unpackhi_epi16(bgHi, raHi));
+}
+
+/** Convert two lines sharing the same chroma values, 8 chroma values at a time. */
+COMMON_TARGET("sse2") static int convertLinesSSE2(byte *dst0, byte *dst1, const byte *y0, const byte *y1,
+		const byte *uSrc, const byte *vSrc, const byte *a0, const byte *a1, int count, bool itu) {
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(128);
+
+	int n = 0;
+	for (; (n + 8) <= count; n += 8) {
+		const __m128i cb = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (uSrc + n)), zero), bias);
+		const __m128i cr = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (vSrc + n)), zero), bias);
+
+		const __m128i r = mulChromaSSE2(cr, kCrRFrac, true);
+		const __m128i g = _mm_sub_epi16(zero, _mm_add_epi16(mulChromaSSE2(cr, kCrGFrac, false),
+		                                                    mulChromaSSE2(cb, kCbGFrac, false)));
+		const __m128i b = mulChromaSSE2(cb, kCbBFrac, true);
+
+		// Each chroma value covers two horizontally adjacent pixels
+		const __m128i rLo = _mm_unpacklo_epi16(r, r), rHi = _mm_unpackhi_epi16(r, r);
+		const __m128i gLo = _mm_unpacklo_epi16(g, g), gHi = _mm_unpackhi_epi16(g, g);
+		const __m128i bLo = _mm_unpacklo_epi16(b, b), bHi = _mm_unpackhi_epi16(b, b);
+
+		convertPixelsSSE2(dst0 + n * 8, y0 + n * 2, a0 ? (a0 + n * 2) : 0, rLo, rHi, gLo, gHi, bLo, bHi, itu);
+		convertPixelsSSE2(dst1 + n * 8, y1 + n * 2, a1 ? (a1 + n * 2) : 0, rLo, rHi, gLo, gHi, bLo, bHi, itu);
+	}
+
+	return n;
+}
+
+/* The AVX2 path works like the SSE2 path, on twice as many pixels. Since
+ * most AVX2 byte and word shuffles work within the two 128-bit lanes, the
+ * pixels are kept in the order 0-7, 16-23, 8-15, 24-31 after packing to
+ * bytes, which the final interleave into BGRA then undoes. */
+
+COMMON_TARGET("avx2") static inline __m256i mulChromaAVX2(__m256i c, uint16 frac, bool intPart) {
+	const __m256i sign = _mm256_srai_epi16(c, 15);
+	const __m256i abs  = _mm256_sub_epi16(_mm256_xor_si256(c, sign), sign);
+
+	__m256i m = _mm256_mulhi_epu16(abs, _mm256_set1_epi16(frac));
+	if (intPart)
+		m = _mm256_add_epi16(m, abs);
+
+	return _mm256_sub_epi16(_mm256_xor_si256(m, sign), sign);
+}
+
+COMMON_TARGET("avx2") static inline __m256i mapColorAVX2(__m256i y, __m256i offset, bool itu) {
+	__m256i c = _mm256_add_epi16(y, offset);
+	if (!itu)
+		return c;
+
+	c = _mm256_min_epi16(_mm256_max_epi16(c, _mm256_set1_epi16(16)), _mm256_set1_epi16(235));
+	c = _mm256_sub_epi16(c, _mm256_set1_epi16(16));
+
+	return _mm256_add_epi16(c, _mm256_mulhi_epu16(c, _mm256_set1_epi16(kITUFrac)));
+}
+
+/** Convert 32 pixels of a line, with the chroma contributions already spread to each pixel. */
+COMMON_TARGET("avx2") static inline void convertPixelsAVX2(byte *dst, const byte *ySrc, const byte *aSrc,
+		__m256i rLo, __m256i rHi, __m256i gLo, __m256i gHi, __m256i bLo, __m256i bHi, bool itu) {
+
+	const __m256i yLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (ySrc +  0)));
+	const __m256i yHi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (ySrc + 16)));
+
+	const __m256i r = _mm256_packus_epi16(mapColorAVX2(yLo, rLo, itu), mapColorAVX2(yHi, rHi, itu));
+	const __m256i g = _mm256_packus_epi16(mapColorAVX2(yLo, gLo, itu), mapColorAVX2(yHi, gHi, itu));
+	const __m256i b = _mm256_packus_epi16(mapColorAVX2(yLo, bLo, itu), mapColorAVX2(yHi, bHi, itu));
+
+	// Bring the alpha values into the same order as the packed color values
+	const __m256i a = aSrc ? _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *) aSrc), 0xD8) :
+	                         _mm256_set1_epi8((char) 0xFF);
+
+	const __m256i bgLo = _mm256_unpacklo_epi8(b, g); // Pixels 0-7, 8-15
+	const __m256i bgHi = _mm256_unpackhi_epi8(b, g); // Pixels 16-23, 24-31
+	const __m256i raLo = _mm256_unpacklo_epi8(r, a);
+	const __m256i raHi = _mm256_unpackhi_epi8(r, a);
+
+	const __m256i p0 = _mm256_unpacklo_epi16(bgLo, raLo); // Pixels 0-3, 8-11
+	const __m256i p1 = _mm256_unpackhi_epi16(bgLo, raLo); // Pixels 4-7, 12-15
+	const __m256i p2 = _mm256_unpacklo_epi16(bgHi, raHi); // Pixels 16-19, 24-27
+	const __m256i p3 = _mm256_unpackhi_epi16(bgHi, raHi); // Pixels 20-23, 28-31
+
+	_mm256_storeu_si256((__m256i *) (dst +  0), _mm256_permute2x128_si256(p0, p1, 0x20));
+	_mm256_storeu_si256((__m256i *) (dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+	_mm256_storeu_si256((__m256i *) (dst + 64), _mm256_permute2x128_si256(p2, p3, 0x20));
+	_mm256_storeu_si256((__m256i *) (dst + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+/** Convert two lines sharing the same chroma values, 16 chroma values at a time. */
+COMMON_TARGET("avx2") static int convertLinesAVX2(byte *dst0, byte *dst1, const byte *y0, const byte *y1,
+		const byte *uSrc, const byte *vSrc, const byte *a0, const byte *a1, int count, bool itu) {
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i bias = _mm256_set1_epi16(128);
+
+	int n = 0;
+	for (; (n + 16) <= count; n += 16) {
+		const __m256i cb = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (uSrc + n))), bias);
+		const __m256i cr = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (vSrc + n))), bias);
+
+		const __m256i r = mulChromaAVX2(cr, kCrRFrac, true);
+		const __m256i g = _mm256_sub_epi16(zero, _mm256_add_epi16(mulChromaAVX2(cr, kCrGFrac, false),
+		                                                          mulChromaAVX2(cb, kCbGFrac, false)));
+		const __m256i b = mulChromaAVX2(cb, kCbBFrac, true);
+
+		// Each chroma value covers two horizontally adjacent pixels. The unpacks give
+		// us the chroma values 0-3, 8-11 and 4-7, 12-15, which we then reorder.
+		const __m256i rA = _mm256_unpacklo_epi16(r, r), rB = _mm256_unpackhi_epi16(r, r);
+		const __m256i gA = _mm256_unpacklo_epi16(g, g), gB = _mm256_unpackhi_epi16(g, g);
+		const __m256i bA = _mm256_unpacklo_epi16(b, b), bB = _mm256_unpackhi_epi16(b, b);
+
+		const __m256i rLo = _mm256_permute2x128_si256(rA, rB, 0x20), rHi = _mm256_permute2x128_si256(rA, rB, 0x31);
+		const __m256i gLo = _mm256_permute2x128_si256(gA, gB, 0x20), gHi = _mm256_permute2x128_si256(gA, gB, 0x31);
+		const __m256i bLo = _mm256_permute2x128_si256(bA, bB, 0x20), bHi = _mm256_permute2x128_si256(bA, bB, 0x31);
+
+		convertPixelsAVX2(dst0 + n * 8, y0 + n * 2, a0 ? (a0 + n * 2) : 0, rLo, rHi, gLo, gHi, bLo, bHi, itu);
+		convertPixelsAVX2(dst1 + n * 8, y1 + n * 2, a1 ? (a1 + n * 2) : 0, rLo, rHi, gLo, gHi, bLo, bHi, itu);
+	}
+
+	return n;
+}
+
+#endif // COMMON_SIMD_X86
+
 class YUVToRGBLookup {
 public:
 	YUVToRGBLookup(YUVToRGBManager::LuminanceScale scale);
@@ -193,6 +389,27 @@ const YUVToRGBLookup *YUVToRGBManager::getLookup(LuminanceScale scale) {
 	return _lookup;
 }
 
+int YUVToRGBManager::convertLines(LuminanceScale scale, byte *dst0, byte *dst1, const byte *y0, const byte *y1,
+                                  const byte *uSrc, const byte *vSrc, const byte *a0, const byte *a1, int halfWidth) const {
+
+	int n = 0;
+
+#ifdef COMMON_SIMD_X86
+	const bool itu = scale == kScaleITU;
+
+	const Common::SIMDLevel simd = Common::getSIMDLevel();
+
+	if (simd >= Common::kSIMDAVX2)
+		n += convertLinesAVX2(dst0, dst1, y0, y1, uSrc, vSrc, a0, a1, halfWidth, itu);
+
+	if (simd >= Common::kSIMDSSE2)
+		n += convertLinesSSE2(dst0 + n * 8, dst1 + n * 8, y0 + n * 2, y1 + n * 2, uSrc + n, vSrc + n,
+		                      a0 ? (a0 + n * 2) : 0, a1 ? (a1 + n * 2) : 0, halfWidth - n, itu);
+#endif
+
+	return n;
+}
+
 #define PUT_PIXEL(s, a, d) \
 	L = &rgbToPix[(s)]; \
 	*((d)) = L[cb_b]; \
@@ -210,7 +427,15 @@ void YUVToRGBManager::convert420(LuminanceScale scale, byte *dst, int dstPitch,
 	dst += dstPitch * (yHeight - 2);
 
 	for (int h = 0; h < halfHeight; h++) {
-		for (int w = 0; w < halfWidth; w++) {
+		const int done = convertLines(scale, dst + dstPitch, dst, ySrc, ySrc + yPitch, uSrc, vSrc, aSrc, aSrc + yPitch, halfWidth);
+
+		dst  += done * 8;
+		ySrc += done * 2;
+		aSrc += done * 2;
+		uSrc += done;
+		vSrc += done;
+
+		for (int w = done; w < halfWidth; w++) {
 			const byte *L;
 
 			int16 cr_r  = _colorTab[*vSrc + 0 * 256];
@@ -249,7 +474,14 @@ void YUVToRGBManager::convert420(LuminanceScale scale, byte *dst, int dstPitch,
 	dst += dstPitch * (yHeight - 2);
 
 	for (int h = 0; h < halfHeight; h++) {
-		for (int w = 0; w < halfWidth; w++) {
+		const int done = convertLines(scale, dst + dstPitch, dst, ySrc, ySrc + yPitch, uSrc, vSrc, 0, 0, halfWidth);
+
+		dst  += done * 8;
+		ySrc += done * 2;
+		uSrc += done;
+		vSrc += done;
+
+		for (int w = done; w < halfWidth; w++) {
 			const byte *L;
 
 			int16 cr_r  = _colorTab[*vSrc + 0 * 256];
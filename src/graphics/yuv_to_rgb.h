@@ -80,6 +80,11 @@ private:
 
 	const YUVToRGBLookup *getLookup(LuminanceScale scale);
 
+	/** Convert the start of two lines sharing the same chroma values, as far as possible
+	 *  with the vectorized paths. Returns the number of chroma values converted. */
+	int convertLines(LuminanceScale scale, byte *dst0, byte *dst1, const byte *y0, const byte *y1,
+	                 const byte *uSrc, const byte *vSrc, const byte *a0, const byte *a1, int halfWidth) const;
+
 	YUVToRGBLookup *_lookup;
 	int16 _colorTab[4 * 256]; // 2048 bytes
 };
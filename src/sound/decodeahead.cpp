@@ -0,0 +1,275 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Decoding audio streams ahead of their playback.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "src/common/util.h"
+#include "src/common/thread.h"
+
+#include "src/sound/decodeahead.h"
+#include "src/sound/audiostream.h"
+
+/** Number of samples the ring buffer of each stream can hold. Needs to be a power of two. */
+static const size_t kDecodeAheadSamples = 32768;
+
+/** Number of samples to decode in one go. Matches the size of one OpenAL buffer. */
+static const size_t kDecodeChunkSamples = 16384;
+
+namespace Sound {
+
+DecodeAheadStream::DecodeAheadStream(AudioStream &stream) : _stream(&stream),
+	_channels(MAX(stream.getChannels(), 1)), _rate(stream.getRate()),
+	_samples(0), _capacity(kDecodeAheadSamples), _chunk(0), _chunkBuffer(0) {
+
+	// Only ever decode whole frames, so that the ring buffer always holds whole frames
+	_chunk = (kDecodeChunkSamples / _channels) * _channels;
+
+	_samples     = new int16[_capacity];
+	_chunkBuffer = new int16[_chunk];
+
+	_readPos.store(0);
+	_writePos.store(0);
+
+	_queued.store(false);
+	_cancelled.store(false);
+	_endOfStream.store(false);
+
+	_underruns.store(0);
+}
+
+DecodeAheadStream::~DecodeAheadStream() {
+	delete[] _samples;
+	delete[] _chunkBuffer;
+}
+
+int DecodeAheadStream::getChannels() const {
+	return _channels;
+}
+
+int DecodeAheadStream::getRate() const {
+	return _rate;
+}
+
+size_t DecodeAheadStream::getAvailable() const {
+	return _writePos.load() - _readPos.load();
+}
+
+size_t DecodeAheadStream::getFree() const {
+	return _capacity - getAvailable();
+}
+
+size_t DecodeAheadStream::readBuffer(int16 *buffer, size_t numSamples) {
+	numSamples  = MIN(numSamples, getAvailable());
+	numSamples -= numSamples % _channels;
+
+	const size_t readPos = _readPos.load();
+	const size_t start   = readPos & (_capacity - 1);
+	const size_t first   = MIN(numSamples, _capacity - start);
+
+	std::memcpy(buffer        , _samples + start, first                * sizeof(int16));
+	std::memcpy(buffer + first, _samples        , (numSamples - first) * sizeof(int16));
+
+	_readPos.store(readPos + numSamples);
+
+	return numSamples;
+}
+
+bool DecodeAheadStream::endOfStream() const {
+	// Check the flag first: once it's set, all samples have been written
+	return _endOfStream.load() && (getAvailable() < (size_t) _channels);
+}
+
+bool DecodeAheadStream::needsDecoding() const {
+	return !_queued.load() && !_cancelled.load() && !_endOfStream.load() && (getFree() >= _chunk);
+}
+
+bool DecodeAheadStream::decode() {
+	Common::StackLock lock(_mutex);
+
+	bool decoded = false;
+
+	while (!_cancelled.load() && !_endOfStream.load() && (getFree() >= _chunk)) {
+		const size_t count = _stream->readBuffer(_chunkBuffer, _chunk);
+		if (count == AudioStream::kSizeInvalid) {
+			warning("Failed reading from stream while decoding ahead");
+
+			_endOfStream.store(true);
+			break;
+		}
+
+		const size_t writePos = _writePos.load();
+		const size_t start    = writePos & (_capacity - 1);
+		const size_t first    = MIN(count, _capacity - start);
+
+		std::memcpy(_samples + start, _chunkBuffer        , first           * sizeof(int16));
+		std::memcpy(_samples        , _chunkBuffer + first, (count - first) * sizeof(int16));
+
+		_writePos.store(writePos + count);
+
+		decoded = decoded || (count > 0);
+
+		if (_stream->endOfStream()) {
+			_endOfStream.store(true);
+			break;
+		}
+
+		// No more data available right now
+		if (count < _chunk)
+			break;
+	}
+
+	_queued.store(false);
+
+	return decoded;
+}
+
+void DecodeAheadStream::cancel() {
+	_cancelled.store(true);
+
+	// Wait for a running decode to finish
+	Common::StackLock lock(_mutex);
+}
+
+uint32 DecodeAheadStream::getUnderruns() const {
+	return _underruns.load();
+}
+
+void DecodeAheadStream::addUnderrun() {
+	_underruns++;
+}
+
+
+class DecodeAheadPool::Worker : public Common::Thread {
+public:
+	Worker(DecodeAheadPool &pool) : _pool(&pool) {
+	}
+
+	~Worker() {
+		destroyThread();
+	}
+
+private:
+	DecodeAheadPool *_pool;
+
+	void threadMethod() {
+		while (!_killThread)
+			_pool->runJob();
+	}
+};
+
+
+DecodeAheadPool::DecodeAheadPool() : _notify(0), _newJob(_mutex) {
+}
+
+DecodeAheadPool::~DecodeAheadPool() {
+	cancel();
+	destroyWorkers();
+}
+
+void DecodeAheadPool::setThreadCount(size_t count) {
+	if (count == _workers.size())
+		return;
+
+	cancel();
+	destroyWorkers();
+
+	for (size_t i = 0; i < count; i++) {
+		Worker *worker = new Worker(*this);
+		if (!worker->createThread()) {
+			delete worker;
+
+			warning("DecodeAheadPool: Failed to create worker thread");
+			break;
+		}
+
+		_workers.push_back(worker);
+	}
+}
+
+void DecodeAheadPool::destroyWorkers() {
+	for (std::list<Worker *>::iterator w = _workers.begin(); w != _workers.end(); ++w)
+		delete *w;
+
+	_workers.clear();
+}
+
+bool DecodeAheadPool::isEnabled() const {
+	return !_workers.empty();
+}
+
+void DecodeAheadPool::setNotify(Common::Condition *notify) {
+	_notify = notify;
+}
+
+void DecodeAheadPool::decode(const StreamPtr &stream) {
+	assert(stream);
+
+	if (!stream->needsDecoding())
+		return;
+
+	if (_workers.empty()) {
+		stream->decode();
+		return;
+	}
+
+	stream->_queued.store(true);
+
+	Common::StackLock lock(_mutex);
+
+	_queue.push_back(stream);
+	_newJob.signal();
+}
+
+void DecodeAheadPool::cancel() {
+	Common::StackLock lock(_mutex);
+
+	for (std::deque<StreamPtr>::iterator s = _queue.begin(); s != _queue.end(); ++s)
+		(*s)->_queued.store(false);
+
+	_queue.clear();
+}
+
+void DecodeAheadPool::runJob() {
+	StreamPtr stream;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (_queue.empty())
+			_newJob.wait(100);
+
+		if (_queue.empty())
+			return;
+
+		stream = _queue.front();
+		_queue.pop_front();
+	}
+
+	// Wake up the sound thread, so that it can queue the new samples
+	if (stream->decode() && _notify)
+		_notify->signal();
+}
+
+} // End of namespace Sound
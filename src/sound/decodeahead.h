@@ -0,0 +1,167 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Decoding audio streams ahead of their playback.
+ */
+
+#ifndef SOUND_DECODEAHEAD_H
+#define SOUND_DECODEAHEAD_H
+
+#include <list>
+#include <deque>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/atomic.h"
+#include "src/common/types.h"
+#include "src/common/mutex.h"
+
+namespace Sound {
+
+class AudioStream;
+
+/** An audio stream that is decoded ahead of its playback.
+ *
+ *  The decoded samples are kept in a ring buffer, with exactly one thread
+ *  decoding into it and one thread reading out of it at any time. Since
+ *  both only ever advance their own position, the ring buffer itself needs
+ *  no locking.
+ *
+ *  The audio stream itself is only ever touched while decoding. After
+ *  cancel() returned, it is not touched anymore and can be safely deleted,
+ *  even though the DecodeAheadStream itself might still be alive.
+ */
+class DecodeAheadStream : boost::noncopyable {
+public:
+	DecodeAheadStream(AudioStream &stream);
+	~DecodeAheadStream();
+
+	/** Return the number channels in this stream. */
+	int getChannels() const;
+	/** Return the sample rate of the stream. */
+	int getRate() const;
+
+	/** Read up to numSamples already decoded samples. Returns the number of samples read. */
+	size_t readBuffer(int16 *buffer, size_t numSamples);
+
+	/** Has the stream been decoded and read completely? */
+	bool endOfStream() const;
+
+	/** Is there enough room in the ring buffer to decode more of the stream? */
+	bool needsDecoding() const;
+
+	/** Decode as much of the stream as fits into the ring buffer.
+	 *
+	 *  @return true if any new samples were decoded.
+	 */
+	bool decode();
+
+	/** Stop decoding, waiting for a decode currently in progress to finish. */
+	void cancel();
+
+	/** Return how often the playback ran out of decoded samples. */
+	uint32 getUnderruns() const;
+	/** Record that the playback ran out of decoded samples. */
+	void addUnderrun();
+
+private:
+	AudioStream *_stream;
+
+	int _channels;
+	int _rate;
+
+	int16 *_samples;  ///< The ring buffer of decoded samples.
+	size_t _capacity; ///< The number of samples the ring buffer can hold. A power of two.
+	size_t _chunk;    ///< The number of samples to decode in one go, whole frames only.
+
+	int16 *_chunkBuffer; ///< Scratch space to decode a chunk into.
+
+	boost::atomic<size_t> _readPos;  ///< Total number of samples read.
+	boost::atomic<size_t> _writePos; ///< Total number of samples decoded.
+
+	boost::atomic<bool> _queued;      ///< Is the stream waiting for a worker thread?
+	boost::atomic<bool> _cancelled;   ///< Was decoding cancelled?
+	boost::atomic<bool> _endOfStream; ///< Was the stream decoded completely?
+
+	boost::atomic<uint32> _underruns;
+
+	Common::Mutex _mutex; ///< Held while decoding.
+
+	size_t getAvailable() const;
+	size_t getFree() const;
+
+	friend class DecodeAheadPool;
+};
+
+/** A pool of worker threads decoding audio streams ahead of their playback.
+ *
+ *  Decoding compressed audio, like WMA or AAC, can take a considerable
+ *  amount of time. If the sound thread did this itself, one expensive
+ *  stream would delay refilling the buffers of all other sounds.
+ *
+ *  Instead, the sound thread hands the streams that need more data to
+ *  this pool, and only queues already decoded samples. Without any
+ *  worker threads, the streams are decoded right away.
+ */
+class DecodeAheadPool : boost::noncopyable {
+public:
+	typedef boost::shared_ptr<DecodeAheadStream> StreamPtr;
+
+	DecodeAheadPool();
+	~DecodeAheadPool();
+
+	/** Set the number of worker threads. 0 disables decoding ahead in the background. */
+	void setThreadCount(size_t count);
+
+	/** Is background decoding enabled? */
+	bool isEnabled() const;
+
+	/** Signal this condition whenever a worker thread decoded new samples. */
+	void setNotify(Common::Condition *notify);
+
+	/** Decode more of this stream, in the background if possible. */
+	void decode(const StreamPtr &stream);
+
+	/** Drop all streams waiting for a worker thread. */
+	void cancel();
+
+private:
+	class Worker;
+
+	std::list<Worker *> _workers;
+
+	std::deque<StreamPtr> _queue; ///< Streams waiting for a worker thread.
+
+	Common::Condition *_notify;
+
+	Common::Mutex     _mutex;
+	Common::Condition _newJob;
+
+	void destroyWorkers();
+
+	/** Wait for a stream and decode it. Called by the worker threads. */
+	void runJob();
+};
+
+} // End of namespace Sound
+
+#endif // SOUND_DECODEAHEAD_H
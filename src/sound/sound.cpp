@@ -23,7 +23,6 @@
  */
 
 #include <cassert>
-#include <cstring>
 
 #include "src/common/readstream.h"
 #include "src/common/util.h"
@@ -58,7 +57,8 @@ static const size_t kOpenALBufferSize = 32768;
 
 namespace Sound {
 
-SoundManager::SoundManager() : _ready(false), _hasSound(false), _hasMultiChannel(false), _format51(0) {
+SoundManager::SoundManager() : _ready(false), _hasSound(false), _hasMultiChannel(false), _format51(0),
+	_usedChannels(0) {
 }
 
 SoundManager::~SoundManager() {
@@ -68,6 +68,10 @@ void SoundManager::init() {
 	for (size_t i = 0; i < kChannelCount; i++)
 		_channels[i] = 0;
 
+	_activeChannels.clear();
+	_freeChannels.clear();
+	_usedChannels = 0;
+
 	for (size_t i = 0; i < kSoundTypeMAX; i++)
 		_types[i].gain = 1.0f;
 
@@ -112,6 +116,10 @@ void SoundManager::init() {
 	if (!_hasSound)
 		return;
 
+	// Decode the sounds ahead of their playback, on worker threads
+	_decoder.setNotify(&_needUpdate);
+	_decoder.setThreadCount(MAX(ConfigMan.getInt("soundthreads", 2), 0));
+
 	setListenerGain(ConfigMan.getDouble("volume", 1.0));
 
 	setTypeGain(kSoundTypeMusic, ConfigMan.getDouble("volume_music", 1.0));
@@ -124,11 +132,12 @@ void SoundManager::deinit() {
 	if (!_ready)
 		return;
 
-	if (!destroyThread())
-		warning("SoundManager::deinit(): Sound thread had to be killed");
+	destroyThread();
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		freeChannel(i);
+	_decoder.setThreadCount(0);
+
+	while (!_activeChannels.empty())
+		freeChannel(_activeChannels.back());
 
 	if (_hasSound) {
 		alcMakeContextCurrent(0);
@@ -191,7 +200,7 @@ bool SoundManager::isPlaying(size_t channel) const {
 		                        formatChannel(_channels[channel]).c_str(), error);
 
 	if (val != AL_PLAYING) {
-		if (!_channels[channel]->stream || _channels[channel]->stream->endOfStream()) {
+		if (!_channels[channel]->decoded || _channels[channel]->decoded->endOfStream()) {
 			ALint buffersQueued;
 			alGetSourcei(_channels[channel]->source, AL_BUFFERS_QUEUED, &buffersQueued);
 			if ((error = alGetError()) != AL_NO_ERROR)
@@ -319,7 +328,6 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 
 	ChannelHandle handle = newChannel();
 
-	_channels[handle.channel] = new Channel;
 	Channel &channel = *_channels[handle.channel];
 
 	channel.id              = handle.id;
@@ -328,6 +336,7 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 	channel.stream          = audStream;
 	channel.source          = 0;
 	channel.disposeAfterUse = disposeAfterUse;
+	channel.starving        = false;
 	channel.type            = type;
 	channel.typeIt          = _types[channel.type].list.end();
 	channel.finishedBuffers = 0;
@@ -346,6 +355,11 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 			if ((error = alGetError()) != AL_NO_ERROR)
 				throw Common::Exception("OpenAL error while generating sources: 0x%X", error);
 
+			/* Decode the start of the sound right away, so that it can start playing
+			 * immediately. The rest is decoded ahead in the background. */
+			channel.decoded.reset(new DecodeAheadStream(*channel.stream));
+			channel.decoded->decode();
+
 			// Create all needed buffers
 			for (size_t i = 0; i < kOpenALBufferCount; i++) {
 				ALuint buffer;
@@ -354,7 +368,7 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 				if ((error = alGetError()) != AL_NO_ERROR)
 					throw Common::Exception("OpenAL error while generating buffers: 0x%X", error);
 
-				if (fillBuffer(channel, buffer, channel.stream, channel.bufferSize[buffer])) {
+				if (fillBuffer(channel, buffer, channel.bufferSize[buffer])) {
 					// If we could fill the buffer with data, queue it
 
 					alSourceQueueBuffers(channel.source, 1, &buffer);
@@ -370,6 +384,8 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 
 			// Set the gain to the current sound type gain
 			alSourcef(channel.source, AL_GAIN, _types[channel.type].gain);
+
+			_decoder.decode(channel.decoded);
 		}
 
 		// Add the channel to the correct type list
@@ -480,15 +496,15 @@ void SoundManager::stopChannel(ChannelHandle &handle) {
 void SoundManager::pauseAll(bool pause) {
 	Common::StackLock lock(_mutex);
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		pauseChannel(_channels[i], pause);
+	for (std::vector<size_t>::const_iterator c = _activeChannels.begin(); c != _activeChannels.end(); ++c)
+		pauseChannel(_channels[*c], pause);
 }
 
 void SoundManager::stopAll() {
 	Common::StackLock lock(_mutex);
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		freeChannel(i);
+	while (!_activeChannels.empty())
+		freeChannel(_activeChannels.back());
 }
 
 void SoundManager::setListenerGain(float gain) {
@@ -585,6 +601,16 @@ uint64 SoundManager::getChannelDurationPlayed(const ChannelHandle &handle) {
 	return (getChannelSamplesPlayed(handle) * 1000) / channel->stream->getRate();
 }
 
+uint32 SoundManager::getChannelUnderruns(const ChannelHandle &handle) {
+	Common::StackLock lock(_mutex);
+
+	Channel *channel = getChannel(handle);
+	if (!channel || !channel->decoded)
+		return 0;
+
+	return channel->decoded->getUnderruns();
+}
+
 void SoundManager::setTypeGain(SoundType type, float gain) {
 	assert((type >= 0) && (type < kSoundTypeMAX));
 
@@ -602,23 +628,20 @@ void SoundManager::setTypeGain(SoundType type, float gain) {
 	}
 }
 
-bool SoundManager::fillBuffer(const Channel &channel, ALuint alBuffer,
-                              AudioStream *stream, ALsizei &bufferedSize) const {
-
+bool SoundManager::fillBuffer(const Channel &channel, ALuint alBuffer, ALsizei &bufferedSize) const {
 	bufferedSize = 0;
 
-	if (!stream)
+	if (!channel.stream)
 		throw Common::Exception("No stream in %s", formatChannel(&channel).c_str());
 
 	if (!_hasSound)
 		return true;
 
-	if (stream->endOfData())
-		return false;
+	DecodeAheadStream &stream = *channel.decoded;
 
 	ALenum format;
 
-	const int channelCount = stream->getChannels();
+	const int channelCount = stream.getChannels();
 	if        (channelCount == 1) {
 		format = AL_FORMAT_MONO16;
 	} else if (channelCount == 2) {
@@ -638,22 +661,17 @@ bool SoundManager::fillBuffer(const Channel &channel, ALuint alBuffer,
 		return false;
 	}
 
-	// Read in the required amount of samples
-	size_t numSamples = kOpenALBufferSize / 2;
-
+	// Take as many of the already decoded samples as fit
 	byte *buffer = new byte[kOpenALBufferSize];
-	std::memset(buffer, 0, kOpenALBufferSize);
 
-	numSamples = stream->readBuffer(reinterpret_cast<int16 *>(buffer), numSamples);
-	if (numSamples == AudioStream::kSizeInvalid) {
+	const size_t numSamples = stream.readBuffer(reinterpret_cast<int16 *>(buffer), kOpenALBufferSize / 2);
+	if (numSamples == 0) {
 		delete[] buffer;
-
-		warning("Failed reading from stream while filling buffer in %s", formatChannel(&channel).c_str());
 		return false;
 	}
 
 	bufferedSize = numSamples * 2;
-	alBufferData(alBuffer, format, buffer, bufferedSize, stream->getRate());
+	alBufferData(alBuffer, format, buffer, bufferedSize, stream.getRate());
 
 	delete[] buffer;
 
@@ -710,10 +728,10 @@ void SoundManager::bufferData(Channel &channel) {
 		channel.finishedBuffers += channel.bufferSize[freeBuffers[i]];
 	}
 
-	// Buffer as long as we still have data and free buffers
+	// Buffer as long as we still have decoded data and free buffers
 	std::list<ALuint>::iterator buffer = channel.freeBuffers.begin();
 	while (buffer != channel.freeBuffers.end()) {
-		if (!fillBuffer(channel, *buffer, channel.stream, channel.bufferSize[*buffer]))
+		if (!fillBuffer(channel, *buffer, channel.bufferSize[*buffer]))
 			break;
 
 		alSourceQueueBuffers(channel.source, 1, &*buffer);
@@ -723,6 +741,23 @@ void SoundManager::bufferData(Channel &channel) {
 
 		buffer = channel.freeBuffers.erase(buffer);
 	}
+
+	/* If nothing is queued anymore, a playing channel ran out of sound data,
+	 * because the decoding couldn't keep up. Count each time that happens. */
+	const bool starving = (channel.state == AL_PLAYING) && !channel.decoded->endOfStream() &&
+	                      (channel.freeBuffers.size() == channel.buffers.size());
+
+	if (starving && !channel.starving) {
+		channel.decoded->addUnderrun();
+
+		debugC(Common::kDebugSound, 1, "Sound channel %s ran out of data (%u times)",
+		       formatChannel(&channel).c_str(), channel.decoded->getUnderruns());
+	}
+
+	channel.starving = starving;
+
+	// Keep the decoding ahead of the playback
+	_decoder.decode(channel.decoded);
 }
 
 void SoundManager::checkReady() {
@@ -733,12 +768,12 @@ void SoundManager::checkReady() {
 void SoundManager::update() {
 	Common::StackLock lock(_mutex);
 
-	size_t channelCount = 0;
-	for (size_t i = 0; i < kChannelCount; i++) {
-		if (!_channels[i])
-			continue;
+	const size_t channelCount = _activeChannels.size();
 
-		channelCount++;
+	/* Go through the active channels from the back. Freeing a channel moves
+	 * the last active channel into its place, which we've already looked at. */
+	for (size_t n = channelCount; n-- > 0; ) {
+		const size_t i = _activeChannels[n];
 
 		// Free the channel if it is no longer playing
 		if (!isPlaying(i)) {
@@ -756,13 +791,23 @@ void SoundManager::update() {
 ChannelHandle SoundManager::newChannel() {
 	size_t foundChannel = kChannelInvalid;
 
-	for (size_t i = 0; (i < kChannelCount) && (foundChannel == kChannelInvalid); i++)
-		if (!_channels[i])
-			foundChannel = i;
+	// Reuse a freed channel first, before touching a new one
+	if (!_freeChannels.empty()) {
+		foundChannel = _freeChannels.back();
+		_freeChannels.pop_back();
+	} else if (_usedChannels < kChannelCount)
+		foundChannel = _usedChannels++;
 
 	if (foundChannel == kChannelInvalid)
 		throw Common::Exception("All sound channels occupied");
 
+	assert(!_channels[foundChannel]);
+
+	_channels[foundChannel] = new Channel;
+	_channels[foundChannel]->activeIndex = _activeChannels.size();
+
+	_activeChannels.push_back(foundChannel);
+
 	ChannelHandle handle;
 
 	handle.channel = foundChannel;
@@ -825,6 +870,10 @@ void SoundManager::freeChannel(size_t channel) {
 		// Nothing to do
 		return;
 
+	// Make sure the stream isn't being decoded anymore
+	if (c->decoded)
+		c->decoded->cancel();
+
 	// Discard the stream, if requested
 	if (c->disposeAfterUse)
 		delete c->stream;
@@ -843,6 +892,16 @@ void SoundManager::freeChannel(size_t channel) {
 	if (c->typeIt != _types[c->type].list.end())
 		_types[c->type].list.erase(c->typeIt);
 
+	// Remove the channel from the active list, by moving the last active channel into its place
+	const size_t lastChannel = _activeChannels.back();
+
+	_activeChannels[c->activeIndex] = lastChannel;
+	_channels[lastChannel]->activeIndex = c->activeIndex;
+
+	_activeChannels.pop_back();
+
+	_freeChannels.push_back(channel);
+
 	// And finally delete the channel itself
 	delete c;
 	_channels[channel] = 0;
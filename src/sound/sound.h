@@ -37,6 +37,7 @@
 
 #include <list>
 #include <map>
+#include <vector>
 
 #include "src/common/types.h"
 #include "src/common/singleton.h"
@@ -45,6 +46,7 @@
 #include "src/common/ustring.h"
 
 #include "src/sound/types.h"
+#include "src/sound/decodeahead.h"
 
 namespace Common {
 	class SeekableReadStream;
@@ -86,6 +88,9 @@ public:
 	uint64 getChannelSamplesPlayed(const ChannelHandle &handle);
 	/** Return the time this channel has already played in milliseconds. */
 	uint64 getChannelDurationPlayed(const ChannelHandle &handle);
+
+	/** Return how often this channel ran out of decoded sound data while playing. */
+	uint32 getChannelUnderruns(const ChannelHandle &handle);
 	// '---
 
 	// .--- Playing sounds
@@ -191,11 +196,19 @@ private:
 		uint32 id;    ///< The channel's ID.
 		size_t index; ///< The channel's index.
 
+		size_t activeIndex; ///< The channel's position in the list of active channels.
+
 		ALint state; ///< The sound's state.
 
 		AudioStream *stream;  ///< The actual audio stream.
 		bool disposeAfterUse; ///< Delete the audio stream when done playing?
 
+		/** The audio stream, decoded ahead of the playback. */
+		DecodeAheadPool::StreamPtr decoded;
+
+		/** Did the channel run out of sound data while playing? */
+		bool starving;
+
 		ALuint source; ///< OpenAL source for this channel.
 
 		std::list<ALuint> buffers;     ///< List of buffers for that channel.
@@ -222,6 +235,16 @@ private:
 	Channel *_channels[kChannelCount]; ///< The sound channels.
 	Type     _types   [kSoundTypeMAX]; ///< The sound types.
 
+	/** The indices of all channels in use, in no particular order. */
+	std::vector<size_t> _activeChannels;
+	/** The indices of channels that were in use once, but were freed since. */
+	std::vector<size_t> _freeChannels;
+	/** The number of channels that were ever in use. All channels from here on are free. */
+	size_t _usedChannels;
+
+	/** The worker threads decoding the audio streams ahead of their playback. */
+	DecodeAheadPool _decoder;
+
 	uint32 _curID; ///< The ID the next sound will get.
 
 	Common::Mutex _mutex;
@@ -238,7 +261,7 @@ private:
 	/** Update the sound information. Called regularly from within the thread method. */
 	void update();
 
-	/** Look for a free place in the channel vector. */
+	/** Find a free channel, and add it to the list of active channels. */
 	ChannelHandle newChannel();
 
 	/** Buffer more sound from the channel to the OpenAL buffers. */
@@ -266,9 +289,8 @@ private:
 
 	void threadMethod();
 
-	/** Fill the buffer with data from the audio stream. */
-	bool fillBuffer(const Channel &channel, ALuint alBuffer,
-	                AudioStream *stream, ALsizei &bufferedSize) const;
+	/** Fill the buffer with data already decoded from the audio stream. */
+	bool fillBuffer(const Channel &channel, ALuint alBuffer, ALsizei &bufferedSize) const;
 
 	/** Return a string representing this channel. */
 	Common::UString formatChannel(const Channel *channel) const;
@@ -218,9 +218,6 @@ void Bink::startVideo() {
 }
 
 void Bink::processData() {
-	if (getTimeToNextFrame() > 0)
-		return;
-
 	if (_curFrame >= _frames.size()) {
 		finish();
 		return;
@@ -252,9 +249,8 @@ void Bink::processData() {
 				//                  Number of samples in bytes
 				audio.sampleCount = _bink->readUint32LE() / (2 * audio.channels);
 
-				audio.bits =
-					new Common::BitStream32LELSB(new Common::SeekableSubReadStream(_bink,
-					    audioPacketStart + 4, audioPacketEnd), true);
+				Common::SeekableSubReadStream audioPacketStream(_bink, audioPacketStart + 4, audioPacketEnd);
+				audio.bits = new Common::MemoryBitStream32LELSB(audioPacketStream);
 
 				audioPacket(audio);
 
@@ -271,9 +267,8 @@ void Bink::processData() {
 	size_t videoPacketStart = _bink->pos();
 	size_t videoPacketEnd   = _bink->pos() + frameSize;
 
-	frame.bits =
-		new Common::BitStream32LELSB(new Common::SeekableSubReadStream(_bink,
-		    videoPacketStart, videoPacketEnd), true);
+	Common::SeekableSubReadStream videoPacketStream(_bink, videoPacketStart, videoPacketEnd);
+	frame.bits = new Common::MemoryBitStream32LELSB(videoPacketStream);
 
 	videoPacket(frame);
 
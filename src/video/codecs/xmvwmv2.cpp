@@ -340,8 +340,8 @@ void XMVWMV2Codec::init() {
 void XMVWMV2Codec::decodeFrame(Graphics::Surface &surface,
                                Common::SeekableReadStream &dataStream) {
 
-	Common::BitStream32LEMSB bits(dataStream);
-	DecodeContext            ctx(bits);
+	Common::MemoryBitStream32LEMSB bits(dataStream);
+	DecodeContext                  ctx(bits);
 
 	initDecodeContext(ctx);
 
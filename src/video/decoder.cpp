@@ -23,10 +23,14 @@
  */
 
 #include <cassert>
+#include <cstring>
 
 #include "src/common/error.h"
+#include "src/common/util.h"
 #include "src/common/memreadstream.h"
 #include "src/common/threads.h"
+#include "src/common/thread.h"
+#include "src/common/configman.h"
 #include "src/common/debug.h"
 
 #include "src/graphics/graphics.h"
@@ -39,13 +43,39 @@
 #include "src/sound/audiostream.h"
 #include "src/sound/decoders/pcm.h"
 
+#include "src/events/events.h"
+
 namespace Video {
 
+VideoDecoder::QueuedFrame::QueuedFrame() : surface(0), time(0) {
+}
+
+
+class VideoDecoder::Worker : public Common::Thread {
+public:
+	Worker(VideoDecoder &video) : _video(&video) {
+	}
+
+	~Worker() {
+		destroyThread();
+	}
+
+private:
+	VideoDecoder *_video;
+
+	void threadMethod() {
+		while (!_killThread)
+			_video->decodeAhead();
+	}
+};
+
+
 VideoDecoder::VideoDecoder() : Renderable(Graphics::kRenderableTypeVideo),
 	_started(false), _finished(false), _needCopy(false),
 	_width(0), _height(0), _surface(0), _texture(0),
 	_textureWidth(0.0f), _textureHeight(0.0f), _scale(kScaleNone),
-	_sound(0), _soundRate(0), _soundFlags(0) {
+	_sound(0), _soundRate(0), _soundFlags(0), _frameRead(0), _frameWrite(0),
+	_frameFree(_frameMutex), _worker(0), _droppedFrames(0) {
 
 }
 
@@ -55,6 +85,9 @@ VideoDecoder::~VideoDecoder() {
 	if (_texture != 0)
 		GfxMan.abandon(&_texture, 1);
 
+	for (std::vector<QueuedFrame>::iterator f = _frameQueue.begin(); f != _frameQueue.end(); ++f)
+		delete f->surface;
+
 	delete _surface;
 
 	deinitSound();
@@ -63,6 +96,9 @@ VideoDecoder::~VideoDecoder() {
 void VideoDecoder::deinit() {
 	hide();
 
+	// The decoder thread calls into the concrete decoder, so it has to stop first
+	stopDecodeAhead();
+
 	GLContainer::removeFromQueue(Graphics::kQueueGLContainer);
 }
 
@@ -187,14 +223,140 @@ void VideoDecoder::copyData() {
 
 	if (!_surface)
 		throw Common::Exception("No video data while trying to copy");
+
+	copyFrame(*_surface);
+
+	_needCopy = false;
+}
+
+void VideoDecoder::copyFrame(const Graphics::Surface &surface) {
 	if (_texture == 0)
 		throw Common::Exception("No texture while trying to copy");
 
 	glBindTexture(GL_TEXTURE_2D, _texture);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _surface->getWidth(), _surface->getHeight(),
-	                GL_BGRA, GL_UNSIGNED_BYTE, _surface->getData());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, surface.getWidth(), surface.getHeight(),
+	                GL_BGRA, GL_UNSIGNED_BYTE, surface.getData());
+}
+
+void VideoDecoder::startDecodeAhead() {
+	stopDecodeAhead();
+
+	const size_t frameCount = MAX(ConfigMan.getInt("videoframes", 4), 0);
+	if (!_surface || (frameCount == 0))
+		return;
+
+	if (_frameQueue.size() != frameCount) {
+		for (std::vector<QueuedFrame>::iterator f = _frameQueue.begin(); f != _frameQueue.end(); ++f)
+			delete f->surface;
+
+		_frameQueue.resize(frameCount);
+
+		for (std::vector<QueuedFrame>::iterator f = _frameQueue.begin(); f != _frameQueue.end(); ++f)
+			f->surface = new Graphics::Surface(_surface->getWidth(), _surface->getHeight());
+	}
+
+	_worker = new Worker(*this);
+	if (!_worker->createThread()) {
+		delete _worker;
+		_worker = 0;
+
+		warning("VideoDecoder: Failed to create decoder thread");
+	}
+}
+
+void VideoDecoder::stopDecodeAhead() {
+	if (!_worker)
+		return;
+
+	delete _worker;
+	_worker = 0;
+
+	_frameRead.store(_frameWrite.load());
+
+	if (_droppedFrames > 0)
+		debugC(Common::kDebugVideo, 1, "Dropped %u video frames", _droppedFrames);
+
+	_droppedFrames = 0;
+}
+
+void VideoDecoder::decodeAhead() {
+	{
+		Common::StackLock lock(_frameMutex);
+
+		// Wait until there's room for a new frame in the queue
+		if (_finished || ((_frameWrite.load() - _frameRead.load()) >= _frameQueue.size())) {
+			_frameFree.wait(100);
+			return;
+		}
+	}
+
+	// Timestamp at which the frame would have been decoded without decoding ahead
+	const uint32 frameTime = EventMan.getTimestamp() + getTimeToNextFrame();
+
+	try {
+		processData();
+	} catch (Common::Exception &e) {
+		e.add("Failed decoding video frame");
+
+		Common::printException(e, "WARNING: ");
+		finish();
+		return;
+	}
+
+	if (!_needCopy) {
+		/* The decoder wasn't ready for a new frame yet. Instead of asking it
+		 * again right away, wait until the next frame is due, but only for a
+		 * short while, so that stopping the video stays responsive. */
+		const uint32 waitTime = CLIP<uint32>(getTimeToNextFrame(), 1, 10);
+
+		Common::StackLock lock(_frameMutex);
+		_frameFree.wait(waitTime);
+		return;
+	}
+
+	// Copy the new frame into the queue
+	QueuedFrame &frame = _frameQueue[_frameWrite.load() % _frameQueue.size()];
+
+	std::memcpy(frame.surface->getData(), _surface->getData(),
+	            _surface->getWidth() * _surface->getHeight() * 4);
+	frame.time = frameTime;
 
 	_needCopy = false;
+
+	_frameWrite++;
+}
+
+void VideoDecoder::showQueuedFrame() {
+	const uint32 curTime = EventMan.getTimestamp();
+
+	const size_t frameWrite = _frameWrite.load();
+	size_t frameRead = _frameRead.load();
+
+	// Find the newest frame that's due, dropping all the ones before it
+	const QueuedFrame *frame = 0;
+	for (; frameRead != frameWrite; frameRead++) {
+		const QueuedFrame &queued = _frameQueue[frameRead % _frameQueue.size()];
+		if (queued.time > curTime)
+			break;
+
+		if (frame)
+			_droppedFrames++;
+
+		frame = &queued;
+	}
+
+	if (!frame)
+		return;
+
+	debugC(Common::kDebugVideo, 9, "New video frame");
+
+	copyFrame(*frame->surface);
+
+	// Give the frames back to the decoder thread
+	Common::StackLock lock(_frameMutex);
+
+	_frameRead.store(frameRead);
+	_frameFree.signal();
 }
 
 void VideoDecoder::setScale(Scale scale) {
@@ -202,7 +364,14 @@ void VideoDecoder::setScale(Scale scale) {
 }
 
 bool VideoDecoder::isPlaying() const {
-	return !_finished || SoundMan.isPlaying(_soundHandle);
+	if (!_finished)
+		return true;
+
+	// Still frames left to show?
+	if (_frameRead.load() != _frameWrite.load())
+		return true;
+
+	return SoundMan.isPlaying(_soundHandle);
 }
 
 void VideoDecoder::getSize(uint32 &width, uint32 &height) const {
@@ -211,6 +380,11 @@ void VideoDecoder::getSize(uint32 &width, uint32 &height) const {
 }
 
 void VideoDecoder::update() {
+	if (_worker) {
+		showQueuedFrame();
+		return;
+	}
+
 	if (getTimeToNextFrame() > 0)
 		return;
 
@@ -293,6 +467,7 @@ void VideoDecoder::finish() {
 
 void VideoDecoder::start() {
 	startVideo();
+	startDecodeAhead();
 
 	show();
 }
@@ -300,6 +475,7 @@ void VideoDecoder::start() {
 void VideoDecoder::abort() {
 	hide();
 
+	stopDecodeAhead();
 	finish();
 }
 
@@ -25,7 +25,11 @@
 #ifndef VIDEO_DECODER_H
 #define VIDEO_DECODER_H
 
+#include <vector>
+
 #include "src/common/types.h"
+#include "src/common/atomic.h"
+#include "src/common/mutex.h"
 
 #include "src/graphics/types.h"
 #include "src/graphics/glcontainer.h"
@@ -44,7 +48,18 @@ namespace Sound {
 
 namespace Video {
 
-/** A generic interface for video decoders. */
+/** A generic interface for video decoders.
+ *
+ *  Normally, the video frames are decoded ahead of their display, by a
+ *  separate decoder thread. The decoded frames are kept in a ring buffer
+ *  of surfaces, together with the timestamps at which they are due. The
+ *  rendering thread then only needs to upload the newest due frame into
+ *  the texture. If it falls behind, older frames are dropped.
+ *
+ *  While the decoder thread is running, it exclusively owns the state
+ *  of the concrete video decoder. Only if decoding ahead is disabled
+ *  are the frames decoded by the rendering thread, once they are due.
+ */
 class VideoDecoder : public Graphics::GLContainer, public Graphics::Renderable {
 public:
 	enum Scale {
@@ -80,7 +95,7 @@ public:
 
 protected:
 	bool _started;  ///< Has playback started?
-	bool _finished; ///< Has playback finished?
+	boost::atomic<bool> _finished; ///< Has playback finished?
 	bool _needCopy; ///< Is new frame content available that needs to by copied?
 
 	uint32 _width;  ///< The video's width.
@@ -124,6 +139,16 @@ protected:
 	void doDestroy();
 
 private:
+	/** A decoded frame, waiting to be shown. */
+	struct QueuedFrame {
+		Graphics::Surface *surface; ///< The frame's image.
+		uint32 time; ///< The timestamp at which the frame is due.
+
+		QueuedFrame();
+	};
+
+	class Worker;
+
 	Graphics::TextureID _texture;
 
 	float _textureWidth;
@@ -136,12 +161,39 @@ private:
 	uint16                     _soundRate;
 	byte                       _soundFlags;
 
+	/** The ring buffer of frames decoded ahead. */
+	std::vector<QueuedFrame> _frameQueue;
+
+	boost::atomic<size_t> _frameRead;  ///< Number of frames taken out of the queue.
+	boost::atomic<size_t> _frameWrite; ///< Number of frames put into the queue.
+
+	Common::Mutex     _frameMutex; ///< Mutex protecting the waits for free frames.
+	Common::Condition _frameFree;  ///< Signaled when frames were taken out of the queue.
+
+	Worker *_worker; ///< The thread decoding the frames ahead.
+
+	uint32 _droppedFrames; ///< Number of decoded frames that were never shown.
+
 
 	/** Update the video, if necessary. */
 	void update();
 
 	/** Copy the video image data to the texture. */
 	void copyData();
+	/** Copy this frame's image data to the texture. */
+	void copyFrame(const Graphics::Surface &surface);
+
+	/** Start decoding frames ahead on a separate thread, if enabled. */
+	void startDecodeAhead();
+	/** Stop decoding frames ahead and clear the frame queue. */
+	void stopDecodeAhead();
+
+	/** Decode the next frame into the queue, or wait for room in the queue.
+	 *  Called by the decoder thread. */
+	void decodeAhead();
+
+	/** Show the newest due frame in the queue, dropping the ones before. */
+	void showQueuedFrame();
 
 	/** Get the dimensions of the quad to draw the texture on. */
 	void getQuadDimensions(float &width, float &height) const;
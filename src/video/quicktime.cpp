@@ -311,9 +311,6 @@ void QuickTimeDecoder::processData() {
 		return;
 	}
 
-	if (getTimeToNextFrame() > 0)
-		return;
-
 	_curFrame++;
 	_nextFrameStartTime += getFrameDuration();
 
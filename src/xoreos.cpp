@@ -48,6 +48,8 @@
 #include "src/aurora/talkman.h"
 #include "src/aurora/util.h"
 
+#include "src/aurora/nwscript/scriptcache.h"
+
 #include "src/graphics/queueman.h"
 #include "src/graphics/graphics.h"
 
@@ -319,6 +321,7 @@ static void deinit() {
 	Aurora::LanguageManager::destroy();
 	Aurora::TalkManager::destroy();
 	Aurora::TwoDARegistry::destroy();
+	Aurora::NWScript::ScriptCache::destroy();
 	Aurora::ResourceManager::destroy();
 	Aurora::FileTypeManager::destroy();
 
@@ -0,0 +1,340 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Stress test for requesting resources from several threads at once.
+ *
+ *  Writes two KEY/BIF pairs filled with random resources. The first pair
+ *  is indexed once, while the main thread keeps indexing and removing the
+ *  second pair. At the same time, several reader threads request random
+ *  resources out of both and compare every byte against the data written.
+ *
+ *  This is done once with memory-mapped archives and once with archives
+ *  read through files.
+ */
+
+#define SDL_MAIN_HANDLED
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/endianness.h"
+#include "src/common/readstream.h"
+#include "src/common/writefile.h"
+#include "src/common/filepath.h"
+#include "src/common/thread.h"
+#include "src/common/threads.h"
+#include "src/common/atomic.h"
+#include "src/common/changeid.h"
+#include "src/common/configman.h"
+
+#include "src/aurora/types.h"
+#include "src/aurora/resman.h"
+
+static const uint32 kResourceCount  = 256;
+static const uint32 kMaxSize        = 65536;
+static const uint32 kThreadCount    = 8;
+static const uint32 kIndexCycles    = 200;
+
+static const Aurora::FileType kType = Aurora::kFileTypeTXT;
+
+/** A small, fast xorshift random number generator, so that runs are repeatable. */
+class Random {
+public:
+	Random(uint32 seed) : _state(seed ? seed : 0x2545F491) {
+	}
+
+	uint32 next() {
+		_state ^= _state << 13;
+		_state ^= _state >> 17;
+		_state ^= _state << 5;
+
+		return _state;
+	}
+
+	uint32 next(uint32 max) {
+		return next() % max;
+	}
+
+private:
+	uint32 _state;
+};
+
+/** All resources within one KEY/BIF pair. */
+struct ResourceSet {
+	Common::UString prefix;
+	std::vector< std::vector<byte> > data;
+
+	Common::UString getName(uint32 index) const {
+		return Common::UString::format("%s%04u", prefix.c_str(), index);
+	}
+};
+
+static void createResources(ResourceSet &set, const Common::UString &prefix, uint32 seed) {
+	Random random(seed);
+
+	set.prefix = prefix;
+	set.data.resize(kResourceCount);
+
+	for (uint32 i = 0; i < kResourceCount; i++) {
+		// Include a few empty resources
+		const uint32 size = ((i % 16) == 0) ? 0 : random.next(kMaxSize);
+
+		set.data[i].resize(size);
+		for (uint32 j = 0; j < size; j++)
+			set.data[i][j] = random.next() >> 24;
+	}
+}
+
+static void writeBIF(const Common::UString &file, const ResourceSet &set) {
+	Common::WriteFile bif(file);
+
+	bif.writeUint32BE(MKTAG('B', 'I', 'F', 'F'));
+	bif.writeUint32BE(MKTAG('V', '1', ' ', ' '));
+	bif.writeUint32LE(set.data.size());
+	bif.writeUint32LE(0);
+	bif.writeUint32LE(20);
+
+	uint32 offset = 20 + set.data.size() * 16;
+	for (uint32 i = 0; i < set.data.size(); i++) {
+		bif.writeUint32LE(i);
+		bif.writeUint32LE(offset);
+		bif.writeUint32LE(set.data[i].size());
+		bif.writeUint32LE(kType);
+
+		offset += set.data[i].size();
+	}
+
+	for (uint32 i = 0; i < set.data.size(); i++)
+		if (!set.data[i].empty())
+			bif.write(&set.data[i][0], set.data[i].size());
+
+	bif.flush();
+	bif.close();
+}
+
+static void writeKEY(const Common::UString &file, const Common::UString &bifName, const ResourceSet &set) {
+	Common::WriteFile key(file);
+
+	const uint32 offFileTable = 64;
+	const uint32 offBIFName   = offFileTable + 12;
+	const uint32 offResTable  = offBIFName + bifName.size();
+
+	key.writeUint32BE(MKTAG('K', 'E', 'Y', ' '));
+	key.writeUint32BE(MKTAG('V', '1', ' ', ' '));
+	key.writeUint32LE(1);
+	key.writeUint32LE(set.data.size());
+	key.writeUint32LE(offFileTable);
+	key.writeUint32LE(offResTable);
+
+	for (uint32 i = 0; i < 10; i++)
+		key.writeUint32LE(0);
+
+	key.writeUint32LE(0);
+	key.writeUint32LE(offBIFName);
+	key.writeUint16LE(bifName.size());
+	key.writeUint16LE(1);
+
+	key.write(bifName.c_str(), bifName.size());
+
+	for (uint32 i = 0; i < set.data.size(); i++) {
+		char name[16];
+		std::memset(name, 0, sizeof(name));
+		std::strncpy(name, set.getName(i).c_str(), sizeof(name));
+
+		key.write(name, sizeof(name));
+		key.writeUint16LE(kType);
+		key.writeUint32LE(i);
+	}
+
+	key.flush();
+	key.close();
+}
+
+/** A thread requesting random resources and comparing them against the expected data. */
+class ReaderThread : public Common::Thread {
+public:
+	ReaderThread(const ResourceSet &fixed, const ResourceSet &changing, uint32 seed) :
+		_fixed(&fixed), _changing(&changing), _random(seed), _reads(0), _errors(0) {
+
+	}
+
+	~ReaderThread() {
+		destroyThread();
+	}
+
+	uint32 getReads() const {
+		return _reads.load();
+	}
+
+	uint32 getErrors() const {
+		return _errors.load();
+	}
+
+private:
+	const ResourceSet *_fixed;
+	const ResourceSet *_changing;
+
+	Random _random;
+
+	boost::atomic<uint32> _reads;
+	boost::atomic<uint32> _errors;
+
+	void threadMethod() {
+		std::vector<byte> buffer(kMaxSize);
+
+		while (!_killThread) {
+			const bool fromFixed = (_random.next() & 1) != 0;
+
+			const ResourceSet &set = fromFixed ? *_fixed : *_changing;
+			const uint32 index = _random.next(kResourceCount);
+
+			try {
+				if (!check(set, index, fromFixed, buffer))
+					_errors++;
+			} catch (Common::Exception &e) {
+				Common::printException(e, "WARNING: ");
+				_errors++;
+			}
+
+			_reads++;
+		}
+	}
+
+	static bool check(const ResourceSet &set, uint32 index, bool mustExist, std::vector<byte> &buffer) {
+		const Common::UString name = set.getName(index);
+		const std::vector<byte> &expected = set.data[index];
+
+		Common::SeekableReadStream *stream = ResMan.getResource(name, kType);
+		if (!stream) {
+			if (mustExist)
+				warning("Resource \"%s\" not found", name.c_str());
+
+			return !mustExist;
+		}
+
+		const size_t size = stream->size();
+		const size_t read = stream->read(&buffer[0], buffer.size());
+
+		delete stream;
+
+		if ((size != expected.size()) || (read != expected.size())) {
+			warning("Resource \"%s\" has %u bytes (read %u), expected %u", name.c_str(),
+			        (uint) size, (uint) read, (uint) expected.size());
+			return false;
+		}
+
+		if (!expected.empty() && (std::memcmp(&buffer[0], &expected[0], expected.size()) != 0)) {
+			warning("Resource \"%s\" doesn't match", name.c_str());
+			return false;
+		}
+
+		return true;
+	}
+};
+
+static bool runTest(const Common::UString &dir, const ResourceSet &fixed, const ResourceSet &changing,
+                    bool mapArchives) {
+
+	ConfigMan.setBool(Common::kConfigRealmDefault, "mmaparchives", mapArchives);
+
+	ResMan.registerDataBase(dir);
+	ResMan.indexResourceDir("data", 0, 0, 2);
+	ResMan.indexArchive("fixed.key", 10);
+
+	std::vector<ReaderThread *> threads;
+	for (uint32 i = 0; i < kThreadCount; i++) {
+		threads.push_back(new ReaderThread(fixed, changing, 1 + i));
+		threads.back()->createThread();
+	}
+
+	for (uint32 i = 0; i < kIndexCycles; i++) {
+		Common::ChangeID change;
+
+		ResMan.indexArchive("changing.key", 20, &change);
+		ResMan.undo(change);
+	}
+
+	uint32 reads = 0, errors = 0;
+	for (std::vector<ReaderThread *>::iterator t = threads.begin(); t != threads.end(); ++t) {
+		(*t)->destroyThread();
+
+		reads  += (*t)->getReads();
+		errors += (*t)->getErrors();
+
+		delete *t;
+	}
+
+	ResMan.clear();
+
+	status("%s archives: %u threads read %u resources during %u index changes, %u errors",
+	       mapArchives ? "Mapped" : "Unmapped", kThreadCount, reads, kIndexCycles, errors);
+
+	return errors == 0;
+}
+
+int main(int UNUSED(argc), char **UNUSED(argv)) {
+	Common::initThreads();
+
+	// Don't touch the user's resource index cache, and don't read ahead
+	ConfigMan.setBool(Common::kConfigRealmDefault, "resindexcache", false);
+	ConfigMan.setInt (Common::kConfigRealmDefault, "prefetchthreads", 0);
+
+	const Common::UString dir = "resman_threads.tmp";
+
+	bool success = true;
+
+	try {
+		ResourceSet fixed, changing;
+
+		createResources(fixed   , "fixed"   , 1);
+		createResources(changing, "changing", 2);
+
+		Common::FilePath::createDirectories(dir + "/data");
+
+		writeBIF(dir + "/data/fixed.bif"   , fixed);
+		writeBIF(dir + "/data/changing.bif", changing);
+
+		writeKEY(dir + "/fixed.key"   , "data\\fixed.bif"   , fixed);
+		writeKEY(dir + "/changing.key", "data\\changing.bif", changing);
+
+		success = runTest(dir, fixed, changing, true ) && success;
+		success = runTest(dir, fixed, changing, false) && success;
+
+	} catch (...) {
+		Common::exceptionDispatcherError();
+		success = false;
+	}
+
+	std::remove((dir + "/data/fixed.bif").c_str());
+	std::remove((dir + "/data/changing.bif").c_str());
+	std::remove((dir + "/fixed.key").c_str());
+	std::remove((dir + "/changing.key").c_str());
+	std::remove((dir + "/data").c_str());
+	std::remove(dir.c_str());
+
+	return success ? 0 : 1;
+}
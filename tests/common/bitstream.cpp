@@ -0,0 +1,197 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Test reading bits directly out of memory.
+ *
+ *  A MemoryBitStreamImpl has to hand out the same bits as a BitStreamImpl
+ *  with the same memory layout, reading the same data through a stream.
+ *  Both are put through the same random sequences of reads, peeks and
+ *  skips, and every result and position is compared.
+ */
+
+#define SDL_MAIN_HANDLED
+
+#include <cstdlib>
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/memreadstream.h"
+#include "src/common/bitstream.h"
+
+static const int kOperations = 20000;
+
+enum Operation {
+	kOperationGetBit = 0,
+	kOperationGetBits,
+	kOperationPeekBits,
+	kOperationSkip,
+	kOperationAddBit,
+	kOperationRewind,
+	kOperationMAX
+};
+
+/** Run one operation on a bit stream, returning its result. Returns false if it threw. */
+static bool runOperation(Common::BitStream &bits, Operation operation, size_t n, uint32 &result) {
+	result = 0;
+
+	try {
+		switch (operation) {
+			case kOperationGetBit:
+				result = bits.getBit();
+				break;
+
+			case kOperationGetBits:
+				result = bits.getBits(n);
+				break;
+
+			case kOperationPeekBits:
+				result = bits.peekBits(n);
+				break;
+
+			case kOperationSkip:
+				bits.skip(n);
+				break;
+
+			case kOperationAddBit:
+				result = 0x5A5A5A5A & ((n == 0) ? 0 : (0xFFFFFFFF >> (32 - n)));
+				bits.addBit(result, n);
+				break;
+
+			case kOperationRewind:
+				bits.rewind();
+				break;
+
+			default:
+				break;
+		}
+	} catch (Common::Exception &UNUSED(e)) {
+		return false;
+	}
+
+	return true;
+}
+
+static size_t getOperationSize(Operation operation) {
+	if (operation == kOperationSkip)
+		return std::rand() % ((std::rand() % 8) ? 40 : 300);
+
+	if (operation == kOperationAddBit)
+		return std::rand() % 32;
+
+	return std::rand() % 33;
+}
+
+template<int valueBits, bool isLE, bool isMSB2LSB>
+static uint32 testLayout(const std::vector<byte> &data) {
+	Common::MemoryReadStream stream(&data[0], data.size());
+
+	Common::BitStreamImpl<valueBits, isLE, isMSB2LSB> streamBits(stream);
+	Common::MemoryBitStreamImpl<valueBits, isLE, isMSB2LSB> memoryBits(&data[0], data.size());
+
+	if (streamBits.size() != memoryBits.size()) {
+		warning("Layout %d, %d, %d: size %u != %u", valueBits, isLE, isMSB2LSB,
+		        (uint) memoryBits.size(), (uint) streamBits.size());
+		return 1;
+	}
+
+	if (streamBits.isMSBFirst() != memoryBits.isMSBFirst()) {
+		warning("Layout %d, %d, %d: bit order differs", valueBits, isLE, isMSB2LSB);
+		return 1;
+	}
+
+	uint32 errors = 0;
+
+	for (int i = 0; i < kOperations; i++) {
+		const Operation operation = (Operation) (std::rand() % kOperationMAX);
+		if ((operation == kOperationRewind) && ((std::rand() % 16) != 0))
+			continue;
+
+		const size_t n = getOperationSize(operation);
+
+		uint32 streamResult, memoryResult;
+		const bool streamSuccess = runOperation(streamBits, operation, n, streamResult);
+		const bool memorySuccess = runOperation(memoryBits, operation, n, memoryResult);
+
+		if (streamSuccess != memorySuccess) {
+			warning("Layout %d, %d, %d: operation %d(%u) %s with the memory bit stream only",
+			        valueBits, isLE, isMSB2LSB, (int) operation, (uint) n, memorySuccess ? "succeeded" : "failed");
+			errors++;
+		}
+
+		if (!streamSuccess || !memorySuccess) {
+			// The positions after running out of bits don't have to match. Start over
+			streamBits.rewind();
+			memoryBits.rewind();
+			continue;
+		}
+
+		if ((streamResult != memoryResult) || (streamBits.pos() != memoryBits.pos()) ||
+		    (streamBits.eos() != memoryBits.eos())) {
+
+			warning("Layout %d, %d, %d: operation %d(%u) returned 0x%08X at %u, expected 0x%08X at %u",
+			        valueBits, isLE, isMSB2LSB, (int) operation, (uint) n,
+			        memoryResult, (uint) memoryBits.pos(), streamResult, (uint) streamBits.pos());
+			errors++;
+
+			streamBits.rewind();
+			memoryBits.rewind();
+		}
+	}
+
+	return errors;
+}
+
+int main(int UNUSED(argc), char **UNUSED(argv)) {
+	std::srand(1);
+
+	uint32 errors = 0;
+
+	// A short buffer runs out of bits often, a longer one has room for long skips
+	const size_t sizes[] = { 8, 64, 1024 };
+
+	for (size_t i = 0; i < ARRAYSIZE(sizes); i++) {
+		std::vector<byte> data(sizes[i]);
+		for (size_t j = 0; j < data.size(); j++)
+			data[j] = std::rand();
+
+		errors += testLayout< 8, false, true >(data);
+		errors += testLayout< 8, false, false>(data);
+		errors += testLayout<16, true , true >(data);
+		errors += testLayout<16, true , false>(data);
+		errors += testLayout<16, false, true >(data);
+		errors += testLayout<16, false, false>(data);
+		errors += testLayout<32, true , true >(data);
+		errors += testLayout<32, true , false>(data);
+		errors += testLayout<32, false, true >(data);
+		errors += testLayout<32, false, false>(data);
+		errors += testLayout<64, true , true >(data);
+		errors += testLayout<64, true , false>(data);
+		errors += testLayout<64, false, true >(data);
+		errors += testLayout<64, false, false>(data);
+	}
+
+	status("Checked %u bit stream layouts, %u errors", (uint) (ARRAYSIZE(sizes) * 14), errors);
+
+	return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Test decoding Huffman codes through lookup tables.
+ *
+ *  Every symbol the Huffman decoder finds through its lookup tables has to
+ *  be the same symbol, with the same code length, that a straight search
+ *  finds when reading the bitstream one bit at a time and checking all
+ *  codes of each length in order. This is checked for prefix-free code
+ *  sets, and for random code sets with colliding and duplicate codes, in
+ *  bitstreams of different layouts.
+ */
+
+#define SDL_MAIN_HANDLED
+
+#include <cstdlib>
+
+#include <vector>
+#include <algorithm>
+
+#include "src/common/types.h"
+#include "src/common/util.h"
+#include "src/common/error.h"
+#include "src/common/memreadstream.h"
+#include "src/common/bitstream.h"
+#include "src/common/huffman.h"
+
+/** A set of Huffman codes. */
+struct CodeSet {
+	std::vector<uint32> codes;
+	std::vector<uint8>  lengths;
+	std::vector<uint32> symbols;
+
+	uint8 maxLength;
+
+	void add(uint32 code, uint8 length) {
+		codes.push_back(code);
+		lengths.push_back(length);
+		symbols.push_back(std::rand());
+
+		maxLength = MAX(maxLength, length);
+	}
+
+	CodeSet() : maxLength(0) {
+	}
+};
+
+static uint32 randomBits(uint8 n) {
+	uint32 bits = 0;
+	for (uint8 i = 0; i < n; i++)
+		bits = (bits << 1) | (std::rand() & 1);
+
+	return bits;
+}
+
+/** Create a prefix-free set of codes with lengths up to maxLength. */
+static void createPrefixFreeCodes(CodeSet &set, uint8 maxLength) {
+	std::vector<uint8> lengths;
+	for (int i = 0; i < 200; i++)
+		lengths.push_back(1 + (std::rand() % maxLength));
+
+	std::sort(lengths.begin(), lengths.end());
+
+	// Assign canonical codes, as long as there are codes left
+	uint32 code   = 0;
+	uint8  length = lengths[0];
+
+	for (size_t i = 0; i < lengths.size(); i++) {
+		code <<= lengths[i] - length;
+		length = lengths[i];
+
+		if ((length < 32) && (code >= (1U << length)))
+			break;
+
+		set.add(code, length);
+
+		if (code == (0xFFFFFFFF >> (32 - length)))
+			break;
+
+		code++;
+	}
+}
+
+/** Create a set of random codes, which collide with each other. */
+static void createRandomCodes(CodeSet &set, uint8 maxLength) {
+	for (int i = 0; i < 100; i++) {
+		const uint8 length = 1 + (std::rand() % maxLength);
+
+		set.add(randomBits(length), length);
+
+		// Add a few codes twice
+		if ((std::rand() % 16) == 0)
+			set.add(set.codes.back(), set.lengths.back());
+	}
+
+	// Add a few codes with bits set outside of their length
+	for (int i = 0; i < 8; i++) {
+		const uint8 length = 1 + (std::rand() % MIN<uint8>(maxLength, 31));
+
+		set.add(randomBits(length) | (1U << length), length);
+	}
+}
+
+/** Find a symbol by reading the bits one by one, and checking all codes of each length. */
+static bool findSymbol(const CodeSet &set, Common::BitStream &bits, uint32 &symbol) {
+	uint32 code = 0;
+
+	for (uint8 length = 1; length <= set.maxLength; length++) {
+		bits.addBit(code, length - 1);
+
+		for (size_t i = 0; i < set.codes.size(); i++) {
+			if ((set.lengths[i] == length) && (set.codes[i] == code)) {
+				symbol = set.symbols[i];
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/** Decode one symbol from each bit offset into the data, and compare the results. */
+template<typename BitStreamType>
+static uint32 testLayout(const CodeSet &set, const Common::Huffman &huffman, const std::vector<byte> &data) {
+	uint32 errors = 0;
+
+	const size_t maxOffset = (data.size() - 8) * 8;
+	for (size_t offset = 0; offset < maxOffset; offset++) {
+		Common::MemoryReadStream streamTable(&data[0], data.size()), streamSearch(&data[0], data.size());
+		BitStreamType bitsTable(streamTable), bitsSearch(streamSearch);
+
+		bitsTable.skip(offset);
+		bitsSearch.skip(offset);
+
+		uint32 symbolSearch = 0;
+		const bool foundSearch = findSymbol(set, bitsSearch, symbolSearch);
+
+		uint32 symbolTable = 0;
+		bool foundTable = true;
+
+		try {
+			symbolTable = huffman.getSymbol(bitsTable);
+		} catch (Common::Exception &UNUSED(e)) {
+			foundTable = false;
+		}
+
+		if (foundTable != foundSearch) {
+			warning("Offset %u: table %s a code, search %s", (uint) offset,
+			        foundTable ? "found" : "didn't find", foundSearch ? "found" : "didn't find");
+			errors++;
+			continue;
+		}
+
+		if (!foundTable)
+			continue;
+
+		if ((symbolTable != symbolSearch) || (bitsTable.pos() != bitsSearch.pos())) {
+			warning("Offset %u: table found symbol %u, ending at %u; search found %u, ending at %u",
+			        (uint) offset, symbolTable, (uint) bitsTable.pos(), symbolSearch, (uint) bitsSearch.pos());
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static uint32 testCodeSet(const CodeSet &set) {
+	const Common::Huffman huffman(0, set.codes.size(), &set.codes[0], &set.lengths[0], &set.symbols[0]);
+
+	// The data has to be a multiple of 8 bytes, for the 64-bit layouts
+	std::vector<byte> data(64);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = std::rand();
+
+	uint32 errors = 0;
+
+	errors += testLayout<Common::BitStream8MSB   >(set, huffman, data);
+	errors += testLayout<Common::BitStream8LSB   >(set, huffman, data);
+	errors += testLayout<Common::BitStream16LEMSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream16BELSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream32LEMSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream32LELSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream32BEMSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream64BEMSB>(set, huffman, data);
+	errors += testLayout<Common::BitStream64LELSB>(set, huffman, data);
+
+	return errors;
+}
+
+int main(int UNUSED(argc), char **UNUSED(argv)) {
+	std::srand(1);
+
+	uint32 sets = 0, errors = 0;
+
+	for (uint8 maxLength = 1; maxLength <= 32; maxLength++) {
+		for (int i = 0; i < 4; i++) {
+			CodeSet prefixFree, random;
+
+			createPrefixFreeCodes(prefixFree, maxLength);
+			createRandomCodes(random, maxLength);
+
+			errors += testCodeSet(prefixFree);
+			errors += testCodeSet(random);
+
+			sets += 2;
+		}
+	}
+
+	status("Checked %u Huffman code sets, %u errors", sets, errors);
+
+	return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Test finding the keyframes of an animation track to interpolate between.
+ *
+ *  The keyframe found with a cursor has to be the same keyframe a linear
+ *  scan from the start of the track finds, whether the animation plays
+ *  forward in small steps, loops, or jumps around in time.
+ */
+
+#define SDL_MAIN_HANDLED
+
+#include <cstdlib>
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/util.h"
+
+#include "src/graphics/aurora/keyframe.h"
+
+struct KeyFrame {
+	float time;
+};
+
+typedef std::vector<KeyFrame> KeyFrames;
+
+/** Find the keyframe to interpolate from with a linear scan over all keyframes. */
+static size_t findLastKeyFrameLinear(const KeyFrames &frames, float time) {
+	size_t lastFrame = 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		if (frames[i].time >= time)
+			break;
+
+		lastFrame = i;
+	}
+
+	return lastFrame;
+}
+
+static float randomFloat(float max) {
+	return (std::rand() * max) / RAND_MAX;
+}
+
+/** Create a track of keyframes, some of them sharing the same time. */
+static void createKeyFrames(KeyFrames &frames, size_t count, float length) {
+	frames.resize(count);
+
+	float time = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		if ((std::rand() % 8) != 0)
+			time += randomFloat((2.0f * length) / count);
+
+		frames[i].time = time;
+	}
+}
+
+static bool check(const KeyFrames &frames, float time, size_t &cursor) {
+	const size_t found    = Graphics::Aurora::findLastKeyFrame(frames, time, cursor);
+	const size_t expected = findLastKeyFrameLinear(frames, time);
+
+	if ((found == expected) && (cursor == found))
+		return true;
+
+	warning("%u keyframes, time %f: found keyframe %u (cursor %u), expected %u",
+	        (uint) frames.size(), time, (uint) found, (uint) cursor, (uint) expected);
+	return false;
+}
+
+/** Play the track forward in small steps, looping a few times. */
+static uint32 testPlay(const KeyFrames &frames, float length) {
+	uint32 errors = 0;
+
+	size_t cursor = 0;
+	for (int loop = 0; loop < 3; loop++)
+		for (float time = 0.0f; time <= length; time += randomFloat(length / 50.0f))
+			if (!check(frames, time, cursor))
+				errors++;
+
+	return errors;
+}
+
+/** Sample the track at random times, including times outside of the track. */
+static uint32 testJump(const KeyFrames &frames, float length) {
+	uint32 errors = 0;
+
+	size_t cursor = 0;
+	for (int i = 0; i < 200; i++)
+		if (!check(frames, randomFloat(1.5f * length) - 0.25f * length, cursor))
+			errors++;
+
+	return errors;
+}
+
+/** Sample the track right after, exactly at, and right before each keyframe's time. */
+static uint32 testExact(const KeyFrames &frames) {
+	uint32 errors = 0;
+
+	size_t cursor = 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		if (!check(frames, frames[i].time + 0.001f, cursor))
+			errors++;
+		if (!check(frames, frames[i].time, cursor))
+			errors++;
+		if (!check(frames, frames[i].time - 0.001f, cursor))
+			errors++;
+	}
+
+	return errors;
+}
+
+int main(int UNUSED(argc), char **UNUSED(argv)) {
+	std::srand(1);
+
+	uint32 tracks = 0, errors = 0;
+
+	for (size_t count = 1; count <= 64; count++) {
+		for (int i = 0; i < 16; i++) {
+			const float length = 0.5f + randomFloat(4.0f);
+
+			KeyFrames frames;
+			createKeyFrames(frames, count, length);
+
+			errors += testPlay(frames, length);
+			errors += testJump(frames, length);
+			errors += testExact(frames);
+
+			tracks++;
+		}
+	}
+
+	status("Checked %u keyframe tracks, %u errors", tracks, errors);
+
+	return (errors == 0) ? 0 : 1;
+}
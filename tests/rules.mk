@@ -0,0 +1,62 @@
+# xoreos - A reimplementation of BioWare's Aurora engine
+#
+# xoreos is the legal property of its developers, whose names
+# can be found in the AUTHORS file distributed with this source
+# distribution.
+#
+# xoreos is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 3
+# of the License, or (at your option) any later version.
+#
+# xoreos is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+
+# Tests, built and run by "make check".
+# Each test is a standalone program that returns 0 on success.
+
+# Libraries the Common tests link against
+LDADD_TESTS_COMMON = \
+    src/common/libcommon.la \
+    src/version/libversion.la \
+    $(LDADD) \
+    $(EMPTY)
+
+# Libraries the Aurora tests link against
+LDADD_TESTS_AURORA = \
+    src/aurora/libaurora.la \
+    src/common/libcommon.la \
+    src/version/libversion.la \
+    lua/liblua.la \
+    toluapp/libtoluapp.la \
+    $(LDADD) \
+    $(EMPTY)
+
+# Reading bits directly out of memory
+check_PROGRAMS += tests/common/test_bitstream
+TESTS          += tests/common/test_bitstream
+tests_common_test_bitstream_SOURCES = tests/common/bitstream.cpp
+tests_common_test_bitstream_LDADD   = $(LDADD_TESTS_COMMON)
+
+# Decoding Huffman codes through lookup tables
+check_PROGRAMS += tests/common/test_huffman
+TESTS          += tests/common/test_huffman
+tests_common_test_huffman_SOURCES = tests/common/huffman.cpp
+tests_common_test_huffman_LDADD   = $(LDADD_TESTS_COMMON)
+
+# Requesting resources from several threads at once
+check_PROGRAMS += tests/aurora/test_resman_threads
+TESTS          += tests/aurora/test_resman_threads
+tests_aurora_test_resman_threads_SOURCES = tests/aurora/resman_threads.cpp
+tests_aurora_test_resman_threads_LDADD   = $(LDADD_TESTS_AURORA)
+
+# Finding animation keyframes with a cursor
+check_PROGRAMS += tests/graphics/test_keyframe
+TESTS          += tests/graphics/test_keyframe
+tests_graphics_test_keyframe_SOURCES = tests/graphics/keyframe.cpp
+tests_graphics_test_keyframe_LDADD   = $(LDADD_TESTS_COMMON)